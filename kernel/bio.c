@@ -1,6 +1,6 @@
 // Buffer cache.
 //
-// The buffer cache is a linked list of buf structures holding
+// The buffer cache is a hash table of buf structures holding
 // cached copies of disk block contents.  Caching disk blocks
 // in memory reduces the number of disk reads and also provides
 // a synchronization point for disk blocks used by multiple processes.
@@ -12,9 +12,17 @@
 // * Do not use the buffer after calling brelse.
 // * Only one process at a time can use a buffer,
 //     so do not keep them longer than necessary.
+// * breadahead starts reads of blocks that will probably be
+//     wanted soon; the disk interrupt releases those buffers.
+// * bstart starts reading or writing locked buffers and
+//     returns at once; wait for them with bwait, or have the
+//     disk interrupt call a completion function for each.
+// * The I/O goes to the driver of the buffer's device in
+//     bdevsw[], each with a queue of its own.
 
 #include "types.h"
 #include "param.h"
+#include "memlayout.h"
 #include "spinlock.h"
 #include "sleeplock.h"
 #include "riscv.h"
@@ -22,77 +30,237 @@
 #include "fs.h"
 #include "buf.h"
 
+// Number of hash buckets. A prime spreads consecutive
+// block numbers evenly.
+#define NBUCKET 31
+
+// A hash bucket: a singly linked list of buffers through
+// next, protected by its own lock. The lock also protects
+// refcnt and timestamp of the buffers on the list.
+struct bucket
+{
+    struct spinlock lock;
+    struct buf*     head;
+};
+
 // 是一个全局结构体，管理整个缓冲区缓存。
 struct
 {
-    struct spinlock lock;        // 用于保护对 bcache 的并发访问。
-    struct buf      buf[NBUF];   // 是一个固定大小的缓冲区数组，每个元素是一个 struct buf
-
-    // Linked list of all buffers, through prev/next.
-    // Sorted by how recently the buffer was used.
-    // head.next is most recent, head.prev is least.
-    struct buf head;   // 是一个虚拟的链表头节点，用于维护所有缓冲区的双向链表。
+    // Held while looking for a buffer to recycle, so that at
+    // most one CPU walks the buckets, and at most one copy of
+    // a block gets cached.
+    struct spinlock evict;
+    int             nbuf;              // 启动时分配的缓冲区数量
+    struct bucket   bucket[NBUCKET];   // 按 (dev, blockno) 散列的桶
 } bcache;
 
+struct bdevsw bdevsw[NBDEV];
+
+// Read-ahead statistics, printed by procdump().
+static struct
+{
+    uint64 ra;      // 预读发出的块数
+    uint64 hit;     // bread() 命中预读块的次数
+    uint64 miss;    // bread() 需要同步读盘的次数
+    uint64 waste;   // 预读块未被使用就被替换的次数
+} bstat;
+
+// 计算 (dev, blockno) 所在的哈希桶
+static struct bucket* bhash(uint dev, uint blockno)
+{
+    return &bcache.bucket[((dev << 16) ^ blockno) % NBUCKET];
+}
+
+// Carve n bytes out of the page at *mem, moving on to a
+// fresh page when the current one runs out.
+// 从启动时分配的页面中切出 n 字节
+static void* bcarve(char** mem, uint* left, uint n)
+{
+    void* p;
+
+    if (*left < n)
+    {
+        if ((*mem = kalloc()) == 0)
+            panic("binit: out of memory");
+        *left = PGSIZE;
+    }
+    p = *mem;
+    *mem += n;
+    *left -= n;
+    return p;
+}
 
+// Size the cache from physical memory: at most 1/BCACHEFRAC
+// of RAM, but never fewer than NBUF buffers and never more
+// than there are blocks on the disk.
 // 初始化缓冲区缓存。
 void binit(void)
 {
-    struct buf* b;
+    struct bucket* bk;
+    struct buf*    b;
+    char *hmem = 0, *dmem = 0;
+    uint  hleft = 0, dleft = 0;
+    int   i, n;
+
+    initticketlock(&bcache.evict, "bcache");
+    for (i = 0; i < NBUCKET; i++)
+        initlock(&bcache.bucket[i].lock, "bcache.bucket");
 
-    initlock(&bcache.lock, "bcache");
+    n = (PHYSTOP - KERNBASE) / BCACHEFRAC / (BSIZE + sizeof(struct buf));
+    if (n > FSSIZE)
+        n = FSSIZE;
+    if (n < NBUF)
+        n = NBUF;
 
-    // Create linked list of buffers
-    bcache.head.prev = &bcache.head;
-    bcache.head.next = &bcache.head;
-    for (b = bcache.buf; b < bcache.buf + NBUF; b++)
+    for (i = 0; i < n; i++)
     {
-        b->next = bcache.head.next;
-        b->prev = &bcache.head;
+        b            = bcarve(&hmem, &hleft, sizeof(struct buf));
+        b->data      = bcarve(&dmem, &dleft, BSIZE);
+        b->valid     = 0;
+        b->disk      = 0;
+        b->iodone    = 0;
+        b->ra        = 0;
+        b->dev       = 0;
+        b->blockno   = 0;
+        b->refcnt    = 0;
+        b->timestamp = 0;
         initsleeplock(&b->lock, "buffer");
-        bcache.head.next->prev = b;
-        bcache.head.next       = b;
+        bk       = &bcache.bucket[i % NBUCKET];
+        b->next  = bk->head;
+        bk->head = b;
     }
+    bcache.nbuf = n;
 }
 
-// Look through buffer cache for block on device dev.
-// If not found, allocate a buffer.
-// In either case, return locked buffer.
-// 查找或分配一个缓冲区，用于指定设备 dev 和块号 blockno 的磁盘块。
-static struct buf* bget(uint dev, uint blockno)
+// Find the buffer for (dev, blockno) on bucket bk.
+// Caller must hold bk->lock.
+// 在哈希桶中查找指定的磁盘块
+static struct buf* blookup(struct bucket* bk, uint dev, uint blockno)
 {
     struct buf* b;
 
-    acquire(&bcache.lock);
+    for (b = bk->head; b; b = b->next)
+        if (b->dev == dev && b->blockno == blockno)
+            return b;
+    return 0;
+}
+
+// Look through buffer cache for block on device dev.
+// If not found, recycle a buffer for it.
+// In either case, return it with refcnt incremented but not
+// locked, and set *hit to whether it was already cached.
+// 查找或分配一个缓冲区（增加引用计数，但不加睡眠锁）。
+static struct buf* bfind(uint dev, uint blockno, int* hit)
+{
+    struct bucket* bk = bhash(dev, blockno);
+    struct bucket* v;
+    struct bucket* bestbk;
+    struct buf *b, *best, **pp;
 
     // Is the block already cached?
-    for (b = bcache.head.next; b != &bcache.head; b = b->next)
+    *hit = 1;
+    acquire(&bk->lock);
+    b = blookup(bk, dev, blockno);
+    if (b)
     {
-        if (b->dev == dev && b->blockno == blockno)
-        {
-            b->refcnt++;
-            release(&bcache.lock);
-            acquiresleep(&b->lock);
-            return b;
-        }
+        b->refcnt++;
+        release(&bk->lock);
+        return b;
     }
+    release(&bk->lock);
 
     // Not cached.
     // Recycle the least recently used (LRU) unused buffer.
-    for (b = bcache.head.prev; b != &bcache.head; b = b->prev)
+    // Other CPUs may have cached the block while bk was
+    // unlocked, so look again once eviction is serialized.
+    acquire(&bcache.evict);
+    acquire(&bk->lock);
+    b = blookup(bk, dev, blockno);
+    if (b)
     {
-        if (b->refcnt == 0)
+        b->refcnt++;
+        release(&bk->lock);
+        release(&bcache.evict);
+        return b;
+    }
+
+    // Keep the lock of the bucket holding the best candidate
+    // so that nobody can pick it up before we move it.
+    best   = 0;
+    bestbk = 0;
+    for (v = bcache.bucket; v < &bcache.bucket[NBUCKET]; v++)
+    {
+        int found = 0;
+        if (v != bk)
+            acquire(&v->lock);
+        for (b = v->head; b; b = b->next)
         {
-            b->dev     = dev;
-            b->blockno = blockno;
-            b->valid   = 0;
-            b->refcnt  = 1;
-            release(&bcache.lock);
-            acquiresleep(&b->lock);
-            return b;
+            if (b->refcnt == 0 && (best == 0 || b->timestamp < best->timestamp))
+            {
+                best  = b;
+                found = 1;
+            }
         }
+        if (found)
+        {
+            if (bestbk && bestbk != bk)
+                release(&bestbk->lock);
+            bestbk = v;
+        }
+        else if (v != bk)
+            release(&v->lock);
     }
-    panic("bget: no buffers");
+    if (best == 0)
+        panic("bget: no buffers");
+
+    if (bestbk != bk)
+    {
+        for (pp = &bestbk->head; *pp != best; pp = &(*pp)->next)
+            ;
+        *pp = best->next;
+        release(&bestbk->lock);
+        best->next = bk->head;
+        bk->head   = best;
+    }
+    if (best->ra)
+        __sync_fetch_and_add(&bstat.waste, 1);
+    best->dev     = dev;
+    best->blockno = blockno;
+    best->valid   = 0;
+    best->ra      = 0;
+    best->refcnt  = 1;
+    release(&bk->lock);
+    release(&bcache.evict);
+    *hit = 0;
+    return best;
+}
+
+// Return a locked buffer for block on device dev.
+// 查找或分配一个缓冲区，用于指定设备 dev 和块号 blockno 的磁盘块。
+static struct buf* bget(uint dev, uint blockno)
+{
+    struct buf* b;
+    int         hit;
+
+    b = bfind(dev, blockno, &hit);
+    acquiresleep(&b->lock);
+    return b;
+}
+
+// Drop a reference to b, which the caller has unlocked.
+// Stamp it with the current time for LRU eviction.
+static void bput(struct buf* b)
+{
+    struct bucket* bk = bhash(b->dev, b->blockno);
+
+    acquire(&bk->lock);
+    b->refcnt--;
+    if (b->refcnt == 0)
+    {
+        // no one is waiting for it.
+        b->timestamp = ticks;
+    }
+    release(&bk->lock);
 }
 
 // Return a locked buf with the contents of the indicated block.
@@ -104,9 +272,148 @@ struct buf* bread(uint dev, uint blockno)
     b = bget(dev, blockno);
     if (!b->valid)
     {
-        virtio_disk_rw(b, 0);
-        b->valid = 1;
+        __sync_fetch_and_add(&bstat.miss, 1);
+        bstart(&b, 1, 0, 0);
+        bwait(&b, 1);
+    }
+    else if (b->ra)
+        __sync_fetch_and_add(&bstat.hit, 1);
+    b->ra = 0;
+    return b;
+}
+
+// Return a locked buf for a block that has just been
+// allocated, zeroed without reading it from the disk, since
+// its old contents are of no interest.
+// 返回新分配块的已锁定缓冲区，内容清零而不读磁盘。
+struct buf* bnew(uint dev, uint blockno)
+{
+    struct buf* b;
+
+    b = bget(dev, blockno);
+    memset(b->data, 0, BSIZE);
+    b->valid = 1;
+    b->ra    = 0;
+    return b;
+}
+
+// Start reading the n blocks in blocks[] into the cache, and
+// return without waiting. Blocks that are already cached, or
+// on their way, are skipped.
+// 异步预读 n 个磁盘块到缓冲区缓存中，不等待完成。
+void breadahead(uint dev, uint* blocks, int n)
+{
+    struct buf* bs[RAMAX];
+    struct buf* b;
+    int         i, m, hit;
+
+    if (n > RAMAX)
+        n = RAMAX;
+    for (i = m = 0; i < n; i++)
+    {
+        b = bfind(dev, blocks[i], &hit);
+        if (hit)
+        {
+            bput(b);
+            continue;
+        }
+        // once bfind() let go of the bucket, another process's
+        // bget() may have found the recycled buffer and read or
+        // even dirtied it before us: then leave it alone.
+        acquiresleep(&b->lock);
+        if (b->valid)
+        {
+            releasesleep(&b->lock);
+            bput(b);
+            continue;
+        }
+        b->ra   = 1;
+        bs[m++] = b;
+    }
+    if (m == 0)
+        return;
+    __sync_fetch_and_add(&bstat.ra, m);
+    bstart(bs, m, 0, bdone);
+}
+
+// Called by the disk interrupt when a read started by
+// breadahead() completes. Release the buffer on behalf of the
+// process that started it.
+// 异步读完成：标记数据有效并释放缓冲区。
+void bdone(struct buf* b)
+{
+    b->valid = 1;
+    releasesleep(&b->lock);
+    bput(b);
+}
+
+// The driver of block device dev.
+// 返回块设备 dev 的驱动
+static struct bdevsw* bdev(uint dev)
+{
+    if (dev >= NBDEV || bdevsw[dev].start == 0)
+        panic("bdev: no such block device");
+    return &bdevsw[dev];
+}
+
+// Start reading (write == 0) or writing the n locked buffers
+// of bs, and return without waiting. The disk sorts and
+// merges them with whatever else is queued. If done is not
+// 0, the disk interrupt calls it for each buffer once its I/O
+// completes, and the buffer then belongs to done; otherwise
+// the caller waits with bwait(). The buffers need not be in
+// the cache: the log writes its private snapshots this way.
+// 启动 n 个已加锁缓冲区的读写后立即返回，完成时可由磁盘中断回调 done
+void bstart(struct buf** bs, int n, int write, void (*done)(struct buf*))
+{
+    int i, j;
+
+    for (i = 0; i < n; i++)
+        bs[i]->iodone = done;
+    // each run of buffers of one device goes to its driver.
+    for (i = 0; i < n; i = j)
+    {
+        for (j = i + 1; j < n && bs[j]->dev == bs[i]->dev; j++)
+            ;
+        bdev(bs[i]->dev)->start(bs + i, j - i, write);
+    }
+}
+
+// Wait for the I/O that bstart() started without a
+// completion function on the n buffers of bs. Read buffers
+// then hold valid data.
+// 等待 bstart() 启动的读写全部完成
+void bwait(struct buf** bs, int n)
+{
+    int i, j;
+
+    for (i = 0; i < n; i = j)
+    {
+        for (j = i + 1; j < n && bs[j]->dev == bs[i]->dev; j++)
+            ;
+        bdev(bs[i]->dev)->wait(bs + i, j - i);
+    }
+    for (i = 0; i < n; i++)
+        bs[i]->valid = 1;
+}
+
+// Return a locked buf for the indicated block, with a read
+// of it started if it is not cached. Wait for the contents
+// with bwait(). Lets a caller read many blocks at once.
+// 返回指定块的已锁定缓冲区，未缓存时只启动读盘不等待
+struct buf* breadstart(uint dev, uint blockno)
+{
+    struct buf* b;
+
+    b = bget(dev, blockno);
+    if (!b->valid)
+    {
+        __sync_fetch_and_add(&bstat.miss, 1);
+        bstart(&b, 1, 0, 0);
     }
+    else if (b->ra)
+        __sync_fetch_and_add(&bstat.hit, 1);
+    b->ra = 0;
     return b;
 }
 
@@ -116,47 +423,54 @@ void bwrite(struct buf* b)
 {
     if (!holdingsleep(&b->lock))
         panic("bwrite");
-    virtio_disk_rw(b, 1);
+    bstart(&b, 1, 1, 0);
+    bwait(&b, 1);
 }
 
 // Release a locked buffer.
-// Move to the head of the most-recently-used list.
-// 释放一个锁定的缓冲区，并将其移动到 LRU 链表的头部（标记为最近使用）。
+// 释放一个锁定的缓冲区，并记录最近一次使用的时间（用于 LRU 替换）。
 void brelse(struct buf* b)
 {
     if (!holdingsleep(&b->lock))
         panic("brelse");
 
     releasesleep(&b->lock);
-
-    acquire(&bcache.lock);
-    b->refcnt--;
-    if (b->refcnt == 0)
-    {
-        // no one is waiting for it.
-        b->next->prev          = b->prev;
-        b->prev->next          = b->next;
-        b->next                = bcache.head.next;
-        b->prev                = &bcache.head;
-        bcache.head.next->prev = b;
-        bcache.head.next       = b;
-    }
-
-    release(&bcache.lock);
+    bput(b);
 }
 
 // 增加缓冲区的引用计数，防止其被 LRU 替换（“固定”缓冲区）。
 void bpin(struct buf* b)
 {
-    acquire(&bcache.lock);
+    struct bucket* bk = bhash(b->dev, b->blockno);
+
+    acquire(&bk->lock);
     b->refcnt++;
-    release(&bcache.lock);
+    release(&bk->lock);
 }
 
 // 减少引用计数，允许缓冲区被替换（“释放固定”）。
 void bunpin(struct buf* b)
 {
-    acquire(&bcache.lock);
+    struct bucket* bk = bhash(b->dev, b->blockno);
+
+    acquire(&bk->lock);
     b->refcnt--;
-    release(&bcache.lock);
+    release(&bk->lock);
+}
+
+// print read-ahead statistics.
+// 打印预读统计信息
+void bcachedump(void)
+{
+    printf("bcache: %d buffers, readahead %d, hit %d, miss %d, wasted %d\n", bcache.nbuf, (int)bstat.ra,
+           (int)bstat.hit, (int)bstat.miss, (int)bstat.waste);
+}
+
+// print each block device's statistics.
+// 打印各块设备的统计信息
+void bdevdump(void)
+{
+    for (int i = 0; i < NBDEV; i++)
+        if (bdevsw[i].dump)
+            bdevsw[i].dump(i);
 }
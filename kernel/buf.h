@@ -1,13 +1,34 @@
 // 管理文件系统或块设备的缓冲区，用于处理从磁盘读取或写入的数据块
 struct buf
 {
-    int  valid;              // 表示缓冲区是否包含从磁盘读取的有效数据。
-    int  disk;               // 表示磁盘是否“拥有”该缓冲区。
-    uint dev;                // 表示设备编号，用于标识缓冲区关联的磁盘设备。
-    uint blockno;            // 表示缓冲区对应的磁盘块编号，指定该缓冲区存储的是磁盘上的哪个数据块。
-    struct sleeplock lock;   // 一个睡眠锁（sleeplock），用于同步访问缓冲区。
-    uint             refcnt;        // 引用计数，记录当前有多少进程或线程正在使用该缓冲区。
-    struct buf*      prev;          // 指向实现LRU缓存的双向链表结构，帮助跟踪缓冲区的使用顺序。
-    struct buf*      next;          // 指向下一个缓冲区的指针，同样用于LRU缓存链表。
-    uchar            data[BSIZE];   // 实际存储数据的数组，BSIZE是块大小
+    int              valid;       // 表示缓冲区是否包含从磁盘读取的有效数据。
+    int              disk;        // 表示磁盘是否“拥有”该缓冲区。
+    void (*iodone)(struct buf*);  // 非空时，读写完成后由磁盘中断调用它（见 bstart()）。
+    int              ra;          // 由预读读入、尚未被 bread() 使用。
+    uint             dev;         // 表示设备编号，用于标识缓冲区关联的磁盘设备。
+    uint             blockno;     // 表示缓冲区对应的磁盘块编号，指定该缓冲区存储的是磁盘上的哪个数据块。
+    struct sleeplock lock;        // 一个睡眠锁（sleeplock），用于同步访问缓冲区。
+    uint             refcnt;      // 引用计数，记录当前有多少进程或线程正在使用该缓冲区。
+    uint             timestamp;   // 引用计数降为 0 时的 ticks，用于 LRU 替换。
+    struct buf*      next;        // 指向同一哈希桶中的下一个缓冲区。
+    struct buf*      qnext;       // 磁盘请求队列中的下一个缓冲区。
+    int              qwrite;      // 在磁盘请求队列中等待写盘（而非读盘）。
+    uchar*           data;        // 实际存储数据的 BSIZE 字节区域，启动时分配
 };
+
+// block device switch: the driver of each block device, by
+// device number, as devsw is for character devices. start()
+// begins reading or writing n locked buffers of the device
+// and returns; a buffer with iodone set is handed to it once
+// its I/O completes, and wait() waits for the others. See
+// bstart() and bwait().
+// 块设备切换表：按设备号找到块设备驱动
+struct bdevsw
+{
+    char* name;                                          // 设备名，用于统计输出
+    void (*start)(struct buf** bs, int n, int write);    // 启动 n 个缓冲区的读写，不等待
+    void (*wait)(struct buf** bs, int n);                // 等待 start() 启动的读写完成
+    void (*dump)(uint dev);                              // 打印设备统计信息，可为空
+};
+
+extern struct bdevsw bdevsw[];
@@ -21,6 +21,7 @@
 #include "riscv.h"
 #include "defs.h"
 #include "proc.h"
+#include "poll.h"
 
 #define BACKSPACE 0x100
 #define C(x)      ((x) - '@')   // Control-x
@@ -59,18 +60,26 @@ struct
 } cons;
 
 
-// user write()s to the console go here.
-// 处理用户态或内核态的 write 系统调用，将数据写入控制台
-int consolewrite(int user_src, uint64 src, int n)
+// user write()s to the console go here, copied in a
+// chunk at a time. if nonblock, only what fits in the
+// uart's output buffer is written.
+// 处理用户态或内核态的 write 系统调用，将数据分块写入控制台
+int consolewrite(int user_src, uint64 src, int n, int nonblock)
 {
-    int i;
+    char buf[128];
+    int  i, m, r;
 
-    for (i = 0; i < n; i++)
+    for (i = 0; i < n; i += r)
     {
-        char c;
-        if (either_copyin(&c, user_src, src + i, 1) == -1)
+        m = n - i < sizeof(buf) ? n - i : sizeof(buf);
+        if (either_copyin(buf, user_src, src + i, m) == -1)
             break;
-        uartputc(c);
+        r = uartwrite(buf, m, nonblock);
+        if (r < m)
+        {
+            i += r;
+            break;
+        }
     }
 
     return i;
@@ -80,9 +89,10 @@ int consolewrite(int user_src, uint64 src, int n)
 // user read()s from the console go here.
 // copy (up to) a whole input line to dst.
 // user_dist indicates whether dst is a user
-// or kernel address.
+// or kernel address. if nonblock, returns -1 instead of
+// waiting for a line, or the part of one it has.
 // 处理用户态或内核态的 read 系统调用，从控制台读取输入
-int consoleread(int user_dst, uint64 dst, int n)
+int consoleread(int user_dst, uint64 dst, int n, int nonblock)
 {
     uint target;
     int  c;
@@ -96,13 +106,17 @@ int consoleread(int user_dst, uint64 dst, int n)
         // input into cons.buffer.
         while (cons.r == cons.w)
         {
-            if (killed(myproc()))
+            if (killed(myproc()) || (nonblock && n == target))
             {
                 release(&cons.lock);
                 return -1;
             }
+            if (nonblock)
+                break;
             sleep(&cons.r, &cons.lock);
         }
+        if (cons.r == cons.w)
+            break;
 
         c = cons.buf[cons.r++ % INPUT_BUF_SIZE];
 
@@ -137,6 +151,20 @@ int consoleread(int user_dst, uint64 dst, int n)
     return target - n;
 }
 
+// Tell poll() whether a line is waiting to be read. Writes
+// count as always ready: they wait only for the uart to drain.
+// 返回控制台是否可读
+static int consolepoll(void)
+{
+    int ev = POLLOUT;
+
+    acquire(&cons.lock);
+    if (cons.r != cons.w)
+        ev |= POLLIN;
+    release(&cons.lock);
+    return ev;
+}
+
 
 // the console input interrupt handler.
 // uartintr() calls this for input character.
@@ -184,6 +212,7 @@ void consoleintr(int c)
                 // has arrived.
                 cons.w = cons.e;
                 wakeup(&cons.r);
+                pollwake();
             }
         }
         break;
@@ -204,4 +233,5 @@ void consoleinit(void)
     // 注册读写函数到设备切换表
     devsw[CONSOLE].read  = consoleread;
     devsw[CONSOLE].write = consolewrite;
+    devsw[CONSOLE].poll  = consolepoll;
 }
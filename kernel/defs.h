@@ -1,21 +1,34 @@
 struct buf;
 struct context;
+struct dirent;
 struct file;
 struct inode;
+struct iovec;
 struct pipe;
 struct proc;
+struct rwlock;
+struct seqlock;
 struct spinlock;
 struct sleeplock;
 struct stat;
 struct superblock;
+struct vma;
 
 // bio.c
 void            binit(void);
 struct buf*     bread(uint, uint);
+struct buf*     bnew(uint, uint);
 void            brelse(struct buf*);
 void            bwrite(struct buf*);
 void            bpin(struct buf*);
 void            bunpin(struct buf*);
+void            breadahead(uint, uint*, int);
+void            bdone(struct buf*);
+void            bstart(struct buf**, int, int, void (*)(struct buf*));
+void            bwait(struct buf**, int);
+struct buf*     breadstart(uint, uint);
+void            bcachedump(void);
+void            bdevdump(void);
 
 // console.c
 void            consoleinit(void);
@@ -24,24 +37,41 @@ void            consputc(int);
 
 // exec.c
 int             exec(char*, char**);
+void            execcacheinit(void);
+void            execinval(struct inode*);
+void            execcachedump(void);
+void            spawnfree(char*, char**);
 
 // file.c
 struct file*    filealloc(void);
 void            fileclose(struct file*);
 struct file*    filedup(struct file*);
 void            fileinit(void);
+int             filecount(void);
 int             fileread(struct file*, uint64, int n);
 int             filestat(struct file*, uint64 addr);
 int             filewrite(struct file*, uint64, int n);
+int             filefcntl(struct file*, int, int);
+int             filepoll(struct file*);
+int             filesplice(struct file*, uint64, int);
+int             filereadv(struct file*, struct iovec*, int);
+int             filewritev(struct file*, struct iovec*, int);
+int             filepread(struct file*, uint64, int, uint);
+int             filepwrite(struct file*, uint64, int, uint);
 
 // fs.c
 void            fsinit(int);
+void            dcacheput(struct inode*, char*, uint);
+void            dcachedump(void);
 int             dirlink(struct inode*, char*, uint);
+void            dirunlink(struct inode*, char*, uint);
+int             dirnext(struct inode*, uint*, struct dirent*, struct inode**, int);
 struct inode*   dirlookup(struct inode*, char*, uint*);
 struct inode*   ialloc(uint, short);
 struct inode*   idup(struct inode*);
 void            iinit();
 void            ilock(struct inode*);
+void            ilockshared(struct inode*);
 void            iput(struct inode*);
 void            iunlock(struct inode*);
 void            iunlockput(struct inode*);
@@ -51,41 +81,102 @@ struct inode*   namei(char*);
 struct inode*   nameiparent(char*, char*);
 int             readi(struct inode*, int, uint64, uint, uint);
 void            stati(struct inode*, struct stat*);
+void            istat(struct inode*, struct stat*);
 int             writei(struct inode*, int, uint64, uint, uint);
+int             writeiblocks(struct inode*, uint);
+uint            writeimax(struct inode*);
 void            itrunc(struct inode*);
 
 // ramdisk.c
 void            ramdiskinit(void);
-void            ramdiskintr(void);
-void            ramdiskrw(struct buf*);
+void            ramdiskload(uint);
 
 // kalloc.c
 void*           kalloc(void);
+void*           kalloc_zeroed(void);
+int             kzero(void);
 void            kfree(void *);
 void            kinit(void);
+void            kinithart(void);
+void            kmemdump(void);
+void            kdup(void*);
+int             krefcnt(void*);
+void            kmeminfo(uint64*, uint64*);
+
+// slab.c
+void            slabinit(void);
+void*           kmalloc(uint);
+void            kmfree(void*);
+void            slabdump(void);
 
 // log.c
 void            initlog(int, struct superblock*);
 void            log_write(struct buf*);
+void            log_free(uint);
+int             log_unsafe(uint);
+int             log_opmax(void);
 void            begin_op(void);
+void            begin_opn(int);
 void            end_op(void);
+void            end_opn(int);
+void            log_sync(void);
+void            logdump(void);
+
+// ksm.c
+void            ksminit(void);
+uint64          ksmsaved(void);
+void            ksmdump(void);
+
+// mmap.c
+uint64          mmap(uint64, uint64, int, int, struct file*, uint64);
+int             munmap(uint64, uint64);
+int             vmaadd(struct proc*, uint64, uint64, int, int, struct file*, uint64, uint64);
+struct vma*     vmalookup(struct proc*, uint64);
+uint64          vmafloor(struct proc*);
+int             vmafault(struct proc*, uint64, int);
+void            vmaprefault(struct proc*, uint64, uint64, int);
+int             vmacopy(struct proc*, struct proc*);
+void            vmaunmapall(struct proc*);
+void            vmashare(struct proc*, struct proc*);
+void            vmadrop(struct proc*);
+
+// pcache.c
+void            pcacheinit(void);
+char*           pcacheget(struct inode*, uint);
+void            pcacheinval(struct inode*);
+void            pcachedump(void);
 
 // pipe.c
 int             pipealloc(struct file**, struct file**);
 void            pipeclose(struct pipe*, int);
-int             piperead(struct pipe*, uint64, int);
-int             pipewrite(struct pipe*, uint64, int);
+int             piperead(struct pipe*, uint64, int, int, int);
+int             pipewrite(struct pipe*, uint64, int, int, int);
+int             pipepoll(struct pipe*, int);
+int             pipesize(struct pipe*);
+int             piperesize(struct pipe*, int);
 
 // printf.c
 void            printf(char*, ...);
 void            panic(char*) __attribute__((noreturn));
 void            printfinit(void);
 
+// prof.c
+void            profinit(void);
+uint64          profdeadline(void);
+void            proftick(void);
+int             prof(int, uint64, int);
+
 // proc.c
 int             cpuid(void);
 void            exit(int);
 int             fork(void);
+int             clone(uint64, uint64, uint64);
+int             spawn(char*, char**, int*);
+int             join(int, uint64);
+int             threaded(struct proc*);
+int             futex(uint64, int, int);
 int             growproc(int);
+int             kthread(void (*)(void), char*);
 void            proc_mapstacks(pagetable_t);
 pagetable_t     proc_pagetable(struct proc *);
 void            proc_freepagetable(pagetable_t, uint64);
@@ -102,7 +193,13 @@ void            sleep(void*, struct spinlock*);
 void            userinit(void);
 int             wait(uint64);
 void            wakeup(void*);
+void            wakeupone(void*);
 void            yield(void);
+void            preempt(void);
+int             setsched(int, int, int);
+int             procinfo(uint64, int);
+int             nproc(void);
+int             ncpu(void);
 int             either_copyout(int user_dst, uint64 dst, void *src, uint64 len);
 int             either_copyin(void *dst, int user_src, uint64 src, uint64 len);
 void            procdump(void);
@@ -110,24 +207,58 @@ void            procdump(void);
 // swtch.S
 void            swtch(struct context*, struct context*);
 
+// usercopy.S
+extern char     ucopystart[], ucopyend[], ucopyfault[];
+int             ucopy(char *, char *, uint64);
+int             ucopystr(char *, char *, uint64);
+
 // spinlock.c
 void            acquire(struct spinlock*);
 int             holding(struct spinlock*);
 void            initlock(struct spinlock*, char*);
+void            initticketlock(struct spinlock*, char*);
+void            freelock(struct spinlock*);
 void            release(struct spinlock*);
 void            push_off(void);
 void            pop_off(void);
 
+// rwlock.c
+void            initrwlock(struct rwlock*, char*);
+void            acquireread(struct rwlock*);
+void            releaseread(struct rwlock*);
+void            acquirewrite(struct rwlock*);
+void            releasewrite(struct rwlock*);
+int             holdingwrite(struct rwlock*);
+
+// seqlock.c
+void            initseqlock(struct seqlock*, char*);
+void            writeseqbegin(struct seqlock*);
+void            writeseqend(struct seqlock*);
+uint            readseqbegin(struct seqlock*);
+int             readseqretry(struct seqlock*, uint);
+
 // sleeplock.c
 void            acquiresleep(struct sleeplock*);
+void            acquiresleepshared(struct sleeplock*);
 void            releasesleep(struct sleeplock*);
 int             holdingsleep(struct sleeplock*);
 void            initsleeplock(struct sleeplock*, char*);
 
+// sprintf.c
+int             snprintf(char*, int, char*, ...);
+
+// stats.c
+void            statsinit(void);
+void            statsaddlock(struct spinlock*);
+void            statsfreelock(struct spinlock*);
+void            statsaddsleeplock(struct sleeplock*);
+
 // string.c
 int             memcmp(const void*, const void*, uint);
 void*           memmove(void*, const void*, uint);
 void*           memset(void*, int, uint);
+void            pgzero(void*);
+void            pgcopy(void*, const void*);
 char*           safestrcpy(char*, const char*, int);
 int             strlen(const char*);
 int             strncmp(const char*, const char*, uint);
@@ -137,6 +268,8 @@ char*           strncpy(char*, const char*, int);
 void            argint(int, int*);
 int             argstr(int, char*, int);
 void            argaddr(int, uint64 *);
+int             syscallstats(uint64, int);
+int             ringenter(int);
 int             fetchstr(uint64, char*, int);
 int             fetchaddr(uint64, uint64*);
 void            syscall();
@@ -146,28 +279,55 @@ extern uint     ticks;
 void            trapinit(void);
 void            trapinithart(void);
 extern struct spinlock tickslock;
+extern struct ushared*  ushared;
 void            usertrapret(void);
+void            tsleep(uint);
+uint            pollstart(void);
+void            pollstop(void);
+int             pollwait(uint*, uint, int);
+void            pollwake(void);
+uint            readticks(void);
+void            timerarm(void);
+void            timerkick(int);
 
 // uart.c
 void            uartinit(void);
 void            uartintr(void);
-void            uartputc(int);
+int             uartwrite(char*, int, int);
 void            uartputc_sync(int);
 int             uartgetc(void);
 
 // vm.c
+extern struct spinlock vmlock;
 void            kvminit(void);
 void            kvminithart(void);
 void            kvmmap(pagetable_t, uint64, uint64, uint64, int);
+pagetable_t     kvmcreate(void);
+void            kvmfree(pagetable_t);
+void            kvmuse(pagetable_t);
+void            kvmreset(pagetable_t);
+int             ukmapfault(uint64, int);
 int             mappages(pagetable_t, uint64, uint64, uint64, int);
 pagetable_t     uvmcreate(void);
+uint64          uvmrss(pagetable_t);
 void            uvmfirst(pagetable_t, uchar *, uint);
 uint64          uvmalloc(pagetable_t, uint64, uint64, int);
 uint64          uvmdealloc(pagetable_t, uint64, uint64);
 int             uvmcopy(pagetable_t, pagetable_t, uint64);
+int             uvmcopyrange(pagetable_t, pagetable_t, uint64, uint64);
 void            uvmfree(pagetable_t, uint64);
 void            uvmunmap(pagetable_t, uint64, uint64, int);
 void            uvmclear(pagetable_t, uint64);
+int             cowfault(pagetable_t, uint64);
+int             vmfault(pagetable_t, uint64, int);
+int             uvmmapshared(pagetable_t, uint64, uint64, int);
+int             uvmtouch(pagetable_t, uint64, uint64, int);
+void            vmdump(void);
+uint64          uvmshare(pagetable_t, uint64);
+int             uvmgift(pagetable_t, uint64, uint64);
+uint64          uvmrdonly(pagetable_t, uint64);
+void            uvmremap(pagetable_t, uint64, uint64);
+uint64          uvmclean(pagetable_t, uint64);
 pte_t *         walk(pagetable_t, uint64, int);
 uint64          walkaddr(pagetable_t, uint64);
 int             copyout(pagetable_t, uint64, char *, uint64);
@@ -182,8 +342,7 @@ void            plic_complete(int);
 
 // virtio_disk.c
 void            virtio_disk_init(void);
-void            virtio_disk_rw(struct buf *, int);
-void            virtio_disk_intr(void);
+void            virtio_disk_intr(int);
 
 // number of elements in fixed-size array
 #define NELEM(x) (sizeof(x)/sizeof((x)[0]))
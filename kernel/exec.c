@@ -6,6 +6,194 @@
 #include "proc.h"
 #include "defs.h"
 #include "elf.h"
+#include "fs.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "fcntl.h"
+
+// Most segments a program may have paged in on demand; any
+// further ones are loaded by exec() itself. NSEG <= NVMA.
+#define NSEG 4
+
+// Most program headers the exec cache keeps for a program.
+#define NPH 8
+
+// Exec cache.
+//
+// For each of the NEXECCACHE programs exec() ran last, keyed
+// by inode, the ELF header, the program headers, and up to
+// EXECPAGES pages of its read-only segments, from the page
+// cache. The cache holds a kalloc() reference of its own on
+// each page, so they stay in memory however busy the page
+// cache is; exec() maps them into the new image right away
+// rather than waiting for the first touch of each. A program
+// with more than NPH program headers is not cached.
+// writei() and itrunc() drop a program through execinval()
+// once its file changes, with the inode locked; exec() reads
+// and fills entries with it locked shared, so the two never
+// overlap.
+struct ecpage
+{
+    uint64 va;     // user address
+    char*  pa;     // the page
+    int    perm;   // PTE_* to map it with
+};
+
+struct ecentry
+{
+    uint           dev;
+    uint           inum;   // 0 if the slot is free
+    uint           used;   // value of tick at the last lookup, for LRU
+    struct elfhdr  elf;
+    struct proghdr ph[NPH];
+    int            npage;
+    struct ecpage  page[EXECPAGES];
+};
+
+static struct
+{
+    struct spinlock lock;
+    struct ecentry  e[NEXECCACHE];
+    uint            tick;
+    uint64          hit;
+    uint64          miss;
+} ecache;
+
+// 初始化执行缓存
+void execcacheinit(void)
+{
+    initlock(&ecache.lock, "ecache");
+}
+
+// Look ip up in the exec cache, and on a hit copy its entry to
+// *e, with a reference on each page for the caller. Returns 1
+// on a hit, 0 on a miss.
+// 在执行缓存中查找 ip，命中时复制其程序头与常驻页
+static int ecget(struct inode* ip, struct ecentry* e)
+{
+    struct ecentry* c;
+
+    acquire(&ecache.lock);
+    for (c = ecache.e; c < &ecache.e[NEXECCACHE]; c++)
+    {
+        if (c->inum == ip->inum && c->dev == ip->dev)
+        {
+            c->used = ++ecache.tick;
+            ecache.hit++;
+            *e = *c;
+            for (int i = 0; i < e->npage; i++)
+                kdup(e->page[i].pa);
+            release(&ecache.lock);
+            return 1;
+        }
+    }
+    ecache.miss++;
+    release(&ecache.lock);
+    return 0;
+}
+
+// Enter e, just read from ip, in the exec cache, replacing the
+// least recently used program. The cache takes references of
+// its own on the pages.
+// 将 ip 的程序头与常驻页加入执行缓存
+static void ecput(struct inode* ip, struct ecentry* e)
+{
+    struct ecentry *c, *victim = ecache.e;
+    int             i;
+
+    acquire(&ecache.lock);
+    for (c = ecache.e; c < &ecache.e[NEXECCACHE]; c++)
+    {
+        if (c->inum == 0)
+        {
+            victim = c;
+            break;
+        }
+        if (c->used < victim->used)
+            victim = c;
+    }
+    for (i = 0; i < victim->npage; i++)
+        kfree(victim->page[i].pa);
+    *victim      = *e;
+    victim->dev  = ip->dev;
+    victim->inum = ip->inum;
+    victim->used = ++ecache.tick;
+    for (i = 0; i < victim->npage; i++)
+        kdup(victim->page[i].pa);
+    ip->ecached = 1;
+    release(&ecache.lock);
+}
+
+// Drop ip from the exec cache, since its contents are
+// changing. The caller must hold ip->lock.
+// 使 ip 在执行缓存中的项失效
+void execinval(struct inode* ip)
+{
+    struct ecentry* c;
+
+    acquire(&ecache.lock);
+    for (c = ecache.e; c < &ecache.e[NEXECCACHE]; c++)
+    {
+        if (c->inum == ip->inum && c->dev == ip->dev)
+        {
+            for (int i = 0; i < c->npage; i++)
+                kfree(c->page[i].pa);
+            c->inum  = 0;
+            c->npage = 0;
+        }
+    }
+    ip->ecached = 0;
+    release(&ecache.lock);
+}
+
+// Print exec cache statistics, for procdump().
+// 打印执行缓存统计信息
+void execcachedump(void)
+{
+    int n = 0, pages = 0;
+
+    for (int i = 0; i < NEXECCACHE; i++)
+    {
+        if (ecache.e[i].inum)
+        {
+            n++;
+            pages += ecache.e[i].npage;
+        }
+    }
+    printf("ecache: %d/%d programs, %d pages, hit %ld, miss %ld\n", n, NEXECCACHE, pages, ecache.hit,
+           ecache.miss);
+}
+
+// Take the first EXECPAGES whole file pages of the read-only
+// segments of seg from the page cache into e. ip is locked.
+// Returns -1 if out of memory.
+// 从页缓存取出只读程序段的前 EXECPAGES 页
+static int ecfill(struct inode* ip, struct ecentry* e, struct vma* seg, int nseg)
+{
+    struct ecpage* pg;
+    uint64         va;
+    int            i;
+
+    for (i = 0; i < nseg; i++)
+    {
+        if (seg[i].prot & PROT_WRITE)
+            continue;
+        for (va = seg[i].addr; va < seg[i].addr + seg[i].len && e->npage < EXECPAGES; va += PGSIZE)
+        {
+            // as in vmafault(): a page only partly from the file
+            // is not the page cache's.
+            if (seg[i].off + (va - seg[i].addr) + PGSIZE > seg[i].fileend)
+                break;
+            pg     = &e->page[e->npage];
+            pg->va = va;
+            if ((pg->pa = pcacheget(ip, seg[i].off + (va - seg[i].addr))) == 0)
+                return -1;
+            pg->perm = PTE_U | PTE_R | ((seg[i].prot & PROT_EXEC) ? PTE_X : 0);
+            e->npage++;
+        }
+    }
+    return 0;
+}
 
 static int loadseg(pde_t*, uint64, struct inode*, uint, uint);
 
@@ -21,6 +209,17 @@ int flags2perm(int flags)
     return perm;
 }
 
+// 将ELF程序段的标志转换为 mmap() 的 PROT_* 权限
+static int flags2prot(int flags)
+{
+    int prot = PROT_READ;
+    if (flags & 0x1)
+        prot |= PROT_EXEC;
+    if (flags & 0x2)
+        prot |= PROT_WRITE;
+    return prot;
+}
+
 // 实现exec系统调用，加载并执行指定路径的可执行文件，并传递参数argv
 int exec(char* path, char** argv)
 {
@@ -37,6 +236,16 @@ int exec(char* path, char** argv)
     struct proghdr ph;                            // ELF程序头结构
     pagetable_t    pagetable = 0, oldpagetable;   // 新页表与旧页表
     struct proc*   p         = myproc();          // 当前进程结构
+    struct vma     seg[NSEG];                     // 按需分页的程序段
+    int            nseg = 0;                      // 程序段个数
+    struct file*   ef   = 0;                      // 程序段映射所用的文件
+    struct ecentry ec;                            // 执行缓存中该程序的项
+    int            hit, npage = 0;                // 是否命中执行缓存；ec 中仍持有引用的页数
+
+    // the other threads of the process would go on running
+    // in the old image.
+    if (threaded(p))
+        return -1;
 
     begin_op();
     // 查找文件：调用namei(path)解析路径，获取可执行文件的索引节点ip
@@ -45,12 +254,23 @@ int exec(char* path, char** argv)
         end_op();
         return -1;
     }
-    // 锁定文件：ilock(ip)锁定索引节点，防止并发修改
-    ilock(ip);
+    // 锁定文件：以共享方式锁定索引节点，防止并发修改，
+    // 同时允许其他进程同时执行同一程序
+    ilockshared(ip);
 
-    // 调用readi从文件偏移0读取ELF文件头到elf结构
-    if (readi(ip, 0, (uint64)&elf, 0, sizeof(elf)) != sizeof(elf))
-        goto bad;
+    // 先查执行缓存；未命中时调用readi从文件偏移0读取ELF文件头到elf结构
+    if ((hit = ecget(ip, &ec)) != 0)
+    {
+        npage = ec.npage;
+        elf   = ec.elf;
+    }
+    else
+    {
+        if (readi(ip, 0, (uint64)&elf, 0, sizeof(elf)) != sizeof(elf))
+            goto bad;
+        ec.npage = 0;
+        ec.elf   = elf;
+    }
     // 检查elf.magic是否等于ELF_MAGIC
     if (elf.magic != ELF_MAGIC)
         goto bad;
@@ -62,9 +282,13 @@ int exec(char* path, char** argv)
     // 循环读取ELF文件的程序头表
     for (i = 0, off = elf.phoff; i < elf.phnum; i++, off += sizeof(ph))
     {
-        // 调用readi读取每个程序头到ph
-        if (readi(ip, 0, (uint64)&ph, off, sizeof(ph)) != sizeof(ph))
+        // 命中时程序头来自执行缓存，否则调用readi读取每个程序头到ph
+        if (hit)
+            ph = ec.ph[i];
+        else if (readi(ip, 0, (uint64)&ph, off, sizeof(ph)) != sizeof(ph))
             goto bad;
+        else if (i < NPH)
+            ec.ph[i] = ph;
         // 检查程序头类型
         if (ph.type != ELF_PROG_LOAD)
             continue;
@@ -75,6 +299,24 @@ int exec(char* path, char** argv)
             goto bad;
         if (ph.vaddr % PGSIZE != 0)
             goto bad;
+        if (ph.memsz == 0)
+            continue;
+        // A segment whose file offset is page-aligned is paged in
+        // from the file on first touch (see vmafault()); its
+        // read-only pages come from the page cache and are shared
+        // with other processes running the same program.
+        if (ph.off % PGSIZE == 0 && nseg < NSEG)
+        {
+            seg[nseg].addr    = ph.vaddr;
+            seg[nseg].len     = PGROUNDUP(ph.vaddr + ph.memsz) - ph.vaddr;
+            seg[nseg].prot    = flags2prot(ph.flags);
+            seg[nseg].off     = ph.off;
+            seg[nseg].fileend = ph.off + ph.filesz;
+            nseg++;
+            if (ph.vaddr + ph.memsz > sz)
+                sz = ph.vaddr + ph.memsz;
+            continue;
+        }
         // 调用uvmalloc为程序段分配内存，从当前sz到ph.vaddr + ph.memsz
         // 权限由flags2perm(ph.flags)设置
         uint64 sz1;
@@ -85,6 +327,36 @@ int exec(char* path, char** argv)
         if (loadseg(pagetable, ph.vaddr, ip, ph.off, ph.filesz) < 0)
             goto bad;
     }
+    // a program seen for the first time joins the exec cache,
+    // with the first pages of its text.
+    if (!hit && elf.phnum <= NPH)
+    {
+        if (ecfill(ip, &ec, seg, nseg) < 0)
+        {
+            npage = ec.npage;
+            goto bad;
+        }
+        ecput(ip, &ec);
+        npage = ec.npage;
+    }
+    // map the cached pages at once, each with the reference ec
+    // holds for it.
+    for (; npage > 0; npage--)
+    {
+        struct ecpage* pg = &ec.page[ec.npage - npage];
+        if (mappages(pagetable, pg->va, PGSIZE, (uint64)pg->pa, pg->perm) != 0)
+            goto bad;
+    }
+    // 程序段通过一个只读打开的文件映射
+    if (nseg > 0)
+    {
+        if ((ef = filealloc()) == 0)
+            goto bad;
+        ef->type     = FD_INODE;
+        ef->ip       = idup(ip);
+        ef->readable = 1;
+        ef->writable = 0;
+    }
     // 释放索引节点
     iunlockput(ip);
     end_op();
@@ -137,16 +409,27 @@ int exec(char* path, char** argv)
     safestrcpy(p->name, last, sizeof(p->name));
 
     // 提交新程序映像
+    vmaunmapall(p);   // 旧映像的内存映射随旧页表一起消失
     oldpagetable      = p->pagetable;          // 保存旧页表
     p->pagetable      = pagetable;             // 替换页面表
     p->sz             = sz;                    // 更新内存大小
     p->trapframe->epc = elf.entry;             // 设置程序入口
     p->trapframe->sp  = sp;                    // 设置栈指针
+    if (p->kpagetable)
+        kvmreset(p->kpagetable);   // 内核页表不再映射旧页表的用户内存
     proc_freepagetable(oldpagetable, oldsz);   // 释放旧页面表和内存。
+    // vmaunmapall() freed every slot, so these cannot fail.
+    for (i = 0; i < nseg; i++)
+        vmaadd(p, seg[i].addr, seg[i].len, seg[i].prot, MAP_PRIVATE, ef, seg[i].off, seg[i].fileend);
+    if (ef)
+        fileclose(ef);
 
     return argc;   // this ends up in a0, the first argument to main(argc, argv)
 
 bad:
+    // the references of the cached pages not yet mapped.
+    for (; npage > 0; npage--)
+        kfree(ec.page[ec.npage - npage].pa);
     if (pagetable)
         proc_freepagetable(pagetable, sz);
     if (ip)
@@ -154,6 +437,8 @@ bad:
         iunlockput(ip);
         end_op();
     }
+    if (ef)
+        fileclose(ef);
     return -1;
 }
 
@@ -178,3 +463,17 @@ static int loadseg(pagetable_t pagetable, uint64 va, struct inode* ip, uint offs
 
     return 0;
 }
+
+// Free the kernel copies of a program's path and arguments that
+// sys_spawn() makes for spawn(): path and the argv array from
+// kmalloc(), each argument from kalloc().
+// 释放 spawn() 使用的路径与参数副本
+void spawnfree(char* path, char** argv)
+{
+    int i;
+
+    for (i = 0; i < MAXARG && argv[i] != 0; i++)
+        kfree(argv[i]);
+    kmfree(argv);
+    kmfree(path);
+}
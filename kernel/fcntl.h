@@ -1,5 +1,26 @@
-#define O_RDONLY 0x000
-#define O_WRONLY 0x001
-#define O_RDWR   0x002
-#define O_CREATE 0x200
-#define O_TRUNC  0x400
\ No newline at end of file
+#define O_RDONLY   0x000
+#define O_WRONLY   0x001
+#define O_RDWR     0x002
+#define O_CREATE   0x200
+#define O_TRUNC    0x400
+#define O_NONBLOCK 0x800   // 不阻塞：管道与控制台无数据可读时 read 返回 -1，write 只写入能立即写入的部分
+// mmap() protections and flags
+#define PROT_NONE   0x0   // 不可访问
+#define PROT_READ   0x1   // 可读
+#define PROT_WRITE  0x2   // 可写
+#define PROT_EXEC   0x4   // 可执行
+#define MAP_SHARED  0x1   // 修改写回文件
+#define MAP_PRIVATE 0x2   // 修改仅对本进程可见
+// fcntl() commands
+#define F_GETPIPE_SZ 1   // 获取管道缓冲区大小
+#define F_SETPIPE_SZ 2   // 设置管道缓冲区大小
+#define F_GETFL      3   // 获取文件状态标志（O_NONBLOCK）
+#define F_SETFL      4   // 设置文件状态标志
+// futex() operations
+#define FUTEX_WAIT 0   // 若 *addr == val 则睡眠
+#define FUTEX_WAKE 1   // 唤醒最多 val 个在 addr 上睡眠的线程
+// setsched() scheduling classes, highest priority first
+#define SCHED_REALTIME 0   // 实时：优先于其他类运行
+#define SCHED_NORMAL   1   // 普通：默认类
+#define SCHED_BATCH    2   // 批处理：其他类空闲时运行，时间片更长
+#define NSCHED         3
@@ -12,41 +12,77 @@
 #include "file.h"
 #include "stat.h"
 #include "proc.h"
+#include "fcntl.h"
+#include "uio.h"
+#include "poll.h"
 
 // 全局设备功能表
 struct devsw devsw[NDEV];
 
-// 全局文件表，管理所有打开的 struct file
+// 全局文件表，管理所有打开的 struct file。
+// 文件结构从 kmalloc() 分配，启动时预分配 NFILE 个；
+// 未使用的结构链在 free 上，超出 NFILE 的部分关闭时归还给 kmalloc()。
 struct
 {
     struct spinlock lock;
-    struct file     file[NFILE];
+    struct file*    free;    // files with ref == 0
+    int             n;       // files allocated now
+    int             nopen;   // files with ref > 0
 } ftable;
 
-// 初始化全局文件表
+// Allocate a new file for the free list.
+// Caller must hold ftable.lock. Returns -1 if out of memory.
+// 分配一个空闲的 struct file
+static int fgrow(void)
+{
+    struct file* f;
+
+    if ((f = (struct file*)kmalloc(sizeof(*f))) == 0)
+        return -1;
+    memset(f, 0, sizeof(*f));
+    f->next     = ftable.free;
+    ftable.free = f;
+    ftable.n++;
+    return 0;
+}
+
+// 初始化全局文件表，预先分配 NFILE 个文件结构
 void fileinit(void)
 {
-    initlock(&ftable.lock, "ftable");
+    initticketlock(&ftable.lock, "ftable");
+    acquire(&ftable.lock);
+    while (ftable.n < NFILE)
+        if (fgrow() < 0)
+            panic("fileinit");
+    release(&ftable.lock);
 }
 
 // Allocate a file structure.
-// 从 ftable.file 分配一个未使用的 struct file
+// 从空闲链表分配一个未使用的 struct file
 struct file* filealloc(void)
 {
     struct file* f;
 
     acquire(&ftable.lock);
-    for (f = ftable.file; f < ftable.file + NFILE; f++)
+    if (ftable.free == 0 && fgrow() < 0)
     {
-        if (f->ref == 0)
-        {
-            f->ref = 1;
-            release(&ftable.lock);
-            return f;
-        }
+        release(&ftable.lock);
+        return 0;
     }
+    f           = ftable.free;
+    ftable.free = f->next;
+    f->ref      = 1;
+    f->nonblock = 0;
+    ftable.nopen++;
     release(&ftable.lock);
-    return 0;
+    return f;
+}
+
+// Return the number of open files.
+// 返回打开的文件数
+int filecount(void)
+{
+    return __atomic_load_n(&ftable.nopen, __ATOMIC_RELAXED);
 }
 
 // Increment ref count for file f.
@@ -78,6 +114,18 @@ void fileclose(struct file* f)
     ff      = *f;
     f->ref  = 0;
     f->type = FD_NONE;
+    ftable.nopen--;
+    if (ftable.n > NFILE)
+    {
+        // a surge of open files is over; give the memory back.
+        kmfree(f);
+        ftable.n--;
+    }
+    else
+    {
+        f->next     = ftable.free;
+        ftable.free = f;
+    }
     release(&ftable.lock);
 
     if (ff.type == FD_PIPE)
@@ -102,9 +150,7 @@ int filestat(struct file* f, uint64 addr)
 
     if (f->type == FD_INODE || f->type == FD_DEVICE)
     {
-        ilock(f->ip);
-        stati(f->ip, &st);
-        iunlock(f->ip);
+        istat(f->ip, &st);
         if (copyout(p->pagetable, addr, (char*)&st, sizeof(st)) < 0)
             return -1;
         return 0;
@@ -112,6 +158,115 @@ int filestat(struct file* f, uint64 addr)
     return -1;
 }
 
+// Read the n buffers of iov from inode ip, starting at *off
+// and advancing it, with ip locked throughout so that the
+// buffers come from one contiguous stretch of the file. Stops
+// at the end of the file. Returns the bytes read, or -1.
+// The lock is shared with other readers when *off belongs to
+// the caller alone; a struct file's offset, which processes
+// may share, needs it exclusively.
+// 依次将 inode 中从 *off 开始的数据读入 iov 的各个用户缓冲区
+static int inoderead(struct inode* ip, struct iovec* iov, int n, uint* off, int shared)
+{
+    int    i, r, tot = 0;
+    uint64 left;
+
+    // no more than the file holds is copied; ip->size is only
+    // a guess without the lock, but a page missed here just
+    // makes the copy fail.
+    left = ip->size > *off ? ip->size - *off : 0;
+    for (i = 0; i < n && left > 0; left -= r, i++)
+    {
+        r = iov[i].iov_len < left ? iov[i].iov_len : left;
+        vmaprefault(myproc(), (uint64)iov[i].iov_base, r, 1);
+    }
+
+    if (shared)
+        ilockshared(ip);
+    else
+        ilock(ip);
+    for (i = 0; i < n; i++)
+    {
+        if ((r = readi(ip, 1, (uint64)iov[i].iov_base, *off, iov[i].iov_len)) < 0)
+        {
+            if (tot == 0)
+                tot = -1;
+            break;
+        }
+        *off += r;
+        tot += r;
+        if (r < iov[i].iov_len)
+            break;
+    }
+    iunlock(ip);
+    return tot;
+}
+
+// Write the n buffers of iov to inode ip, starting at *off
+// and advancing it. As many bytes go in each transaction as
+// it has room for, however they are split among the buffers.
+// Returns the bytes written, or -1 if not all of them could be.
+// 将 iov 的各个用户缓冲区依次写入 inode 中从 *off 开始的位置
+static int inodewrite(struct inode* ip, struct iovec* iov, int n, uint* off)
+{
+    // write as many blocks at a time as writeimax() says
+    // one transaction can take, and reserve the log blocks
+    // that the bytes actually written may dirty (see
+    // writeiblocks()). the bytes of one transaction are
+    // contiguous in the file, so the slop for non-aligned
+    // writes is the same however many buffers they come
+    // from.
+    // this really belongs lower down, since writei()
+    // might be writing a device like the console.
+    int    max, nlog, i = 0, r = 0, room, n1, tot = 0;
+    uint64 left = 0;
+    uint64 done = 0;   // bytes of iov[i] already written
+
+    for (i = 0; i < n; i++)
+    {
+        left += iov[i].iov_len;
+        vmaprefault(myproc(), (uint64)iov[i].iov_base, iov[i].iov_len, 0);
+    }
+    i = 0;
+    ilock(ip);
+    max = writeimax(ip);
+    iunlock(ip);
+
+    while (i < n && r >= 0)
+    {
+        ilock(ip);
+        nlog = writeiblocks(ip, left < max ? left : max);
+        iunlock(ip);
+        begin_opn(nlog);
+        ilock(ip);
+        for (room = max; i < n && room > 0; room -= r)
+        {
+            n1 = iov[i].iov_len - done < room ? iov[i].iov_len - done : room;
+            if ((r = writei(ip, 1, (uint64)iov[i].iov_base + done, *off, n1)) > 0)
+            {
+                *off += r;
+                tot += r;
+                done += r;
+                left -= r;
+            }
+            if (r != n1)
+            {
+                // error from writei
+                r = -1;
+                break;
+            }
+            if (done == iov[i].iov_len)
+            {
+                i++;
+                done = 0;
+            }
+        }
+        iunlock(ip);
+        end_opn(nlog);
+    }
+    return r < 0 ? -1 : tot;
+}
+
 // Read from file f.
 // addr is a user virtual address.
 // 读取文件 fileread
@@ -124,7 +279,7 @@ int fileread(struct file* f, uint64 addr, int n)
 
     if (f->type == FD_PIPE)
     {
-        r = piperead(f->pipe, addr, n);
+        r = piperead(f->pipe, addr, n, 0, f->nonblock);
     }
     else if (f->type == FD_DEVICE)
     {
@@ -134,14 +289,13 @@ int fileread(struct file* f, uint64 addr, int n)
         // user_dst：1（表示目标缓冲区在用户态）。
         // dst：用户态缓冲区地址（buf）。
         // n：请求读取的字节数（sizeof(buf)）。
-        r = devsw[f->major].read(1, addr, n);
+        // nonblock：无数据时是否立即返回。
+        r = devsw[f->major].read(1, addr, n, f->nonblock);
     }
     else if (f->type == FD_INODE)
     {
-        ilock(f->ip);
-        if ((r = readi(f->ip, 1, addr, f->off, n)) > 0)
-            f->off += r;
-        iunlock(f->ip);
+        struct iovec iov = {(void*)addr, n};
+        r                = inoderead(f->ip, &iov, 1, &f->off, 0);
     }
     else
     {
@@ -156,53 +310,26 @@ int fileread(struct file* f, uint64 addr, int n)
 // 将 n 字节从用户态地址 addr 写入文件 f
 int filewrite(struct file* f, uint64 addr, int n)
 {
-    int r, ret = 0;
+    int ret = 0;
 
     if (f->writable == 0)
         return -1;
 
     if (f->type == FD_PIPE)
     {
-        ret = pipewrite(f->pipe, addr, n);
+        ret = pipewrite(f->pipe, addr, n, 0, f->nonblock);
     }
     else if (f->type == FD_DEVICE)
     {
         if (f->major < 0 || f->major >= NDEV || !devsw[f->major].write)
             return -1;
-        ret = devsw[f->major].write(1, addr, n);
+        ret = devsw[f->major].write(1, addr, n, f->nonblock);
     }
     // 写入inode
     else if (f->type == FD_INODE)
     {
-        // write a few blocks at a time to avoid exceeding
-        // the maximum log transaction size, including
-        // i-node, indirect block, allocation blocks,
-        // and 2 blocks of slop for non-aligned writes.
-        // this really belongs lower down, since writei()
-        // might be writing a device like the console.
-        int max = ((MAXOPBLOCKS - 1 - 1 - 2) / 2) * BSIZE;
-        int i   = 0;
-        while (i < n)
-        {
-            int n1 = n - i;
-            if (n1 > max)
-                n1 = max;
-
-            begin_op();
-            ilock(f->ip);
-            if ((r = writei(f->ip, 1, addr + i, f->off, n1)) > 0)
-                f->off += r;
-            iunlock(f->ip);
-            end_op();
-
-            if (r != n1)
-            {
-                // error from writei
-                break;
-            }
-            i += r;
-        }
-        ret = (i == n ? n : -1);
+        struct iovec iov = {(void*)addr, n};
+        ret              = n < 0 ? -1 : inodewrite(f->ip, &iov, 1, &f->off);
     }
     else
     {
@@ -211,3 +338,129 @@ int filewrite(struct file* f, uint64 addr, int n)
 
     return ret;
 }
+
+// Read into the n buffers of iov from file f, filling each
+// before the next. A pipe or device read that comes up short
+// ends the list. iov is in kernel memory; its buffers are in
+// user memory.
+// 将文件 f 的数据依次读入 iov 的各个缓冲区 (readv)
+int filereadv(struct file* f, struct iovec* iov, int n)
+{
+    int i, r, tot = 0;
+
+    if (f->readable == 0)
+        return -1;
+    if (f->type == FD_INODE)
+        return inoderead(f->ip, iov, n, &f->off, 0);
+    for (i = 0; i < n; i++)
+    {
+        if ((r = fileread(f, (uint64)iov[i].iov_base, iov[i].iov_len)) < 0)
+            return tot > 0 ? tot : -1;
+        tot += r;
+        if (r < iov[i].iov_len)
+            break;
+    }
+    return tot;
+}
+
+// Write the n buffers of iov to file f, in order.
+// 将 iov 的各个缓冲区依次写入文件 f (writev)
+int filewritev(struct file* f, struct iovec* iov, int n)
+{
+    int i, r, tot = 0;
+
+    if (f->writable == 0)
+        return -1;
+    if (f->type == FD_INODE)
+        return inodewrite(f->ip, iov, n, &f->off);
+    for (i = 0; i < n; i++)
+    {
+        if ((r = filewrite(f, (uint64)iov[i].iov_base, iov[i].iov_len)) < 0)
+            return tot > 0 ? tot : -1;
+        tot += r;
+        if (r < iov[i].iov_len)
+            break;
+    }
+    return tot;
+}
+
+// Read n bytes at offset off of file f into user address
+// addr, leaving f->off alone. Only files on disk have
+// offsets.
+// 从文件 f 的偏移 off 处读取，不改变 f->off (pread)
+int filepread(struct file* f, uint64 addr, int n, uint off)
+{
+    struct iovec iov = {(void*)addr, n};
+
+    if (f->readable == 0 || f->type != FD_INODE || n < 0)
+        return -1;
+    return inoderead(f->ip, &iov, 1, &off, 1);
+}
+
+// Write n bytes from user address addr at offset off of
+// file f, leaving f->off alone.
+// 向文件 f 的偏移 off 处写入，不改变 f->off (pwrite)
+int filepwrite(struct file* f, uint64 addr, int n, uint off)
+{
+    struct iovec iov = {(void*)addr, n};
+
+    if (f->writable == 0 || f->type != FD_INODE || n < 0)
+        return -1;
+    return inodewrite(f->ip, &iov, 1, &off);
+}
+
+// Return the poll() events that f is ready for: POLLIN,
+// POLLOUT, and POLLERR or POLLHUP for a pipe whose other end
+// is closed. Files on disk are always ready.
+// 返回文件 f 已就绪的 poll 事件
+int filepoll(struct file* f)
+{
+    int ev = POLLIN | POLLOUT;
+
+    if (f->type == FD_PIPE)
+        return pipepoll(f->pipe, f->writable);
+    if (f->type == FD_DEVICE && f->major >= 0 && f->major < NDEV && devsw[f->major].poll)
+        ev = devsw[f->major].poll();
+    if (!f->readable)
+        ev &= ~POLLIN;
+    if (!f->writable)
+        ev &= ~POLLOUT;
+    return ev;
+}
+
+// Miscellaneous operations on file f, selected by cmd.
+// Returns the result of the operation, or -1.
+// 对文件 f 执行 cmd 指定的控制操作
+int filefcntl(struct file* f, int cmd, int arg)
+{
+    switch (cmd)
+    {
+    case F_GETPIPE_SZ:
+        if (f->type != FD_PIPE)
+            return -1;
+        return pipesize(f->pipe);
+    case F_SETPIPE_SZ:
+        if (f->type != FD_PIPE)
+            return -1;
+        return piperesize(f->pipe, arg);
+    case F_GETFL:
+        return f->nonblock ? O_NONBLOCK : 0;
+    case F_SETFL:
+        f->nonblock = (arg & O_NONBLOCK) != 0;
+        return 0;
+    }
+    return -1;
+}
+
+// Move n bytes between user address addr and pipe f, passing
+// whole pages by reference where possible instead of copying.
+// Writes if f is the pipe's write end, reads if the read end.
+// 在用户内存与管道之间按页零拷贝地传输数据
+int filesplice(struct file* f, uint64 addr, int n)
+{
+    if (f->type != FD_PIPE)
+        return -1;
+    if (f->writable)
+        return pipewrite(f->pipe, addr, n, 1, f->nonblock);
+    return piperead(f->pipe, addr, n, 1, f->nonblock);
+}
@@ -11,10 +11,12 @@ struct file
     int           ref;   // 引用计数
     char          readable;
     char          writable;
+    char          nonblock;   // O_NONBLOCK: 读写不阻塞（见 fcntl.h）
     struct pipe*  pipe;    // 指向管道结构（定义在 pipe.h），仅对 FD_PIPE 有效。
     struct inode* ip;      // 指向内存中的 inode
     uint          off;     // 文件偏移量，仅对 FD_INODE 有效，记录读写位置。
     short         major;   // 主设备号，仅对 FD_DEVICE 有效，用于标识设备类型。
+    struct file*  next;    // ref 为 0 时链入 ftable 的空闲链表
 };
 
 #define major(dev)  ((dev) >> 16 & 0xFFFF)      // 从设备号 dev 提取主设备号（高 16 位）
@@ -27,9 +29,21 @@ struct inode
 {
     uint             dev;     // 设备号，标识 inode 所在的设备
     uint             inum;    // inode 编号，唯一标识文件或目录
-    int              ref;     // 引用计数，记录 inode 被多少文件描述符或目录引用
+    int              ref;     // 引用计数，记录 inode 被多少文件描述符或目录引用；持 itable 读锁时原子地增加
     struct sleeplock lock;    // 睡眠锁，保护以下字段的并发访问
     int              valid;   // 布尔值，1 表示 inode 已从磁盘读取，0 表示未初始化
+    struct inode*    next;    // itable 哈希链，受 itable.lock 保护；ref 为 0 的 inode 仍在链上，保留其属性
+    struct inode*    lnext;   // itable 的 LRU 链表中的下一个，受 itable.lock 保护
+    int              onlru;   // 是否在 LRU 链表上
+
+    // 顺序读检测、预读与块分配目标，受 lock 保护；
+    // 共享锁下的读者可能同时更新预读字段，它们只是提示，不影响正确性
+    uint ranext;   // 下一次顺序读应开始的块号
+    uint rawin;    // 当前预读窗口（块数），0 表示非顺序读
+    uint raend;    // 已发出预读的块号上界
+    uint bgoal;    // 下一次为该文件分配块时的目标块号（最近映射的块 + 1）
+    int  pcached;  // 页缓存中可能有该文件的页（见 pcache.c）
+    int  ecached;  // 执行缓存中可能有该文件（见 exec.c）
 
     // 直接复制磁盘上的 struct dinode
     short type;
@@ -37,18 +51,21 @@ struct inode
     short minor;
     short nlink;
     uint  size;
-    uint  addrs[NDIRECT + 1];
+    uint  addrs[NDIRECT + 2];
 };
 
 // map major device number to device functions.
 // 定义设备驱动的功能表，映射主设备号到读写函数。
 struct devsw
 {
-    int (*read)(int, uint64, int);
-    int (*write)(int, uint64, int);
+    int (*read)(int, uint64, int, int);    // the last argument is f->nonblock
+    int (*write)(int, uint64, int, int);   // the last argument is f->nonblock
+    int (*poll)(void);                     // poll() events it is ready for; if 0, always ready
 };
 
 extern struct devsw devsw[];
 
 // 定义控制台设备的主设备号为 1
 #define CONSOLE 1
+// 锁争用统计设备的主设备号（见 stats.c）
+#define STATS 2
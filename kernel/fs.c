@@ -4,7 +4,8 @@
 **      Blocks: 提供 balloc 和 bfree，管理磁盘块分配。
 **      Log: 使用日志（log_write, initlog）确保操作原子性和崩溃恢复。
 **      Files: 通过 ialloc, iupdate, readi, writei 管理文件内容和元数据。
-**      Directories: 通过 dirlookup, dirlink 管理目录（存储 struct dirent）。
+**      Directories: 通过 dirlookup, dirlink, dirunlink 管理目录（存储 struct dirent），
+**          大目录带哈希索引，dcache 缓存最近的查找结果。
 **      Names: 通过 namei, nameiparent 解析路径名。
 **  这些层次从低到高构建了文件系统的功能，代码按此结构组织。
 ********************************************************************************
@@ -16,6 +17,7 @@
 #include "param.h"
 #include "stat.h"
 #include "spinlock.h"
+#include "rwlock.h"
 #include "proc.h"
 #include "sleeplock.h"
 #include "fs.h"
@@ -24,6 +26,9 @@
 
 #define min(a, b) ((a) < (b) ? (a) : (b))
 
+#define WBATCH   8    // data blocks writei() sends to the disk at once
+#define WRITEMAX 64   // most blocks written in one transaction
+
 // 全局静态变量，存储文件系统的超级块
 struct superblock sb;
 
@@ -56,40 +61,80 @@ static void bzero(int dev, int bno)
     brelse(bp);
 }
 
-// 在设备 dev 上分配一个空闲块，返回块号；若无空闲块，返回 0。
-static uint balloc(uint dev)
+// Where the next allocation without a goal starts looking:
+// just past the last block handed out, or lower if a block
+// below that was freed. Only a hint, so races are harmless.
+// Like sb, whose bitmap balloc() and bfree() scan, it is the
+// root device's: that is the only file system there is.
+// 根设备的空闲块分配提示：下一次分配开始扫描的块号
+static uint bhint;
+
+// Allocate a zeroed disk block, preferring goal or the first
+// free block after it, and wrapping around to the start of the
+// disk. A goal of 0 means "anywhere", and uses bhint. The
+// bitmap is scanned 64 bits at a time, skipping full words.
+// If data is set, the block is for file data that will be
+// written around the log (see iordered()): it is not zeroed,
+// since the caller fills it, and blocks the log could still
+// write over (see log_unsafe()) are passed over.
+// returns 0 if out of disk space.
+// 在设备 dev 上分配一个空闲块，优先从 goal 开始，返回块号；若无空闲块，返回 0。
+static uint balloc(uint dev, uint goal, int data)
 {
-    int         b, bi, m;
     struct buf* bp;
-
-    bp = 0;
-    // 外层循环：以位图块为单位遍历整个磁盘（每个位图块管理 BPB=8192 个块）
-    for (b = 0; b < sb.size; b += BPB)
+    uint64*     w;
+    uint64      bits;
+    uint        b, n, nword, bit;
+
+    if (goal == 0 || goal >= sb.size)
+        goal = bhint < sb.size ? bhint : 0;
+
+    // Visit every bitmap word once, starting with the word
+    // holding goal, and that word once more at the end for the
+    // bits below goal.
+    bp    = 0;
+    nword = (sb.size + 63) / 64;
+    for (n = 0; n <= nword; n++)
     {
-        // 1. 读取当前位图块（计算位图块号并读取）
-        bp = bread(dev, BBLOCK(b, sb));
-        // 内层循环：扫描当前位图块的每一位
-        for (bi = 0; bi < BPB && b + bi < sb.size; bi++)
+        b = (goal / 64 + n) % nword * 64;   // 该字第 0 位对应的块号
+        if (bp && bp->blockno != BBLOCK(b, sb))
         {
-            // 2. 计算当前位的掩码（确定在字节中的位置）
-            m = 1 << (bi % 8);
-            // 3. 检查当前位是否空闲（0 表示空闲）
-            if ((bp->data[bi / 8] & m) == 0)
-            {
-                // 4. 标记位图为已使用（设置对应位）
-                bp->data[bi / 8] |= m;
-                // 5. 写回位图块（通过日志系统）
-                log_write(bp);
-                // 6. 释放位图缓冲区
-                brelse(bp);
-                // 7. 清零新分配的数据块
-                bzero(dev, b + bi);
-                return b + bi;
-            }
+            brelse(bp);
+            bp = 0;
+        }
+        if (bp == 0)
+            bp = bread(dev, BBLOCK(b, sb));
+        w    = (uint64*)bp->data + b % BPB / 64;
+        bits = *w;
+        if (n == 0)
+            bits |= (1UL << goal % 64) - 1;   // 第一次访问时跳过 goal 之前的块
+        if (b + 64 > sb.size)
+            bits |= ~0UL << (sb.size - b);   // 超出磁盘的位视为已占用
+        for (;;)
+        {
+            if (bits == ~0UL)
+                break;
+            for (bit = 0; bits & (1UL << bit); bit++)
+                ;
+            if (!data || !log_unsafe(b + bit))
+                break;
+            bits |= 1UL << bit;   // 日志仍可能覆盖该块，跳过
         }
-        // 当前位图块无空闲块，释放缓冲区
+        if (bits == ~0UL)
+            continue;
+
+        // 标记位图为已使用并写回（通过日志系统）
+        *w |= 1UL << bit;
+        log_write(bp);
         brelse(bp);
+        // 清零新分配的块（绕过日志的数据块由调用者填写）
+        if (!data)
+            bzero(dev, b + bit);
+        bhint = b + bit + 1;
+        return b + bit;
     }
+    if (bp)
+        brelse(bp);
     // 所有块都已分配，报错
     printf("balloc: out of blocks\n");
     return 0;
@@ -113,26 +158,114 @@ static void bfree(int dev, uint b)
     bp->data[bi / 8] &= ~m;
     // 5. 写回修改后的位图块（通过日志系统）
     log_write(bp);
+    log_free(b);
     brelse(bp);
+    if (b < bhint)
+        bhint = b;
 }
 
-// 定义全局 itable，管理内存中的 inode 表
+// 定义全局 itable，管理内存中的 inode 表。
+// inode 按页从 kalloc() 分配，不够时再扩充，从不释放。
+// 使用过的 inode 按 (dev, inum) 链入哈希桶；引用计数降为 0 后仍留在桶中，
+// 保留读入的属性，并按释放顺序排在 LRU 链表末尾，iget() 从表头回收。
+// 查找命中只需读锁，引用计数在读锁下原子地增加；其余修改需写锁。
+// 命中时重新被引用的 inode 仍在 LRU 链表上，回收时跳过并摘下。
 struct
 {
-    struct spinlock lock;
-    struct inode    inode[NINODE];   // 最多50个活动的inodes
+    struct rwlock   lock;
+    struct inode*   hash[NIHASH];   // inodes with a (dev, inum)
+    struct inode*   lru;            // inodes released with ref == 0, least recently first
+    struct inode*   lrutail;        // last on lru
+    int             n;              // inodes allocated so far
 } itable;
 
-// 初始化 inode 表
-void iinit()
+#define IHASH(dev, inum) (&itable.hash[((dev) * 31 + (inum)) % NIHASH])
+
+// Put ip, which has just lost its last reference, at the end
+// of the LRU list, unless it is still on the list from before a
+// lookup took it back. Caller holds itable.lock for writing.
+// 将 ip 加入 LRU 链表末尾
+static void ilru(struct inode* ip)
 {
-    int i = 0;
+    if (ip->onlru)
+        return;
+    ip->onlru = 1;
+    ip->lnext = 0;
+    if (itable.lrutail)
+        itable.lrutail->lnext = ip;
+    else
+        itable.lru = ip;
+    itable.lrutail = ip;
+}
 
-    initlock(&itable.lock, "itable");
-    for (i = 0; i < NINODE; i++)
+// Carve a new page into inodes for the LRU list.
+// Caller must hold itable.lock for writing. Returns -1 if out
+// of memory.
+// 分配一页并切分为空闲的 inode
+static int igrow(void)
+{
+    struct inode* ip;
+    char*         mem;
+
+    if ((mem = kalloc()) == 0)
+        return -1;
+    pgzero(mem);
+    for (ip = (struct inode*)mem; ip + 1 <= (struct inode*)(mem + PGSIZE); ip++)
     {
-        initsleeplock(&itable.inode[i].lock, "inode");
+        initsleeplock(&ip->lock, "inode");
+        ilru(ip);
+        itable.n++;
     }
+    return 0;
+}
+
+// Take the least recently released inode with ref == 0 off the
+// LRU list and out of its hash bucket, for reuse, growing the
+// table if there is none. Caller holds itable.lock for writing.
+// Returns 0 if out of memory.
+// 回收最久未使用的空闲 inode
+static struct inode* irecycle(void)
+{
+    struct inode *ip, **pp;
+
+    for (;;)
+    {
+        if (itable.lru == 0 && igrow() < 0)
+            return 0;
+        ip         = itable.lru;
+        itable.lru = ip->lnext;
+        if (itable.lru == 0)
+            itable.lrutail = 0;
+        ip->onlru = 0;
+        if (ip->ref == 0)
+            break;
+        // a lookup took it back since it was put on the list.
+    }
+    if (ip->inum != 0)
+    {
+        for (pp = IHASH(ip->dev, ip->inum); *pp != ip; pp = &(*pp)->next)
+            ;
+        *pp = ip->next;
+    }
+    return ip;
+}
+
+static void dcacheinit(void);
+static void dcacheinval(struct inode* dp);
+static int  iordered(struct inode* ip);
+static uint dixroot(struct inode* dp);
+static void dixdrop(uint dev, uint root);
+
+// 初始化 inode 表
+void iinit()
+{
+    initrwlock(&itable.lock, "itable");
+    acquirewrite(&itable.lock);
+    while (itable.n < NINODE)
+        if (igrow() < 0)
+            panic("iinit");
+    releasewrite(&itable.lock);
+    dcacheinit();
 }
 
 static struct inode* iget(uint dev, uint inum);
@@ -184,40 +317,62 @@ void iupdate(struct inode* ip)
     brelse(bp);
 }
 
+// Find inode inum of device dev in the table and take a
+// reference to it, or return 0. Caller must hold itable.lock,
+// for reading at least: references taken under a read lock
+// are atomic increments, and only iput(), holding the lock
+// for writing, can see ref drop.
+// 在 inode 表中查找 inode 并增加其引用计数
+static struct inode* ifind(uint dev, uint inum)
+{
+    struct inode* ip;
+
+    for (ip = *IHASH(dev, inum); ip; ip = ip->next)
+    {
+        if (ip->dev == dev && ip->inum == inum)
+        {
+            __sync_fetch_and_add(&ip->ref, 1);
+            return ip;
+        }
+    }
+    return 0;
+}
+
 // Find the inode with number inum on device dev
 // and return the in-memory copy. Does not lock
 // the inode and does not read it from disk.
+// A hit needs only the read lock; a miss takes the write
+// lock and looks again, in case another CPU added it.
 // 获取设备 dev 上编号为 inum 的内存 inode，不锁定，不从磁盘读取。
 static struct inode* iget(uint dev, uint inum)
 {
-    struct inode *ip, *empty;
+    struct inode *ip, **bucket;
 
-    acquire(&itable.lock);
+    acquireread(&itable.lock);
+    ip = ifind(dev, inum);
+    releaseread(&itable.lock);
+    if (ip)
+        return ip;
 
-    // Is the inode already in the table?
-    empty = 0;
-    for (ip = &itable.inode[0]; ip < &itable.inode[NINODE]; ip++)
+    acquirewrite(&itable.lock);
+    if ((ip = ifind(dev, inum)) != 0)
     {
-        if (ip->ref > 0 && ip->dev == dev && ip->inum == inum)
-        {
-            ip->ref++;
-            release(&itable.lock);
-            return ip;
-        }
-        if (empty == 0 && ip->ref == 0)   // Remember empty slot.
-            empty = ip;
+        releasewrite(&itable.lock);
+        return ip;
     }
 
     // Recycle an inode entry.
-    if (empty == 0)
+    if ((ip = irecycle()) == 0)
         panic("iget: no inodes");
 
-    ip        = empty;
-    ip->dev   = dev;
-    ip->inum  = inum;
-    ip->ref   = 1;
-    ip->valid = 0;
-    release(&itable.lock);
+    bucket      = IHASH(dev, inum);
+    ip->dev     = dev;
+    ip->inum    = inum;
+    ip->ref     = 1;
+    ip->valid   = 0;
+    ip->next    = *bucket;
+    *bucket     = ip;
+    releasewrite(&itable.lock);
 
     return ip;
 }
@@ -227,9 +382,9 @@ static struct inode* iget(uint dev, uint inum)
 // 增加 inode 的引用计数，返回 inode。
 struct inode* idup(struct inode* ip)
 {
-    acquire(&itable.lock);
-    ip->ref++;
-    release(&itable.lock);
+    acquireread(&itable.lock);
+    __sync_fetch_and_add(&ip->ref, 1);
+    releaseread(&itable.lock);
     return ip;
 }
 
@@ -240,11 +395,14 @@ void ilock(struct inode* ip)
 {
     struct buf*    bp;
     struct dinode* dip;
+    struct proc*   p = myproc();
 
     if (ip == 0 || ip->ref < 1)
         panic("ilock");
 
     acquiresleep(&ip->lock);
+    if (p)
+        p->ilocks++;
 
     if (ip->valid == 0)
     {
@@ -257,25 +415,61 @@ void ilock(struct inode* ip)
         ip->size  = dip->size;
         memmove(ip->addrs, dip->addrs, sizeof(ip->addrs));
         brelse(bp);
-        ip->valid = 1;
+        ip->ranext = 0;
+        ip->rawin  = 0;
+        ip->raend  = 0;
+        ip->bgoal  = 0;
+        // an earlier copy of this inode may have left pages
+        // in the page cache.
+        ip->pcached = 1;
+        ip->ecached = 1;
+        // istat() reads the fields without the lock once this is set.
+        __atomic_store_n(&ip->valid, 1, __ATOMIC_RELEASE);
         if (ip->type == 0)
             panic("ilock: no type");
     }
 }
 
-// Unlock the given inode.
+// Lock the given inode shared with other readers, for
+// callers that only read it and its contents, like readi()
+// to a private buffer with an offset of the caller's own.
+// Reading the inode in from disk needs it exclusively; once
+// it is valid it stays so while the caller holds a reference.
+// 以共享方式锁定 inode，供只读取 inode 及其内容的调用者使用
+void ilockshared(struct inode* ip)
+{
+    struct proc* p = myproc();
+
+    if (ip == 0 || ip->ref < 1)
+        panic("ilockshared");
+
+    if (ip->valid == 0)
+    {
+        ilock(ip);
+        iunlock(ip);
+    }
+    acquiresleepshared(&ip->lock);
+    if (p)
+        p->ilocks++;
+}
+
+// Unlock the given inode, locked exclusively or shared.
 // 解锁 inode
 void iunlock(struct inode* ip)
 {
+    struct proc* p = myproc();
+
     if (ip == 0 || !holdingsleep(&ip->lock) || ip->ref < 1)
         panic("iunlock");
 
+    if (p)
+        p->ilocks--;
     releasesleep(&ip->lock);
 }
 
 // Drop a reference to an in-memory inode.
 // If that was the last reference, the inode table entry can
-// be recycled.
+// be recycled, but keeps its attributes until it is.
 // If that was the last reference and the inode has no links
 // to it, free the inode (and its content) on disk.
 // All calls to iput() must be inside a transaction in
@@ -283,7 +477,7 @@ void iunlock(struct inode* ip)
 // 减少 inode 引用计数，若无引用且无链接，释放 inode。
 void iput(struct inode* ip)
 {
-    acquire(&itable.lock);
+    acquirewrite(&itable.lock);
 
     if (ip->ref == 1 && ip->valid && ip->nlink == 0)
     {
@@ -293,8 +487,10 @@ void iput(struct inode* ip)
         // so this acquiresleep() won't block (or deadlock).
         acquiresleep(&ip->lock);
 
-        release(&itable.lock);
+        releasewrite(&itable.lock);
 
+        if (ip->type == T_DIR)
+            dcacheinval(ip);
         itrunc(ip);
         ip->type = 0;
         iupdate(ip);
@@ -302,11 +498,14 @@ void iput(struct inode* ip)
 
         releasesleep(&ip->lock);
 
-        acquire(&itable.lock);
+        acquirewrite(&itable.lock);
     }
 
-    ip->ref--;
-    release(&itable.lock);
+    // ip stays in its hash bucket, so that a lookup finds its
+    // attributes still valid until iget() recycles it.
+    if (--ip->ref == 0)
+        ilru(ip);
+    releasewrite(&itable.lock);
 }
 
 // Common idiom: unlock, then put.
@@ -322,68 +521,137 @@ void iunlockput(struct inode* ip)
 // The content (data) associated with each inode is stored
 // in blocks on the disk. The first NDIRECT block numbers
 // are listed in ip->addrs[].  The next NINDIRECT blocks are
-// listed in block ip->addrs[NDIRECT].
+// listed in block ip->addrs[NDIRECT], and the next NDINDIRECT
+// in the indirect blocks listed in block ip->addrs[NDIRECT+1].
+// File systems made before FSF_DINDIRECT have NDIRECT+1 direct
+// blocks followed by the singly-indirect block, and no more.
+
+// Number of direct blocks in an inode on this file system.
+// 返回本文件系统 inode 中直接块的数量
+static uint ndirect(void)
+{
+    return (sb.features & FSF_DINDIRECT) ? NDIRECT : NDIRECT + 1;
+}
+
+// Maximum file size in blocks on this file system.
+// 返回本文件系统支持的最大文件块数
+static uint maxfile(void)
+{
+    return (sb.features & FSF_DINDIRECT) ? MAXFILE : NDIRECT + 1 + NINDIRECT;
+}
+
+// Return the address in *ap, allocating a block for it first
+// if it is 0, as close after the inode's last mapped block as
+// possible. bp is the buffer holding *ap, if any, which is
+// logged when it changes. Returns 0 if out of disk space.
+// 返回 *ap 中的块号，为 0 时先分配一个新块。
+static uint bmapslot(struct inode* ip, uint* ap, struct buf* bp, int* fresh)
+{
+    uint addr;
+    int  data = fresh && iordered(ip);
+
+    if (fresh)
+        *fresh = 0;
+    if ((addr = *ap) == 0)
+    {
+        addr = balloc(ip->dev, ip->bgoal, data);
+        if (addr == 0)
+            return 0;
+        *ap = addr;
+        if (bp)
+            log_write(bp);
+        if (data)
+            *fresh = 1;
+    }
+    // keep the file's next block next to this one.
+    ip->bgoal = addr + 1;
+    return addr;
+}
+
+// Return entry i of the indirect block at addr, allocating
+// a block for it if necessary. Returns 0 if out of disk space.
+// 返回间接块 addr 中第 i 项的块号，必要时分配新块。
+static uint bmapind(struct inode* ip, uint addr, uint i, int* fresh)
+{
+    struct buf* bp;
+
+    bp   = bread(ip->dev, addr);
+    addr = bmapslot(ip, (uint*)bp->data + i, bp, fresh);
+    brelse(bp);
+    return addr;
+}
 
 // Return the disk block address of the nth block in inode ip.
-// If there is no such block, bmap allocates one.
+// If there is no such block, bmap allocates one. writei()
+// passes fresh, to learn whether a data block written around
+// the log was just allocated, and so is not zeroed.
 // returns 0 if out of disk space.
 // 返回 inode ip 第 bn 个逻辑块的磁盘块号，必要时分配新块。
-static uint bmap(struct inode* ip, uint bn)
+static uint bmap(struct inode* ip, uint bn, int* fresh)
 {
-    uint        addr, *a;
-    struct buf* bp;
+    uint nd = ndirect();
+    uint addr;
 
-    if (bn < NDIRECT)
-    {
-        if ((addr = ip->addrs[bn]) == 0)
-        {
-            addr = balloc(ip->dev);
-            if (addr == 0)
-                return 0;
-            ip->addrs[bn] = addr;
-        }
-        return addr;
-    }
-    bn -= NDIRECT;
+    if (bn < nd)
+        return bmapslot(ip, &ip->addrs[bn], 0, fresh);
+    bn -= nd;
 
     if (bn < NINDIRECT)
     {
         // Load indirect block, allocating if necessary.
-        if ((addr = ip->addrs[NDIRECT]) == 0)
-        {
-            addr = balloc(ip->dev);
-            if (addr == 0)
-                return 0;
-            ip->addrs[NDIRECT] = addr;
-        }
-        bp = bread(ip->dev, addr);
-        a  = (uint*)bp->data;
-        if ((addr = a[bn]) == 0)
-        {
-            addr = balloc(ip->dev);
-            if (addr)
-            {
-                a[bn] = addr;
-                log_write(bp);
-            }
-        }
-        brelse(bp);
-        return addr;
+        if ((addr = bmapslot(ip, &ip->addrs[nd], 0, 0)) == 0)
+            return 0;
+        return bmapind(ip, addr, bn, fresh);
+    }
+    bn -= NINDIRECT;
+
+    if (bn < NDINDIRECT && (sb.features & FSF_DINDIRECT))
+    {
+        // Walk the doubly-indirect block, then the indirect
+        // block it points to, allocating either if necessary.
+        if ((addr = bmapslot(ip, &ip->addrs[nd + 1], 0, 0)) == 0)
+            return 0;
+        if ((addr = bmapind(ip, addr, bn / NINDIRECT, 0)) == 0)
+            return 0;
+        return bmapind(ip, addr, bn % NINDIRECT, fresh);
     }
 
     panic("bmap: out of range");
 }
 
+// Free an indirect block and the blocks it lists. With
+// depth 2 the listed blocks are themselves indirect blocks.
+// 释放间接块 addr 及其引用的所有块。
+static void bfreeind(uint dev, uint addr, int depth)
+{
+    struct buf* bp;
+    uint*       a;
+    int         j;
+
+    bp = bread(dev, addr);
+    a  = (uint*)bp->data;
+    for (j = 0; j < NINDIRECT; j++)
+    {
+        if (a[j] == 0)
+            continue;
+        if (depth > 1)
+            bfreeind(dev, a[j], depth - 1);
+        else
+            bfree(dev, a[j]);
+    }
+    brelse(bp);
+    bfree(dev, addr);
+}
+
 // Truncate inode (discard contents).
 // Caller must hold ip->lock.
 // 释放 inode ip 的所有数据块，清零大小。
 void itrunc(struct inode* ip)
 {
-    int         i, j;
-    struct buf* bp;
-    uint*       a;
+    uint nd = ndirect();
+    uint i;
 
-    for (i = 0; i < NDIRECT; i++)
+    for (i = 0; i < nd; i++)
     {
         if (ip->addrs[i])
         {
@@ -392,22 +660,30 @@ void itrunc(struct inode* ip)
         }
     }
 
-    if (ip->addrs[NDIRECT])
+    if (ip->addrs[nd])
     {
-        bp = bread(ip->dev, ip->addrs[NDIRECT]);
-        a  = (uint*)bp->data;
-        for (j = 0; j < NINDIRECT; j++)
-        {
-            if (a[j])
-                bfree(ip->dev, a[j]);
-        }
-        brelse(bp);
-        bfree(ip->dev, ip->addrs[NDIRECT]);
-        ip->addrs[NDIRECT] = 0;
+        bfreeind(ip->dev, ip->addrs[nd], 1);
+        ip->addrs[nd] = 0;
+    }
+
+    if (dixroot(ip))
+    {
+        // a directory's hash index, not a doubly-indirect block.
+        dixdrop(ip->dev, ip->addrs[nd + 1]);
+        ip->addrs[nd + 1] = 0;
+    }
+    else if ((sb.features & FSF_DINDIRECT) && ip->addrs[nd + 1])
+    {
+        bfreeind(ip->dev, ip->addrs[nd + 1], 2);
+        ip->addrs[nd + 1] = 0;
     }
 
     ip->size = 0;
     iupdate(ip);
+    if (ip->pcached)
+        pcacheinval(ip);
+    if (ip->ecached)
+        execinval(ip);
 }
 
 // Copy stat information from inode.
@@ -422,6 +698,65 @@ void stati(struct inode* ip, struct stat* st)
     st->size  = ip->size;
 }
 
+// Copy stat information from ip, which the caller holds a
+// reference to, taking its lock only to read it in: once
+// valid, it stays so until the reference is dropped, and each
+// field is read whole.
+// 复制 inode 的状态信息，inode 已读入时不加锁
+void istat(struct inode* ip, struct stat* st)
+{
+    if (__atomic_load_n(&ip->valid, __ATOMIC_ACQUIRE))
+    {
+        stati(ip, st);
+        return;
+    }
+    ilockshared(ip);
+    stati(ip, st);
+    iunlock(ip);
+}
+
+// Sequential read detection and read-ahead.
+// A read that starts in the block where the previous one
+// ended is sequential and doubles the inode's window, from
+// RAMIN up to RAMAX blocks; any other read closes the window.
+// When less than half a window has been read ahead past the
+// end of this read, start reads for the rest of the window.
+// Caller must hold ip->lock; [off, end) is the range just read.
+// 检测顺序读并异步预读后续的磁盘块。
+static void readahead(struct inode* ip, uint off, uint end)
+{
+    uint blocks[RAMAX];
+    uint bn, first, last, nb;
+    int  n;
+
+    if (off / BSIZE == ip->ranext)
+        ip->rawin = ip->rawin ? min(2 * ip->rawin, RAMAX) : RAMIN;
+    else
+        ip->rawin = ip->raend = 0;
+    ip->ranext = end / BSIZE;
+    if (ip->rawin == 0)
+        return;
+
+    // blocks of the file past the end of this read.
+    nb    = (ip->size + BSIZE - 1) / BSIZE;
+    first = (end + BSIZE - 1) / BSIZE;
+    last  = min(first + ip->rawin, nb);
+    if (ip->raend > first && ip->raend - first >= ip->rawin / 2)
+        return;
+
+    n = 0;
+    for (bn = ip->raend > first ? ip->raend : first; bn < last; bn++)
+    {
+        // within the file, so bmap() does not allocate.
+        if ((blocks[n] = bmap(ip, bn, 0)) == 0)
+            break;
+        n++;
+    }
+    ip->raend = bn;
+    if (n > 0)
+        breadahead(ip->dev, blocks, n);
+}
+
 // Read data from inode.
 // Caller must hold ip->lock.
 // If user_dst==1, then dst is a user virtual address;
@@ -442,7 +777,7 @@ int readi(struct inode* ip, int user_dst, uint64 dst, uint off, uint n)
 
     for (tot = 0; tot < n; tot += m, off += m, dst += m)
     {
-        uint addr = bmap(ip, off / BSIZE);
+        uint addr = bmap(ip, off / BSIZE, 0);
         if (addr == 0)
             break;
         bp = bread(ip->dev, addr);
@@ -455,9 +790,74 @@ int readi(struct inode* ip, int user_dst, uint64 dst, uint off, uint n)
         }
         brelse(bp);
     }
+    if (tot != -1)
+        readahead(ip, off - tot, off);
     return tot;
 }
 
+// Whether writei() sends ip's data straight to the disk
+// rather than through the log (ordered data): the data of
+// ordinary files, when ORDEREDDATA is set. The blocks are
+// written before writei() returns, and so before the
+// transaction that makes the file point at them commits.
+// Only metadata is journaled. Directory contents still go
+// through the log. Caller must hold ip->lock.
+// 判断 ip 的数据块是否绕过日志直接写盘
+static int iordered(struct inode* ip)
+{
+    return ORDEREDDATA && ip->type == T_FILE;
+}
+
+// Start writing the n locked data blocks of bs to the disk
+// as one batch, and return without waiting.
+// 启动一批数据块的直接写盘，不等待完成
+static void writedata(struct buf** bs, int n)
+{
+    bstart(bs, n, 1, 0);
+}
+
+// Wait for the blocks of a writedata(), and release them.
+// 等待一批数据块写盘完成并释放
+static void waitdata(struct buf** bs, int n)
+{
+    int i;
+
+    bwait(bs, n);
+    for (i = 0; i < n; i++)
+        brelse(bs[i]);
+}
+
+// The most log blocks that a writei() of n bytes to ip can
+// dirty: the inode, a doubly-indirect block and one indirect
+// block per NINDIRECT data blocks (plus one), the bitmap
+// blocks, and, unless ordered, the data blocks themselves.
+// Two extra data blocks allow for the partial ones at the
+// ends. Caller must hold ip->lock.
+// 估计 writei() 写 n 字节最多会修改多少个日志块
+int writeiblocks(struct inode* ip, uint n)
+{
+    uint nb      = n / BSIZE + 2;
+    uint nbitmap = min(nb, sb.size / BPB + 1);
+
+    return 1 + 1 + nb / NINDIRECT + 1 + nbitmap + (iordered(ip) ? 0 : nb);
+}
+
+// How many bytes of ip one transaction should write. With
+// ordered data, a begin_op() reservation covers the metadata
+// of up to WRITEMAX blocks; otherwise as much as a whole log
+// segment, reserved with begin_opn(), holds.
+// Caller must hold ip->lock.
+// 计算一个事务中最多向 ip 写入的字节数
+uint writeimax(struct inode* ip)
+{
+    int  nlog = iordered(ip) ? MAXOPBLOCKS : log_opmax();
+    uint nb;
+
+    for (nb = WRITEMAX; nb > 1 && writeiblocks(ip, nb * BSIZE) > nlog; nb--)
+        ;
+    return nb * BSIZE;
+}
+
 // Write data to inode.
 // Caller must hold ip->lock.
 // If user_src==1, then src is a user virtual address;
@@ -468,29 +868,54 @@ int readi(struct inode* ip, int user_dst, uint64 dst, uint off, uint n)
 // 用于将数据写入文件系统的索引节点（inode）
 int writei(struct inode* ip, int user_src, uint64 src, uint off, uint n)
 {
-    uint        tot, m;
+    uint        tot, m, addr;
     struct buf* bp;
+    struct buf* wb[2][WBATCH];   // data blocks written around the log, two batches
+    int         nwb[2] = {0, 0}, cur = 0, fresh, ordered = iordered(ip);
 
     if (off > ip->size || off + n < off)
         return -1;
-    if (off + n > MAXFILE * BSIZE)
+    if (off + n > maxfile() * BSIZE)
         return -1;
 
     for (tot = 0; tot < n; tot += m, off += m, src += m)
     {
-        uint addr = bmap(ip, off / BSIZE);
-        if (addr == 0)
+        if ((addr = bmap(ip, off / BSIZE, &fresh)) == 0)
             break;
-        bp = bread(ip->dev, addr);
+        // a fresh block's old contents are of no interest.
+        bp = fresh ? bnew(ip->dev, addr) : bread(ip->dev, addr);
         m  = min(n - tot, BSIZE - off % BSIZE);
         if (either_copyin(bp->data + (off % BSIZE), user_src, src, m) == -1)
         {
-            brelse(bp);
+            // a fresh block must not keep what the copy left.
+            if (fresh)
+            {
+                memset(bp->data, 0, BSIZE);
+                wb[cur][nwb[cur]++] = bp;
+            }
+            else
+                brelse(bp);
             break;
         }
-        log_write(bp);
-        brelse(bp);
+        if (!ordered)
+        {
+            log_write(bp);
+            brelse(bp);
+            continue;
+        }
+        wb[cur][nwb[cur]++] = bp;
+        if (nwb[cur] == WBATCH)
+        {
+            // fill the other batch while this one is written.
+            writedata(wb[cur], nwb[cur]);
+            cur = !cur;
+            waitdata(wb[cur], nwb[cur]);
+            nwb[cur] = 0;
+        }
     }
+    writedata(wb[cur], nwb[cur]);
+    waitdata(wb[!cur], nwb[!cur]);
+    waitdata(wb[cur], nwb[cur]);
 
     if (off > ip->size)
         ip->size = off;
@@ -499,6 +924,10 @@ int writei(struct inode* ip, int user_src, uint64 src, uint off, uint n)
     // because the loop above might have called bmap() and added a new
     // block to ip->addrs[].
     iupdate(ip);
+    if (tot > 0 && ip->pcached)
+        pcacheinval(ip);
+    if (tot > 0 && ip->ecached)
+        execinval(ip);
 
     return tot;
 }
@@ -510,34 +939,310 @@ int namecmp(const char* s, const char* t)
     return strncmp(s, t, DIRSIZ);
 }
 
+// Directory hash index.
+//
+// On a file system with FSF_DIRHASH, a directory gets a hash
+// index (see struct dirindex in fs.h) when its first entry
+// other than "." and ".." is linked, so that dirlookup() and
+// dirlink() read a few blocks instead of every entry.
+// Directories without an index, such as those of older file
+// systems, are still searched entry by entry. The index is
+// only changed with the directory locked, by dirlink() and
+// dirunlink().
+
+// Hash a directory entry name.
+// Must match dirhash() in mkfs/mkfs.c.
+// 计算目录项名字的哈希值
+static uint dirhash(char* name)
+{
+    uint h = 0;
+    int  i;
+
+    for (i = 0; i < DIRSIZ && name[i]; i++)
+        h = h * 31 + (uchar)name[i];
+    return h;
+}
+
+// The root block of dp's hash index, or 0 if it has none.
+// 返回目录 dp 的哈希索引根块号，没有索引时返回 0
+static uint dixroot(struct inode* dp)
+{
+    if (dp->type != T_DIR || !(sb.features & FSF_DIRHASH))
+        return 0;
+    return dp->addrs[NDIRECT + 1];
+}
+
+// Give dp, which holds only "." and "..", an empty index.
+// Returns the root block, or 0 if out of disk space.
+// 为只含 "." 和 ".." 的目录 dp 建立空的哈希索引
+static uint dixcreate(struct inode* dp)
+{
+    struct buf*      bp;
+    struct dirindex* dx;
+    uint             root;
+
+    if ((root = balloc(dp->dev, 0, 0)) == 0)
+        return 0;
+    bp        = bread(dp->dev, root);
+    dx        = (struct dirindex*)bp->data;
+    dx->magic = DIXMAGIC;
+    dx->free  = 2;
+    log_write(bp);
+    brelse(bp);
+    dp->addrs[NDIRECT + 1] = root;
+    iupdate(dp);
+    return root;
+}
+
+// Read the index root block of dp at root.
+// 读取目录哈希索引的根块
+static struct buf* dixread(struct inode* dp, uint root)
+{
+    struct buf* bp = bread(dp->dev, root);
+
+    if (((struct dirindex*)bp->data)->magic != DIXMAGIC)
+        panic("dirindex: bad root");
+    return bp;
+}
+
+// Return the leaf block that hash h falls in, allocating it
+// if alloc is set; 0 if there is none.
+// 返回哈希值 h 所在的叶块，alloc 时按需分配
+static uint dixleaf(struct inode* dp, uint root, uint h, int alloc)
+{
+    struct buf*      bp = dixread(dp, root);
+    struct dirindex* dx = (struct dirindex*)bp->data;
+    uint             leaf;
+
+    if ((leaf = dx->leaf[h % DIXLEAVES]) == 0 && alloc && (leaf = balloc(dp->dev, 0, 0)) != 0)
+    {
+        dx->leaf[h % DIXLEAVES] = leaf;
+        log_write(bp);
+    }
+    brelse(bp);
+    return leaf;
+}
+
+// Look for name in the index of dp. Returns the number of its
+// entry, which is read into *de, or 0 if it is not there.
+// 在目录 dp 的哈希索引中查找 name，返回目录项编号
+static uint dixlookup(struct inode* dp, uint root, char* name, struct dirent* de)
+{
+    struct buf* bp;
+    ushort*     slot;
+    uint        h = dirhash(name), leaf, i, e = 0;
+
+    if ((leaf = dixleaf(dp, root, h, 0)) == 0)
+        return 0;
+    bp   = bread(dp->dev, leaf);
+    slot = (ushort*)bp->data;
+    for (i = 0; i < DIXSLOTS; i++)
+    {
+        e = slot[(h / DIXLEAVES + i) % DIXSLOTS];
+        if (e == 0)
+            break;
+        if (e == DIXTOMB)
+            continue;
+        if (readi(dp, 0, (uint64)de, e * sizeof(*de), sizeof(*de)) != sizeof(*de))
+            panic("dixlookup read");
+        if (de->inum != 0 && namecmp(name, de->name) == 0)
+            break;
+        e = 0;
+    }
+    brelse(bp);
+    return i < DIXSLOTS ? e : 0;
+}
+
+// Add entry number e, holding name, to the index of dp.
+// Returns -1 if out of disk space or the leaf is full.
+// 将名为 name 的目录项编号 e 加入目录 dp 的哈希索引
+static int dixinsert(struct inode* dp, uint root, char* name, uint e)
+{
+    struct buf* bp;
+    ushort*     slot;
+    uint        h = dirhash(name), leaf, i, k;
+
+    if ((leaf = dixleaf(dp, root, h, 1)) == 0)
+        return -1;
+    bp   = bread(dp->dev, leaf);
+    slot = (ushort*)bp->data;
+    for (i = 0; i < DIXSLOTS; i++)
+    {
+        k = (h / DIXLEAVES + i) % DIXSLOTS;
+        if (slot[k] == 0 || slot[k] == DIXTOMB)
+        {
+            slot[k] = e;
+            log_write(bp);
+            brelse(bp);
+            return 0;
+        }
+    }
+    brelse(bp);
+    return -1;
+}
+
+// Remove entry number e, holding name, from the index of dp.
+// The slot becomes free if it ends its probe sequence, and a
+// tombstone otherwise.
+// 从目录 dp 的哈希索引中删除名为 name 的目录项编号 e
+static void dixremove(struct inode* dp, uint root, char* name, uint e)
+{
+    struct buf* bp;
+    ushort*     slot;
+    uint        h = dirhash(name), leaf, i, k;
+
+    if ((leaf = dixleaf(dp, root, h, 0)) == 0)
+        panic("dixremove");
+    bp   = bread(dp->dev, leaf);
+    slot = (ushort*)bp->data;
+    for (i = 0; i < DIXSLOTS; i++)
+    {
+        k = (h / DIXLEAVES + i) % DIXSLOTS;
+        if (slot[k] == e)
+        {
+            slot[k] = slot[(k + 1) % DIXSLOTS] == 0 ? 0 : DIXTOMB;
+            log_write(bp);
+            break;
+        }
+    }
+    if (i == DIXSLOTS)
+        panic("dixremove: not found");
+    brelse(bp);
+}
+
+// Move the index's hint for the first free entry back to e,
+// if the entry was just freed and lies before it, or past e,
+// if e was just taken: dirlink() takes the first free entry
+// at or after the hint.
+// 更新哈希索引中第一个空闲目录项的提示
+static void dixhint(struct inode* dp, uint root, uint e, int freed)
+{
+    struct buf*      bp = dixread(dp, root);
+    struct dirindex* dx = (struct dirindex*)bp->data;
+
+    if (freed && e < dx->free)
+        dx->free = e;
+    else if (!freed && e >= dx->free)
+        dx->free = e + 1;
+    else
+    {
+        brelse(bp);
+        return;
+    }
+    log_write(bp);
+    brelse(bp);
+}
+
+// Free the index whose root block is root: its leaves, then
+// the root itself.
+// 释放目录的哈希索引
+static void dixdrop(uint dev, uint root)
+{
+    struct buf*      bp = bread(dev, root);
+    struct dirindex* dx = (struct dirindex*)bp->data;
+    int              i;
+
+    for (i = 0; i < DIXLEAVES; i++)
+        if (dx->leaf[i])
+            bfree(dev, dx->leaf[i]);
+    brelse(bp);
+    bfree(dev, root);
+}
+
+// Return the locked buffer holding the directory entry at byte
+// offset off of dp, which must be within the directory.
+// 返回目录 dp 中偏移 off 处目录项所在块的缓冲区
+static struct buf* dirbread(struct inode* dp, uint off)
+{
+    uint addr;
+
+    if ((addr = bmap(dp, off / BSIZE, 0)) == 0)
+        panic("dirbread");
+    return bread(dp->dev, addr);
+}
+
+// Copy the live entries of dp from byte offset *off on into
+// de[], a block at a time, until n have been found or the
+// directory ends, and advance *off past those looked at. If
+// ips is not 0, also set ips[i] to a reference to the inode
+// of de[i], taken while the entry is still there.
+// Returns the number found. Caller must hold dp->lock.
+// 从偏移 *off 开始按块读取目录 dp 中最多 n 个有效目录项
+int dirnext(struct inode* dp, uint* off, struct dirent* de, struct inode** ips, int n)
+{
+    struct buf*    bp;
+    struct dirent* d;
+    int            found = 0;
+
+    if (*off % sizeof(*d) != 0)
+        *off += sizeof(*d) - *off % sizeof(*d);
+    while (found < n && *off < dp->size)
+    {
+        bp = dirbread(dp, *off);
+        for (d = (struct dirent*)(bp->data + *off % BSIZE);
+             found < n && *off < dp->size && (uchar*)d < bp->data + BSIZE; d++, *off += sizeof(*d))
+            if (d->inum != 0)
+            {
+                if (ips)
+                    ips[found] = iget(dp->dev, d->inum);
+                de[found++] = *d;
+            }
+        brelse(bp);
+    }
+    return found;
+}
+
 // Look for a directory entry in a directory.
 // If found, set *poff to byte offset of entry.
 // 用于在目录中查找指定文件/子目录，在给定的目录 inode 中搜索匹配的文件名
 struct inode* dirlookup(struct inode* dp, char* name, uint* poff)
 {
-    uint          off, inum;
-    struct dirent de;
+    uint           off, inum, root, end, e;
+    struct dirent  de;
+    struct dirent* d;
+    struct buf*    bp = 0;
 
     if (dp->type != T_DIR)
         panic("dirlookup not DIR");
-    // 从偏移量 0 开始遍历整个目录文件（每次步进一个目录项大小 sizeof(de)）
-    for (off = 0; off < dp->size; off += sizeof(de))
+    // 有索引时只查找索引；"." 和 ".." 总是前两项，不在索引中
+    end = dp->size;
+    if ((root = dixroot(dp)) != 0)
     {
-        // readi 从目录 inode 读取一个目录项（struct dirent）到 de 结构体
-        if (readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
-            panic("dirlookup read");
-        if (de.inum == 0)
+        if (namecmp(name, ".") != 0 && namecmp(name, "..") != 0)
+        {
+            if ((e = dixlookup(dp, root, name, &de)) == 0)
+                return 0;
+            if (poff)
+                *poff = e * sizeof(de);
+            return iget(dp->dev, de.inum);
+        }
+        end = 2 * sizeof(de);
+    }
+    // 从偏移量 0 开始遍历整个目录文件，每次读一个块并检查块中的所有目录项
+    for (off = 0; off < end; off += sizeof(*d))
+    {
+        if (off % BSIZE == 0 || bp == 0)
+        {
+            if (bp)
+                brelse(bp);
+            bp = dirbread(dp, off);
+        }
+        d = (struct dirent*)(bp->data + off % BSIZE);
+        if (d->inum == 0)
             continue;
-        if (namecmp(name, de.name) == 0)
+        if (namecmp(name, d->name) == 0)
         {
             // entry matches path element
             if (poff)
                 *poff = off;
-            inum = de.inum;
+            inum = d->inum;
+            brelse(bp);
             // 通过 iget() 获取并返回目标文件的 inode
             return iget(dp->dev, inum);
         }
     }
+    if (bp)
+        brelse(bp);
     return 0;
 }
 
@@ -545,8 +1250,10 @@ struct inode* dirlookup(struct inode* dp, char* name, uint* poff)
 int dirlink(struct inode* dp, char* name, uint inum)
 {
     int           off;
+    uint          root;
     struct dirent de;
     struct inode* ip;
+    struct buf*   bp = 0;
 
     // 使用 dirlookup 检查目录中是否已存在同名文件
     if ((ip = dirlookup(dp, name, 0)) != 0)
@@ -555,23 +1262,258 @@ int dirlink(struct inode* dp, char* name, uint inum)
         return -1;
     }
 
-    // 寻找空闲目录槽位
-    for (off = 0; off < dp->size; off += sizeof(de))
+    // 新目录加入第一个普通目录项时建立哈希索引
+    root = dixroot(dp);
+    if (root == 0 && (sb.features & FSF_DIRHASH) && dp->size == 2 * sizeof(de) &&
+        namecmp(name, ".") != 0 && namecmp(name, "..") != 0 && (root = dixcreate(dp)) == 0)
+        return -1;
+
+    // 寻找空闲目录槽位，有索引时从提示的位置开始
+    off = 0;
+    if (root)
     {
-        if (readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
-            panic("dirlink read");
-        if (de.inum == 0)
-            break; 
+        bp  = dixread(dp, root);
+        off = ((struct dirindex*)bp->data)->free * sizeof(de);
+        brelse(bp);
+        bp = 0;
     }
+    for (; off < dp->size; off += sizeof(de))
+    {
+        if (off % BSIZE == 0 || bp == 0)
+        {
+            if (bp)
+                brelse(bp);
+            bp = dirbread(dp, off);
+        }
+        if (((struct dirent*)(bp->data + off % BSIZE))->inum == 0)
+            break;
+    }
+    if (bp)
+        brelse(bp);
+    // 启用索引的文件系统上，目录不使用二级间接块
+    if ((sb.features & FSF_DIRHASH) && off / BSIZE >= NDIRECT + NINDIRECT)
+        return -1;
 
+    if (root && dixinsert(dp, root, name, off / sizeof(de)) < 0)
+        return -1;
     strncpy(de.name, name, DIRSIZ);
     de.inum = inum;
     if (writei(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
+    {
+        if (root)
+            dixremove(dp, root, name, off / sizeof(de));
         return -1;
+    }
+    if (root)
+        dixhint(dp, root, off / sizeof(de), 0);
+    dcacheput(dp, name, inum);
+
+    return 0;
+}
+
+// Remove the entry for name, at byte offset off, from the
+// directory dp. Caller must hold dp->lock.
+// 删除目录 dp 中偏移 off 处名为 name 的目录项
+void dirunlink(struct inode* dp, char* name, uint off)
+{
+    struct dirent de;
+    uint          root;
+
+    memset(&de, 0, sizeof(de));
+    if (writei(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
+        panic("dirunlink: writei");
+    if ((root = dixroot(dp)) != 0)
+    {
+        dixremove(dp, root, name, off / sizeof(de));
+        dixhint(dp, root, off / sizeof(de), 1);
+    }
+    dcacheput(dp, name, 0);
+}
+
+// Directory lookup cache.
+//
+// Remembers the inode number that a name in a directory was
+// last found to have, or that it was not there (inum 0), so
+// that namex() can step through a path without locking each
+// directory and reading its entries. The entries of a directory
+// are only changed with the directory locked: dirlink() and
+// sys_unlink() update the cache as they change the directory,
+// and namex() fills it in with the directory still locked from
+// dirlookup(), so the cache never disagrees with the disk. When
+// a directory is freed, iput() drops its entries, since its
+// inode number may be used again.
+//
+// dcache.lock protects the table. Lookups, by far the most
+// common use, share it for reading and count their hits and
+// LRU ticks with atomic increments; changes take it for writing.
+
+struct dentry
+{
+    uint           dev;
+    uint           parent;   // inum of the directory
+    char           name[DIRSIZ];
+    uint           inum;     // 0 for a name known not to exist
+    uint           used;     // value of tick at the last lookup, for LRU
+    int            slot;     // index in dcache.entry
+    struct dentry* next;     // next in the same hash bucket
+};
+
+static struct
+{
+    struct rwlock   lock;
+    struct dentry*  entry[NDCACHE];   // from kmalloc(), 0 if free
+    struct dentry*  bucket[NDHASH];
+    uint            tick;
+    uint64          hit;
+    uint64          miss;
+} dcache;
+
+// 初始化目录查找缓存
+static void dcacheinit(void)
+{
+    initrwlock(&dcache.lock, "dcache");
+}
 
+// 计算 (dev, parent, name) 的哈希桶
+static struct dentry** dhash(uint dev, uint parent, const char* name)
+{
+    uint h = dev * 31 + parent;
+    int  i;
+
+    for (i = 0; i < DIRSIZ && name[i]; i++)
+        h = h * 31 + (uchar)name[i];
+    return &dcache.bucket[h % NDHASH];
+}
+
+// Find the entry for name in directory inode parent, or 0.
+// Caller must hold dcache.lock, for reading at least.
+// 在哈希桶中查找目录项
+static struct dentry* dfind(uint dev, uint parent, const char* name)
+{
+    struct dentry* e;
+
+    for (e = *dhash(dev, parent, name); e; e = e->next)
+        if (e->dev == dev && e->parent == parent && namecmp(name, e->name) == 0)
+            return e;
     return 0;
 }
 
+// Take e out of its hash bucket, and free it unless keep is
+// set. Caller must hold dcache.lock for writing.
+// 从哈希桶中移除目录项
+static void dremove(struct dentry* e, int keep)
+{
+    struct dentry** pp;
+
+    for (pp = dhash(e->dev, e->parent, e->name); *pp != e; pp = &(*pp)->next)
+        ;
+    *pp = e->next;
+    if (!keep)
+    {
+        dcache.entry[e->slot] = 0;
+        kmfree(e);
+    }
+}
+
+// Look up name in directory dp without locking it. Returns 1
+// and sets *ipp to the inode found, referenced but not locked,
+// or to 0 if name is known not to exist; returns 0 if name is
+// not cached. The inode is got under dcache.lock, so that an
+// unlink of the name cannot free it first.
+// 在目录查找缓存中查找 dp 下的 name
+static int dcacheget(struct inode* dp, char* name, struct inode** ipp)
+{
+    struct dentry* e;
+
+    acquireread(&dcache.lock);
+    if ((e = dfind(dp->dev, dp->inum, name)) == 0)
+    {
+        __sync_fetch_and_add(&dcache.miss, 1);
+        releaseread(&dcache.lock);
+        return 0;
+    }
+    e->used = __sync_add_and_fetch(&dcache.tick, 1);
+    __sync_fetch_and_add(&dcache.hit, 1);
+    *ipp = e->inum ? iget(dp->dev, e->inum) : 0;
+    releaseread(&dcache.lock);
+    return 1;
+}
+
+// Record that name in directory dp is inode inum, or does not
+// exist if inum is 0. Caller must hold dp->lock.
+// 记录 dp 下 name 对应的 inode 号
+void dcacheput(struct inode* dp, char* name, uint inum)
+{
+    struct dentry *e, *old, **pp;
+    int            i;
+
+    acquirewrite(&dcache.lock);
+    if ((e = dfind(dp->dev, dp->inum, name)) == 0)
+    {
+        // a free slot gets a new entry, if there is memory for
+        // one; otherwise the least recently used entry is reused.
+        old = 0;
+        for (i = 0; i < NDCACHE; i++)
+        {
+            if (dcache.entry[i] == 0)
+            {
+                if ((e = (struct dentry*)kmalloc(sizeof(*e))) != 0)
+                {
+                    e->slot         = i;
+                    dcache.entry[i] = e;
+                    break;
+                }
+            }
+            else if (old == 0 || dcache.entry[i]->used < old->used)
+                old = dcache.entry[i];
+        }
+        if (e == 0)
+        {
+            if ((e = old) == 0)
+            {
+                releasewrite(&dcache.lock);
+                return;
+            }
+            dremove(e, 1);
+        }
+        e->dev    = dp->dev;
+        e->parent = dp->inum;
+        strncpy(e->name, name, DIRSIZ);
+        pp      = dhash(e->dev, e->parent, e->name);
+        e->next = *pp;
+        *pp     = e;
+    }
+    e->inum = inum;
+    e->used = ++dcache.tick;
+    releasewrite(&dcache.lock);
+}
+
+// Drop every entry of directory dp, which is being freed.
+// 使目录 dp 的所有缓存项失效
+static void dcacheinval(struct inode* dp)
+{
+    struct dentry* e;
+    int            i;
+
+    acquirewrite(&dcache.lock);
+    for (i = 0; i < NDCACHE; i++)
+        if ((e = dcache.entry[i]) != 0 && e->dev == dp->dev && e->parent == dp->inum)
+            dremove(e, 0);
+    releasewrite(&dcache.lock);
+}
+
+// Print directory cache statistics, for procdump().
+// 打印目录查找缓存统计信息
+void dcachedump(void)
+{
+    int i, n = 0;
+
+    for (i = 0; i < NDCACHE; i++)
+        if (dcache.entry[i])
+            n++;
+    printf("dcache: %d/%d names, hit %ld, miss %ld\n", n, NDCACHE, dcache.hit, dcache.miss);
+}
+
 // Paths
 
 // Copy the next path element from path into name.
@@ -628,6 +1570,15 @@ static struct inode* namex(char* path, int nameiparent, char* name)
 
     while ((path = skipelem(path, name)) != 0)
     {
+        // ip is a directory if it has cached names.
+        if (!(nameiparent && *path == '\0') && dcacheget(ip, name, &next))
+        {
+            iput(ip);
+            if (next == 0)
+                return 0;
+            ip = next;
+            continue;
+        }
         ilock(ip);
         if (ip->type != T_DIR)
         {
@@ -640,7 +1591,9 @@ static struct inode* namex(char* path, int nameiparent, char* name)
             iunlock(ip);
             return ip;
         }
-        if ((next = dirlookup(ip, name, 0)) == 0)
+        next = dirlookup(ip, name, 0);
+        dcacheput(ip, name, next ? next->inum : 0);
+        if (next == 0)
         {
             iunlockput(ip);
             return 0;
@@ -19,13 +19,24 @@ struct superblock
     uint nlog;         // 日志块的数量
     uint logstart;     // 日志区域的起始块号
     uint bmapstart;    // 空闲位图的起始块号
+    uint features;     // FSF_* 格式特性位，旧文件系统为 0
 };
 
 #define FSMAGIC 0x10203040   // 定义魔数，用于标识 xv6 文件系统，防止误识别其他文件系统格式
 
-#define NDIRECT   12                       // 每个 inode 包含 12 个直接块地址，指向文件的数据块。
-#define NINDIRECT (BSIZE / sizeof(uint))   // 定义间接块的指针数量
-#define MAXFILE   (NDIRECT + NINDIRECT)    // 定义文件最大块数为 NDIRECT + NINDIRECT = 268 块
+// Superblock feature flags.
+// Without FSF_DINDIRECT, addrs[] holds NDIRECT+1 direct blocks
+// and a singly-indirect block, as in the original format.
+#define FSF_DINDIRECT 0x1   // addrs[NDIRECT+1] 为二级间接块
+// With FSF_DIRHASH (which needs FSF_DINDIRECT), a directory may
+// have a hash index, whose root block is in addrs[NDIRECT+1];
+// a directory never grows into the doubly-indirect blocks.
+#define FSF_DIRHASH 0x2   // 目录可带哈希索引（struct dirindex）
+
+#define NDIRECT    11                                   // 每个 inode 包含 11 个直接块地址，指向文件的数据块。
+#define NINDIRECT  (BSIZE / sizeof(uint))               // 定义间接块的指针数量
+#define NDINDIRECT (NINDIRECT * NINDIRECT)              // 二级间接块可映射的块数
+#define MAXFILE    (NDIRECT + NINDIRECT + NDINDIRECT)   // 文件最大块数 11 + 256 + 65536 = 65803 块
 
 // On-disk inode structure
 // struct dinode 定义了磁盘上 inode 的格式，存储文件或目录的元数据。
@@ -36,7 +47,7 @@ struct dinode
     short minor;                // 次设备号 (T_DEVICE only)
     short nlink;                // inode 的硬链接计数
     uint  size;                 // 文件大小（字节）
-    uint  addrs[NDIRECT + 1];   // 数据块地址数组，大小为 12 + 1 = 13
+    uint  addrs[NDIRECT + 2];   // 数据块地址：11 个直接块、一级间接块、二级间接块
 };
 
 // 计算每个磁盘块可存储的 inode 数量（IPB=16）
@@ -60,3 +71,24 @@ struct dirent
     ushort inum;
     char   name[DIRSIZ];
 };
+
+// Hash index of a directory (FSF_DIRHASH). The entries are still
+// a plain array of struct dirent, so the directory reads as one
+// without an index. A name hashes to one of DIXLEAVES leaf
+// blocks, allocated when first needed; a leaf is an open-
+// addressing table of DIXSLOTS entry numbers (byte offset /
+// sizeof(struct dirent)), probed linearly from a slot also
+// chosen by the hash. 0 marks a free slot, since entry 0 is "."
+// ("." and ".." are never indexed), and DIXTOMB a removed one.
+#define DIXMAGIC  0x78696468                 // "hdix"
+#define DIXLEAVES 254                        // 每个索引的叶块数
+#define DIXSLOTS  (BSIZE / sizeof(ushort))   // 每个叶块的槽数
+#define DIXTOMB   0xffff                     // 已删除目录项的槽
+
+// 目录哈希索引的根块
+struct dirindex
+{
+    uint magic;             // DIXMAGIC
+    uint free;              // 第一个可能空闲的目录项编号
+    uint leaf[DIXLEAVES];   // 叶块的块号，未分配为 0
+};
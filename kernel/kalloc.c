@@ -16,28 +16,113 @@
 当需要内存时（如创建页表、分配进程栈），调用kalloc()获取一页物理内存
 当内存不再需要时，调用kfree()将内存页返回给分配器
 分配器使用空闲链表管理可用内存页，采用头插法实现快速分配和释放
+每个 CPU 拥有自己的空闲链表，本地链表为空时从其他 CPU 批量窃取
+空闲的 CPU 在调度循环中预先清零空闲页，放入本 CPU 的零页池，供 kalloc_zeroed() 直接使用
 *********************************************************/
 
 void freerange(void* pa_start, void* pa_end);
 
 extern char end[];   // first address after kernel. defined by kernel.ld.
 
+// Maximum number of pages moved by one steal, so that
+// a CPU that runs dry refills its list in one trip
+// instead of stealing a page at a time.
+#define KSTEAL 32
+
 struct run
 {
     struct run* next;
 };
 
-struct
+// One free list per CPU. Each list has its own lock, so
+// CPUs allocating and freeing concurrently do not contend
+// unless one of them has to steal. Beside it, each CPU keeps a
+// pool of up to KZEROPAGES pages that it zeroed while idle
+// (see kzero()), for kalloc_zeroed().
+struct kmem
 {
     struct spinlock lock;
     struct run*     freelist;
-} kmem;
+    struct run*     zerolist;   // free pages already zeroed
+    uint64          nfree;      // pages on both lists, and any kzero() is zeroing
+    uint64          nzero;      // pages on zerolist
+    uint64          nzmiss;     // kalloc_zeroed() calls that had to zero a page
+    uint64          nsteal;     // refills that stole from another CPU
+    uint64          nstolen;    // pages other CPUs took from this list
+    uint64          ncontend;   // acquires that found the lock already held
+} __attribute__((aligned(CACHELINE)));   // one cache line or more for each CPU's list
+
+struct kmem kmem[NCPU];
+
+// Reference counts for physical pages, so that fork can
+// share pages copy-on-write. A page is put back on a free
+// list only when its last reference is dropped by kfree().
+static int pgref[(PHYSTOP - KERNBASE) / PGSIZE];
+#define PGREF(pa) pgref[((uint64)(pa) - KERNBASE) / PGSIZE]
+
+static uint64 npages;   // pages kinit() handed to the allocator
 
+// The pages from end to PHYSTOP go to the allocator a chunk of
+// KCHUNK bytes at a time. kinit() frees KINITCHUNKS chunks on
+// CPU 0, enough for the rest of its boot, and the other harts,
+// which would otherwise spin until CPU 0 is done, free the
+// rest onto their own lists meanwhile (see kinithart()).
+#define KCHUNK      MEGAPGSIZE
+#define KINITCHUNKS 4
+
+static char* kbase;       // first page
+static int   nchunk;      // chunks from kbase to PHYSTOP
+static int   nextchunk;   // next chunk to be freed
+static int   kready;      // set once kinit() has set up the above
+
+// Lock a CPU's free list, counting the acquire as contended
+// if some other CPU holds the lock at the time.
+// 获取空闲链表锁，并统计锁竞争次数
+static void kmem_lock(struct kmem* km)
+{
+    if (km->lock.locked)
+        __sync_fetch_and_add(&km->ncontend, 1);
+    acquire(&km->lock);
+}
+
+// Free chunks of pages onto this hart's list, until there are
+// none left or max of them have been freed.
+// 领取并释放至多 max 个物理页区块
+static void kfreechunks(int max)
+{
+    char* s;
+    int   c;
+
+    while (max-- > 0 && (c = __sync_fetch_and_add(&nextchunk, 1)) < nchunk)
+    {
+        s = kbase + (uint64)c * KCHUNK;
+        freerange(s, s + KCHUNK < (char*)PHYSTOP ? s + KCHUNK : (char*)PHYSTOP);
+    }
+}
+
+// Set up the allocator, on CPU 0, with the first few chunks of
+// pages.
 // 初始化内存分配器
 void kinit()
 {
-    initlock(&kmem.lock, "kmem");
-    freerange(end, (void*)PHYSTOP);
+    for (int i = 0; i < NCPU; i++)
+        initlock(&kmem[i].lock, "kmem");
+    kbase  = (char*)PGROUNDUP((uint64)end);
+    nchunk = (PHYSTOP - (uint64)kbase + KCHUNK - 1) / KCHUNK;
+    __sync_synchronize();
+    kready = 1;
+    kfreechunks(KINITCHUNKS);
+}
+
+// Free the chunks no hart has taken yet. Every hart calls this
+// while it boots, the others as soon as kinit() has run, and
+// CPU 0 last, for any chunks that are left.
+// 各 hart 启动时并行释放剩余的物理页区块
+void kinithart()
+{
+    while (__atomic_load_n(&kready, __ATOMIC_ACQUIRE) == 0)
+        ;
+    kfreechunks(nchunk);
 }
 
 // 将指定范围内的物理内存页按页大小对齐后，逐个释放到空闲链表中
@@ -46,31 +131,123 @@ void freerange(void* pa_start, void* pa_end)
     char* p;
     p = (char*)PGROUNDUP((uint64)pa_start);
     for (; p + PGSIZE <= (char*)pa_end; p += PGSIZE)
+    {
+        PGREF(p) = 1;
         kfree(p);
+        __sync_fetch_and_add(&npages, 1);
+    }
 }
 
-// Free the page of physical memory pointed at by pa,
-// which normally should have been returned by a
+// Drop a reference to the page of physical memory pointed
+// at by pa, which normally should have been returned by a
 // call to kalloc().  (The exception is when
 // initializing the allocator; see kinit above.)
-// 内存释放函数：负责将不再使用的内存页添加到空闲链表中
+// When the last reference goes away the page goes onto
+// the current CPU's free list.
+// 内存释放函数：引用计数降为 0 时将内存页添加到当前 CPU 的空闲链表中
 // 将所有数据填充位1
 void kfree(void* pa)
 {
-    struct run* r;
+    struct run*  r;
+    struct kmem* km;
 
     if (((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
         panic("kfree");
 
+    int ref = __sync_sub_and_fetch(&PGREF(pa), 1);
+    if (ref > 0)
+        return;
+    if (ref < 0)
+        panic("kfree: ref");
+
+#ifdef KDEBUG
     // Fill with junk to catch dangling refs.
     memset(pa, 1, PGSIZE);
+#endif
 
     r = (struct run*)pa;
 
-    acquire(&kmem.lock);
-    r->next       = kmem.freelist;
-    kmem.freelist = r;
-    release(&kmem.lock);
+    // freed pages are dirty: only kzero() feeds zerolist.
+    push_off();
+    km = &kmem[cpuid()];
+    kmem_lock(km);
+    r->next      = km->freelist;
+    km->freelist = r;
+    km->nfree++;
+    release(&km->lock);
+    pop_off();
+}
+
+// Move up to KSTEAL pages from some other CPU's free list
+// onto km, which the caller has locked and found empty.
+// Only one victim lock is held at a time, and never
+// together with km->lock, so two CPUs stealing from each
+// other cannot deadlock.
+// Returns the number of pages moved.
+// 从其他 CPU 的空闲链表中批量窃取页面
+static int ksteal(struct kmem* km)
+{
+    struct kmem* victim;
+    struct run*  first;
+    struct run*  last;
+    int          n;
+
+    for (victim = kmem; victim < &kmem[NCPU]; victim++)
+    {
+        if (victim == km || victim->freelist == 0)
+            continue;
+
+        kmem_lock(victim);
+        first = last = victim->freelist;
+        n            = 0;
+        if (first)
+        {
+            // take half of the victim's list, capped at KSTEAL.
+            int want = (victim->nfree - victim->nzero) / 2;
+            if (want < 1)
+                want = 1;
+            if (want > KSTEAL)
+                want = KSTEAL;
+            for (n = 1; n < want && last->next; n++)
+                last = last->next;
+            victim->freelist = last->next;
+            victim->nfree -= n;
+            victim->nstolen += n;
+        }
+        release(&victim->lock);
+
+        if (n == 0)
+            continue;
+
+        kmem_lock(km);
+        last->next   = km->freelist;
+        km->freelist = first;
+        km->nfree += n;
+        km->nsteal++;
+        release(&km->lock);
+        return n;
+    }
+    return 0;
+}
+
+// Take a page off km's free list or, with zeroed, its pool of
+// zeroed pages. Returns 0 if that list is empty.
+// 从 km 的空闲链表或零页池取出一页
+static struct run* kpop(struct kmem* km, int zeroed)
+{
+    struct run** list = zeroed ? &km->zerolist : &km->freelist;
+    struct run*  r;
+
+    kmem_lock(km);
+    if ((r = *list) != 0)
+    {
+        *list = r->next;
+        km->nfree--;
+        if (zeroed)
+            km->nzero--;
+    }
+    release(&km->lock);
+    return r;
 }
 
 // Allocate one 4096-byte page of physical memory.
@@ -80,14 +257,130 @@ void kfree(void* pa)
 void* kalloc(void)
 {
     struct run* r;
+    int         id, i;
 
-    acquire(&kmem.lock);
-    r = kmem.freelist;
-    if (r)
-        kmem.freelist = r->next;
-    release(&kmem.lock);
+    push_off();
+    id = cpuid();
+    while ((r = kpop(&kmem[id], 0)) == 0 && ksteal(&kmem[id]) > 0)
+        ;
+    // the last free pages may all be in zeroed pools.
+    for (i = 0; r == 0 && i < NCPU; i++)
+        r = kpop(&kmem[(id + i) % NCPU], 1);
+    pop_off();
 
     if (r)
+    {
+        PGREF(r) = 1;
+#ifdef KDEBUG
         memset((char*)r, 5, PGSIZE);   // fill with junk
+#endif
+    }
+    return (void*)r;
+}
+
+// Allocate a page of zeroes, for page tables and user memory.
+// It comes from this CPU's pool of pages zeroed while idle if
+// there is one, and is zeroed here otherwise.
+// Returns 0 if the memory cannot be allocated.
+// 分配一个全零的物理页，优先使用零页池
+void* kalloc_zeroed(void)
+{
+    struct kmem* km;
+    struct run*  r;
+
+    push_off();
+    km = &kmem[cpuid()];
+    if ((r = kpop(km, 1)) == 0)
+        __sync_fetch_and_add(&km->nzmiss, 1);
+    pop_off();
+
+    if (r == 0)
+    {
+        if ((r = kalloc()) != 0)
+            pgzero(r);
+        return (void*)r;
+    }
+    r->next  = 0;   // the only word of the page that is not zero
+    PGREF(r) = 1;
     return (void*)r;
 }
+
+// Zero a page from this CPU's free list for its pool, unless
+// the pool has KZEROPAGES already. The scheduler calls this
+// on an idle CPU, with interrupts off, until there is work.
+// Returns 1 if it zeroed a page.
+// 空闲时清零一个空闲页并放入本 CPU 的零页池
+int kzero(void)
+{
+    struct kmem* km = &kmem[cpuid()];
+    struct run*  r;
+
+    if (__atomic_load_n(&km->nzero, __ATOMIC_RELAXED) >= KZEROPAGES)
+        return 0;
+    // still counted in nfree while it is on neither list.
+    kmem_lock(km);
+    if ((r = km->freelist) != 0)
+        km->freelist = r->next;
+    release(&km->lock);
+    if (r == 0)
+        return 0;
+
+    pgzero(r);
+
+    kmem_lock(km);
+    r->next      = km->zerolist;
+    km->zerolist = r;
+    km->nzero++;
+    release(&km->lock);
+    return 1;
+}
+
+// Add a reference to an allocated page, e.g. when fork
+// shares it copy-on-write.
+// 增加物理页的引用计数
+void kdup(void* pa)
+{
+    if (((uint64)pa % PGSIZE) != 0 || (char*)pa < end || (uint64)pa >= PHYSTOP)
+        panic("kdup");
+    if (__sync_fetch_and_add(&PGREF(pa), 1) <= 0)
+        panic("kdup: free page");
+}
+
+// Return the number of references to an allocated page.
+// 返回物理页的引用计数
+int krefcnt(void* pa)
+{
+    return __atomic_load_n(&PGREF(pa), __ATOMIC_RELAXED);
+}
+
+// Set *nfree to the number of free pages, the sum of the
+// per-CPU lists' counts, and *ntotal to the number of pages the
+// allocator manages. No locks: the counts only move by whole
+// pages, so the sum is at worst a little out of date.
+// 统计空闲页数与可分配的总页数
+void kmeminfo(uint64* nfree, uint64* ntotal)
+{
+    struct kmem* km;
+
+    *nfree = 0;
+    for (km = kmem; km < &kmem[NCPU]; km++)
+        *nfree += __atomic_load_n(&km->nfree, __ATOMIC_RELAXED);
+    *ntotal = npages;
+}
+
+// Print per-CPU free list sizes and counters.
+// For debugging; no locks, like procdump().
+// 打印每个 CPU 空闲链表的页数与统计计数
+void kmemdump(void)
+{
+    struct kmem* km;
+
+    for (km = kmem; km < &kmem[NCPU]; km++)
+    {
+        if (km->nfree == 0 && km->nsteal == 0 && km->nstolen == 0 && km->ncontend == 0)
+            continue;
+        printf("kmem cpu%d: free %d zeroed %d zero misses %d steal %d stolen %d contended %d\n",
+               (int)(km - kmem), (int)km->nfree, (int)km->nzero, (int)km->nzmiss, (int)km->nsteal,
+               (int)km->nstolen, (int)km->ncontend);
+    }
+}
@@ -0,0 +1,265 @@
+//
+// Merging of identical read-only user pages.
+//
+// Processes running the same program, or forked from the same
+// parent and left alone, often hold private pages with the same
+// contents that they can no longer write without a fault. A
+// kernel thread, ksmd, wakes every KSMTICKS and hashes each
+// such page (see uvmrdonly()) that no one else holds a
+// reference to, and looks the hash up in a table of frames kept
+// for sharing. A page with the same contents as one of those is
+// remapped to it and freed (see uvmremap()); a page that matches
+// none takes a free slot of the table as a new shared frame.
+//
+// Each frame in the table holds a kalloc() reference of the
+// table's own, so that cowfault() always copies it before a
+// write and its contents never change. A pass counts the
+// mappings it comes across of each frame in the table, and at
+// its end the table lets go of the frames it found mapped once
+// at most: those that matched nothing, and those whose other
+// sharers have gone. References held elsewhere, by the exec
+// cache, a pipe or a copy-on-write fork, do not keep a frame.
+// The last mapping can then be written without a copy, and the
+// slot goes to a page of the next pass.
+//
+// Only the memory below p->sz of sleeping processes that share
+// their page table with no other thread is looked at, one page
+// at a time with p->lock held: such a process is not running
+// on any CPU, and so is neither using a stale TLB entry nor
+// halfway through changing its own page table. That is the
+// program, exec()'s private data and bss among it, and the
+// heap. The mmap() regions lie above p->sz, below MMAPTOP, and
+// are never looked at, so MAP_SHARED pages, which stand for
+// the file and which munmap() writes back, stay as they are.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "defs.h"
+#include "fcntl.h"
+
+#define NKSMHASH 61
+
+extern struct proc proc[NPROC];
+
+struct ksmpage
+{
+    uint64          hash;    // of the frame's contents
+    char*           pa;      // shared frame, or 0 if the slot is free
+    int             seen;    // mappings of it found so far in this pass
+    int             users;   // mappings of it found in the last pass
+    struct ksmpage* next;    // in the same hash bucket, or on the free list
+    struct ksmpage* pnext;   // in the same bucket of byaddr
+};
+
+static struct
+{
+    struct spinlock lock;
+    struct ksmpage  page[NKSM];
+    struct ksmpage* hash[NKSMHASH];     // by contents
+    struct ksmpage* byaddr[NKSMHASH];   // by frame address
+    struct ksmpage* free;
+    uint64          scanned;   // pages hashed
+    uint64          merged;    // pages remapped to a shared frame and freed
+} ksm;
+
+static void ksmd(void);
+
+// 初始化页合并表并启动 ksmd 线程
+void ksminit(void)
+{
+    initlock(&ksm.lock, "ksm");
+    for (int i = 0; i < NKSM; i++)
+    {
+        ksm.page[i].next = ksm.free;
+        ksm.free         = &ksm.page[i];
+    }
+    if (kthread(ksmd, "ksmd") < 0)
+        panic("ksminit");
+}
+
+// FNV-1a over the words of the page at pa.
+// 计算一页内容的哈希值
+static uint64 pghash(char* pa)
+{
+    uint64* w = (uint64*)pa;
+    uint64  h = 0xcbf29ce484222325UL;
+
+    for (int i = 0; i < PGSIZE / sizeof(uint64); i++)
+        h = (h ^ w[i]) * 0x100000001b3UL;
+    return h;
+}
+
+// The bucket of byaddr for the frame at pa.
+// 按物理地址查找共享页的哈希桶
+static struct ksmpage** ksmbyaddr(char* pa)
+{
+    return &ksm.byaddr[(uint64)pa / PGSIZE % NKSMHASH];
+}
+
+// Merge the page at va of pagetable into a shared frame with
+// the same contents, or make it one, if it is a candidate, or
+// count it if it maps one of the table's frames already.
+// Caller holds the owning process's p->lock.
+// 尝试将 va 处的只读页合并到内容相同的共享页，或为已共享的页计数
+static void ksmpage(pagetable_t pagetable, uint64 va)
+{
+    struct ksmpage* kp;
+    char*           pa;
+    uint64          h;
+
+    if ((pa = (char*)uvmrdonly(pagetable, va)) == 0)
+        return;
+    // the table's frames hold a reference of its own, so a page
+    // with a single one is not among them.
+    if (krefcnt(pa) != 1)
+    {
+        acquire(&ksm.lock);
+        for (kp = *ksmbyaddr(pa); kp && kp->pa != pa; kp = kp->pnext)
+            ;
+        if (kp)
+            kp->seen++;
+        release(&ksm.lock);
+        return;
+    }
+    h = pghash(pa);
+
+    acquire(&ksm.lock);
+    ksm.scanned++;
+    for (kp = ksm.hash[h % NKSMHASH]; kp; kp = kp->next)
+        if (kp->hash == h && memcmp(kp->pa, pa, PGSIZE) == 0)
+            break;
+    if (kp)
+    {
+        kdup(kp->pa);
+        uvmremap(pagetable, va, (uint64)kp->pa);
+        kp->seen++;
+        ksm.merged++;
+    }
+    else if ((kp = ksm.free) != 0)
+    {
+        ksm.free               = kp->next;
+        kp->hash               = h;
+        kp->pa                 = pa;
+        kp->seen               = 1;
+        kp->users              = 0;
+        kp->next               = ksm.hash[h % NKSMHASH];
+        ksm.hash[h % NKSMHASH] = kp;
+        kp->pnext              = *ksmbyaddr(pa);
+        *ksmbyaddr(pa)         = kp;
+        kdup(pa);
+    }
+    release(&ksm.lock);
+}
+
+// Look at the pages below p->sz of p while it sleeps with a
+// page table of its own, stopping if it wakes up.
+// 扫描一个睡眠进程的用户页
+static void ksmproc(struct proc* p)
+{
+    pagetable_t pagetable;
+    uint64      va;
+    int         pid, ok;
+
+    acquire(&p->lock);
+    pagetable = p->pagetable;
+    pid       = p->pid;
+    release(&p->lock);
+
+    for (va = 0;; va += PGSIZE)
+    {
+        acquire(&p->lock);
+        ok = p->state == SLEEPING && p->kfn == 0 && p->pid == pid && p->pagetable == pagetable && va < p->sz &&
+             !threaded(p);
+        if (ok)
+            ksmpage(pagetable, va);
+        release(&p->lock);
+        if (!ok)
+            break;
+    }
+}
+
+// Drop the table's reference to the shared frames that the
+// pass just over found mapped once at most, and start the
+// count of the others afresh.
+// 释放本轮扫描中最多只有一个映射的共享页的表内引用
+static void ksmsweep(void)
+{
+    struct ksmpage **pp, **ap, *kp;
+
+    acquire(&ksm.lock);
+    for (int i = 0; i < NKSMHASH; i++)
+    {
+        for (pp = &ksm.hash[i]; (kp = *pp) != 0;)
+        {
+            if (kp->seen > 1)
+            {
+                kp->users = kp->seen;
+                kp->seen  = 0;
+                pp        = &kp->next;
+                continue;
+            }
+            *pp = kp->next;
+            for (ap = ksmbyaddr(kp->pa); *ap != kp; ap = &(*ap)->pnext)
+                ;
+            *ap = kp->pnext;
+            kfree(kp->pa);
+            kp->pa   = 0;
+            kp->next = ksm.free;
+            ksm.free = kp;
+        }
+    }
+    release(&ksm.lock);
+}
+
+// The merging thread: a pass over every process each
+// KSMTICKS, in the batch class so that it runs only when no
+// other process wants the CPU.
+// 页合并线程：定期扫描所有进程
+static void ksmd(void)
+{
+    struct proc* p;
+    uint         ticks0;
+
+    setsched(0, SCHED_BATCH, 19);
+    for (;;)
+    {
+        acquire(&tickslock);
+        ticks0 = ticks;
+        while (ticks - ticks0 < KSMTICKS)
+            tsleep(ticks0 + KSMTICKS);
+        release(&tickslock);
+
+        for (p = proc; p < &proc[NPROC]; p++)
+            if (p != myproc())
+                ksmproc(p);
+        ksmsweep();
+    }
+}
+
+// Return the number of pages merging saves: the mappings of
+// each shared frame that the last pass found, beyond the one
+// it stands for.
+// 返回合并相同页省下的页数
+uint64 ksmsaved(void)
+{
+    struct ksmpage* kp;
+    uint64          n = 0;
+
+    acquire(&ksm.lock);
+    for (kp = ksm.page; kp < &ksm.page[NKSM]; kp++)
+        if (kp->pa && kp->users > 1)
+            n += kp->users - 1;
+    release(&ksm.lock);
+    return n;
+}
+
+// Print the merging counters, for procdump().
+// 打印页合并的统计计数
+void ksmdump(void)
+{
+    printf("ksm: scanned %d merged %d saved %d\n", (int)ksm.scanned, (int)ksm.merged, (int)ksmsaved());
+}
@@ -10,8 +10,8 @@
 // Simple logging that allows concurrent FS system calls.
 //
 // A log transaction contains the updates of multiple FS system
-// calls. The logging system only commits when there are
-// no FS system calls active. Thus there is never
+// calls. The logging system only closes a transaction when
+// there are no FS system calls active. Thus there is never
 // any reasoning required about whether a commit might
 // write an uncommitted system call's updates to disk.
 //
@@ -21,14 +21,50 @@
 // But if it thinks the log is close to running out, it
 // sleeps until the last outstanding end_op() commits.
 //
+// Group commit: end_op() does not commit every transaction.
+// The open transaction keeps absorbing system calls until
+// it is close to full, LOGFLUSHTICKS have passed, or someone
+// calls log_sync() (fsync). A background thread commits
+// transactions that have been open for too long.
+//
+// The log area is split into two segments, used alternately.
+// Closing a transaction snapshots its blocks into private
+// buffers, so new system calls can fill the next segment
+// while the previous one is written and installed.
+//
+// Write-back checkpointing: a committed segment is not
+// installed to the blocks' home locations right away. Its
+// blocks stay pinned in the cache, and it is installed, in
+// block order, when the next commit needs the segment or
+// after LOGCKPTTICKS, by the background thread. A block
+// that the other, later committed segment logs again is
+// left for that segment to install, so a block rewritten by
+// consecutive transactions goes home once.
+//
+// A system call reserves room in the open transaction for
+// the blocks it may log: MAXOPBLOCKS with begin_op(), or any
+// number up to a whole segment with begin_opn(), so that a
+// large write can go in one transaction.
+//
+// With ordered data (ORDEREDDATA, see iordered() in fs.c) the
+// data of ordinary files is written straight to the disk, and
+// only metadata is journaled. A block must therefore not be
+// given to a file while an earlier transaction could still
+// write over it (it is logged in a segment not yet installed),
+// or while the transaction that freed it could still be lost
+// in a crash, leaving it with its old file. log_unsafe() tells
+// balloc() which blocks these are.
+//
 // The log is a physical re-do log containing disk blocks.
-// The on-disk log format:
-//   header block, containing block #s for block A, B, C, ...
+// The on-disk format of each segment:
+//   header block, containing a sequence number and
+//     block #s for block A, B, C, ...
 //   block A
 //   block B
 //   block C
 //   ...
-// Log appends are synchronous.
+// Segments are committed and installed in sequence order,
+// so recovery replays them lowest sequence number first.
 
 /*
 **********************************************************************************************************************
@@ -37,111 +73,252 @@ xv6
 
 日志的格式：
 
-日志头块（header block）：记录事务中涉及的块号（block[LOGSIZE]）和块数量（n）。
+日志区分为两个段，轮流使用。每个段由头块和数据块组成：
+日志头块（header block）：记录事务的序号（seq）、涉及的块号（block[]）和块数量（n）。
 日志数据块：存储修改后的磁盘块内容，紧跟头块。
-日志操作是同步的，确保数据在写入日志时已持久化到磁盘。
+组提交：多个系统调用合并成一个事务，事务满、超时或 fsync 时才提交；
+提交时先把数据块快照到私有缓冲区，新的事务可以同时写入另一个段。
 **********************************************************************************************************************
 */
 
 // Contents of the header block, used for both the on-disk header block
 // and to keep track in memory of logged block# before commit.
-// 日志头块（header block）：记录事务中涉及的块号（block[LOGSIZE]）和块数量（n）。
+// 日志头块（header block）：记录事务序号、涉及的块号（block[]）和块数量（n）。
 struct logheader
 {
     int n;                // 当前日志中有效块的数量
+    int seq;              // 事务序号，恢复时按序号从小到大重放
     int block[LOGSIZE];   // 每个日志块对应的实际磁盘块号
 };
 
+// One half of the on-disk log, holding a closed transaction
+// while it is written to the log and installed.
+// 日志段：保存一个已关闭的事务，直到它写入日志并安装完成。
+struct logseg
+{
+    int              start;               // 段头块的块号
+    int              busy;                // 段中的事务尚未安装完成
+    uint             durableat;           // 段中事务提交（写入日志头）时的 ticks
+    struct logheader lh;                  // 段中事务的日志头
+    struct buf*      bufs[LOGSIZE];       // 缓存中的原始块，安装完成前保持固定
+    struct buf       snap[LOGSIZE / 2];   // 关闭事务时的块快照，不在缓存中
+    uchar            freed[FSSIZE / 8];   // 段中事务释放的块，安装完成前不分给普通文件数据
+};
+
 // 日志数据块：存储修改后的磁盘块内容，紧跟头块。
 struct log
 {
-    struct spinlock  lock;          // 互斥锁
-    int              start;         // 日志区起始扇区号
-    int              size;          // 日志区总块数
-    int              outstanding;   // 未提交的事务数量
-    int              committing;    // 是否正在提交事务（0/1）
-    int              dev;           // 设备号
-    struct logheader lh;            // 日志头（内存缓存）
+    struct spinlock  lock;                // 互斥锁
+    int              start;               // 日志区起始扇区号
+    int              size;                // 日志区总块数
+    int              segsize;             // 每个段的块数（含头块）
+    int              outstanding;         // 未提交的事务数量
+    int              reserved;            // 进行中的系统调用预留的日志块数
+    int              closing;             // 正在关闭当前事务，新的系统调用需等待
+    int              dev;                 // 设备号
+    int              cur;                 // 当前事务将提交到的段
+    int              seq;                 // 当前事务的序号
+    int              durable;             // 已写入日志头（已提交）的最大序号
+    int              installed;           // 已安装到最终位置的最大序号
+    int              installing;          // 正在安装一个日志段
+    uint             lastcommit;          // 上次关闭事务时的 ticks
+    struct logheader lh;                  // 当前事务的日志头（内存缓存）
+    struct buf*      bufs[LOGSIZE];       // 当前事务在缓存中固定的块
+    uchar            freed[FSSIZE / 8];   // 当前事务释放的块
+    struct logseg    seg[2];              // 两个日志段
 };
 struct log log;
 
+// Log statistics, printed by procdump(). Protected by log.lock.
+static struct
+{
+    uint64 absorbed;     // log_write() 时块已在事务中的次数
+    uint64 commits;      // 提交的事务数
+    uint64 installs;     // 安装的日志段数
+    uint64 installed;    // 安装时写回最终位置的块数
+    uint64 superseded;   // 安装时因后一个事务再次记录而跳过的块数
+} lstat;
+
 static void recover_from_log(void);
-static void commit();
+static int  inlog(struct logheader* lh, uint b);
+static void write_head(int start, struct logheader* lh);
+static void commit(void);
+static void logflusher(void);
 
 // 初始化日志系统。
 void initlog(int dev, struct superblock* sb)
 {
+    char* mem = 0;
+    int   i, s, k;
+
     if (sizeof(struct logheader) >= BSIZE)
         panic("initlog: too big logheader");
+    if (sb->nlog > LOGSIZE || sb->nlog < 2 * (MAXOPBLOCKS + 1))
+        panic("initlog: bad log size");
+
+    initticketlock(&log.lock, "log");
+    log.start   = sb->logstart;
+    log.size    = sb->nlog;
+    log.segsize = sb->nlog / 2;
+    log.dev     = dev;
+
+    // Private snapshot buffers, four blocks to a page.
+    k = 0;
+    for (s = 0; s < 2; s++)
+    {
+        log.seg[s].start = log.start + s * log.segsize;
+        for (i = 0; i < log.segsize - 1; i++, k++)
+        {
+            if (k % (PGSIZE / BSIZE) == 0 && (mem = kalloc()) == 0)
+                panic("initlog: out of memory");
+            log.seg[s].snap[i].dev  = dev;
+            log.seg[s].snap[i].data = (uchar*)mem;
+            mem += BSIZE;
+        }
+    }
 
-    initlock(&log.lock, "log");
-    log.start = sb->logstart;
-    log.size  = sb->nlog;
-    log.dev   = dev;
     recover_from_log();
+    log.seq        = 1;
+    log.lastcommit = ticks;
+
+    if ((LOGFLUSHTICKS > 0 || LOGCKPTTICKS > 0) && kthread(logflusher, "logflush") < 0)
+        panic("initlog: logflush");
 }
 
-// Copy committed blocks from log to their home location
-// 将日志中的块内容复制到它们的最终磁盘位置（“home location”）。
-static void install_trans(int recovering)
+// Copy committed blocks of a recovered segment from log to
+// their home location. The log blocks are read, and the home
+// blocks written, each as one batch.
+// 恢复时将日志段中的块内容复制到它们的最终磁盘位置（“home location”）。
+static void install_recovered(int start, struct logheader* lh)
 {
-    int tail;   // 循环索引，用于遍历日志块
+    struct buf* lbufs[LOGSIZE / 2];   // 日志块 (log block)
+    struct buf* dbufs[LOGSIZE / 2];   // 目标块 (destination block)
+    int         tail;                 // 循环索引，用于遍历日志块
 
-    // 遍历日志中所有待应用的块
-    for (tail = 0; tail < log.lh.n; tail++)
+    // 1. 一次性启动所有日志块的读盘，只等待一次
+    for (tail = 0; tail < lh->n; tail++)
+        lbufs[tail] = breadstart(log.dev, start + tail + 1);
+    bwait(lbufs, lh->n);
+    // 2. 将日志块数据复制到目标块（目标块的旧内容无需读盘），此时修改仍在内存，未落盘
+    for (tail = 0; tail < lh->n; tail++)
     {
-        // 1. 读取磁盘日志块 (lbuf = log block)，读取到内存cache中
-        struct buf* lbuf = bread(log.dev, log.start + tail + 1);
-        // 2. 读取目标磁盘块 (dbuf = destination block)，读取到内存cache中
-        struct buf* dbuf = bread(log.dev, log.lh.block[tail]);
-        // 3. 将日志块数据复制到目标块，此时修改仍在内存，未落盘
-        memmove(dbuf->data, lbuf->data, BSIZE);
-        // 4. 将修改后的目标块写回磁盘
-        bwrite(dbuf);
-        // 5. 非恢复模式：解固定目标块
-        if (recovering == 0)
-            bunpin(dbuf);
-        brelse(lbuf);
-        brelse(dbuf);
+        dbufs[tail] = bnew(log.dev, lh->block[tail]);
+        memmove(dbufs[tail]->data, lbufs[tail]->data, BSIZE);
+        brelse(lbufs[tail]);
     }
+    // 3. 将修改后的目标块作为一批写回磁盘（由磁盘队列排序合并）
+    bstart(dbufs, lh->n, 1, 0);
+    bwait(dbufs, lh->n);
+    for (tail = 0; tail < lh->n; tail++)
+        brelse(dbufs[tail]);
+}
+
+// Copy the snapshot of the committed segment s to the blocks'
+// home locations, as one batch that the disk queue sorts into
+// block order, and free the segment for a new transaction.
+// The cached blocks may already hold newer data from later
+// transactions, so write the snapshot, not the cache. Blocks that the other segment, committed later,
+// logs again are skipped: it will install them itself, and
+// recovery would replay them from it. s must be the oldest
+// segment not yet installed, and no other install may be in
+// progress. Called with log.lock held; drops it while
+// talking to the disk and returns with it held.
+// 将已提交段的快照写到块的最终磁盘位置，并释放该段。
+static void install_trans(struct logseg* s)
+{
+    struct logseg*   o = &log.seg[s == &log.seg[0]];
+    struct logheader empty;
+    struct buf*      bs[LOGSIZE / 2];
+    int              i, n = 0, later;
+
+    log.installing = 1;
+    later          = o->busy && o->lh.seq > s->lh.seq && o->lh.seq <= log.durable;
+    for (i = 0; i < s->lh.n; i++)
+    {
+        if (later && inlog(&o->lh, s->lh.block[i]))
+        {
+            lstat.superseded++;
+            continue;
+        }
+        s->snap[i].blockno = s->lh.block[i];
+        bs[n++]            = &s->snap[i];
+    }
+    release(&log.lock);
+
+    bstart(bs, n, 1, 0);
+    bwait(bs, n);
+    for (i = 0; i < s->lh.n; i++)
+        bunpin(s->bufs[i]);
+    empty.n   = 0;
+    empty.seq = s->lh.seq;
+    write_head(s->start, &empty);
+
+    acquire(&log.lock);
+    lstat.installs++;
+    lstat.installed += n;
+    log.installed = s->lh.seq;
+    s->lh.n       = 0;
+    memset(s->freed, 0, sizeof(s->freed));
+    s->busy        = 0;
+    log.installing = 0;
+    wakeup(&log);
+}
+
+// Wait until the committed segment s can be installed, and
+// install it, unless someone else does first. Called and
+// returns with log.lock held.
+// 等待日志段 s 可以安装时将其安装
+static void checkpoint(struct logseg* s)
+{
+    int seq = s->lh.seq;
+
+    while (s->busy && s->lh.seq == seq &&
+           (log.installing || log.durable < seq || log.installed < seq - 1))
+        sleep(&log, &log.lock);
+    if (s->busy && s->lh.seq == seq)
+        install_trans(s);
 }
 
-// Read the log header from disk into the in-memory log header
-// 从磁盘读取日志头块到内存中的 log.lh。
-static void read_head(void)
+// Read the header of the segment at start from disk into lh.
+// 从磁盘读取日志段头块到内存中的 lh。
+static void read_head(int start, struct logheader* lh)
 {
-    // 1. 读取日志头块：从磁盘读取日志区的第一个块（log.start位置）
-    struct buf* buf = bread(log.dev, log.start);
+    // 1. 读取日志头块：从磁盘读取日志段的第一个块
+    struct buf* buf = bread(log.dev, start);
     // 2. 将缓冲区数据转换为日志头结构
-    struct logheader* lh = (struct logheader*)(buf->data);
-    // 3. 复制日志块数量
-    log.lh.n = lh->n;
+    struct logheader* hb = (struct logheader*)(buf->data);
+    // 3. 复制日志块数量和序号
+    lh->n   = hb->n;
+    lh->seq = hb->seq;
+    if (lh->n < 0 || lh->n >= log.segsize)
+        lh->n = 0;
     // 4. 循环复制所有日志条目
-    for (int i = 0; i < log.lh.n; i++)
+    for (int i = 0; i < lh->n; i++)
     {
         // 复制每个日志块对应的实际磁盘块号
-        log.lh.block[i] = lh->block[i];
+        lh->block[i] = hb->block[i];
     }
     // 5. 释放缓冲区
     brelse(buf);
 }
 
-// Write in-memory log header to disk.
-// This is the true point at which the
-// current transaction commits.
-// 将内存中的日志头（log.lh）写入磁盘的头块。
-static void write_head(void)
+// Write the header lh to the segment at start on disk.
+// Writing a non-empty header is the true point at which
+// the segment's transaction commits.
+// 将日志头 lh 写入磁盘上日志段的头块。
+static void write_head(int start, struct logheader* lh)
 {
     // 1. 读取日志头块到缓冲区
-    struct buf* buf = bread(log.dev, log.start);
+    struct buf* buf = bread(log.dev, start);
     // 2. 将缓冲区映射到日志头结构
     struct logheader* hb = (struct logheader*)(buf->data);
-    // 3. 复制内存中的日志块数量到磁盘日志头
-    hb->n = log.lh.n;
+    // 3. 复制内存中的日志块数量和序号到磁盘日志头
+    hb->n   = lh->n;
+    hb->seq = lh->seq;
     // 4. 复制内存中的块映射数组到磁盘日志头
-    for (int i = 0; i < log.lh.n; i++)
+    for (int i = 0; i < lh->n; i++)
     {
-        hb->block[i] = log.lh.block[i];
+        hb->block[i] = lh->block[i];
     }
     // 5. 将修改后的缓冲区写回磁盘
     bwrite(buf);
@@ -151,42 +328,74 @@ static void write_head(void)
 // 从日志中恢复文件系统状态（用于系统启动后的崩溃恢复）。
 static void recover_from_log(void)
 {
-    // 1. 读取磁盘上的日志头信息
-    read_head();
-    // 2. 如果存在已提交但未应用的日志，将其应用到文件系统
-    // 参数1表示处于恢复模式
-    install_trans(1);
-    // 3. 在内存中标记日志为空
-    log.lh.n = 0;
-    // 4. 将空日志头写回磁盘，清除日志
-    write_head();
+    struct logheader* lh[2];
+    int               s;
+
+    // 1. 读取两个日志段的头信息
+    for (s = 0; s < 2; s++)
+    {
+        lh[s] = &log.seg[s].lh;
+        read_head(log.seg[s].start, lh[s]);
+    }
+    // 2. 按序号从小到大将已提交但未应用的日志应用到文件系统
+    s = (lh[0]->n > 0 && lh[1]->n > 0 && lh[1]->seq < lh[0]->seq) ? 1 : 0;
+    install_recovered(log.seg[s].start, lh[s]);
+    install_recovered(log.seg[!s].start, lh[!s]);
+    // 3. 清除两个段的日志头
+    for (s = 0; s < 2; s++)
+    {
+        lh[s]->n = 0;
+        write_head(log.seg[s].start, lh[s]);
+    }
 }
 
 // called at the start of each FS system call.
-// 标记文件系统调用的开始，确保日志空间足够。
+// 标记文件系统调用的开始，预留 MAXOPBLOCKS 个日志块。
 void begin_op(void)
 {
+    begin_opn(MAXOPBLOCKS);
+}
+
+// The most blocks one begin_opn() can reserve: a whole
+// segment, less its header.
+// 单个系统调用最多可预留的日志块数
+int log_opmax(void)
+{
+    return log.segsize - 1;
+}
+
+// called at the start of an FS system call that may log
+// up to n blocks; end it with end_opn(n).
+// 标记文件系统调用的开始，确保日志中有 n 个块的空间。
+void begin_opn(int n)
+{
+    if (n < 1 || n > log_opmax())
+        panic("begin_opn");
     // 获取日志锁（保证互斥访问）
     acquire(&log.lock);
     // 循环直到满足执行条件
     while (1)
     {
-        // 情况1：日志系统正在提交事务
-        if (log.committing)
+        // 情况1：当前事务正在关闭
+        if (log.closing)
         {
-            // 休眠等待提交完成
+            // 休眠等待事务关闭
             sleep(&log, &log.lock);
         }
-        // 情况2：日志空间可能不足
-        else if (log.lh.n + (log.outstanding + 1) * MAXOPBLOCKS > LOGSIZE)
+        // 情况2：当前事务的日志段空间可能不足
+        else if (log.lh.n + log.reserved + n > log.segsize - 1)
         {
-            // 休眠等待空间释放
-            sleep(&log, &log.lock);
+            // 没有进行中的系统调用时由自己提交，否则休眠等待最后一个 end_op() 提交
+            if (log.outstanding == 0)
+                commit();
+            else
+                sleep(&log, &log.lock);
         }
         // 情况3：满足执行条件
         else
         {
             log.outstanding += 1;   // 增加未完成事务计数
+            log.reserved += n;      // 预留日志空间
             release(&log.lock);     // 释放日志锁
             break;                  // 退出循环
         }
@@ -194,87 +403,191 @@ void begin_op(void)
 }
 
 // called at the end of each FS system call.
-// commits if this was the last outstanding operation.
-// 标记文件系统调用的结束，如果是最后一个操作则触发提交。
+// commits if this was the last outstanding operation and
+// the open transaction should not wait for more.
+// 标记文件系统调用的结束，如果是最后一个操作且需要提交则触发提交。
 void end_op(void)
 {
-    // 提交标志，1表示需要提交事务
-    int do_commit = 0;
+    end_opn(MAXOPBLOCKS);
+}
+
+// called at the end of an FS system call begun with
+// begin_opn(n).
+// 结束以 begin_opn(n) 开始的文件系统调用
+void end_opn(int n)
+{
     // 1. 获取日志
     acquire(&log.lock);
-    // 2. 减少未完成事务计数
+    // 2. 减少未完成事务计数，归还预留的日志空间
     log.outstanding -= 1;
-    // 3. 安全检查：确保当前没有正在提交的事务
-    if (log.committing)
-        panic("log.committing");
-    // 4. 判断是否需要提交事务
-    if (log.outstanding == 0)
+    log.reserved -= n;
+    // 3. 判断是否需要提交事务：事务快满、超时或不启用组提交
+    if (log.outstanding == 0 && !log.closing && log.lh.n > 0 &&
+        (LOGFLUSHTICKS == 0 || log.lh.n + MAXOPBLOCKS > log.segsize - 1 ||
+         ticks - log.lastcommit >= LOGFLUSHTICKS))
     {
-        do_commit      = 1;
-        log.committing = 1;
+        commit();   // 执行事务提交
     }
-
     else
     {
         // begin_op() may be waiting for log space,
         // and decrementing log.outstanding has decreased
-        // the amount of reserved space.
-        // 5. 如果不是最后一个事务，唤醒可能等待的进程
+        // the amount of reserved space. flush() may be
+        // waiting for outstanding to drop to zero.
+        // 4. 唤醒可能等待的进程
         wakeup(&log);
     }
-    // 6. 释放日志锁
+    // 5. 释放日志锁
     release(&log.lock);
-    // 7. 如果需要提交，则执行提交操作
-    if (do_commit)
-    {
+}
 
-        // 注意：提交时不持有锁（因为commit可能睡眠）
-        commit();   // 执行事务提交
-        // 提交完成后更新状态
-        acquire(&log.lock);
-        log.committing = 0;   // 清除提交标志
-        wakeup(&log);         // 唤醒等待提交完成的进程
-        release(&log.lock);
+// Start copying a closed segment's snapshot to its log
+// blocks, all at once, filling in bs for the caller to
+// bwait() on.
+// 启动日志段快照写入磁盘日志区域，不等待完成。
+static void write_log(struct logseg* s, struct buf** bs)
+{
+    for (int tail = 0; tail < s->lh.n; tail++)
+    {
+        s->snap[tail].blockno = s->start + tail + 1;
+        bs[tail]              = &s->snap[tail];
     }
+    bstart(bs, s->lh.n, 1, 0);
 }
 
-// Copy modified blocks from cache to log.
-// 将修改的块从缓存复制到磁盘日志区域。
-static void write_log(void)
+// Close the open transaction and commit it. No FS system
+// call may be in progress. Called with log.lock held; drops
+// it while talking to the disk and returns with it held.
+// 关闭当前事务并提交，将日志内容持久化到磁盘。
+static void commit(void)
 {
-    // 循环索引，用于遍历日志块
-    int tail;
-    // 遍历所有需要写入日志的块
-    for (tail = 0; tail < log.lh.n; tail++)
+    struct logseg* s = &log.seg[log.cur];
+    struct buf*    bs[LOGSIZE / 2];
+    int            seq;
+
+    if (log.outstanding != 0)
+        panic("commit: outstanding");
+
+    // 阶段0: 等待日志段空闲（必要时先安装段中已提交的事务），再把块快照到段的私有缓冲区
+    log.closing = 1;
+    if (s->busy)
+        checkpoint(s);
+    if (log.lh.n == 0)
     {
-        // 1. 分配日志块缓冲区（目标位置）
-        struct buf* to = bread(log.dev, log.start + tail + 1);
-        // 2. 获取源数据缓冲区（修改后的数据）
-        struct buf* from = bread(log.dev, log.lh.block[tail]);
-        // 3. 数据复制：从缓存块复制到日志块
-        memmove(to->data, from->data, BSIZE);
-        // 4. 将日志块从内存写入磁盘（日志块）
-        bwrite(to);
-        brelse(from);
-        brelse(to);
+        log.closing = 0;
+        wakeup(&log);
+        return;
     }
+    seq        = log.seq;
+    s->busy    = 1;
+    s->lh.n    = log.lh.n;
+    s->lh.seq  = seq;
+    for (int i = 0; i < log.lh.n; i++)
+    {
+        s->lh.block[i] = log.lh.block[i];
+        s->bufs[i]     = log.bufs[i];
+        memmove(s->snap[i].data, log.bufs[i]->data, BSIZE);
+    }
+    memmove(s->freed, log.freed, sizeof(s->freed));
+    memset(log.freed, 0, sizeof(log.freed));
+    log.lh.n       = 0;
+    log.seq        = seq + 1;
+    log.cur        = !log.cur;
+    log.lastcommit = ticks;
+    log.closing    = 0;
+    wakeup(&log);   // new system calls can fill the other segment now
+    release(&log.lock);
+
+    // 阶段1: 启动修改的数据块写入磁盘的日志区域
+    write_log(s, bs);
+
+    // 阶段2: 写日志头（标记事务已提交），必须在前一个事务提交之后、本段日志块写完之后
+    acquire(&log.lock);
+    while (log.durable < seq - 1)
+        sleep(&log, &log.lock);
+    release(&log.lock);
+    bwait(bs, s->lh.n);
+    write_head(s->start, &s->lh);
+
+    // 阶段3: 将日志中的修改应用到实际的文件系统位置；写回模式下推迟到段被再次使用或超时
+    acquire(&log.lock);
+    log.durable  = seq;
+    s->durableat = ticks;
+    lstat.commits++;
+    wakeup(&log);
+    if (LOGCKPTTICKS == 0)
+        checkpoint(s);
+}
+
+// Commit the open transaction, if any, once the FS system
+// calls in progress have finished. New system calls are
+// held off in begin_op() meanwhile. Called and returns with
+// log.lock held.
+// 等待进行中的系统调用结束后提交当前事务
+static void flush(void)
+{
+    while (log.closing)
+        sleep(&log, &log.lock);
+    if (log.lh.n == 0)
+        return;
+    log.closing = 1;
+    while (log.outstanding > 0)
+        sleep(&log, &log.lock);
+    commit();
+}
+
+// Make every completed FS system call durable: commit the
+// open transaction and wait until it is on disk.
+// Must not be called between begin_op() and end_op().
+// 提交当前事务并等待其写入磁盘（fsync 屏障）。
+void log_sync(void)
+{
+    int target;
+
+    acquire(&log.lock);
+    target = log.lh.n > 0 ? log.seq : log.seq - 1;
+    flush();
+    while (log.durable < target)
+        sleep(&log, &log.lock);
+    release(&log.lock);
 }
 
-// 提交事务，将日志内容持久化到磁盘。
-static void commit()
+// Background thread that commits transactions that have
+// been open for LOGFLUSHTICKS, so group commit never delays
+// durability by more than that, and installs segments that
+// have been committed for LOGCKPTTICKS.
+// 后台线程：定期提交打开过久的事务，并安装提交过久的日志段。
+static void logflusher(void)
 {
-    // 检查是否有需要提交的日志块
-    if (log.lh.n > 0)
+    uint           period = LOGFLUSHTICKS;
+    uint           ticks0;
+    struct logseg* s;
+
+    if (period == 0 || (LOGCKPTTICKS > 0 && LOGCKPTTICKS < period))
+        period = LOGCKPTTICKS;
+    for (;;)
     {
-        // 阶段1: 将修改的数据块写入磁盘的日志区域
-        write_log();
-        // 阶段2: 写日志头（标记事务已提交）
-        write_head();
-        // 阶段3: 将日志中的修改应用到实际的文件系统位置
-        install_trans(0);
-        // 阶段4: 清理日志
-        log.lh.n = 0;
-        write_head();
+        acquire(&tickslock);
+        ticks0 = ticks;
+        while (ticks - ticks0 < period)
+            tsleep(ticks0 + period);
+        release(&tickslock);
+
+        acquire(&log.lock);
+        if (log.lh.n > 0 && ticks - log.lastcommit >= LOGFLUSHTICKS)
+            flush();
+        // install the oldest segment first.
+        for (;;)
+        {
+            s = &log.seg[0];
+            if (!s->busy || (log.seg[1].busy && log.seg[1].lh.seq < s->lh.seq))
+                s = &log.seg[1];
+            if (LOGCKPTTICKS == 0 || !s->busy || log.installing || log.durable < s->lh.seq ||
+                ticks - s->durableat < LOGCKPTTICKS)
+                break;
+            install_trans(s);
+        }
+        release(&log.lock);
     }
 }
 
@@ -293,8 +606,8 @@ void log_write(struct buf* b)
     int i;
     // 1. 获取日志锁（保证互斥访问）
     acquire(&log.lock);
-    // 2. 安全检查：日志空间是否充足
-    if (log.lh.n >= LOGSIZE || log.lh.n >= log.size - 1)
+    // 2. 安全检查：日志段空间是否充足
+    if (log.lh.n >= log.segsize - 1)
         panic("too big a transaction");
     // 3. 安全检查：是否在有效事务中
     if (log.outstanding < 1)
@@ -303,16 +616,71 @@ void log_write(struct buf* b)
     for (i = 0; i < log.lh.n; i++)
     {
         if (log.lh.block[i] == b->blockno)   // 块已存在日志中
+        {
+            lstat.absorbed++;
             break;
+        }
     }
     // 5. 记录块号到日志头
     log.lh.block[i] = b->blockno;
     // 6. 如果是新块，添加到日志
     if (i == log.lh.n)
     {
-        bpin(b);      // 固定缓冲区（增加引用计数）
-        log.lh.n++;   // 增加日志块计数
+        bpin(b);            // 固定缓冲区（增加引用计数）
+        log.bufs[i] = b;    // 关闭事务时从这里做快照
+        log.lh.n++;         // 增加日志块计数
     }
     // 7. 释放日志锁
     release(&log.lock);
 }
+
+// Record that block b was freed by the open transaction.
+// 记录当前事务释放了块 b
+void log_free(uint b)
+{
+    acquire(&log.lock);
+    if (b < FSSIZE)
+        log.freed[b / 8] |= 1 << (b % 8);
+    release(&log.lock);
+}
+
+// Whether lh lists block b.
+// 判断日志头 lh 中是否包含块 b
+static int inlog(struct logheader* lh, uint b)
+{
+    for (int i = 0; i < lh->n; i++)
+        if (lh->block[i] == b)
+            return 1;
+    return 0;
+}
+
+// Whether writing block b around the log could be undone:
+// it is logged by the open transaction or by a segment not
+// yet installed, which would write it over, or was freed by a
+// transaction that is not yet installed, which a crash could
+// lose, leaving b in the file it was freed from.
+// 判断块 b 此时是否不能绕过日志直接写入
+int log_unsafe(uint b)
+{
+    int r, s;
+
+    if (b >= FSSIZE)
+        return 1;
+    acquire(&log.lock);
+    r = inlog(&log.lh, b) || (log.freed[b / 8] & (1 << (b % 8)));
+    for (s = 0; s < 2 && !r; s++)
+        if (log.seg[s].busy)
+            r = inlog(&log.seg[s].lh, b) || (log.seg[s].freed[b / 8] & (1 << (b % 8)));
+    release(&log.lock);
+    return r;
+}
+
+// Print log statistics, for procdump().
+// 打印日志统计信息
+void logdump(void)
+{
+    printf("log: %ld commits, %ld absorbed, %ld installs, %ld blocks installed (%ld per commit), "
+           "%ld superseded\n",
+           lstat.commits, lstat.absorbed, lstat.installs, lstat.installed,
+           lstat.commits ? lstat.installed / lstat.commits : 0, lstat.superseded);
+}
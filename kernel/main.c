@@ -4,8 +4,48 @@
 #include "riscv.h"
 #include "defs.h"
 
+#define TIMEMHZ 10   // r_time() counts at 10 MHz under qemu
+
 volatile static int started = 0;
 
+// The end of each boot phase on CPU 0, in r_time() units since
+// reset, printed once it is done so that cold-boot time can be
+// tracked.
+#define NPHASE 8
+
+static struct
+{
+    char*  name;
+    uint64 end;
+} phases[NPHASE];
+static int nphase;
+
+// Note that boot phase name has just ended.
+// 记录一个启动阶段的结束时刻
+static void phase(char* name)
+{
+    if (nphase < NPHASE)
+    {
+        phases[nphase].name  = name;
+        phases[nphase++].end = r_time();
+    }
+}
+
+// Print how long each boot phase took, in microseconds.
+// 打印各启动阶段的耗时
+static void phasedump(void)
+{
+    uint64 t = 0;
+
+    printf("boot:");
+    for (int i = 0; i < nphase; i++)
+    {
+        printf(" %s %dus", phases[i].name, (int)((phases[i].end - t) / TIMEMHZ));
+        t = phases[i].end;
+    }
+    printf(", total %dus\n", (int)(t / TIMEMHZ));
+}
+
 // start() jumps here in supervisor mode on all CPUs.
 void main()
 {
@@ -16,24 +56,40 @@ void main()
         printf("\n");
         printf("xv6 kernel is booting\n");
         printf("\n");
+        phase("console");
         kinit();              // physical page allocator
+        slabinit();           // small object allocator
         kvminit();            // create kernel page table
         kvminithart();        // turn on paging
+        phase("vm");
         procinit();           // process table
         trapinit();           // trap vectors
         trapinithart();       // install kernel trap vector
         plicinit();           // set up interrupt controller
         plicinithart();       // ask PLIC for device interrupts
+        phase("trap");
         binit();              // buffer cache
+        pcacheinit();         // page cache
+        execcacheinit();      // exec cache
         iinit();              // inode table
         fileinit();           // file table
-        virtio_disk_init();   // emulated hard disk
+        statsinit();          // lock statistics device
+        profinit();           // sampling profiler
+        phase("fs");
+        virtio_disk_init();   // emulated hard disks
+        ramdiskinit();        // memory-backed disk
+        phase("disk");
         userinit();           // first user process
+        ksminit();            // identical page merging thread
+        kinithart();          // pages the other harts have not freed
+        phase("user");
+        phasedump();
         __sync_synchronize();
         started = 1;
     }
     else
     {
+        kinithart();   // free pages while CPU 0 boots
         while (started == 0)
             ;
         __sync_synchronize();
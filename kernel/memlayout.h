@@ -21,12 +21,16 @@
 #define UART0     0x10000000L
 #define UART0_IRQ 10
 
-// virtio mmio interface
+// virtio mmio interface. qemu's virt machine has a block of
+// them; the second holds an optional second disk.
 #define VIRTIO0     0x10001000L
 #define VIRTIO0_IRQ 1
+#define VIRTIO1     0x10002000L
+#define VIRTIO1_IRQ 2
 
 // core local interruptor (CLINT), which contains the timer.
 #define CLINT                  0x2000000L
+#define CLINT_MSIP(hartid)     (CLINT + 4 * (hartid))   // machine software interrupt pending
 #define CLINT_MTIMECMP(hartid) (CLINT + 0x4000 + 8 * (hartid))
 #define CLINT_MTIME            (CLINT + 0xBFF8)   // cycles since boot.
 
@@ -71,6 +75,38 @@
 //   fixed-size stack
 //   expandable heap
 //   ...
+//   mmap() regions, placed downwards from MMAPTOP
+//   USYSRING (struct sysring, read-write, see sysring.h)
+//   USHARED (struct ushared, read-only, the same in every process)
+//   USYSCALL (struct usyscall, read-only, p->usyscall)
+//   TFRAME(NTHREAD-1) ... TFRAME(1), trapframes of threads made by clone()
 //   TRAPFRAME (p->trapframe, used by the trampoline)
 //   TRAMPOLINE (the same page as in the kernel)
 #define TRAPFRAME (TRAMPOLINE - PGSIZE)
+#define TFRAME(t) (TRAPFRAME - (uint64)(t) * PGSIZE)
+#define USYSCALL  TFRAME(NTHREAD)
+#define USHARED   (USYSCALL - PGSIZE)
+#define USYSRING  (USHARED - PGSIZE)
+#define MMAPTOP   (USYSRING - PGSIZE)
+
+// User addresses below UKMAPTOP, the lowest device address, are
+// mapped in the process's kernel page table as well, where
+// copyin() and copyout() can reach them directly (see
+// kvmsync() in vm.c).
+#define UKMAPTOP CLINT
+
+#ifndef __ASSEMBLER__
+// Values that user code reads from the USYSCALL page instead of
+// making the system calls that return them; see user/ulib.c.
+struct usyscall
+{
+    int pid;   // getpid(), or 0 once threads share the page
+};
+
+// Values of the USHARED page, which the kernel updates for all
+// processes at once.
+struct ushared
+{
+    uint ticks;   // uptime()
+};
+#endif
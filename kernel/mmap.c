@@ -0,0 +1,435 @@
+//
+// Memory-mapped files.
+//
+// mmap() only records a struct vma in the process; nothing is
+// read until a page of the region is first touched, when
+// vmafault() fills it from the inode with readi(), going
+// through the buffer cache like read() does. exec() maps the
+// segments of a program the same way. munmap(), exit() and
+// exec() write the dirty pages of MAP_SHARED regions back with
+// writei() and drop the mapping.
+//
+// Pages that a MAP_PRIVATE region only reads come from the page
+// cache (pcache.c) and are shared by every process mapping
+// them, which is what lets programs share their text. A
+// MAP_SHARED region maps its own copy of each page instead, so
+// its changes reach the file when the region is unmapped rather
+// than immediately, and are not seen by other processes mapping
+// the same file until then.
+//
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "fs.h"
+#include "sleeplock.h"
+#include "file.h"
+#include "fcntl.h"
+
+// Return the region of p containing va, or 0.
+// 查找进程 p 中包含地址 va 的映射区域
+struct vma* vmalookup(struct proc* p, uint64 va)
+{
+    struct vma* v;
+
+    for (v = p->vma; v < &p->vma[NVMA]; v++)
+        if (v->len && va >= v->addr && va < v->addr + v->len)
+            return v;
+    return 0;
+}
+
+// Return the lowest address used by p's mappings above the
+// heap, which is as far as the heap may grow. Program segments
+// lie below p->sz.
+// 返回堆之上映射区域的最低地址，即堆增长的上限
+uint64 vmafloor(struct proc* p)
+{
+    struct vma* v;
+    uint64      floor = MMAPTOP;
+
+    for (v = p->vma; v < &p->vma[NVMA]; v++)
+        if (v->len && v->addr >= p->sz && v->addr < floor)
+            floor = v->addr;
+    return floor;
+}
+
+// Return a region of p overlapping [addr, addr+len), or 0.
+// 查找与地址范围重叠的映射区域
+static struct vma* vmaoverlap(struct proc* p, uint64 addr, uint64 len)
+{
+    struct vma* v;
+
+    for (v = p->vma; v < &p->vma[NVMA]; v++)
+        if (v->len && addr < v->addr + v->len && v->addr < addr + len)
+            return v;
+    return 0;
+}
+
+// Find a free slot in p's table of regions.
+// 分配一个空闲的映射区域槽位
+static struct vma* vmaalloc(struct proc* p)
+{
+    struct vma* v;
+
+    for (v = p->vma; v < &p->vma[NVMA]; v++)
+        if (v->len == 0)
+            return v;
+    return 0;
+}
+
+// Record a region of len bytes at addr of p, which must not
+// overlap any other, mapping f from offset off; file offsets
+// from fileend on read as zeros. Takes a new reference to f.
+// Returns 0 on success, -1 if p has no free slot.
+// 为进程 p 记录一个映射区域
+int vmaadd(struct proc* p, uint64 addr, uint64 len, int prot, int flags, struct file* f, uint64 off,
+           uint64 fileend)
+{
+    struct vma* v;
+
+    if ((v = vmaalloc(p)) == 0)
+        return -1;
+    v->addr    = addr;
+    v->len     = len;
+    v->prot    = prot;
+    v->flags   = flags;
+    v->f       = filedup(f);
+    v->off     = off;
+    v->fileend = fileend;
+    return 0;
+}
+
+// Map len bytes of f, starting at file offset off, into the
+// current process. The address hint is ignored: regions are
+// placed top-down below MMAPTOP, at the highest gap that fits
+// above the heap.
+// Returns the address of the mapping, or -1.
+// 将文件 f 从 off 开始的 len 字节映射到当前进程的地址空间
+uint64 mmap(uint64 addr, uint64 len, int prot, int flags, struct file* f, uint64 off)
+{
+    struct proc* p = myproc();
+    struct vma*  o;
+    uint64       top;
+
+    if (len == 0 || len > MMAPTOP || off % PGSIZE != 0)
+        return -1;
+    // each thread made by clone() has a copy of the regions.
+    if (threaded(p))
+        return -1;
+    if (flags != MAP_SHARED && flags != MAP_PRIVATE)
+        return -1;
+    if (f->type != FD_INODE || !f->readable)
+        return -1;
+    // private pages are never written back, so only a shared
+    // writable mapping needs a writable file.
+    if (flags == MAP_SHARED && (prot & PROT_WRITE) && !f->writable)
+        return -1;
+    if (vmaalloc(p) == 0)
+        return -1;
+    len = PGROUNDUP(len);
+    top = MMAPTOP;
+    while (top >= PGROUNDUP(p->sz) + len && (o = vmaoverlap(p, top - len, len)) != 0)
+        top = o->addr;
+    if (top < PGROUNDUP(p->sz) + len)
+        return -1;
+    if (vmaadd(p, top - len, len, prot, flags, f, off, off + len) < 0)
+        return -1;
+    return top - len;
+}
+
+// Write the pages of [start, end) in v that were modified
+// since they were read in back to the file. Nothing is
+// written past the end of the file. A page counts as modified
+// when its PTE is dirty: the hardware sets the bit on stores by
+// the process, and copyout() on its own (see uvmxlate()).
+// 将共享映射中被修改过的页写回文件
+static void vmawriteback(struct proc* p, struct vma* v, uint64 start, uint64 end)
+{
+    struct inode* ip  = v->f->ip;
+    int           max = ((MAXOPBLOCKS - 1 - 1 - 2) / 2) * BSIZE;
+    uint64        va, pa;
+
+    for (va = start; va < end; va += PGSIZE)
+    {
+        // clean before writing, so that a store made meanwhile
+        // dirties the page again rather than being lost.
+        if ((pa = uvmclean(p->pagetable, va)) == 0)
+            continue;
+
+        uint   off = v->off + (va - v->addr);
+        int    i   = 0;
+        while (i < PGSIZE)
+        {
+            int n1 = PGSIZE - i;
+            if (n1 > max)
+                n1 = max;
+
+            begin_op();
+            ilock(ip);
+            if (off + i >= ip->size)
+                n1 = 0;
+            else if (off + i + n1 > ip->size)
+                n1 = ip->size - (off + i);
+            if (n1 > 0)
+                writei(ip, 0, pa + i, off + i, n1);
+            iunlock(ip);
+            end_op();
+
+            if (n1 < max)
+                break;
+            i += n1;
+        }
+    }
+}
+
+// Unmap [addr, addr+len) of p, which must lie within one
+// region; the region shrinks, or is split in two if the range
+// is in its middle. p must be the current process.
+// Returns 0 on success, -1 on error.
+// 解除 [addr, addr+len) 的映射，必要时将区域一分为二
+static int vmaunmap(struct proc* p, uint64 addr, uint64 len)
+{
+    struct vma* v;
+    struct vma* w;
+    uint64      end, vend;
+
+    if (addr % PGSIZE != 0 || len == 0)
+        return -1;
+    if ((v = vmalookup(p, addr)) == 0)
+        return -1;
+    end  = PGROUNDUP(addr + len);
+    vend = v->addr + v->len;
+    if (end > vend)
+        return -1;
+
+    w = 0;
+    if (addr > v->addr && end < vend && (w = vmaalloc(p)) == 0)
+        return -1;
+
+    if (v->flags == MAP_SHARED)
+        vmawriteback(p, v, addr, end);
+    uvmunmap(p->pagetable, addr, (end - addr) / PGSIZE, 1);
+
+    if (addr == v->addr && end == vend)
+    {
+        struct file* f = v->f;
+        v->len         = 0;
+        v->f           = 0;
+        fileclose(f);
+    }
+    else if (addr == v->addr)
+    {
+        v->addr = end;
+        v->len  = vend - end;
+        v->off += end - addr;
+    }
+    else if (end == vend)
+    {
+        v->len = addr - v->addr;
+    }
+    else
+    {
+        *w      = *v;
+        w->addr = end;
+        w->len  = vend - end;
+        w->off  = v->off + (end - v->addr);
+        filedup(w->f);
+        v->len = addr - v->addr;
+    }
+    return 0;
+}
+
+// Unmap [addr, addr+len) of the current process.
+// 解除当前进程的一段内存映射
+int munmap(uint64 addr, uint64 len)
+{
+    if (threaded(myproc()))
+        return -1;
+    return vmaunmap(myproc(), addr, len);
+}
+
+// Give np, a thread being made by clone(), a copy of the
+// regions of p, whose pages it shares along with the rest of
+// p's page table. Neither may map or unmap regions while they
+// share it; see threaded().
+// 将进程 p 的内存映射复制给共享其页表的新线程（用于 clone）
+void vmashare(struct proc* p, struct proc* np)
+{
+    int i;
+
+    for (i = 0; i < NVMA; i++)
+    {
+        np->vma[i] = p->vma[i];
+        if (p->vma[i].len)
+            np->vma[i].f = filedup(p->vma[i].f);
+    }
+}
+
+// Forget the regions of p, an exiting thread, leaving their
+// pages mapped for the other threads sharing its page table.
+// The thread it shares them with holds its own references to
+// the files, so fileclose() does not sleep here.
+// 退出的线程丢弃其映射区域的副本，页面留给共享页表的其他线程
+void vmadrop(struct proc* p)
+{
+    struct vma* v;
+
+    for (v = p->vma; v < &p->vma[NVMA]; v++)
+    {
+        if (v->len)
+        {
+            fileclose(v->f);
+            v->len = 0;
+        }
+    }
+}
+
+// Unmap all of p's regions, writing back shared ones.
+// Called by exit() and exec() for the current process.
+// 解除进程的全部内存映射
+void vmaunmapall(struct proc* p)
+{
+    struct vma* v;
+
+    for (v = p->vma; v < &p->vma[NVMA]; v++)
+        if (v->len)
+            vmaunmap(p, v->addr, v->len);
+}
+
+// Give np, the child being made by fork(), the regions of p.
+// The pages already read in are shared copy-on-write, as the
+// rest of the memory is, so a MAP_PRIVATE change made by either
+// process after the fork is not seen by the other one. Parts
+// of regions below p->sz, i.e. program segments, were already
+// shared by uvmcopy().
+// Returns 0 on success, -1 on failure, with np left without
+// any region.
+// 将父进程的内存映射复制给子进程（用于 fork）
+int vmacopy(struct proc* p, struct proc* np)
+{
+    int i;
+
+    for (i = 0; i < NVMA; i++)
+    {
+        struct vma* v = &p->vma[i];
+        if (v->len == 0)
+            continue;
+        uint64 start = v->addr < PGROUNDUP(p->sz) ? PGROUNDUP(p->sz) : v->addr;
+        if (start < v->addr + v->len &&
+            uvmcopyrange(p->pagetable, np->pagetable, start, v->addr + v->len) < 0)
+            goto err;
+        np->vma[i]   = *v;
+        np->vma[i].f = filedup(v->f);
+    }
+    return 0;
+
+err:
+    // p still holds a reference to every file, so fileclose()
+    // only drops a count here and never sleeps.
+    while (--i >= 0)
+    {
+        struct vma* w = &np->vma[i];
+        if (w->len == 0)
+            continue;
+        uint64 start = w->addr < PGROUNDUP(p->sz) ? PGROUNDUP(p->sz) : w->addr;
+        if (start < w->addr + w->len)
+            uvmunmap(np->pagetable, start, (w->addr + w->len - start) / PGSIZE, 1);
+        fileclose(w->f);
+        w->len = 0;
+    }
+    return -1;
+}
+
+// Fill in the page at va of p's region v, which is not yet
+// mapped, from the file. A page past the end of the file reads
+// as zeros. A private region that is read shares the page with
+// the page cache when the whole page comes from the file; if
+// the region is writable, the page is mapped copy-on-write.
+// Returns 0 on success, -1 if the access is not allowed or the
+// page cannot be read in here.
+// 处理映射区域的缺页：从文件（或页缓存）中读入该页并建立映射
+int vmafault(struct proc* p, uint64 va, int write)
+{
+    struct vma*   v = vmalookup(p, va);
+    struct inode* ip;
+    char*         mem;
+    uint64        off;
+    int           perm, held, r;
+
+    if (v == 0)
+        return -1;
+    if (write && (v->prot & PROT_WRITE) == 0)
+        return -1;
+    if (!write && (v->prot & (PROT_READ | PROT_EXEC)) == 0)
+        return -1;
+
+    // readi() sleeps, so a copyout() or copyin() done while
+    // holding a spinlock cannot read the page in; the caller
+    // has to drop its locks and call vmfault() itself. Nor is
+    // another inode's lock taken here while one is held: two
+    // processes each copying between one file and a mapping of
+    // the other would deadlock. read() and write() fault their
+    // buffers in before locking the file (see vmaprefault()).
+    ip = v->f->ip;
+    push_off();
+    held = mycpu()->noff > 1;
+    pop_off();
+    if (held || myproc()->ilocks > 0)
+        return -1;
+
+    // RISC-V has no write-only pages.
+    perm = PTE_U;
+    if (v->prot & (PROT_READ | PROT_WRITE))
+        perm |= PTE_R;
+    if (v->prot & PROT_WRITE)
+        perm |= PTE_W;
+    if (v->prot & PROT_EXEC)
+        perm |= PTE_X;
+
+    va  = PGROUNDDOWN(va);
+    off = v->off + (va - v->addr);
+    ilock(ip);
+    if (!write && v->flags == MAP_PRIVATE && off + PGSIZE <= v->fileend)
+    {
+        mem = pcacheget(ip, off);
+        if (perm & PTE_W)
+            perm = (perm & ~PTE_W) | PTE_COW;
+    }
+    else if ((mem = kalloc_zeroed()) != 0)
+    {
+        if (off < v->fileend)
+            readi(ip, 0, (uint64)mem, off, v->fileend - off < PGSIZE ? v->fileend - off : PGSIZE);
+    }
+    iunlock(ip);
+    if (mem == 0)
+        return -1;
+
+    acquire(&vmlock);
+    r = uvmmapshared(p->pagetable, va, (uint64)mem, perm);
+    release(&vmlock);
+    if (r != 0)
+    {
+        kfree(mem);
+        return r < 0 ? -1 : 0;
+    }
+    return 0;
+}
+
+// Fault in the pages of [va, va+len) that lie in regions of p
+// and are not mapped yet, for a copy to them if write is set
+// or from them otherwise, which is about to be done with an
+// inode locked and so could not read them in (see vmafault()).
+// Pages that cannot be read in are left for the copy to fail on.
+// 在锁定 inode 之前预先读入 [va, va+len) 中尚未映射的文件映射页
+void vmaprefault(struct proc* p, uint64 va, uint64 len, int write)
+{
+    uint64 a;
+
+    for (a = PGROUNDDOWN(va); a < va + len && a < MAXVA; a += PGSIZE)
+        if (vmalookup(p, a) && walkaddr(p->pagetable, a) == 0)
+            vmafault(p, a, write);
+}
@@ -1,13 +1,48 @@
-#define NPROC       64                  // 最大进程数量
-#define NCPU        8                   // 最大CPU数
-#define NOFILE      16                  // 每个进程打开的文件数
-#define NFILE       100                 // 系统打开文件数
-#define NINODE      50                  // 最大活动的inode数
-#define NDEV        10                  // 最大设备数
-#define ROOTDEV     1                   // 文件系统根设备数量
-#define MAXARG      32                  // 最大exec参数
-#define MAXOPBLOCKS 10                  // 系统调用最大操作磁盘块数
-#define LOGSIZE     (MAXOPBLOCKS * 3)   // 最大磁盘日志块
-#define NBUF        (MAXOPBLOCKS * 3)   // 缓冲层数据块
-#define FSSIZE      2000                // 文件系统最大块数
-#define MAXPATH     128                 // 路径最长名字
\ No newline at end of file
+#define NPROC         64                  // 最大进程数量
+#define NCPU          8                   // 最大CPU数
+#define CACHELINE     64                  // 缓存行字节数：每个 CPU 的数据按它对齐，以免伪共享
+#define TICKCYCLES    1000000             // 时钟滴答和时间片的长度（r_time() 单位，qemu 中约 1/10 秒）
+#define PROFCYCLES    (TICKCYCLES / 10)   // 性能采样的间隔（r_time() 单位，qemu 中约 1/100 秒）
+#define NPROFSAMPLE   4096                // 每个 CPU 的性能采样缓冲区可存的样本数
+#define BATCHSKIP     8                   // 批处理进程等待时普通进程最多连续运行的时间片数
+#define NOFILE        16                  // 每个进程打开的文件数
+#define NFILE         100                 // 启动时预分配的打开文件数，不足时从 kmalloc() 扩充
+#define NINODE        50                  // 启动时预分配的活动inode数，不足时按页扩充
+#define NIHASH        61                  // inode 表的哈希桶数
+#define NDEV          10                  // 最大设备数
+#define NBDEV         4                   // 最大块设备数（bdevsw 的项数）
+#define DISKDEV       1                   // 第一块 virtio 磁盘的块设备号
+#define RAMDEV        2                   // 内存盘的块设备号
+#define DISK1DEV      3                   // 第二块 virtio 磁盘（若有）的块设备号
+#ifdef RAMROOT
+#define ROOTDEV       RAMDEV              // 根文件系统所在的块设备号：启动时从 DISKDEV 载入内存盘
+#else
+#define ROOTDEV       DISKDEV             // 根文件系统所在的块设备号
+#endif
+#define MAXARG        32                  // 最大exec参数
+#define MAXOPBLOCKS   10                  // 系统调用最大操作磁盘块数
+#define LOGSIZE       (MAXOPBLOCKS * 6)   // 最大磁盘日志块（分为两个段）
+#define LOGFLUSHTICKS 10                  // 组提交：事务最长保持打开的 ticks，0 表示每次都提交
+#define LOGCKPTTICKS  50                  // 写回：已提交的日志段推迟安装的最长 ticks，0 表示提交后立即安装
+#define ORDEREDDATA   1                   // 1 表示普通文件的数据块绕过日志直接写盘，只记录元数据
+#define NBUF          (MAXOPBLOCKS * 3)   // 缓冲层数据块的最小数量
+#define BCACHEFRAC    64                  // 缓冲层最多占用物理内存的 1/BCACHEFRAC
+#define RAMIN         2                   // 顺序读预读窗口的初始块数
+#define RAMAX         16                  // 顺序读预读窗口的最大块数
+#define FSSIZE        20000               // 文件系统最大块数
+#define RAMDISKBLOCKS FSSIZE              // 内存盘的默认块数，RAMROOT 时按映像大小扩大；块在首次写入时才分配内存
+#define MAXPIPEPAGES  16                  // 管道缓冲区最多的页数（2 的幂）
+#define KUSERMAP      1                   // 1 表示每个进程的内核页表也映射其 UKMAPTOP 以下的用户内存，copyin/copyout 直接访问
+#define NVMA          16                  // 每个进程最多的内存映射区域数
+#define NTHREAD       8                   // 共享一个地址空间的最多线程数（含创建者）
+#define NPCACHE       64                  // 页缓存的页数
+#define NKSM          256                 // 可供多个进程共享的相同内容页的最多数量
+#define KSMTICKS      50                  // 页合并线程两次扫描之间的 ticks
+#define KZEROPAGES    64                  // 每个 CPU 空闲时预先清零的最多空闲页数
+#define NEXECCACHE    8                   // 执行缓存的程序数，每个保存解析好的程序头
+#define EXECPAGES     16                  // 执行缓存为每个程序常驻的只读代码页数
+#define NDCACHE       128                 // 目录查找缓存的最多项数，按需从 kmalloc() 分配
+#define NDHASH        61                  // 目录查找缓存的哈希桶数
+#define MAXBACKOFF    1024                // 自旋锁指数退避的最长等待循环数
+#define TICKETBACKOFF 64                  // 排队锁中每个排在前面的等待者对应的等待循环数
+#define MAXPATH       128                 // 路径最长名字
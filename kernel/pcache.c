@@ -0,0 +1,145 @@
+// Page cache.
+//
+// A small cache of whole file pages, so that the processes
+// running a program, or otherwise mapping a file privately,
+// share the physical pages of the parts they only read. Each
+// cached page holds a kalloc() reference of its own; a process
+// mapping it takes another (see vmafault()), and the page is
+// really freed once both the cache and every mapping have
+// dropped theirs.
+//
+// Interface:
+// * pcacheget() returns the page at a page-aligned offset of a
+//     locked inode, reading it in on a miss.
+// * pcacheinval() drops the pages of an inode once it changes;
+//     writei() and itrunc() call it. Pages already mapped keep
+//     the old contents, as with the copy made by a private
+//     mapping.
+//
+// The inode's sleep-lock orders a fill against writes to the
+// file; pcache.lock only protects the table itself.
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "riscv.h"
+#include "defs.h"
+#include "fs.h"
+#include "file.h"
+
+struct
+{
+    struct spinlock lock;
+    struct
+    {
+        uint  dev;
+        uint  inum;
+        uint  off;    // Page-aligned file offset
+        char* pa;     // Cached page, or 0 if the slot is free
+        uint  used;   // Value of tick at the last lookup, for LRU
+    } page[NPCACHE];
+    uint   tick;
+    uint64 hit;
+    uint64 miss;
+} pcache;
+
+// 初始化页缓存
+void pcacheinit(void)
+{
+    initlock(&pcache.lock, "pcache");
+}
+
+// Return the page at offset off of ip, with a reference for
+// the caller, who must hold ip->lock and later kfree() it.
+// Bytes past the end of the file read as zeros.
+// Returns 0 if out of memory.
+// 获取 ip 在偏移 off 处的缓存页，未命中时从文件读入
+char* pcacheget(struct inode* ip, uint off)
+{
+    char* mem;
+    int   i, victim;
+
+    if (!holdingsleep(&ip->lock) || off % PGSIZE != 0)
+        panic("pcacheget");
+
+    acquire(&pcache.lock);
+    for (i = 0; i < NPCACHE; i++)
+    {
+        if (pcache.page[i].pa && pcache.page[i].dev == ip->dev && pcache.page[i].inum == ip->inum &&
+            pcache.page[i].off == off)
+        {
+            pcache.page[i].used = ++pcache.tick;
+            pcache.hit++;
+            mem = pcache.page[i].pa;
+            kdup(mem);
+            release(&pcache.lock);
+            return mem;
+        }
+    }
+    pcache.miss++;
+    release(&pcache.lock);
+
+    // ip->lock keeps anyone else from filling the same page
+    // while readi() sleeps.
+    if ((mem = kalloc()) == 0)
+        return 0;
+    pgzero(mem);
+    readi(ip, 0, (uint64)mem, off, PGSIZE);
+
+    acquire(&pcache.lock);
+    victim = 0;
+    for (i = 0; i < NPCACHE; i++)
+    {
+        if (pcache.page[i].pa == 0)
+        {
+            victim = i;
+            break;
+        }
+        if (pcache.page[i].used < pcache.page[victim].used)
+            victim = i;
+    }
+    if (pcache.page[victim].pa)
+        kfree(pcache.page[victim].pa);
+    pcache.page[victim].dev  = ip->dev;
+    pcache.page[victim].inum = ip->inum;
+    pcache.page[victim].off  = off;
+    pcache.page[victim].pa   = mem;
+    pcache.page[victim].used = ++pcache.tick;
+    kdup(mem);
+    ip->pcached = 1;
+    release(&pcache.lock);
+    return mem;
+}
+
+// Drop the cached pages of ip, whose contents are changing.
+// The caller must hold ip->lock.
+// 使 ip 的所有缓存页失效
+void pcacheinval(struct inode* ip)
+{
+    int i;
+
+    acquire(&pcache.lock);
+    for (i = 0; i < NPCACHE; i++)
+    {
+        if (pcache.page[i].pa && pcache.page[i].dev == ip->dev && pcache.page[i].inum == ip->inum)
+        {
+            kfree(pcache.page[i].pa);
+            pcache.page[i].pa = 0;
+        }
+    }
+    ip->pcached = 0;
+    release(&pcache.lock);
+}
+
+// Print page cache statistics, for procdump().
+// 打印页缓存统计信息
+void pcachedump(void)
+{
+    int i, n = 0;
+
+    for (i = 0; i < NPCACHE; i++)
+        if (pcache.page[i].pa)
+            n++;
+    printf("pcache: %d/%d pages, hit %d, miss %d\n", n, NPCACHE, (int)pcache.hit, (int)pcache.miss);
+}
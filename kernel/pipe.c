@@ -7,21 +7,111 @@
 #include "fs.h"
 #include "sleeplock.h"
 #include "file.h"
+#include "poll.h"
 
-// 定义管道缓冲区大小为 512 字节，限制管道一次可存储的数据量
-#define PIPESIZE 512
+#define min(a, b) ((a) < (b) ? (a) : (b))
 
 // 定义管道的内存数据结构，用于存储数据和状态。
+// The buffer is a ring of size bytes spread over size/PGSIZE
+// separately allocated pages. size is a power of two, so the
+// free-running nread and nwrite counters stay valid when they
+// wrap around.
 struct pipe
 {
-    struct spinlock lock;             // 自旋锁，保护管道数据
-    char            data[PIPESIZE];   // 管道缓冲区，固定大小
-    uint            nread;            // 已读取的字节数
-    uint            nwrite;           // 已写入的字节数
-    int             readopen;         // 读端是否仍打开（1=打开，0=关闭）
-    int             writeopen;        // 写端是否仍打开（1=打开，0=关闭）
+    struct spinlock lock;                 // 自旋锁，保护管道数据
+    char*           page[MAXPIPEPAGES];   // 环形缓冲区所在的页
+    uint            size;                 // 缓冲区大小（字节），PGSIZE 的 2 的幂倍
+    uint            nread;                // 已读取的字节数
+    uint            nwrite;               // 已写入的字节数
+    int             readopen;             // 读端是否仍打开（1=打开，0=关闭）
+    int             writeopen;            // 写端是否仍打开（1=打开，0=关闭）
 };
 
+// Return the address of byte off of pi's ring, and set *len to
+// the number of bytes from there to the end of its page.
+// 返回环形缓冲区中第 off 字节的地址，以及到页末尾的连续字节数
+static char* pipeptr(struct pipe* pi, uint off, uint* len)
+{
+    uint i = off % pi->size;
+
+    *len = PGSIZE - i % PGSIZE;
+    return pi->page[i / PGSIZE] + i % PGSIZE;
+}
+
+// Make sure the ring page holding byte off is not shared with a
+// process that spliced it in, before the kernel writes to it.
+// Returns 0, or -1 if there is no memory for a private copy.
+// 写入前确保环形缓冲区的页不与其他进程共享
+static int pipeunshare(struct pipe* pi, uint off)
+{
+    char** pg = &pi->page[off % pi->size / PGSIZE];
+    char*  mem;
+
+    if (krefcnt(*pg) == 1)
+        return 0;
+    if ((mem = kalloc()) == 0)
+        return -1;
+    pgcopy(mem, *pg);
+    kfree(*pg);
+    *pg = mem;
+    return 0;
+}
+
+// Move whole pages between the ring and user memory by
+// reference, when the user buffer, the ring position and the
+// amount of data or space all line up on pages. Writing, the
+// user's page takes the place of the ring page, and becomes
+// copy-on-write for the writer. Reading, the ring page is
+// mapped at the user's address and the ring gets a fresh one.
+// Returns 1 if a page was moved, 0 to fall back to copying.
+// 按页零拷贝地在管道与用户内存之间移动数据
+static int pipeswap(struct pipe* pi, pagetable_t pagetable, uint64 va, int write)
+{
+    char** pg;
+    uint64 pa;
+    char*  mem;
+
+    if (va % PGSIZE != 0)
+        return 0;
+    if (write)
+    {
+        pg = &pi->page[pi->nwrite % pi->size / PGSIZE];
+        if (pi->nwrite % PGSIZE != 0 || pi->nread + pi->size - pi->nwrite < PGSIZE)
+            return 0;
+        if ((pa = uvmshare(pagetable, va)) == 0)
+            return 0;
+        kfree(*pg);
+        *pg = (char*)pa;
+        pi->nwrite += PGSIZE;
+    }
+    else
+    {
+        pg = &pi->page[pi->nread % pi->size / PGSIZE];
+        if (pi->nread % PGSIZE != 0 || pi->nwrite - pi->nread < PGSIZE)
+            return 0;
+        if ((mem = kalloc()) == 0)
+            return 0;
+        if (uvmgift(pagetable, va, (uint64)*pg) != 0)
+        {
+            kfree(mem);
+            return 0;
+        }
+        *pg = mem;
+        pi->nread += PGSIZE;
+    }
+    return 1;
+}
+
+// Free a pipe and its buffer pages.
+static void pipefree(struct pipe* pi)
+{
+    for (int i = 0; i < pi->size / PGSIZE; i++)
+        if (pi->page[i])
+            kfree(pi->page[i]);
+    freelock(&pi->lock);
+    kmfree(pi);
+}
+
 // 创建管道，分配读端和写端的文件描述符（f0 和 f1），并初始化管道结构。
 int pipealloc(struct file** f0, struct file** f1)
 {
@@ -31,7 +121,11 @@ int pipealloc(struct file** f0, struct file** f1)
     *f0 = *f1 = 0;
     if ((*f0 = filealloc()) == 0 || (*f1 = filealloc()) == 0)
         goto bad;
-    if ((pi = (struct pipe*)kalloc()) == 0)
+    if ((pi = (struct pipe*)kmalloc(sizeof(*pi))) == 0)
+        goto bad;
+    memset(pi, 0, sizeof(*pi));
+    pi->size = PGSIZE;
+    if ((pi->page[0] = kalloc()) == 0)
         goto bad;
     pi->readopen  = 1;
     pi->writeopen = 1;
@@ -50,7 +144,7 @@ int pipealloc(struct file** f0, struct file** f1)
 
 bad:
     if (pi)
-        kfree((char*)pi);
+        pipefree(pi);
     if (*f0)
         fileclose(*f0);
     if (*f1)
@@ -77,17 +171,25 @@ void pipeclose(struct pipe* pi, int writable)
     if (pi->readopen == 0 && pi->writeopen == 0)
     {
         release(&pi->lock);
-        kfree((char*)pi);
+        pipefree(pi);
     }
     else
         release(&pi->lock);
+    pollwake();
 }
 
 // 从用户空间地址 addr 向管道写入 n 个字节。
-int pipewrite(struct pipe* pi, uint64 addr, int n)
+// Data is copied in contiguous chunks: as much as fits before
+// the end of a buffer page, at most two per lap of a one-page ring.
+// With splice set, whole user pages are moved by reference
+// where possible (see pipeswap()). With nonblock set, only what
+// fits is written, which may be nothing.
+int pipewrite(struct pipe* pi, uint64 addr, int n, int splice, int nonblock)
 {
-    int          i  = 0;
+    int          i  = 0, r;
     struct proc* pr = myproc();
+    char*        dst;
+    uint         m;
 
     acquire(&pi->lock);
     while (i < n)
@@ -98,55 +200,185 @@ int pipewrite(struct pipe* pi, uint64 addr, int n)
             release(&pi->lock);
             return -1;
         }
-        if (pi->nwrite == pi->nread + PIPESIZE)
+        if (pi->nwrite == pi->nread + pi->size)
         {   // DOC: pipewrite-full
+            if (nonblock)
+                break;
             wakeup(&pi->nread);
             sleep(&pi->nwrite, &pi->lock);
         }
+        else if (splice && n - i >= PGSIZE && pipeswap(pi, pr->pagetable, addr + i, 1))
+        {
+            i += PGSIZE;
+        }
         else
         {
-            char ch;
-            // 使用 copyin 从用户地址 addr + i 复制 1 字节到 ch。
-            if (copyin(pr->pagetable, &ch, addr + i, 1) == -1)
+            // 使用 copyin 从用户地址 addr + i 复制一段连续数据到缓冲区。
+            if (pipeunshare(pi, pi->nwrite) != 0)
                 break;
-            pi->data[pi->nwrite++ % PIPESIZE] = ch;
-            i++;
+            dst = pipeptr(pi, pi->nwrite, &m);
+            m   = min(m, pi->nread + pi->size - pi->nwrite);
+            m   = min(m, n - i);
+            if (copyin(pr->pagetable, dst, addr + i, m) == -1)
+            {
+                // a page of a mapped file cannot be read in while
+                // pi->lock is held; fault it in and try again.
+                release(&pi->lock);
+                r = uvmtouch(pr->pagetable, addr + i, m, 0);
+                acquire(&pi->lock);
+                if (r != 0)
+                    break;
+                continue;
+            }
+            pi->nwrite += m;
+            i += m;
         }
     }
     wakeup(&pi->nread);
     release(&pi->lock);
+    pollwake();
 
     return i;
 }
 
 // 从管道读取最多 n 个字节到用户空间地址 addr。
-int piperead(struct pipe* pi, uint64 addr, int n)
+// With splice set, whole pages are mapped into the reader
+// where possible (see pipeswap()). With nonblock set, an empty
+// pipe whose write end is open returns -1 at once.
+int piperead(struct pipe* pi, uint64 addr, int n, int splice, int nonblock)
 {
-    int          i;
+    int          i, r;
     struct proc* pr = myproc();
-    char         ch;
+    char*        src;
+    uint         m;
 
     acquire(&pi->lock);
     // 如果管道为空且写端仍打开，调用sleep
     while (pi->nread == pi->nwrite && pi->writeopen)
     {   // DOC: pipe-empty
-        if (killed(pr))
+        if (killed(pr) || nonblock)
         {
             release(&pi->lock);
             return -1;
         }
         sleep(&pi->nread, &pi->lock);   // DOC: piperead-sleep
     }
-    for (i = 0; i < n; i++)
-    {   //无数据则退出循环。
-        if (pi->nread == pi->nwrite)
-            break;
-        // 使用 copyout 将 ch 复制到用户地址 addr + i。
-        ch = pi->data[pi->nread++ % PIPESIZE];
-        if (copyout(pr->pagetable, addr + i, &ch, 1) == -1)
-            break;
+    // 无数据则退出循环。
+    for (i = 0; i < n && pi->nread != pi->nwrite; i += m)
+    {
+        m = PGSIZE;   // a page moved by reference
+        if (splice && n - i >= PGSIZE && pipeswap(pi, pr->pagetable, addr + i, 0))
+            continue;
+        // 使用 copyout 将一段连续数据复制到用户地址 addr + i。
+        src = pipeptr(pi, pi->nread, &m);
+        m   = min(m, pi->nwrite - pi->nread);
+        m   = min(m, n - i);
+        if (copyout(pr->pagetable, addr + i, src, m) == -1)
+        {
+            // as in pipewrite().
+            release(&pi->lock);
+            r = uvmtouch(pr->pagetable, addr + i, m, 1);
+            acquire(&pi->lock);
+            if (r != 0)
+                break;
+            m = 0;
+            continue;
+        }
+        pi->nread += m;
     }
     wakeup(&pi->nwrite);   // DOC: piperead-wakeup
     release(&pi->lock);
+    pollwake();
     return i;
 }
+
+// Return the poll() events that pi's write end, if writable,
+// or else its read end, is ready for.
+// 返回管道一端已就绪的 poll 事件
+int pipepoll(struct pipe* pi, int writable)
+{
+    int ev = 0;
+
+    acquire(&pi->lock);
+    if (writable && pi->readopen == 0)
+        ev = POLLERR;
+    else if (writable && pi->nwrite != pi->nread + pi->size)
+        ev = POLLOUT;
+    else if (!writable && pi->writeopen == 0)
+        ev = POLLIN | POLLHUP;
+    else if (!writable && pi->nread != pi->nwrite)
+        ev = POLLIN;
+    release(&pi->lock);
+    return ev;
+}
+
+// Return the size of pi's buffer in bytes.
+// 返回管道缓冲区的大小
+int pipesize(struct pipe* pi)
+{
+    return pi->size;
+}
+
+// Give pi a buffer of at least size bytes, rounded up to a
+// power-of-two number of pages, and move the buffered data
+// into it. Fails if the data would not fit.
+// Returns the new size, or -1.
+// 调整管道缓冲区大小，返回新大小；失败返回 -1。
+int piperesize(struct pipe* pi, int size)
+{
+    char* page[MAXPIPEPAGES];
+    char *src, *dst;
+    uint  npage, oldn, len, off, m, n;
+    int   i;
+
+    if (size <= 0 || size > MAXPIPEPAGES * PGSIZE)
+        return -1;
+    for (npage = 1; npage * PGSIZE < size; npage *= 2)
+        ;
+    for (i = 0; i < npage; i++)
+    {
+        if ((page[i] = kalloc()) == 0)
+        {
+            while (--i >= 0)
+                kfree(page[i]);
+            return -1;
+        }
+    }
+
+    acquire(&pi->lock);
+    len = pi->nwrite - pi->nread;
+    if (len > npage * PGSIZE)
+    {
+        release(&pi->lock);
+        for (i = 0; i < npage; i++)
+            kfree(page[i]);
+        return -1;
+    }
+    // 将已缓冲的数据复制到新缓冲区的开头
+    for (off = 0; off < len; off += m)
+    {
+        src = pipeptr(pi, pi->nread + off, &m);
+        dst = page[off / PGSIZE] + off % PGSIZE;
+        n   = PGSIZE - off % PGSIZE;
+        m   = min(min(m, n), len - off);
+        memmove(dst, src, m);
+    }
+    // 交换新旧页，旧页在释放锁后释放
+    oldn = pi->size / PGSIZE;
+    for (i = 0; i < MAXPIPEPAGES; i++)
+    {
+        src         = pi->page[i];
+        pi->page[i] = i < npage ? page[i] : 0;
+        page[i]     = i < oldn ? src : 0;
+    }
+    pi->size   = npage * PGSIZE;
+    pi->nread  = 0;
+    pi->nwrite = len;
+    wakeup(&pi->nwrite);   // there may be room for writers now
+    release(&pi->lock);
+    pollwake();
+
+    for (i = 0; i < oldn; i++)
+        kfree(page[i]);
+    return npage * PGSIZE;
+}
@@ -13,6 +13,7 @@ void plicinit(void)
     // set desired IRQ priorities non-zero (otherwise disabled).
     *(uint32*)(PLIC + UART0_IRQ * 4)   = 1;   // UART中断优先级设为1
     *(uint32*)(PLIC + VIRTIO0_IRQ * 4) = 1;   // 磁盘中断优先级设为1
+    *(uint32*)(PLIC + VIRTIO1_IRQ * 4) = 1;   // 第二块磁盘中断优先级设为1
 }
 
 // 核心相关中断配置
@@ -21,9 +22,9 @@ void plicinithart(void)
     int hart = cpuid();
 
     // set enable bits for this hart's S-mode
-    // for the uart and virtio disk.
+    // for the uart and virtio disks.
     // 打开当前核心的UART和磁盘中断
-    *(uint32*)PLIC_SENABLE(hart) = (1 << UART0_IRQ) | (1 << VIRTIO0_IRQ);
+    *(uint32*)PLIC_SENABLE(hart) = (1 << UART0_IRQ) | (1 << VIRTIO0_IRQ) | (1 << VIRTIO1_IRQ);
 
     // set this hart's S-mode priority threshold to 0.
     // 设置核心优先级阈值为0（接受所有优先级>0的中断）
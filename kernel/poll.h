@@ -0,0 +1,16 @@
+// One file to wait on with poll(): fd and the events to wait
+// for go in, and the events that have happened come back in
+// revents. POLLERR, POLLHUP and POLLNVAL are reported whether
+// asked for or not; an fd below 0 is skipped.
+struct pollfd
+{
+    int   fd;
+    short events;    // 等待的事件
+    short revents;   // 已发生的事件
+};
+
+#define POLLIN   0x01   // 可读而不阻塞：有数据，或写端已关闭
+#define POLLOUT  0x04   // 可写而不阻塞：有空间
+#define POLLERR  0x08   // 管道的读端已关闭，写入会失败
+#define POLLHUP  0x10   // 管道的写端已关闭
+#define POLLNVAL 0x20   // fd 未打开
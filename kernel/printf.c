@@ -26,11 +26,11 @@ static struct
 
 static char digits[] = "0123456789abcdef";
 
-static void printint(int xx, int base, int sign)
+static void printint(long long xx, int base, int sign)
 {
-    char buf[16];
-    int  i;
-    uint x;
+    char   buf[24];
+    int    i;
+    uint64 x;
 
     if (sign && (sign = xx < 0))
         x = -xx;
@@ -59,7 +59,8 @@ static void printptr(uint64 x)
         consputc(digits[x >> (sizeof(uint64) * 8 - 4)]);
 }
 
-// Print to the console. only understands %d, %x, %p, %s.
+// Print to the console. only understands %d, %u, %x, %p, %s,
+// and %ld, %lu, %lx for 64-bit values.
 void printf(char* fmt, ...)
 {
     va_list ap;
@@ -89,9 +90,30 @@ void printf(char* fmt, ...)
         case 'd':
             printint(va_arg(ap, int), 10, 1);
             break;
+        case 'u':
+            printint(va_arg(ap, uint), 10, 0);
+            break;
         case 'x':
             printint(va_arg(ap, int), 16, 1);
             break;
+        case 'l':
+            c = fmt[++i] & 0xff;
+            if (c == 'd')
+                printint(va_arg(ap, uint64), 10, 1);
+            else if (c == 'u')
+                printint(va_arg(ap, uint64), 10, 0);
+            else if (c == 'x')
+                printint(va_arg(ap, uint64), 16, 0);
+            else
+            {
+                consputc('%');
+                consputc('l');
+                if (c == 0)
+                    i--;
+                else
+                    consputc(c);
+            }
+            break;
         case 'p':
             printptr(va_arg(ap, uint64));
             break;
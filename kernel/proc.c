@@ -3,8 +3,11 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "seqlock.h"
 #include "proc.h"
 #include "defs.h"
+#include "fcntl.h"
+#include "sysinfo.h"
 
 // CPU信息表
 struct cpu cpus[NCPU];
@@ -12,23 +15,84 @@ struct cpu cpus[NCPU];
 // 进程表
 struct proc proc[NPROC];
 
+// A per-CPU run queue of RUNNABLE processes: a FIFO for each
+// scheduling class, linked through p->rqnext. A process is on
+// exactly one run queue while it is RUNNABLE and on none
+// otherwise. Lock order: p->lock, then a run queue lock; never
+// hold two run queue locks at once.
+struct runq
+{
+    struct spinlock lock;
+    struct proc*    head[NSCHED];
+    struct proc*    tail[NSCHED];
+    int             n;               // 队列长度，可不加锁读取作为提示
+    int             nclass[NSCHED];  // 各调度类的进程数，同上
+    int             skip;            // 批处理进程等待期间普通进程连续运行的时间片数
+} __attribute__((aligned(CACHELINE)));   // 每个 CPU 的队列独占缓存行
+
+// 每个 CPU 的运行队列
+static struct runq runq[NCPU];
+
+// Sleeping processes, hashed by wait channel into lists linked
+// through p->wqnext, so that wakeup() only visits processes
+// sleeping on a channel that shares the bucket. A process is
+// on a list exactly while it is SLEEPING. Lock order: the lock
+// passed to sleep(), then a wait queue lock, then p->lock.
+#define NWAITQ 61
+
+struct waitq
+{
+    struct spinlock lock;
+    struct proc*    head;
+};
+
+// 按等待通道散列的等待队列
+static struct waitq waitq[NWAITQ];
+
+// Held by futex() from its check of the futex word until the
+// waiter is on its wait queue, and while waking, so that no
+// wakeup can fall in between.
+static struct spinlock futex_lock;
+
+// 计算 chan 所在的等待队列
+static struct waitq* wqhash(void* chan)
+{
+    return &waitq[((uint64)chan >> 3) % NWAITQ];
+}
+
 // 指向初始用户进程
 struct proc* initproc;
 
 int             nextpid = 1;   // 进程ID
-struct spinlock pid_lock;      // 自旋锁
+struct spinlock pid_lock;      // 保护 nextpid 与 pidhash 的修改
+
+// Processes with a pid, hashed by it into lists linked
+// through p->pidnext, so that kill() need not scan proc[].
+// Changes are made under pid_lock inside pidseq, and lookups
+// take no lock at all: pidfind() just reads the bucket again
+// if it changed meanwhile.
+#define NPIDHASH 61
+
+static struct proc*   pidhash[NPIDHASH];
+static struct seqlock pidseq;
+
+static int ncpus;   // CPUs that have entered scheduler()
 
 extern void forkret(void);
+static void kthreadret(void);
+static void spawnret(void);
 static void freeproc(struct proc* p);
+static void unsleep(struct proc* p);
 
 extern char trampoline[];   // trampoline.S
 
-// helps ensure that wakeups of wait()ing
-// parents are not lost. helps obey the
-// memory model when using p->parent.
-// must be acquired before any p->lock.
-// 保护父进程等待子进程时的同步，防止竞争条件
-struct spinlock wait_lock;
+// Each process keeps a list of its children, p->children,
+// under its own p->wlock, which it also sleeps on in wait(),
+// so that a parent looks only at its own children and
+// parents reaping at the same time do not contend. An exiting
+// child holds its parent's wlock to wake it, which keeps the
+// wakeup from being lost. Lock order: a process's wlock, then
+// its parent's or init's; a wlock before any p->lock.
 
 // Allocate a page for each process's kernel stack.
 // Map it high in memory, followed by an invalid
@@ -56,10 +120,16 @@ void procinit(void)
     struct proc* p;
 
     initlock(&pid_lock, "nextpid");
-    initlock(&wait_lock, "wait_lock");
+    initseqlock(&pidseq, "pidhash");
+    initlock(&futex_lock, "futex");
+    for (int i = 0; i < NCPU; i++)
+        initlock(&runq[i].lock, "runq");
+    for (int i = 0; i < NWAITQ; i++)
+        initlock(&waitq[i].lock, "waitq");
     for (p = proc; p < &proc[NPROC]; p++)
     {
         initlock(&p->lock, "proc");
+        initlock(&p->wlock, "wait");
         p->state = UNUSED;
         // 绑定进程栈的虚拟地址
         p->kstack = KSTACK((int)(p - proc));
@@ -97,17 +167,239 @@ struct proc* myproc(void)
     return p;
 }
 
-// 分配进程 ID
-int allocpid()
+// Wake a CPU waiting in wfi to take the process just queued
+// on CPU id's run queue: CPU id itself if it is idle, else
+// another to steal it, unless id is about to run it anyway
+// because p is the process giving id up. If id is running a
+// process of a lower class, end its time slice now instead.
+// 唤醒一个空闲 CPU 来运行刚加入 CPU id 运行队列的进程
+static void runq_kick(int id, struct proc* p)
+{
+    struct proc* cur = cpus[id].proc;
+
+    if (__atomic_load_n(&cpus[id].idling, __ATOMIC_SEQ_CST))
+    {
+        timerkick(id);
+        return;
+    }
+    if (cur == p)
+        return;
+    if (cur && p->sclass < cur->sclass)
+    {
+        cpus[id].sliceend = 1;
+        timerkick(id);
+        return;
+    }
+    for (int i = 1; i < NCPU; i++)
+    {
+        if (__atomic_load_n(&cpus[(id + i) % NCPU].idling, __ATOMIC_SEQ_CST))
+        {
+            timerkick((id + i) % NCPU);
+            return;
+        }
+    }
+}
+
+// Mark p RUNNABLE and append it to its class's queue on the
+// run queue of p->cpu. Caller must hold p->lock.
+// 将进程标记为可运行并加入其 CPU 运行队列中所属调度类的队尾
+static void setrunnable(struct proc* p)
+{
+    struct runq* rq = &runq[p->cpu];
+    int          c  = p->sclass;
+
+    if (!holding(&p->lock))
+        panic("setrunnable");
+    p->state = RUNNABLE;
+    acquire(&rq->lock);
+    p->rqnext = 0;
+    if (rq->tail[c])
+        rq->tail[c]->rqnext = p;
+    else
+        rq->head[c] = p;
+    rq->tail[c] = p;
+    rq->n++;
+    rq->nclass[c]++;
+    release(&rq->lock);
+    runq_kick(p->cpu, p);
+}
+
+// Take the process at the head of the highest class's queue
+// in rq, or return 0. A waiting batch process goes ahead of
+// the normal ones once they have had BATCHSKIP slices in a
+// row, so that it is not starved. The caller must then
+// acquire its p->lock before running it.
+// 从运行队列中取出优先级最高的进程
+static struct proc* runq_pop(struct runq* rq)
+{
+    struct proc* p = 0;
+    int          c;
+
+    if (rq->n == 0)
+        return 0;
+    acquire(&rq->lock);
+    for (c = 0; c < NSCHED && rq->head[c] == 0; c++)
+        ;
+    if (c == SCHED_NORMAL && rq->head[SCHED_BATCH])
+    {
+        if (rq->skip >= BATCHSKIP)
+            c = SCHED_BATCH;
+        else
+            rq->skip++;
+    }
+    if (c == SCHED_BATCH)
+        rq->skip = 0;
+    if (c < NSCHED)
+    {
+        p           = rq->head[c];
+        rq->head[c] = p->rqnext;
+        if (rq->head[c] == 0)
+            rq->tail[c] = 0;
+        rq->n--;
+        rq->nclass[c]--;
+        p->rqnext = 0;
+    }
+    release(&rq->lock);
+    return p;
+}
+
+// Should a process of class c that has used up its time slice
+// give way to one waiting in rq? It should for one of the
+// same or a higher class, and a normal process should for a
+// batch one that runq_pop() would now put first.
+// 时间片用完的 c 类进程是否应让位给 rq 中等待的进程
+static int runq_preempts(struct runq* rq, int c)
 {
-    int pid;
+    int i, yes = 0;
+
+    if (rq->n == 0)
+        return 0;
+    acquire(&rq->lock);
+    for (i = 0; i <= c; i++)
+        if (rq->head[i])
+            yes = 1;
+    if (!yes && c == SCHED_NORMAL && rq->head[SCHED_BATCH])
+    {
+        if (rq->skip >= BATCHSKIP)
+            yes = 1;
+        else
+            rq->skip++;
+    }
+    release(&rq->lock);
+    return yes;
+}
+
+// The length of p's time slice, in r_time() units: TICKCYCLES
+// at nice 0, twice that at -20, a twentieth at 19, and four
+// times as long for a batch process, which has no one to be
+// responsive to.
+// 计算进程的时间片长度
+static uint64 timeslice(struct proc* p)
+{
+    uint64 t = TICKCYCLES * (20 - p->nice) / 20;
+
+    if (p->sclass == SCHED_BATCH)
+        t *= 4;
+    return t;
+}
+
+// Find work for an idle CPU in the other CPUs' run queues,
+// starting with the next CPU so that thieves spread out.
+// 空闲 CPU 从其他 CPU 的运行队列窃取一个进程
+static struct proc* runq_steal(int id)
+{
+    struct proc* p;
+
+    for (int i = 1; i < NCPU; i++)
+        if ((p = runq_pop(&runq[(id + i) % NCPU])) != 0)
+            return p;
+    return 0;
+}
+
+// Wait for an interrupt with nothing to run. The timer is
+// left armed only for CPU 0's ticks, so another CPU sleeps
+// until a device interrupts or runq_kick() finds it idling.
+// Interrupts stay off from the last look at the run queues
+// to the wfi, which an interrupt pending meanwhile ends at
+// once, so that a kick cannot be taken and lost before it.
+// 没有可运行进程时用 wfi 等待中断
+static void idle(struct cpu* c)
+{
+    int i, queued;
+
+    intr_off();
+    timerarm();
+    __atomic_store_n(&c->idling, 1, __ATOMIC_SEQ_CST);
+    // zero free pages for kalloc_zeroed() a page at a time,
+    // until there is something to run.
+    do
+    {
+        queued = 0;
+        for (i = 0; i < NCPU; i++)
+            queued |= __atomic_load_n(&runq[i].n, __ATOMIC_SEQ_CST);
+    } while (!queued && kzero());
+    if (!queued)
+        asm volatile("wfi");
+    __atomic_store_n(&c->idling, 0, __ATOMIC_SEQ_CST);
+}
+
+// Give p a new pid and add it to the pid hash.
+// Caller must hold p->lock.
+// 分配进程 ID 并将进程加入 pid 哈希表
+static void allocpid(struct proc* p)
+{
+    struct proc** b;
 
     acquire(&pid_lock);
-    pid     = nextpid;
+    p->pid  = nextpid;
     nextpid = nextpid + 1;
+    b       = &pidhash[p->pid % NPIDHASH];
+    writeseqbegin(&pidseq);
+    p->pidnext = *b;
+    *b         = p;
+    writeseqend(&pidseq);
     release(&pid_lock);
+}
 
-    return pid;
+// Take p out of the pid hash. Caller must hold p->lock.
+// 将进程移出 pid 哈希表
+static void freepid(struct proc* p)
+{
+    struct proc** pp;
+
+    acquire(&pid_lock);
+    for (pp = &pidhash[p->pid % NPIDHASH]; *pp != p; pp = &(*pp)->pidnext)
+        ;
+    writeseqbegin(&pidseq);
+    *pp = p->pidnext;
+    writeseqend(&pidseq);
+    release(&pid_lock);
+    p->pidnext = 0;
+}
+
+// Find the process with the given pid, or return 0, without
+// taking a lock. The process may exit and its slot be used
+// again at any time, so the caller must lock it and check
+// p->pid once more. A walk that meets a change to the hash
+// may go astray, and is not trusted: it stops after NPROC
+// steps and starts over once pidseq says the change is done.
+// 不加锁地按 pid 查找进程
+static struct proc* pidfind(int pid)
+{
+    struct proc* p;
+    uint         s;
+    int          n;
+
+    if (pid <= 0)
+        return 0;
+    do
+    {
+        s = readseqbegin(&pidseq);
+        for (p = pidhash[pid % NPIDHASH], n = 0; p && n < NPROC; p = p->pidnext, n++)
+            if (p->pid == pid)
+                break;
+    } while (readseqretry(&pidseq, s));
+    return p;
 }
 
 // Look in the process table for an UNUSED proc.
@@ -134,8 +426,14 @@ static struct proc* allocproc(void)
     return 0;
 
 found:
-    p->pid   = allocpid();
-    p->state = USED;
+    allocpid(p);
+    p->state   = USED;
+    p->cpu     = cpuid();
+    p->sclass  = SCHED_NORMAL;
+    p->nice    = 0;
+    p->cputime = 0;
+    p->nvcsw   = 0;
+    p->nivcsw  = 0;
 
     // Allocate a trapframe page.
     if ((p->trapframe = (struct trapframe*)kalloc()) == 0)
@@ -145,6 +443,17 @@ found:
         return 0;
     }
 
+    // Allocate the page of values user code reads without a
+    // system call.
+    if ((p->usyscall = (struct usyscall*)kalloc()) == 0)
+    {
+        freeproc(p);
+        release(&p->lock);
+        return 0;
+    }
+    memset(p->usyscall, 0, PGSIZE);
+    p->usyscall->pid = p->pid;
+
     // An empty user page table.
     p->pagetable = proc_pagetable(p);
     if (p->pagetable == 0)
@@ -154,6 +463,9 @@ found:
         return 0;
     }
 
+    // its own kernel page table, to map its user memory too,
+    // waits for the first copy that can use it (see ukmapped()).
+
     // Set up new context to start executing at forkret,
     // which returns to user space.
 
@@ -173,16 +485,40 @@ static void freeproc(struct proc* p)
     if (p->trapframe)
         kfree((void*)p->trapframe);
     p->trapframe = 0;
-    if (p->pagetable)
+    if (p->usyscall)
+        kfree((void*)p->usyscall);
+    p->usyscall = 0;
+    if (p->pagetable && p->thread)
+    {
+        // the page table belongs to the thread's parent.
+        acquire(&vmlock);
+        uvmunmap(p->pagetable, TFRAME(p->thread), 1, 0);
+        release(&vmlock);
+    }
+    else if (p->pagetable)
         proc_freepagetable(p->pagetable, p->sz);
+    if (p->kpagetable)
+        kvmfree(p->kpagetable);
+    p->kpagetable = 0;
+    if (p->pid)
+        freepid(p);
     p->pagetable = 0;
     p->sz        = 0;
     p->pid       = 0;
     p->parent    = 0;
+    p->sibling   = 0;
     p->name[0]   = 0;
     p->chan      = 0;
     p->killed    = 0;
     p->xstate    = 0;
+    p->kfn       = 0;
+    if (p->execargv)
+        spawnfree(p->execpath, p->execargv);
+    p->execpath = 0;
+    p->execargv = 0;
+    p->tracemask = 0;
+    p->thread    = 0;
+    p->shared    = 0;
     p->state     = UNUSED;
 }
 
@@ -192,6 +528,7 @@ static void freeproc(struct proc* p)
 pagetable_t proc_pagetable(struct proc* p)
 {
     pagetable_t pagetable;
+    char*       ring;
 
     // An empty page table.
     // 获取一个空的进程页表（第一页）
@@ -216,6 +553,40 @@ pagetable_t proc_pagetable(struct proc* p)
         return 0;
     }
 
+    // map the pages that user code reads instead of making
+    // some system calls, read-only.
+    if (mappages(pagetable, USYSCALL, PGSIZE, (uint64)(p->usyscall), PTE_R | PTE_U) < 0)
+    {
+        uvmunmap(pagetable, TRAPFRAME, 1, 0);
+        uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+        uvmfree(pagetable, 0);
+        return 0;
+    }
+    if (mappages(pagetable, USHARED, PGSIZE, (uint64)ushared, PTE_R | PTE_U) < 0)
+    {
+        uvmunmap(pagetable, USYSCALL, 1, 0);
+        uvmunmap(pagetable, TRAPFRAME, 1, 0);
+        uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+        uvmfree(pagetable, 0);
+        return 0;
+    }
+
+    // the system call ring, which belongs to the page table and
+    // so is shared by its threads and new after exec().
+    if ((ring = kalloc()) == 0 ||
+        mappages(pagetable, USYSRING, PGSIZE, (uint64)ring, PTE_R | PTE_W | PTE_U) < 0)
+    {
+        if (ring)
+            kfree(ring);
+        uvmunmap(pagetable, USHARED, 1, 0);
+        uvmunmap(pagetable, USYSCALL, 1, 0);
+        uvmunmap(pagetable, TRAPFRAME, 1, 0);
+        uvmunmap(pagetable, TRAMPOLINE, 1, 0);
+        uvmfree(pagetable, 0);
+        return 0;
+    }
+    memset(ring, 0, PGSIZE);
+
     return pagetable;
 }
 
@@ -228,6 +599,9 @@ void proc_freepagetable(pagetable_t pagetable, uint64 sz)
     uvmunmap(pagetable, TRAMPOLINE, 1, 0);
     // 解除虚拟地址TRAPFRAME的物理映射
     uvmunmap(pagetable, TRAPFRAME, 1, 0);
+    uvmunmap(pagetable, USYSCALL, 1, 0);
+    uvmunmap(pagetable, USHARED, 1, 0);
+    uvmunmap(pagetable, USYSRING, 1, 1);
     // 解除最后一级页表的映射并释放对应的物理内存
     // 递归释放页表及其子页表
     uvmfree(pagetable, sz);
@@ -260,36 +634,110 @@ void userinit(void)
     p->trapframe->epc = 0;        // user program counter，用户程序入口地址（0x0）
     p->trapframe->sp  = PGSIZE;   // user stack pointer，用户栈指针（地址0x1000）
     safestrcpy(p->name, "initcode", sizeof(p->name));   // 标记为可运行状态
-    p->cwd   = namei("/");                              // 当前工作目录设为根目录
-    p->state = RUNNABLE;                                // 标记为可运行状态
+    p->cwd = namei("/");                                // 当前工作目录设为根目录
+    setrunnable(p);                                     // 标记为可运行状态
+
+    release(&p->lock);
+}
+
+// Start a kernel thread that runs fn() until the machine
+// stops. It occupies a process slot so that it can sleep,
+// but it never returns to user space and never exits.
+// Returns the new thread's pid, or -1 on failure.
+// 创建内核线程，在内核中一直运行 fn()
+int kthread(void (*fn)(void), char* name)
+{
+    struct proc* p;
+    int          pid;
 
+    if ((p = allocproc()) == 0)
+        return -1;
+    p->kfn        = fn;
+    p->context.ra = (uint64)kthreadret;
+    safestrcpy(p->name, name, sizeof(p->name));
+    setrunnable(p);
+    pid = p->pid;
     release(&p->lock);
+    return pid;
 }
 
 // Grow or shrink user memory by n bytes.
+// Growing only moves p->sz; the pages themselves are
+// allocated on first touch. The threads sharing p's page
+// table all get the new size.
 // Return 0 on success, -1 on failure.
 // 增加或减少进程的用户内存大小。
 int growproc(int n)
 {
     uint64       sz;
+    struct proc* pp;
     struct proc* p = myproc();
 
+    acquire(&vmlock);
     sz = p->sz;
     if (n > 0)
     {
-        if ((sz = uvmalloc(p->pagetable, sz, sz + n, PTE_W)) == 0)
+        // pages are allocated on first touch; see vmfault().
+        if (sz + n > vmafloor(p))
         {
+            release(&vmlock);
             return -1;
         }
+        sz += n;
     }
     else if (n < 0)
     {
         sz = uvmdealloc(p->pagetable, sz, sz + n);
     }
-    p->sz = sz;
+    for (pp = proc; pp < &proc[NPROC]; pp++)
+        if (pp->pagetable == p->pagetable)
+            pp->sz = sz;
+    release(&vmlock);
     return 0;
 }
 
+// Make c a child of parent.
+// 将 c 链入 parent 的子进程链表
+static void linkchild(struct proc* parent, struct proc* c)
+{
+    acquire(&parent->wlock);
+    c->parent        = parent;
+    c->sibling       = parent->children;
+    parent->children = c;
+    release(&parent->wlock);
+}
+
+// Take c off its parent's list of children.
+// Caller must hold the parent's wlock.
+// 将 c 从其父进程的子进程链表中移除
+static void unlinkchild(struct proc* c)
+{
+    struct proc** pp;
+
+    for (pp = &c->parent->children; *pp != c; pp = &(*pp)->sibling)
+        ;
+    *pp        = c->sibling;
+    c->sibling = 0;
+}
+
+// Acquire the wlock of p's parent and return the parent, which
+// cannot change while it is held: reparent() changes p->parent
+// only under the old parent's wlock.
+// 获取 p 的父进程的 wlock，并返回父进程
+static struct proc* lockparent(struct proc* p)
+{
+    struct proc* pp;
+
+    for (;;)
+    {
+        pp = __atomic_load_n(&p->parent, __ATOMIC_ACQUIRE);
+        acquire(&pp->wlock);
+        if (p->parent == pp)
+            return pp;
+        release(&pp->wlock);
+    }
+}
+
 // Create a new process, copying the parent.
 // Sets up child kernel stack to return as if from fork() system call.
 // 创建子进程，复制父进程的内存和状态。
@@ -305,15 +753,31 @@ int fork(void)
         return -1;
     }
 
-    // Copy user memory from parent to child.
+    // Copy user memory from parent to child, and inherit the
+    // memory-mapped files. Other threads of the parent may be
+    // faulting on the page table meanwhile.
     // uvmcopy：复制父进程的页表和物理内存到子进程（用于 fork）。
+    acquire(&vmlock);
     if (uvmcopy(p->pagetable, np->pagetable, p->sz) < 0)
     {
+        release(&vmlock);
+        freeproc(np);
+        release(&np->lock);
+        return -1;
+    }
+    np->sz        = p->sz;
+    np->tracemask = p->tracemask;
+    np->sclass    = p->sclass;
+    np->nice      = p->nice;
+
+    if (vmacopy(p, np) < 0)
+    {
+        release(&vmlock);
         freeproc(np);
         release(&np->lock);
         return -1;
     }
-    np->sz = p->sz;
+    release(&vmlock);
 
     // copy saved user registers.
     *(np->trapframe) = *(p->trapframe);
@@ -332,48 +796,294 @@ int fork(void)
     safestrcpy(np->name, p->name, sizeof(p->name));
 
     pid = np->pid;
-    // 先释放进程私有锁，因为设置parent需要wait_lock,防止构成死锁
+    // 先释放进程私有锁，因为加入子进程链表需要 p->wlock，防止构成死锁
     release(&np->lock);
 
-    // 将新创建的子进程（np）的 parent 字段设置为当前进程
+    // 将新创建的子进程（np）加入当前进程的子进程链表
     /*
     ****************************************************************
-    ** wait_lock 保护所有涉及父子关系的关键代码，包括：
-    **      fork 中的 np->parent 设置。
+    ** 每个进程的 wlock 保护其子进程链表以及各子进程的 parent 字段：
+    **      fork 中的 np->parent 设置与链入。
     **      wait 中的子进程遍历和状态检查。
     **      exit 中的父进程通知和 reparent 操作。
-    ** 通过全局锁，确保这些操作序列化，避免竞争。
+    ** 不同父进程的回收互不干扰，不再经过一把全局锁。
     ****************************************************************
     */
-    acquire(&wait_lock);
-    np->parent = p;
-    release(&wait_lock);
+    linkchild(p, np);
+
+
+    acquire(&np->lock);
+    setrunnable(np);
+    release(&np->lock);
+
+    return pid;
+}
+
+// Create a child that runs the program path with arguments
+// argv, as fork() followed by exec() in the child would, but
+// without copying the parent's memory only to throw it away:
+// the child starts with an empty address space, and its first
+// act, in spawnret(), is the exec(). path and argv are kernel
+// copies, from kmalloc() and kalloc() as spawnfree() expects,
+// which the child owns once spawn() succeeds. If fds is not 0,
+// the child's file descriptors 0, 1 and 2 are the parent's
+// fds[0], fds[1] and fds[2], or closed where those are
+// negative, and it gets no others; otherwise it gets all of
+// the parent's, as from fork().
+// Returns the child's pid, or -1.
+// 创建直接运行 path 程序的子进程，不复制父进程的内存
+int spawn(char* path, char** argv, int* fds)
+{
+    int          i, pid;
+    struct proc* np;
+    struct proc* p = myproc();
+
+    if ((np = allocproc()) == 0)
+        return -1;
+
+    np->execpath  = path;
+    np->execargv  = argv;
+    np->tracemask = p->tracemask;
+    np->sclass    = p->sclass;
+    np->nice      = p->nice;
+    if (fds)
+    {
+        for (i = 0; i < 3; i++)
+            if (fds[i] >= 0)
+                np->ofile[i] = filedup(p->ofile[fds[i]]);
+    }
+    else
+    {
+        for (i = 0; i < NOFILE; i++)
+            if (p->ofile[i])
+                np->ofile[i] = filedup(p->ofile[i]);
+    }
+    np->cwd = idup(p->cwd);
+    safestrcpy(np->name, p->name, sizeof(p->name));
+    np->context.ra = (uint64)spawnret;
+
+    pid = np->pid;
+    release(&np->lock);
+
+    linkchild(p, np);
+
+    acquire(&np->lock);
+    setrunnable(np);
+    release(&np->lock);
+
+    return pid;
+}
+
+// Create a thread of the current process that starts running
+// fn(arg) on the user stack whose top is stack. It shares the
+// page table, and so the memory, of the process, and gets its
+// own trapframe, mapped in that page table at TFRAME(t) for a
+// free slot t; the memory-mapped regions, open files and
+// current directory it starts with are those of its creator.
+// Every thread is a child of the process that owns the page
+// table, whichever thread made it, and is reaped by join();
+// fn must end with exit(), since there is nothing to return to.
+// Returns the new thread's pid, or -1.
+// 创建与当前进程共享页表的线程，从 fn(arg) 开始在用户栈 stack 上运行
+int clone(uint64 fn, uint64 arg, uint64 stack)
+{
+    int          i, t, used, pid;
+    struct proc *np, *pp, *owner;
+    struct proc* p = myproc();
+
+    if (stack % 16 != 0)
+        return -1;
+    if ((np = allocproc()) == 0)
+        return -1;
+
+    // Trade the page table allocproc() made for p's, mapping
+    // np's trapframe at the lowest free slot.
+    proc_freepagetable(np->pagetable, 0);
+    np->pagetable = 0;
+    acquire(&vmlock);
+    used = 0;
+    for (pp = proc; pp < &proc[NPROC]; pp++)
+        if (pp->pagetable == p->pagetable)
+            used |= 1 << pp->thread;
+    for (t = 1; t < NTHREAD && (used & (1 << t)); t++)
+        ;
+    if (t == NTHREAD ||
+        mappages(p->pagetable, TFRAME(t), PGSIZE, (uint64)np->trapframe, PTE_R | PTE_W) != 0)
+    {
+        release(&vmlock);
+        freeproc(np);
+        release(&np->lock);
+        return -1;
+    }
+    np->pagetable = p->pagetable;
+    np->thread    = t;
+    np->sz        = p->sz;
+    release(&vmlock);
+    np->tracemask = p->tracemask;
+    np->sclass    = p->sclass;
+    np->nice      = p->nice;
+    vmashare(p, np);
+
+    // Start at fn(arg); a return from fn jumps to the
+    // trampoline, which user code cannot execute, and faults.
+    *(np->trapframe)   = *(p->trapframe);
+    np->trapframe->epc = fn;
+    np->trapframe->a0  = arg;
+    np->trapframe->sp  = stack;
+    np->trapframe->ra  = TRAMPOLINE;
+
+    for (i = 0; i < NOFILE; i++)
+        if (p->ofile[i])
+            np->ofile[i] = filedup(p->ofile[i]);
+    np->cwd = idup(p->cwd);
+
+    safestrcpy(np->name, p->name, sizeof(p->name));
+
+    pid = np->pid;
+    release(&np->lock);
 
+    // the owner's USYSCALL page holds its pid, which is not
+    // that of every thread: getpid() has to ask from now on.
+    owner = p->thread ? p->parent : p;
+    linkchild(owner, np);
+    owner->usyscall->pid = 0;
 
     acquire(&np->lock);
-    np->state = RUNNABLE;
+    setrunnable(np);
     release(&np->lock);
 
     return pid;
 }
 
+// Wait for the thread tid, or any thread if tid is 0, of the
+// current process to exit, and return its pid, copying its
+// exit status to addr if that is not 0. Any thread of the
+// process may join any other.
+// Return -1 if there is no such thread.
+// 等待当前进程的线程 tid（0 表示任意线程）退出并回收它
+int join(int tid, uint64 addr)
+{
+    struct proc *pp, *owner;
+    int          havethreads, pid;
+    struct proc* p = myproc();
+
+    owner = p->thread ? p->parent : p;
+    acquire(&owner->wlock);
+
+    for (;;)
+    {
+        havethreads = 0;
+        for (pp = owner->children; pp; pp = pp->sibling)
+        {
+            if (!pp->thread || pp == p || (tid && pp->pid != tid))
+                continue;
+            acquire(&pp->lock);
+            havethreads = 1;
+            if (pp->state == ZOMBIE)
+            {
+                pid = pp->pid;
+                if (addr != 0 &&
+                    copyout(p->pagetable, addr, (char*)&pp->xstate, sizeof(pp->xstate)) < 0)
+                {
+                    release(&pp->lock);
+                    release(&owner->wlock);
+                    return -1;
+                }
+                unlinkchild(pp);
+                freeproc(pp);
+                release(&pp->lock);
+                release(&owner->wlock);
+                return pid;
+            }
+            release(&pp->lock);
+        }
+
+        if (!havethreads || killed(p))
+        {
+            release(&owner->wlock);
+            return -1;
+        }
+
+        // exit() wakes up the parent, for its wait() and for
+        // joining threads alike.
+        sleep(owner, &owner->wlock);
+    }
+}
+
+// Kill the threads of p, which is exiting, and reap them once
+// they have exited, so that none is left running on the page
+// table p is about to give up.
+// 杀死正在退出的进程 p 的全部线程，并等待回收它们
+static void reapthreads(struct proc* p)
+{
+    struct proc *pp, *next;
+    int          n;
+
+    acquire(&p->wlock);
+    for (;;)
+    {
+        n = 0;
+        for (pp = p->children; pp; pp = next)
+        {
+            next = pp->sibling;
+            if (!pp->thread)
+                continue;
+            acquire(&pp->lock);
+            if (pp->state == ZOMBIE)
+            {
+                unlinkchild(pp);
+                freeproc(pp);
+                release(&pp->lock);
+                continue;
+            }
+            pp->killed = 1;
+            release(&pp->lock);
+            unsleep(pp);
+            n++;
+        }
+        if (n == 0)
+            break;
+        sleep(p, &p->wlock);
+    }
+    release(&p->wlock);
+}
+
+// Return whether p shares its page table with other threads
+// that have not exited.
+// 判断进程 p 是否与其他未退出的线程共享页表
+int threaded(struct proc* p)
+{
+    struct proc* pp;
+
+    for (pp = proc; pp < &proc[NPROC]; pp++)
+        if (pp != p && pp->pagetable == p->pagetable && pp->state != UNUSED && pp->state != ZOMBIE)
+            return 1;
+    return 0;
+}
+
 // Pass p's abandoned children to init.
-// Caller must hold wait_lock.
 // 在进程 p 退出时，确保其所有子进程不会成为无人管理的孤儿进程。
 // 通过将子进程的父进程重新设置为 initproc，并唤醒 initproc 来处理这些子进程。
 void reparent(struct proc* p)
 {
     struct proc* pp;
 
-    for (pp = proc; pp < &proc[NPROC]; pp++)
+    acquire(&p->wlock);
+    if (p->children)
     {
-        if (pp->parent == p)
+        acquire(&initproc->wlock);
+        while ((pp = p->children) != 0)
         {
-            pp->parent = initproc;
-            // 为了通知 initproc 检查并回收可能的 ZOMBIE 状态子进程？
-            wakeup(initproc);
+            p->children        = pp->sibling;
+            pp->parent         = initproc;
+            pp->sibling        = initproc->children;
+            initproc->children = pp;
         }
+        // 通知 initproc 检查并回收可能的 ZOMBIE 状态子进程
+        wakeup(initproc);
+        release(&initproc->wlock);
     }
+    release(&p->wlock);
 }
 
 // Exit the current process.  Does not return.
@@ -383,10 +1093,25 @@ void reparent(struct proc* p)
 void exit(int status)
 {
     struct proc* p = myproc();
+    struct proc* parent;
 
     if (p == initproc)
         panic("init exiting");
 
+    // Write back and unmap the memory-mapped files, which hold
+    // references of their own to them. A thread leaves the
+    // pages to the others sharing its page table; the owner
+    // takes its threads down first.
+    if (p->thread)
+    {
+        vmadrop(p);
+    }
+    else
+    {
+        reapthreads(p);
+        vmaunmapall(p);
+    }
+
     // Close all open files.
     for (int fd = 0; fd < NOFILE; fd++)
     {
@@ -403,20 +1128,20 @@ void exit(int status)
     end_op();
     p->cwd = 0;
 
-    acquire(&wait_lock);
-
     // Give any children to init.
     reparent(p);
 
-    // Parent might be sleeping in wait().
-    wakeup(p->parent);
+    // Parent might be sleeping in wait(). Holding its wlock
+    // until p is a ZOMBIE keeps it from looking in between.
+    parent = lockparent(p);
+    wakeup(parent);
 
     acquire(&p->lock);
 
     p->xstate = status;
     p->state  = ZOMBIE;
 
-    release(&wait_lock);
+    release(&parent->wlock);
 
     // Jump into the scheduler, never to return.
     sched();
@@ -433,93 +1158,130 @@ int wait(uint64 addr)
     int          havekids, pid;
     struct proc* p = myproc();
 
-    acquire(&wait_lock);
+    acquire(&p->wlock);
 
     for (;;)
     {
-        // 遍历所有进程
+        // 遍历子进程链表
         havekids = 0;
-        for (pp = proc; pp < &proc[NPROC]; pp++)
+        for (pp = p->children; pp; pp = pp->sibling)
         {
-            if (pp->parent == p)
-            {
-                // make sure the child isn't still in exit() or swtch().
-                acquire(&pp->lock);
+            // threads are reaped by join() instead.
+            if (pp->thread)
+                continue;
 
-                havekids = 1;
-                if (pp->state == ZOMBIE)
+            // make sure the child isn't still in exit() or swtch().
+            acquire(&pp->lock);
+
+            havekids = 1;
+            if (pp->state == ZOMBIE)
+            {
+                // 记录子进程PID
+                pid = pp->pid;
+                // 将子进程退出信息（pp->xstate,在内核中）复制到addr对应的父进程用户空间中（由用户态参数传递）
+                if (addr != 0 &&
+                    copyout(p->pagetable, addr, (char*)&pp->xstate, sizeof(pp->xstate)) < 0)
                 {
-                    // 记录子进程PID
-                    pid = pp->pid;
-                    // 将子进程退出信息（pp->xstate,在内核中）复制到addr对应的父进程用户空间中（由用户态参数传递）
-                    if (addr != 0 &&
-                        copyout(p->pagetable, addr, (char*)&pp->xstate, sizeof(pp->xstate)) < 0)
-                    {
-                        release(&pp->lock);
-                        release(&wait_lock);
-                        return -1;
-                    }
-                    // 1.释放trampframe物理页表
-                    // 2.调用proc_freepagetable释放虚拟地址对应的物理内存一以及物理页表
-                    freeproc(pp);
                     release(&pp->lock);
-                    release(&wait_lock);
-                    return pid;
+                    release(&p->wlock);
+                    return -1;
                 }
+                // 1.释放trampframe物理页表
+                // 2.调用proc_freepagetable释放虚拟地址对应的物理内存一以及物理页表
+                unlinkchild(pp);
+                freeproc(pp);
                 release(&pp->lock);
+                release(&p->wlock);
+                return pid;
             }
+            release(&pp->lock);
         }
 
         // No point waiting if we don't have any children.
         if (!havekids || killed(p))
         {
-            release(&wait_lock);
+            release(&p->wlock);
             return -1;
         }
 
         // channel：p，在进程p上睡眠
-        // 传入wait_lock:进入睡眠后释放全局锁wait_lock
-        sleep(p, &wait_lock);   // DOC: wait-sleep
+        // 传入p->wlock:进入睡眠后释放子进程链表锁
+        sleep(p, &p->wlock);   // DOC: wait-sleep
     }
 }
 
 // Per-CPU process scheduler.
 // Each CPU calls scheduler() after setting itself up.
 // Scheduler never returns.  It loops, doing:
-//  - choose a process to run.
-//  - swtch to start running that process.
+//  - take a process from this CPU's run queue, or steal
+//    one from another CPU's if this one is empty, or
+//    wait in idle() if there is none.
+//  - arm the timer for the end of its time slice, which
+//    is longer or shorter with its nice value, and
+//    swtch to start running that process.
 //  - eventually that process transfers control
 //    via swtch back to the scheduler.
-// 每个 CPU 运行的调度器，循环选择可运行进程并切换到它。
+// 每个 CPU 运行的调度器，从运行队列取出可运行进程并切换到它。
 void scheduler(void)
 {
     struct proc* p;
-    struct cpu*  c = mycpu();
+    struct cpu*  c         = mycpu();
+    int          id        = cpuid();
+    uint64       idlestart = 0;   // 开始空闲的时刻，0 表示不空闲
+    uint64       start;
 
     c->proc = 0;
+    __atomic_fetch_add(&ncpus, 1, __ATOMIC_SEQ_CST);
     for (;;)
     {
         // Avoid deadlock by ensuring that devices can interrupt.
         intr_on();
 
-        for (p = proc; p < &proc[NPROC]; p++)
+        if ((p = runq_pop(&runq[id])) == 0 && (p = runq_steal(id)) != 0)
+            c->nsteal++;
+        if (p == 0)
         {
-            acquire(&p->lock);
-            if (p->state == RUNNABLE)
-            {
-                // Switch to chosen process.  It is the process's job
-                // to release its lock and then reacquire it
-                // before jumping back to us.
-                p->state = RUNNING;
-                c->proc  = p;
-                swtch(&c->context, &p->context);
-
-                // Process is done running for now.
-                // It should have changed its p->state before coming back.
-                c->proc = 0;
-            }
-            release(&p->lock);
+            if (idlestart == 0)
+                idlestart = r_time();
+            idle(c);
+            continue;
+        }
+        if (idlestart)
+        {
+            c->idle += r_time() - idlestart;
+            idlestart = 0;
         }
+
+        // The process may still be switching away on the CPU
+        // that queued it; its p->lock is held until that is done.
+        acquire(&p->lock);
+        if (p->state != RUNNABLE)
+            panic("scheduler: not runnable");
+
+        // Switch to chosen process.  It is the process's job
+        // to release its lock and then reacquire it
+        // before jumping back to us.
+        start       = r_time();
+        p->state    = RUNNING;
+        p->cpu      = id;
+        c->proc     = p;
+        c->sliceend = start + timeslice(p);
+        c->nswtch++;
+        timerarm();
+        if (p->kpagetable)
+            kvmuse(p->kpagetable);
+        swtch(&c->context, &p->context);
+        // off p's kernel page table, which wait() may free once
+        // p->lock is released.
+        if (p->kpagetable)
+            kvmuse(0);
+
+        // Process is done running for now.
+        // It should have changed its p->state before coming back.
+        p->cputime += r_time() - start;
+        c->proc     = 0;
+        c->sliceend = 0;
+        release(&p->lock);
     }
 }
 
@@ -557,11 +1319,123 @@ void yield(void)
 {
     struct proc* p = myproc();
     acquire(&p->lock);
-    p->state = RUNNABLE;
+    p->nivcsw++;
+    setrunnable(p);
     sched();
     release(&p->lock);
 }
 
+// The current process's time slice is over: yield if
+// runq_preempts() says a process waiting on this CPU should
+// have its turn, otherwise carry on with a new slice.
+// 时间片用完：有同级或更高优先级进程等待时让出 CPU，否则开始新的时间片
+void preempt(void)
+{
+    struct proc* p = myproc();
+    struct cpu*  c;
+    int          yes;
+
+    push_off();
+    c = mycpu();
+    if ((yes = runq_preempts(&runq[cpuid()], p->sclass)) == 0)
+    {
+        c->sliceend = r_time() + timeslice(p);
+        timerarm();
+    }
+    pop_off();
+    if (yes)
+        yield();
+}
+
+// Set the scheduling class and nice value of process pid, or
+// of the caller if pid is 0. A process already on a run
+// queue moves to its new class's queue when next queued.
+// Returns 0, or -1 if there is no such process or the
+// values are out of range.
+// 设置进程的调度类和 nice 值
+int setsched(int pid, int sclass, int nice)
+{
+    struct proc* p;
+
+    if (sclass < 0 || sclass >= NSCHED || nice < -20 || nice > 19)
+        return -1;
+    if (pid == 0)
+        pid = myproc()->pid;
+    if ((p = pidfind(pid)) == 0)
+        return -1;
+    acquire(&p->lock);
+    if (p->pid != pid || p->state == ZOMBIE)
+    {
+        release(&p->lock);
+        return -1;
+    }
+    p->sclass = sclass;
+    p->nice   = nice;
+    release(&p->lock);
+    return 0;
+}
+
+// Copy a struct procinfo for each of up to n processes in use
+// to user address addr. Each is read under its p->lock, but the
+// parent's pid without its parent's wlock, so it may be out of
+// date by the time it is read.
+// Returns the number copied, or -1.
+// 将各进程的信息复制到用户空间，返回复制的个数
+int procinfo(uint64 addr, int n)
+{
+    struct proc*    p;
+    struct proc*    pp;
+    struct procinfo pi;
+    int             i = 0;
+
+    for (p = proc; p < &proc[NPROC] && i < n; p++)
+    {
+        acquire(&p->lock);
+        if (p->state == UNUSED)
+        {
+            release(&p->lock);
+            continue;
+        }
+        memset(&pi, 0, sizeof(pi));
+        pp         = __atomic_load_n(&p->parent, __ATOMIC_ACQUIRE);
+        pi.pid     = p->pid;
+        pi.ppid    = pp ? pp->pid : 0;
+        pi.state   = p->state;
+        pi.sclass  = p->sclass;
+        pi.nice    = p->nice;
+        pi.thread  = p->thread;
+        pi.sz      = p->sz;
+        pi.rss     = p->pagetable ? uvmrss(p->pagetable) : 0;
+        pi.cputime = p->cputime;
+        safestrcpy(pi.name, p->name, sizeof(pi.name));
+        release(&p->lock);
+        if (copyout(myproc()->pagetable, addr + i * sizeof(pi), (char*)&pi, sizeof(pi)) < 0)
+            return -1;
+        i++;
+    }
+    return i;
+}
+
+// Return the number of processes in use.
+// 返回使用中的进程数
+int nproc(void)
+{
+    struct proc* p;
+    int          n = 0;
+
+    for (p = proc; p < &proc[NPROC]; p++)
+        if (__atomic_load_n(&p->state, __ATOMIC_RELAXED) != UNUSED)
+            n++;
+    return n;
+}
+
+// Return the number of CPUs running processes.
+// 返回运行调度器的 CPU 数
+int ncpu(void)
+{
+    return __atomic_load_n(&ncpus, __ATOMIC_SEQ_CST);
+}
+
 // A fork child's very first scheduling by scheduler()
 // will swtch to forkret.
 // 在进程从内核态首次返回用户态时执行，确保正确初始化并切换到用户态
@@ -578,36 +1452,85 @@ void forkret(void)
         // regular process (e.g., because it calls sleep), and thus cannot
         // be run from main().
         first = 0;
+#ifdef RAMROOT
+        ramdiskload(DISKDEV);
+#endif
         fsinit(ROOTDEV);
     }
 
     usertrapret();
 }
 
+// A kernel thread's very first scheduling by scheduler()
+// will swtch to kthreadret.
+// 内核线程首次被调度时从这里开始运行
+static void kthreadret(void)
+{
+    struct proc* p = myproc();
+
+    // Still holding p->lock from scheduler.
+    release(&p->lock);
+    p->kfn();
+    panic("kthread returned");
+}
+
+// A spawn() child's very first scheduling by scheduler()
+// will swtch to spawnret, to load its program.
+// spawn() 创建的子进程首次被调度时从这里开始，加载并运行程序
+static void spawnret(void)
+{
+    struct proc* p = myproc();
+    int          argc;
+
+    // Still holding p->lock from scheduler.
+    release(&p->lock);
+
+    argc = exec(p->execpath, p->execargv);
+    spawnfree(p->execpath, p->execargv);
+    p->execpath = 0;
+    p->execargv = 0;
+    if (argc < 0)
+        exit(-1);
+
+    // what syscall() would have done with exec()'s return.
+    p->trapframe->a0 = argc;
+    usertrapret();
+}
+
 // Atomically release lock and sleep on chan.
 // Reacquires lock when awakened.
 // 使当前进程在指定通道（chan）上休眠，等待被唤醒
 void sleep(void* chan, struct spinlock* lk)
 {
-    struct proc* p = myproc();
+    struct proc*  p  = myproc();
+    struct waitq* wq = wqhash(chan);
+    struct proc** pp;
 
     // Must acquire p->lock in order to
     // change p->state and then call sched.
-    // Once we hold p->lock, we can be
+    // Once we are on chan's wait queue, we can be
     // guaranteed that we won't miss any wakeup
-    // (wakeup locks p->lock),
+    // (wakeup looks at the wait queue),
     // so it's okay to release lk.
 
-    acquire(&p->lock);   // DOC: sleeplock1
-    release(lk);
+    acquire(&wq->lock);   // DOC: sleeplock1
+    acquire(&p->lock);
+    p->nvcsw++;
+
+    // Go to sleep, at the tail so that wakeupone() is FIFO.
+    p->chan   = chan;
+    p->state  = SLEEPING;
+    p->wqnext = 0;
+    for (pp = &wq->head; *pp; pp = &(*pp)->wqnext)
+        ;
+    *pp = p;
 
-    // Go to sleep.
-    p->chan  = chan;
-    p->state = SLEEPING;
+    release(lk);
+    release(&wq->lock);
 
     sched();
 
-    // Tidy up.
+    // Tidy up. Whoever woke us took us off the queue.
     p->chan = 0;
 
     // Reacquire original lock.
@@ -615,27 +1538,151 @@ void sleep(void* chan, struct spinlock* lk)
     acquire(lk);
 }
 
+// Wake up processes sleeping on chan, all of them or just the
+// first. The caller holds wq->lock; takes each p->lock.
+// Returns the number woken.
+static int wakeup1(struct waitq* wq, void* chan, int all)
+{
+    struct proc **pp, *p;
+    int           n = 0;
+
+    for (pp = &wq->head; (p = *pp) != 0;)
+    {
+        if (p->chan != chan)
+        {
+            pp = &p->wqnext;
+            continue;
+        }
+        acquire(&p->lock);
+        *pp       = p->wqnext;
+        p->wqnext = 0;
+        setrunnable(p);
+        release(&p->lock);
+        n++;
+        if (!all)
+            break;
+    }
+    return n;
+}
+
 // Wake up all processes sleeping on chan.
-// Must be called without any p->lock.
+// Must be called without any p->lock, and with the lock the
+// sleepers passed to sleep(), so that an empty queue can be
+// seen without locking it.
 // 唤醒在指定通道（chan）上休眠的所有进程
 void wakeup(void* chan)
 {
-    struct proc* p;
+    struct waitq* wq = wqhash(chan);
 
-    for (p = proc; p < &proc[NPROC]; p++)
+    if (wq->head == 0)
+        return;
+    acquire(&wq->lock);
+    wakeup1(wq, chan, 1);
+    release(&wq->lock);
+}
+
+// Wake up the process that has slept longest on chan, for
+// resources that only one waiter can take.
+// Same locking rules as wakeup().
+// 只唤醒在 chan 上休眠最久的一个进程
+void wakeupone(void* chan)
+{
+    struct waitq* wq = wqhash(chan);
+
+    if (wq->head == 0)
+        return;
+    acquire(&wq->lock);
+    wakeup1(wq, chan, 0);
+    release(&wq->lock);
+}
+
+// If p is asleep, take it off its wait queue and make it
+// runnable. The wait queue lock comes before p->lock, so look
+// up the channel first and check that p is still there.
+// 若进程 p 正在休眠，将其移出等待队列并唤醒
+static void unsleep(struct proc* p)
+{
+    struct waitq* wq;
+    struct proc** pp;
+    void*         chan;
+
+    for (;;)
     {
-        if (p != myproc())
+        acquire(&p->lock);
+        chan = p->state == SLEEPING ? p->chan : 0;
+        release(&p->lock);
+        if (chan == 0)
+            return;
+
+        wq = wqhash(chan);
+        acquire(&wq->lock);
+        acquire(&p->lock);
+        if (p->state == SLEEPING && p->chan == chan)
         {
-            acquire(&p->lock);
-            if (p->state == SLEEPING && p->chan == chan)
-            {
-                p->state = RUNNABLE;
-            }
-            release(&p->lock);
+            for (pp = &wq->head; *pp != p; pp = &(*pp)->wqnext)
+                ;
+            *pp       = p->wqnext;
+            p->wqnext = 0;
+            setrunnable(p);
+            chan = 0;
         }
+        release(&p->lock);
+        release(&wq->lock);
+        if (chan == 0)
+            return;
     }
 }
 
+// Wait on the int at user address addr while it holds val
+// (FUTEX_WAIT), or wake up to val of the threads waiting on it
+// (FUTEX_WAKE). The wait channel stands for the page table and
+// addr, which every thread sharing the page table sees, rather
+// than for the int's physical page, which a copy-on-write fault
+// after a fork() moves. It lies above every kernel address, so
+// no kernel sleeper can share it. Wakeups may be spurious, so
+// waiters check the int again.
+// Returns 0 after a wait, the number of threads woken after a
+// wake, or -1 if the int did not hold val or addr is bad.
+// 在用户地址 addr 处的整数上等待或唤醒，实现用户态的睡眠锁
+int futex(uint64 addr, int op, int val)
+{
+    struct proc*  p = myproc();
+    struct waitq* wq;
+    uint64        pa;
+    void*         chan;
+    int           n;
+
+    if (addr % sizeof(int) != 0 || addr >= MAXVA || uvmtouch(p->pagetable, addr, sizeof(int), 0) < 0)
+        return -1;
+
+    acquire(&futex_lock);
+    acquire(&vmlock);
+    pa = walkaddr(p->pagetable, addr);
+    n  = pa && (op != FUTEX_WAIT || *(int*)(pa + addr % PGSIZE) == val) ? 0 : -1;
+    release(&vmlock);
+    if (n < 0 || (op != FUTEX_WAIT && op != FUTEX_WAKE))
+    {
+        release(&futex_lock);
+        return -1;
+    }
+    chan = (void*)(1UL << 63 | ((uint64)p->pagetable - KERNBASE) / PGSIZE << 38 | addr);
+
+    if (op == FUTEX_WAIT)
+    {
+        sleep(chan, &futex_lock);
+    }
+    else
+    {
+        wq = wqhash(chan);
+        acquire(&wq->lock);
+        while (n < val && wakeup1(wq, chan, 0))
+            n++;
+        release(&wq->lock);
+    }
+    release(&futex_lock);
+    return n;
+}
+
 // Kill the process with the given pid.
 // The victim won't exit until it tries to return
 // to user space (see usertrap() in trap.c).
@@ -644,23 +1691,20 @@ int kill(int pid)
 {
     struct proc* p;
 
-    for (p = proc; p < &proc[NPROC]; p++)
+    if ((p = pidfind(pid)) == 0)
+        return -1;
+    acquire(&p->lock);
+    if (p->pid != pid)
     {
-        acquire(&p->lock);
-        if (p->pid == pid)
-        {
-            p->killed = 1;
-            if (p->state == SLEEPING)
-            {
-                // Wake process from sleep().
-                p->state = RUNNABLE;
-            }
-            release(&p->lock);
-            return 0;
-        }
+        // it exited and was reaped meanwhile.
         release(&p->lock);
+        return -1;
     }
-    return -1;
+    p->killed = 1;
+    release(&p->lock);
+    // Wake process from sleep().
+    unsleep(p);
+    return 0;
 }
 
 // 将指定进程的 killed 字段设为 1，标记其为“被杀死”状态。
@@ -718,7 +1762,9 @@ int either_copyin(void* dst, int user_src, uint64 src, uint64 len)
     }
 }
 
-// Print a process listing to console.  For debugging.
+// Print a process listing to console, followed by
+// scheduler, allocator, page fault and disk statistics.
+// For debugging.
 // Runs when user types ^P on console.
 // No lock to avoid wedging a stuck machine further.
 // 打印进程表中所有非 UNUSED 进程的信息，用于调试。
@@ -726,6 +1772,8 @@ void procdump(void)
 {
     static char* states[] = {[UNUSED] "unused",   [USED] "used",      [SLEEPING] "sleep ",
                              [RUNNABLE] "runble", [RUNNING] "run   ", [ZOMBIE] "zombie"};
+    static char* classes[] = {[SCHED_REALTIME] "rt", [SCHED_NORMAL] "normal",
+                              [SCHED_BATCH] "batch"};
     struct proc* p;
     char*        state;
 
@@ -739,6 +1787,23 @@ void procdump(void)
         else
             state = "???";
         printf("%d %s %s", p->pid, state, p->name);
+        printf(" [%s nice %d, %ld ticks, %ld voluntary, %ld involuntary switches, %ld pages]",
+               classes[p->sclass], p->nice, p->cputime / TICKCYCLES, p->nvcsw, p->nivcsw,
+               p->pagetable ? uvmrss(p->pagetable) : 0);
         printf("\n");
     }
+    for (int i = 0; i < NCPU; i++)
+        if (cpus[i].nswtch)
+            printf("cpu%d: %d runnable, %d switches, %d steals, %d ticks idle\n", i, runq[i].n,
+                   (int)cpus[i].nswtch, (int)cpus[i].nsteal, (int)(cpus[i].idle / TICKCYCLES));
+    kmemdump();
+    slabdump();
+    vmdump();
+    ksmdump();
+    pcachedump();
+    execcachedump();
+    dcachedump();
+    bcachedump();
+    logdump();
+    bdevdump();
 }
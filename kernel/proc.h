@@ -22,17 +22,26 @@ struct context
 // Per-CPU state.
 struct cpu
 {
-    struct proc*   proc;      // The process running on this cpu, or null.
-    struct context context;   // swtch() here to enter scheduler().
-    int            noff;      // Depth of push_off() nesting.
-    int            intena;    // Were interrupts enabled before push_off()?
-};
+    struct proc*   proc;       // The process running on this cpu, or null.
+    struct context context;    // swtch() here to enter scheduler().
+    int            noff;       // Depth of push_off() nesting.
+    int            intena;     // Were interrupts enabled before push_off()?
+    uint64         sliceend;   // When the running process's time slice ends, in r_time() units, or 0.
+    int            idling;     // Waiting in wfi for timerkick()?
+
+    // scheduling statistics, printed by procdump().
+    uint64 nswtch;   // Context switches into processes.
+    uint64 nsteal;   // Processes taken from other CPUs' run queues.
+    uint64 idle;     // Time spent with nothing to run, in r_time() units.
+} __attribute__((aligned(CACHELINE)));   // a cache line of its own, not shared with a neighbour
 
 extern struct cpu cpus[NCPU];
 
 // per-process data for the trap handling code in trampoline.S.
 // sits in a page by itself just under the trampoline page in the
-// user page table. not specially mapped in the kernel page table.
+// user page table, or for a thread made by clone() further down,
+// at TFRAME(p->thread). not specially mapped in the kernel page table.
+// userret leaves its user address in sscratch for uservec.
 // uservec in trampoline.S saves user registers in the trapframe,
 // then initializes registers from the trapframe's
 // kernel_sp, kernel_hartid, kernel_satp, and jumps to kernel_trap.
@@ -92,10 +101,53 @@ enum procstate
     ZOMBIE
 };
 
+// A region of a file mapped into user memory by mmap(), or a
+// program segment mapped by exec(). Pages are read in on first
+// touch (see vmafault()).
+struct vma
+{
+    uint64       addr;      // Page-aligned start
+    uint64       len;       // Length in bytes, a multiple of PGSIZE; 0 if the slot is free
+    int          prot;      // PROT_* from fcntl.h
+    int          flags;     // MAP_SHARED or MAP_PRIVATE
+    struct file* f;         // Mapped file, holding a reference
+    uint64       off;       // File offset of addr
+    uint64       fileend;   // File offset from which the region reads as zeros
+};
+
+// The last user page copyin() or copyout() translated for a
+// process (see uvmxlate()).
+struct xlate
+{
+    pagetable_t pagetable;   // page table it was found in, 0 if none
+    uint64      va;          // page-aligned user address
+    uint64      pa;          // physical page
+    uint        gen;         // the page table's generation then
+    int         write;       // writable, not copy-on-write
+};
+
 // Per-process state
+//
+// The fields are grouped by who touches them, each group
+// starting a cache line of its own, so that the owner's traps
+// and switches do not bounce lines with other CPUs taking
+// p->lock or walking the process lists: first those the process
+// itself uses on every trap and switch, then p->lock and what
+// it protects, then the links other CPUs follow, and last those
+// seldom used.
 struct proc
 {
-    struct spinlock lock;
+    // hot, and private to the process, so p->lock need not be held.
+    uint64            kstack;       // Virtual address of kernel stack
+    struct trapframe* trapframe;    // data page for trampoline.S
+    pagetable_t       pagetable;    // User page table
+    pagetable_t       kpagetable;   // Kernel page table, mapping user memory too; made on demand (see ukmapped())
+    uint64            sz;           // Size of process memory (bytes)
+    struct usyscall*  usyscall;     // page mapped read-only at USYSCALL
+    struct context    context;      // swtch() here to run process
+    struct xlate      xlate;        // Translation cache for copyin() and copyout()
+
+    struct spinlock lock __attribute__((aligned(CACHELINE)));
 
     // p->lock must be held when using these:
     enum procstate state;    // Process state
@@ -103,17 +155,39 @@ struct proc
     int            killed;   // If non-zero, have been killed
     int            xstate;   // Exit status to be returned to parent's wait
     int            pid;      // Process ID
+    int            cpu;      // CPU whose run queue p joins when runnable
+    int            sclass;   // Scheduling class, SCHED_* from fcntl.h
+    int            nice;     // -20..19, scales the time slice: lower is longer
+    uint64         cputime;  // Time spent running, in r_time() units
+    uint64         nvcsw;    // Switches away to sleep
+    uint64         nivcsw;   // Switches away at the end of a time slice
+
+    // the parent's wlock must be held when changing these:
+    struct proc* parent __attribute__((aligned(CACHELINE)));   // Parent process
+    struct proc* sibling;   // Next child of the same parent
 
-    // wait_lock must be held when using this:
-    struct proc* parent;   // Parent process
+    // wlock must be held when using this; it is also the lock
+    // a parent sleeps on in wait() and join():
+    struct spinlock wlock;      // Protects children, and each child's parent and sibling
+    struct proc*    children;   // First child, linked through sibling
 
-    // these are private to the process, so p->lock need not be held.
-    uint64            kstack;          // Virtual address of kernel stack
-    uint64            sz;              // Size of process memory (bytes)
-    pagetable_t       pagetable;       // User page table
-    struct trapframe* trapframe;       // data page for trampoline.S
-    struct context    context;         // swtch() here to run process
-    struct file*      ofile[NOFILE];   // Open files
+    // pid_lock must be held when changing this:
+    struct proc* pidnext;   // Next process in the same pid hash bucket
+
+    // the lock of the run or wait queue p is on must be held when using these:
+    struct proc* rqnext;   // Next process on the same run queue
+    struct proc* wqnext;   // Next process on the same wait queue
+
+    // cold, and private to the process too.
+    struct file*      ofile[NOFILE] __attribute__((aligned(CACHELINE)));   // Open files
+    struct vma        vma[NVMA];       // Memory-mapped files
     struct inode*     cwd;             // Current directory
     char              name[16];        // Process name (debugging)
-};
+    uint64            tracemask;       // System calls to log, bit 1 << SYS_* (see trace())
+    int               thread;          // If non-zero, a thread of its parent, trapframe at TFRAME(thread)
+    struct sleeplock* shared;          // Sleep-lock held shared, if any (see acquiresleepshared())
+    int               ilocks;          // Inode locks held (see vmafault())
+    char*             execpath;        // For a child of spawn(), the program to run, until it runs it
+    char**            execargv;        // and its arguments (see spawnfree())
+    void (*kfn)(void);                 // Entry point if this is a kernel thread
+} __attribute__((aligned(CACHELINE)));
@@ -0,0 +1,153 @@
+//
+// Sampling profiler.
+//
+// While sampling is on, every CPU's timer also fires every
+// PROFCYCLES, and the timer interrupt records what it
+// interrupted: sepc, whether that was user or kernel code, and
+// the running process. Each CPU keeps its samples in a ring of
+// its own, which prof() empties into user memory; when a ring
+// is full, new samples are counted and dropped.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
+#include "prof.h"
+#include "defs.h"
+
+#define NPROFCOPY 32   // samples copied out per lock hold
+
+struct profbuf
+{
+    struct spinlock   lock;      // protects the ring and dropped
+    struct profsample s[NPROFSAMPLE];
+    uint              head;      // free-running, like a pipe's nread
+    uint              tail;      // and nwrite
+    int               dropped;   // samples lost to a full ring
+    uint64            next;      // r_time() of the next sample; this CPU only
+} __attribute__((aligned(CACHELINE)));   // 每个 CPU 的缓冲区独占缓存行
+
+static struct profbuf profbufs[NCPU];
+static int            profon;   // sampling?
+
+// 初始化各 CPU 的采样缓冲区
+void profinit(void)
+{
+    for (int i = 0; i < NCPU; i++)
+        initlock(&profbufs[i].lock, "prof");
+}
+
+// When this CPU's timer must next fire for a sample, or 0 if
+// sampling is off. Interrupts must be off.
+// 返回本 CPU 下一次采样的时刻
+uint64 profdeadline(void)
+{
+    struct profbuf* b = &profbufs[cpuid()];
+
+    if (!__atomic_load_n(&profon, __ATOMIC_SEQ_CST))
+        return 0;
+    if (b->next == 0)
+        b->next = r_time() + PROFCYCLES;
+    return b->next;
+}
+
+// Take a sample of what the timer interrupted, if one is due.
+// Called by devintr() for every timer interrupt, before sepc
+// and sstatus change.
+// 在定时器中断中记录一个样本
+void proftick(void)
+{
+    struct profbuf*    b = &profbufs[cpuid()];
+    struct proc*       p = mycpu()->proc;
+    struct profsample* s;
+    uint64             now = r_time();
+
+    if (!__atomic_load_n(&profon, __ATOMIC_SEQ_CST) || now < b->next)
+        return;
+    b->next = now + PROFCYCLES;
+
+    acquire(&b->lock);
+    if (b->tail - b->head == NPROFSAMPLE)
+        b->dropped++;
+    else
+    {
+        s       = &b->s[b->tail++ % NPROFSAMPLE];
+        s->pc   = r_sepc();
+        s->pid  = p ? p->pid : 0;
+        s->cpu  = cpuid();
+        s->user = (r_sstatus() & SSTATUS_SPP) == 0;
+    }
+    release(&b->lock);
+}
+
+// Move up to n samples from the rings to user address addr.
+// Returns the number moved, or -1.
+// 将样本从各 CPU 的缓冲区取到用户空间
+static int profread(uint64 addr, int n)
+{
+    struct profsample buf[NPROFCOPY];
+    struct profbuf*   b;
+    int               m, tot = 0;
+
+    for (b = profbufs; b < &profbufs[NCPU]; b++)
+    {
+        for (;;)
+        {
+            acquire(&b->lock);
+            for (m = 0; m < NPROFCOPY && tot + m < n && b->head != b->tail; m++)
+                buf[m] = b->s[b->head++ % NPROFSAMPLE];
+            release(&b->lock);
+            if (m == 0)
+                break;
+            if (copyout(myproc()->pagetable, addr + tot * sizeof(buf[0]), (char*)buf, m * sizeof(buf[0])) < 0)
+                return -1;
+            tot += m;
+        }
+    }
+    return tot;
+}
+
+// Start or stop sampling, or read samples: see prof.h.
+// 性能采样的系统调用：开始、停止或读取样本
+int prof(int op, uint64 addr, int n)
+{
+    struct profbuf* b;
+    int             i, dropped = 0;
+
+    switch (op)
+    {
+    case PROF_START:
+        for (b = profbufs; b < &profbufs[NCPU]; b++)
+        {
+            acquire(&b->lock);
+            b->head = b->tail = 0;
+            b->dropped        = 0;
+            release(&b->lock);
+        }
+        __atomic_store_n(&profon, 1, __ATOMIC_SEQ_CST);
+        // idle CPUs arm their timers only when woken.
+        for (i = 0; i < NCPU; i++)
+            if (__atomic_load_n(&cpus[i].idling, __ATOMIC_SEQ_CST))
+                timerkick(i);
+        return 0;
+
+    case PROF_STOP:
+        __atomic_store_n(&profon, 0, __ATOMIC_SEQ_CST);
+        for (b = profbufs; b < &profbufs[NCPU]; b++)
+        {
+            acquire(&b->lock);
+            dropped += b->dropped;
+            release(&b->lock);
+        }
+        return dropped;
+
+    case PROF_READ:
+        if (n < 0)
+            return -1;
+        return profread(addr, n);
+    }
+    return -1;
+}
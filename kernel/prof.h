@@ -0,0 +1,13 @@
+// Operations of prof(), the sampling profiler (see prof.c).
+#define PROF_START 1   // 清空缓冲区并开始采样
+#define PROF_STOP  2   // 停止采样，返回因缓冲区满而丢弃的样本数
+#define PROF_READ  3   // 取出缓冲区中的样本
+
+// One sample, taken at a timer interrupt.
+struct profsample
+{
+    uint64 pc;     // 被中断处的 sepc
+    int    pid;    // 正在运行的进程，没有则为 0
+    short  cpu;    // 采样的 CPU
+    short  user;   // pc 是否为用户地址
+};
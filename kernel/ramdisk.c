@@ -1,5 +1,19 @@
 //
-// ramdisk that uses the disk image loaded by qemu -initrd fs.img
+// RAM disk: block device RAMDEV, kept in memory.
+//
+// its blocks live in pages from kalloc(), PGSIZE / BSIZE to a
+// page, allocated the first time one of them is written; a block
+// that was never written reads as zeros. the pages are found
+// through a two-level table whose second level is allocated the
+// same way, so that the disk costs little more than the blocks
+// written to it, however big it is. reads and writes are
+// copies done at once by ramdisk_start(), which calls b->iodone
+// itself, so ramdisk_wait() has nothing to wait for.
+//
+// built with RAMROOT, the root file system is on the RAM disk:
+// ramdiskload() copies the image on the first virtio disk into
+// it before fsinit(), growing the disk to the size in the
+// image's superblock. the disk image is then never written.
 //
 
 #include "types.h"
@@ -12,33 +26,136 @@
 #include "fs.h"
 #include "buf.h"
 
-void ramdiskinit(void) {}
+#define BPP     (PGSIZE / BSIZE)           // blocks per page
+#define PPP     (PGSIZE / sizeof(char*))   // page pointers per page
+#define MAXRAMB (PPP * PPP * BPP)          // largest RAM disk, in blocks
+
+static struct
+{
+    struct spinlock lock;       // 保护 dir[] 及其指向的页的分配
+    char**          dir[PPP];   // 每项指向一页存放块的页的指针，未用到的为 0
+    uint            nblock;     // 块数
+    int             npage;      // 已分配的块页数
+    uint64          nread;      // 读的块数
+    uint64          nwrite;     // 写的块数
+} ramdisk;
+
+// Allocate a zeroed page for the RAM disk.
+// 为内存盘分配一个清零的页
+static void* ramdisk_page(void)
+{
+    void* pg;
+
+    if ((pg = kalloc()) == 0)
+        panic("ramdisk: out of memory");
+    pgzero(pg);
+    return pg;
+}
 
-// If B_DIRTY is set, write buf to disk, clear B_DIRTY, set B_VALID.
-// Else if B_VALID is not set, read buf from disk, set B_VALID.
-void ramdiskrw(struct buf* b)
+// Where block blockno is kept, or 0 if it has never been
+// written. With alloc, allocate its page if need be.
+// 返回块 blockno 在内存中的位置
+static char* ramdisk_block(uint blockno, int alloc)
 {
-    if (!holdingsleep(&b->lock))
-        panic("ramdiskrw: buf not locked");
-    if ((b->flags & (B_VALID | B_DIRTY)) == B_VALID)
-        panic("ramdiskrw: nothing to do");
+    char** pp;
+    char*  pg = 0;
 
-    if (b->blockno >= FSSIZE)
-        panic("ramdiskrw: blockno too big");
+    if (blockno >= ramdisk.nblock)
+        panic("ramdisk: blockno too big");
+    acquire(&ramdisk.lock);
+    if ((pp = ramdisk.dir[blockno / BPP / PPP]) == 0 && alloc)
+        pp = ramdisk.dir[blockno / BPP / PPP] = ramdisk_page();
+    if (pp && (pg = pp[blockno / BPP % PPP]) == 0 && alloc)
+    {
+        pg = pp[blockno / BPP % PPP] = ramdisk_page();
+        ramdisk.npage++;
+    }
+    release(&ramdisk.lock);
+    return pg ? pg + blockno % BPP * BSIZE : 0;
+}
 
-    uint64 diskaddr = b->blockno * BSIZE;
-    char*  addr     = (char*)RAMDISK + diskaddr;
+// Read or write the n locked buffers of bs: bdevsw's start.
+// 读写 n 个缓冲区，立即完成
+static void ramdisk_start(struct buf** bs, int n, int write)
+{
+    struct buf* b;
+    char*       p;
 
-    if (b->flags & B_DIRTY)
+    for (int i = 0; i < n; i++)
     {
-        // write
-        memmove(addr, b->data, BSIZE);
-        b->flags &= ~B_DIRTY;
+        b = bs[i];
+        p = ramdisk_block(b->blockno, write);
+        if (write)
+            memmove(p, b->data, BSIZE);
+        else if (p)
+            memmove(b->data, p, BSIZE);
+        else
+            memset(b->data, 0, BSIZE);
+        __sync_fetch_and_add(write ? &ramdisk.nwrite : &ramdisk.nread, 1);
+        if (b->iodone)
+        {
+            void (*done)(struct buf*) = b->iodone;
+            b->iodone                 = 0;
+            done(b);
+        }
     }
-    else
+}
+
+// The I/O ramdisk_start() starts is done when it returns.
+// 内存盘的读写在启动时已完成，无需等待
+static void ramdisk_wait(struct buf** bs, int n) {}
+
+// print RAM disk statistics.
+// 打印内存盘统计信息
+static void ramdisk_dump(uint dev)
+{
+    printf("ramdisk: %d pages, %ld blocks read, %ld written\n", ramdisk.npage, ramdisk.nread,
+           ramdisk.nwrite);
+}
+
+// 初始化内存盘并注册为块设备 RAMDEV
+void ramdiskinit(void)
+{
+    initlock(&ramdisk.lock, "ramdisk");
+    ramdisk.nblock       = RAMDISKBLOCKS;
+    bdevsw[RAMDEV].name  = "ramdisk";
+    bdevsw[RAMDEV].start = ramdisk_start;
+    bdevsw[RAMDEV].wait  = ramdisk_wait;
+    bdevsw[RAMDEV].dump  = ramdisk_dump;
+}
+
+// Copy the file system image on block device from onto the
+// RAM disk, RAMAX blocks at a time, first making the disk as
+// big as the image if it is bigger, as mkfs -s can make it.
+// Must be called from a process, before fsinit().
+// 将块设备 from 上的文件系统映像复制到内存盘
+void ramdiskload(uint from)
+{
+    struct superblock sb;
+    struct buf*       bs[RAMAX];
+    struct buf*       b;
+    uint              bno;
+    int               i, n;
+
+    b = bread(from, 1);
+    memmove(&sb, b->data, sizeof(sb));
+    brelse(b);
+    if (sb.magic != FSMAGIC || sb.size > MAXRAMB)
+        panic("ramdiskload: bad file system");
+    if (sb.size > ramdisk.nblock)
+        ramdisk.nblock = sb.size;
+
+    for (bno = 0; bno < sb.size; bno += n)
     {
-        // read
-        memmove(b->data, addr, BSIZE);
-        b->flags |= B_VALID;
+        n = sb.size - bno < RAMAX ? sb.size - bno : RAMAX;
+        for (i = 0; i < n; i++)
+            bs[i] = breadstart(from, bno + i);
+        bwait(bs, n);
+        for (i = 0; i < n; i++)
+        {
+            memmove(ramdisk_block(bno + i, 1), bs[i]->data, BSIZE);
+            brelse(bs[i]);
+        }
     }
+    printf("ramdisk: loaded %d blocks\n", sb.size);
 }
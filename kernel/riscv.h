@@ -38,6 +38,7 @@ static inline void w_mepc(uint64 x)
 
 // Supervisor Status Register, sstatus
 
+#define SSTATUS_SUM  (1L << 18)  // Supervisor may access User memory
 #define SSTATUS_SPP  (1L << 8)   // Previous mode, 1=Supervisor, 0=User
 #define SSTATUS_SPIE (1L << 5)   // Supervisor Previous Interrupt Enable
 #define SSTATUS_UPIE (1L << 4)   // User Previous Interrupt Enable
@@ -236,6 +237,19 @@ static inline uint64 r_mcounteren()
     return x;
 }
 
+// Supervisor-mode Counter-Enable
+static inline void w_scounteren(uint64 x)
+{
+    asm volatile("csrw scounteren, %0" : : "r"(x));
+}
+
+static inline uint64 r_scounteren()
+{
+    uint64 x;
+    asm volatile("csrr %0, scounteren" : "=r"(x));
+    return x;
+}
+
 // machine-mode cycle counter
 static inline uint64 r_time()
 {
@@ -314,6 +328,8 @@ typedef uint64* pagetable_t;   // 512 PTEs
 #define PTE_W (1L << 2)   // 可写位
 #define PTE_X (1L << 3)   // 可执行位
 #define PTE_U (1L << 4)   // 用户模式可访问位
+#define PTE_D (1L << 7)   // 脏位，硬件在写入该页时置位
+#define PTE_COW (1L << 8)   // 写时复制页（RSW 软件保留位）
 
 // 物理地址与页表项转换
 #define PA2PTE(pa)     ((((uint64)pa) >> 12) << 10)   // 将物理地址转换为页表项格式
@@ -324,6 +340,9 @@ typedef uint64* pagetable_t;   // 512 PTEs
 #define PXMASK         0x1FF                       // 掩码值 0x1FF 表示 9 位（111111111）
 #define PXSHIFT(level) (PGSHIFT + (9 * (level)))   // 计算特定级别的索引在虚拟地址中的位移量
 #define PX(level, va)  ((((uint64)(va)) >> PXSHIFT(level)) & PXMASK)   // 提取特定级别的索引值
+#define LEVELSIZE(level) (1L << PXSHIFT(level))   // 一个第 level 级页表项覆盖的地址范围
+#define MEGAPGSIZE       LEVELSIZE(1)             // 第 1 级叶子页表项映射的大页（2MB）
+#define PTE_LEAF(pte)    ((pte) & (PTE_R | PTE_W | PTE_X))   // 是否为叶子页表项
 
 // one beyond the highest possible virtual address.
 // MAXVA is actually one bit less than the max allowed by
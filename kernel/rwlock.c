@@ -0,0 +1,87 @@
+// Reader-writer spin locks, for data read far more often than
+// it is written. Readers share the lock and may hold it on
+// several CPUs at once; a writer has it to itself. A waiting
+// writer keeps new readers out, so that a stream of readers
+// cannot starve it. As with spinlocks, interrupts are off
+// while the lock is held, and holders must not sleep.
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "rwlock.h"
+#include "riscv.h"
+#include "proc.h"
+#include "defs.h"
+
+void initrwlock(struct rwlock* lk, char* name)
+{
+    lk->name  = name;
+    lk->state = 0;
+    lk->wwait = 0;
+    lk->cpu   = 0;
+}
+
+// Acquire the lock shared with other readers.
+// 以读者身份获取读写锁
+void acquireread(struct rwlock* lk)
+{
+    int s;
+
+    push_off();   // disable interrupts to avoid deadlock.
+    if (lk->cpu == mycpu())
+        panic("acquireread");
+    for (;;)
+    {
+        s = __atomic_load_n(&lk->state, __ATOMIC_RELAXED);
+        if (s >= 0 && __atomic_load_n(&lk->wwait, __ATOMIC_RELAXED) == 0 &&
+            __sync_bool_compare_and_swap(&lk->state, s, s + 1))
+            break;
+    }
+    __sync_synchronize();
+}
+
+// Release a shared hold of the lock.
+// 释放读者持有的读写锁
+void releaseread(struct rwlock* lk)
+{
+    if (lk->state <= 0)
+        panic("releaseread");
+    __sync_synchronize();
+    __sync_fetch_and_sub(&lk->state, 1);
+    pop_off();
+}
+
+// Acquire the lock for this CPU alone.
+// 以写者身份获取读写锁
+void acquirewrite(struct rwlock* lk)
+{
+    push_off();   // disable interrupts to avoid deadlock.
+    if (lk->cpu == mycpu())
+        panic("acquirewrite");
+    __sync_fetch_and_add(&lk->wwait, 1);
+    while (!__sync_bool_compare_and_swap(&lk->state, 0, -1))
+        ;
+    __sync_fetch_and_sub(&lk->wwait, 1);
+    __sync_synchronize();
+    lk->cpu = mycpu();
+}
+
+// Release the lock held for writing.
+// 释放写者持有的读写锁
+void releasewrite(struct rwlock* lk)
+{
+    if (!holdingwrite(lk))
+        panic("releasewrite");
+    lk->cpu = 0;
+    __sync_synchronize();
+    __atomic_store_n(&lk->state, 0, __ATOMIC_RELEASE);
+    pop_off();
+}
+
+// Is this CPU holding the lock for writing?
+// Interrupts must be off.
+int holdingwrite(struct rwlock* lk)
+{
+    return lk->state == -1 && lk->cpu == mycpu();
+}
@@ -0,0 +1,10 @@
+// Reader-writer spin lock: any number of readers, or one writer.
+struct rwlock
+{
+    int state;   // Number of readers, or -1 if a writer holds it
+    int wwait;   // Writers waiting, who hold off new readers
+
+    // For debugging:
+    char*       name;   // Name of lock.
+    struct cpu* cpu;    // The cpu holding it for writing.
+};
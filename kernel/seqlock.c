@@ -0,0 +1,64 @@
+// Sequence locks, for small data read often and written
+// rarely, where even a shared lock would bounce its cache line
+// between the readers. A writer makes lk->seq odd while it
+// changes the data and even again after; a reader notes seq
+// before reading and reads again if seq was odd or has since
+// changed. Writers must be kept apart by a lock of their own.
+//
+//   do {
+//       s = readseqbegin(&lk);
+//       copy the data
+//   } while (readseqretry(&lk, s));
+
+#include "types.h"
+#include "param.h"
+#include "riscv.h"
+#include "seqlock.h"
+#include "defs.h"
+
+void initseqlock(struct seqlock* lk, char* name)
+{
+    lk->name = name;
+    lk->seq  = 0;
+}
+
+// Start a change to the data. The caller holds the lock that
+// keeps writers apart.
+// 写者开始修改数据
+void writeseqbegin(struct seqlock* lk)
+{
+    if (lk->seq & 1)
+        panic("writeseqbegin");
+    __atomic_store_n(&lk->seq, lk->seq + 1, __ATOMIC_RELAXED);
+    __sync_synchronize();
+}
+
+// Finish a change to the data.
+// 写者结束修改数据
+void writeseqend(struct seqlock* lk)
+{
+    __sync_synchronize();
+    __atomic_store_n(&lk->seq, lk->seq + 1, __ATOMIC_RELAXED);
+}
+
+// Start reading the data, waiting out a change in progress.
+// Returns the sequence number to give readseqretry().
+// 读者开始读取数据
+uint readseqbegin(struct seqlock* lk)
+{
+    uint s;
+
+    while ((s = __atomic_load_n(&lk->seq, __ATOMIC_RELAXED)) & 1)
+        ;
+    __sync_synchronize();
+    return s;
+}
+
+// Did the data change after readseqbegin() returned s? If
+// so, what was read may be inconsistent and must be read again.
+// 判断读取期间数据是否被修改，需要重读
+int readseqretry(struct seqlock* lk, uint s)
+{
+    __sync_synchronize();
+    return __atomic_load_n(&lk->seq, __ATOMIC_RELAXED) != s;
+}
@@ -0,0 +1,9 @@
+// Sequence lock: readers take no lock, but retry if a writer
+// changed the data while they read it.
+struct seqlock
+{
+    uint seq;   // Odd while a write is in progress
+
+    // For debugging:
+    char* name;   // Name of lock.
+};
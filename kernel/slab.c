@@ -0,0 +1,240 @@
+//
+// Allocator for small kernel objects, on top of kalloc().
+//
+// kmalloc() rounds a request up to one of a few size classes.
+// Each class cuts whole pages from kalloc() into slabs of
+// equal objects: a page starts with a struct slab, which keeps
+// the page's free objects, so kmfree() finds an object's class
+// from the page it lies in. A class keeps its slabs that have
+// free objects on its partial list, and gives a slab's page
+// back to kalloc() once all of its objects are free.
+//
+// In front of the slabs every CPU has a magazine per class, a
+// small stack of free objects it takes and returns with only
+// interrupts off. The class lock is needed just to refill an
+// empty magazine or drain a full one, and then for half a
+// magazine of objects at a time.
+//
+
+#include "types.h"
+#include "param.h"
+#include "memlayout.h"
+#include "spinlock.h"
+#include "riscv.h"
+#include "defs.h"
+
+#define NKCLASS 7    // size classes
+#define KMAG    16   // objects in a full magazine
+
+struct kobj
+{
+    struct kobj* next;
+};
+
+// The head of each slab page. Objects follow it, from SLABHDR
+// bytes into the page.
+struct slab
+{
+    struct kcache* cache;   // class of the objects
+    struct slab*   next;    // next slab on the class's partial list
+    struct kobj*   free;    // free objects in the slab
+    int            nfree;
+};
+
+#define SLABHDR ((sizeof(struct slab) + 15) & ~15)
+
+// A CPU's stack of free objects of one class. Used with
+// interrupts off, by its own CPU only.
+struct kmag
+{
+    void* obj[KMAG];
+    int   n;
+} __attribute__((aligned(CACHELINE)));   // so that CPUs' magazines share no cache line
+
+struct kcache
+{
+    struct spinlock lock;      // protects partial, the slabs on it, and the counters
+    uint            size;      // bytes per object, a multiple of 16
+    int             perslab;   // objects per slab
+    struct slab*    partial;   // slabs with free objects
+    uint64          nslab;     // slabs allocated now
+    uint64          ninuse;    // objects outside the slabs, in use or in magazines
+    struct kmag     mag[NCPU];
+};
+
+// the largest fits twice in a page after the slab header.
+static uint ksizes[NKCLASS] = {32, 64, 128, 256, 512, 1024, 2016};
+
+static struct kcache kcache[NKCLASS];
+
+// 初始化各个大小类
+void slabinit(void)
+{
+    struct kcache* c;
+    int            i;
+
+    for (i = 0; i < NKCLASS; i++)
+    {
+        c          = &kcache[i];
+        c->size    = ksizes[i];
+        c->perslab = (PGSIZE - SLABHDR) / c->size;
+        initlock(&c->lock, "kcache");
+    }
+}
+
+// Cut a page from kalloc() into a slab of c's objects and put
+// it on c's partial list. Caller must hold c->lock.
+// Returns -1 if out of memory.
+// 从 kalloc() 分配一页并切分为新的 slab
+static int slabgrow(struct kcache* c)
+{
+    struct slab* s;
+    struct kobj* o;
+    int          i;
+
+    if ((s = (struct slab*)kalloc()) == 0)
+        return -1;
+    s->cache = c;
+    s->free  = 0;
+    s->nfree = c->perslab;
+    for (i = c->perslab - 1; i >= 0; i--)
+    {
+        o       = (struct kobj*)((char*)s + SLABHDR + i * c->size);
+        o->next = s->free;
+        s->free = o;
+    }
+    s->next    = c->partial;
+    c->partial = s;
+    c->nslab++;
+    return 0;
+}
+
+// Fill the empty magazine m with up to KMAG/2 objects from c's
+// slabs. Returns the number of objects moved, 0 if out of memory.
+// 从 slab 中取出对象装入空的弹匣
+static int magfill(struct kcache* c, struct kmag* m)
+{
+    struct slab* s;
+    struct kobj* o;
+
+    acquire(&c->lock);
+    while (m->n < KMAG / 2)
+    {
+        if (c->partial == 0 && slabgrow(c) < 0)
+            break;
+        s       = c->partial;
+        o       = s->free;
+        s->free = o->next;
+        if (--s->nfree == 0)
+            c->partial = s->next;   // full now
+        m->obj[m->n++] = o;
+        c->ninuse++;
+    }
+    release(&c->lock);
+    return m->n;
+}
+
+// Return the older half of the full magazine m to c's slabs,
+// and the pages of any slabs that become empty to kalloc().
+// 将满弹匣中的一半对象归还给 slab
+static void magdrain(struct kcache* c, struct kmag* m)
+{
+    struct slab  *s, **pp, *empty = 0;
+    struct kobj* o;
+    int          i, n = KMAG / 2;
+
+    acquire(&c->lock);
+    for (i = 0; i < n; i++)
+    {
+        o       = (struct kobj*)m->obj[i];
+        s       = (struct slab*)PGROUNDDOWN((uint64)o);
+        o->next = s->free;
+        s->free = o;
+        if (s->nfree++ == 0)
+        {
+            s->next    = c->partial;
+            c->partial = s;
+        }
+        else if (s->nfree == c->perslab)
+        {
+            for (pp = &c->partial; *pp != s; pp = &(*pp)->next)
+                ;
+            *pp     = s->next;
+            s->next = empty;
+            empty   = s;
+            c->nslab--;
+        }
+        c->ninuse--;
+    }
+    release(&c->lock);
+
+    for (i = n; i < m->n; i++)
+        m->obj[i - n] = m->obj[i];
+    m->n -= n;
+
+    while ((s = empty) != 0)
+    {
+        empty = s->next;
+        kfree(s);
+    }
+}
+
+// Allocate n bytes, at most 2016, aligned to 16 bytes.
+// Returns 0 if the memory cannot be allocated.
+// 分配 n 字节的内核对象
+void* kmalloc(uint n)
+{
+    struct kcache* c;
+    struct kmag*   m;
+    void*          o = 0;
+
+    for (c = kcache; c < &kcache[NKCLASS] && c->size < n; c++)
+        ;
+    if (c == &kcache[NKCLASS])
+        panic("kmalloc: too big");
+
+    push_off();
+    m = &c->mag[cpuid()];
+    if (m->n > 0 || magfill(c, m) > 0)
+        o = m->obj[--m->n];
+    pop_off();
+    return o;
+}
+
+// Free an object returned by kmalloc().
+// 释放 kmalloc() 分配的对象
+void kmfree(void* o)
+{
+    struct slab*   s = (struct slab*)PGROUNDDOWN((uint64)o);
+    struct kcache* c = s->cache;
+    struct kmag*   m;
+
+    if (c < kcache || c >= &kcache[NKCLASS] || ((char*)o - (char*)s - SLABHDR) % c->size != 0)
+        panic("kmfree");
+
+    // Fill with junk to catch dangling refs.
+    memset(o, 1, c->size);
+
+    push_off();
+    m = &c->mag[cpuid()];
+    if (m->n == KMAG)
+        magdrain(c, m);
+    m->obj[m->n++] = o;
+    pop_off();
+}
+
+// Print each size class's slabs and objects in use.
+// For debugging; no locks, like procdump().
+// 打印各大小类的 slab 数与在用对象数
+void slabdump(void)
+{
+    struct kcache* c;
+
+    for (c = kcache; c < &kcache[NKCLASS]; c++)
+    {
+        if (c->nslab == 0)
+            continue;
+        printf("kmalloc-%d: slabs %d objects %d/%d\n", (int)c->size, (int)c->nslab,
+               (int)c->ninuse, (int)(c->nslab * c->perslab));
+    }
+}
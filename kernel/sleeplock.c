@@ -12,38 +12,98 @@
 void initsleeplock(struct sleeplock* lk, char* name)
 {
     initlock(&lk->lk, "sleep lock");
-    lk->name   = name;
-    lk->locked = 0;
-    lk->pid    = 0;
+    lk->name     = name;
+    lk->locked   = 0;
+    lk->readers  = 0;
+    lk->xwait    = 0;
+    lk->swait    = 0;
+    lk->pid      = 0;
+    lk->nacquire = 0;
+    lk->nsleep   = 0;
+    statsaddsleeplock(lk);
 }
 
 void acquiresleep(struct sleeplock* lk)
 {
     acquire(&lk->lk);
-    while (lk->locked)
+    lk->nacquire++;
+    while (lk->locked || lk->readers)
     {
+        lk->nsleep++;
+        lk->xwait++;
         sleep(lk, &lk->lk);
+        lk->xwait--;
     }
     lk->locked = 1;
     lk->pid    = myproc()->pid;
     release(&lk->lk);
 }
 
+// Take the lock shared with other readers, who may hold it at
+// the same time, but not with an exclusive holder. Waits while
+// anyone is waiting for it exclusively, so that readers
+// cannot starve a writer. A process shares one lock at a
+// time, recorded in p->shared for holdingsleep().
+// 以共享方式获取睡眠锁
+void acquiresleepshared(struct sleeplock* lk)
+{
+    struct proc* p = myproc();
+
+    if (p->shared)
+        panic("acquiresleepshared");
+    acquire(&lk->lk);
+    lk->nacquire++;
+    while (lk->locked || lk->xwait)
+    {
+        lk->nsleep++;
+        lk->swait++;
+        sleep(lk, &lk->lk);
+        lk->swait--;
+    }
+    lk->readers++;
+    p->shared = lk;
+    release(&lk->lk);
+}
+
+// Release the lock, held exclusively or shared.
 void releasesleep(struct sleeplock* lk)
 {
     acquire(&lk->lk);
-    lk->locked = 0;
-    lk->pid    = 0;
-    wakeup(lk);
+    if (lk->locked)
+    {
+        lk->locked = 0;
+        lk->pid    = 0;
+    }
+    else
+    {
+        myproc()->shared = 0;
+        if (--lk->readers > 0)
+        {
+            release(&lk->lk);
+            return;
+        }
+    }
+    // only one waiter can take the lock, unless some of them
+    // want it shared, and may all take it, or must see that
+    // a writer is still waiting.
+    if (lk->swait)
+        wakeup(lk);
+    else
+        wakeupone(lk);
     release(&lk->lk);
 }
 
+// Does the current process hold the lock, exclusively or
+// shared?
 int holdingsleep(struct sleeplock* lk)
 {
     int r;
 
     acquire(&lk->lk);
-    r = lk->locked && (lk->pid == myproc()->pid);
+    if (lk->locked)
+        r = lk->pid == myproc()->pid;
+    else
+        r = lk->readers > 0 && myproc()->shared == lk;
     release(&lk->lk);
     return r;
 }
@@ -1,10 +1,18 @@
 // Long-term locks for processes
 struct sleeplock
 {
-    uint            locked;   // Is the lock held?
+    uint            locked;   // Is the lock held exclusively?
+    int             readers;  // Holders sharing it (see acquiresleepshared())
+    int             xwait;    // Sleeping for it exclusively, holding off new readers
+    int             swait;    // Sleeping for it shared
     struct spinlock lk;       // spinlock protecting this sleep lock
 
     // For debugging:
     char* name;   // Name of lock.
     int   pid;    // Process holding lock
+
+    // For statistics (see stats.c), protected by lk:
+    uint64            nacquire;    // Number of acquiresleep() calls
+    uint64            nsleep;      // Times acquiresleep() had to sleep
+    struct sleeplock* statsnext;   // Next sleep-lock the statistics know of
 };
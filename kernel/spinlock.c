@@ -1,4 +1,17 @@
 // Mutual exclusion spin locks.
+//
+// A lock made by initlock() is a test-and-set lock: waiters
+// spin reading lk->locked, which stays in their own caches
+// while it does not change, and back off exponentially after
+// each failed test-and-set, so that a release is not met by
+// every CPU's swap at once. It is cheap, but not fair.
+//
+// A lock made by initticketlock() hands itself out in the
+// order acquire() was called: each acquirer takes the next
+// ticket and waits until lk->owner reaches it, backing off in
+// proportion to the number of waiters ahead. It suits the
+// global locks all CPUs contend for, where test-and-set lets
+// some CPUs wait far longer than others.
 
 #include "types.h"
 #include "param.h"
@@ -10,25 +23,79 @@
 
 void initlock(struct spinlock* lk, char* name)
 {
-    lk->name   = name;
-    lk->locked = 0;
-    lk->cpu    = 0;
+    lk->name     = name;
+    lk->locked   = 0;
+    lk->ticket   = 0;
+    lk->next     = 0;
+    lk->owner    = 0;
+    lk->cpu      = 0;
+    lk->nacquire = 0;
+    lk->nspin    = 0;
+    statsaddlock(lk);
+}
+
+// Initialize lk as a fair ticket lock.
+// 初始化一个按申请顺序获得的排队锁
+void initticketlock(struct spinlock* lk, char* name)
+{
+    initlock(lk, name);
+    lk->ticket = 1;
+}
+
+// Forget about a lock that is about to be freed.
+// 注销即将被释放的锁
+void freelock(struct spinlock* lk)
+{
+    statsfreelock(lk);
+}
+
+// Spin for about n loop iterations without touching memory.
+// 空转约 n 次循环
+static inline void backoff(uint n)
+{
+    for (volatile uint i = 0; i < n; i++)
+        ;
 }
 
 // Acquire the lock.
 // Loops (spins) until the lock is acquired.
 void acquire(struct spinlock* lk)
 {
+    uint delay, t, owner;
+
     push_off();   // disable interrupts to avoid deadlock.
     if (holding(lk))
         panic("acquire");
 
-    // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
-    //   a5 = 1
-    //   s1 = &lk->locked
-    //   amoswap.w.aq a5, a5, (s1)
-    while (__sync_lock_test_and_set(&lk->locked, 1) != 0)
-        ;
+    __sync_fetch_and_add(&lk->nacquire, 1);
+    if (lk->ticket)
+    {
+        // take a ticket and wait for it to come up.
+        t = __sync_fetch_and_add(&lk->next, 1);
+        while ((owner = __atomic_load_n(&lk->owner, __ATOMIC_ACQUIRE)) != t)
+        {
+            __sync_fetch_and_add(&lk->nspin, 1);
+            backoff((t - owner) * TICKETBACKOFF);
+        }
+        lk->locked = 1;
+    }
+    else
+    {
+        // On RISC-V, sync_lock_test_and_set turns into an atomic swap:
+        //   a5 = 1
+        //   s1 = &lk->locked
+        //   amoswap.w.aq a5, a5, (s1)
+        delay = 1;
+        while (__sync_lock_test_and_set(&lk->locked, 1) != 0)
+        {
+            __sync_fetch_and_add(&lk->nspin, 1);
+            backoff(delay);
+            if (delay < MAXBACKOFF)
+                delay *= 2;
+            while (__atomic_load_n(&lk->locked, __ATOMIC_RELAXED))
+                ;
+        }
+    }
 
     // Tell the C compiler and the processor to not move loads or stores
     // past this point, to ensure that the critical section's memory
@@ -65,6 +132,10 @@ void release(struct spinlock* lk)
     //   amoswap.w zero, zero, (s1)
     __sync_lock_release(&lk->locked);
 
+    // a ticket lock passes to the holder of the next ticket.
+    if (lk->ticket)
+        __atomic_store_n(&lk->owner, lk->owner + 1, __ATOMIC_RELEASE);
+
     pop_off();
 }
 
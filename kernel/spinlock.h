@@ -3,7 +3,18 @@ struct spinlock
 {
     uint locked;   // Is the lock held?
 
+    // For a ticket lock (see initticketlock()):
+    int  ticket;   // Hand the lock out in ticket order?
+    uint next;     // Next ticket to take
+    uint owner;    // Ticket of the holder, or of the next to hold it
+
     // For debugging:
     char*       name;   // Name of lock.
     struct cpu* cpu;    // The cpu holding the lock.
+
+    // For statistics (see stats.c):
+    uint64            nacquire;    // Number of acquire() calls.
+    uint64            nspin;       // Failed test-and-sets while spinning.
+    struct spinlock*  statsnext;   // Next lock the statistics know of
+    struct spinlock** statsprev;   // What points to this one there
 };
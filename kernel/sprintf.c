@@ -0,0 +1,108 @@
+//
+// formatted output to a buffer, for devices that
+// produce text, like the statistics device.
+//
+
+#include <stdarg.h>
+
+#include "types.h"
+#include "riscv.h"
+#include "defs.h"
+
+static char digits[] = "0123456789abcdef";
+
+// Append c to buf at *off, if there is room; the last byte of
+// buf is kept for the terminating NUL.
+// 向缓冲区追加一个字符
+static void sputc(char* buf, int sz, int* off, char c)
+{
+    if (*off < sz - 1)
+        buf[*off] = c;
+    (*off)++;
+}
+
+// 向缓冲区追加一个整数
+static void sprintint(char* buf, int sz, int* off, long long xx, int base, int sign)
+{
+    char   tmp[24];
+    int    i;
+    uint64 x;
+
+    if (sign && (sign = xx < 0))
+        x = -xx;
+    else
+        x = xx;
+
+    i = 0;
+    do
+    {
+        tmp[i++] = digits[x % base];
+    } while ((x /= base) != 0);
+
+    if (sign)
+        tmp[i++] = '-';
+
+    while (--i >= 0)
+        sputc(buf, sz, off, tmp[i]);
+}
+
+// Print to buf, at most sz bytes including the NUL, like
+// printf() does to the console. Returns the length of the
+// string, not counting text that did not fit.
+// 格式化输出到缓冲区
+int snprintf(char* buf, int sz, char* fmt, ...)
+{
+    va_list ap;
+    int     i, c, off = 0;
+    char*   s;
+
+    if (sz <= 0)
+        return 0;
+
+    va_start(ap, fmt);
+    for (i = 0; (c = fmt[i] & 0xff) != 0; i++)
+    {
+        if (c != '%')
+        {
+            sputc(buf, sz, &off, c);
+            continue;
+        }
+        c = fmt[++i] & 0xff;
+        if (c == 0)
+            break;
+        switch (c)
+        {
+        case 'd':
+            sprintint(buf, sz, &off, va_arg(ap, int), 10, 1);
+            break;
+        case 'x':
+            sprintint(buf, sz, &off, va_arg(ap, int), 16, 1);
+            break;
+        case 'l':
+            c = fmt[++i] & 0xff;
+            if (c == 'x')
+                sprintint(buf, sz, &off, va_arg(ap, uint64), 16, 0);
+            else if (c == 'u')
+                sprintint(buf, sz, &off, va_arg(ap, uint64), 10, 0);
+            else
+                sprintint(buf, sz, &off, va_arg(ap, uint64), 10, 1);
+            if (c == 0)
+                i--;
+            break;
+        case 's':
+            if ((s = va_arg(ap, char*)) == 0)
+                s = "(null)";
+            for (; *s; s++)
+                sputc(buf, sz, &off, *s);
+            break;
+        default:
+            sputc(buf, sz, &off, '%');
+            sputc(buf, sz, &off, c);
+            break;
+        }
+    }
+    va_end(ap);
+
+    buf[off < sz ? off : sz - 1] = 0;
+    return off < sz ? off : sz - 1;
+}
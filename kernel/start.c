@@ -13,7 +13,7 @@ __attribute__((aligned(16))) char stack0[4096 * NCPU];
 
 // a scratch area per CPU for machine-mode timer interrupts.
 // 
-uint64 timer_scratch[NCPU][5];
+uint64 timer_scratch[NCPU][CACHELINE / 8] __attribute__((aligned(CACHELINE)));   // a cache line per hart
 
 // assembly code in kernelvec.S for machine-mode timer interrupt.
 extern void timervec();
@@ -51,6 +51,13 @@ void start()
     w_pmpaddr0(0x3fffffffffffffull);
     w_pmpcfg0(0xf);
 
+    // let supervisor and user mode read the cycle and time
+    // counters. The scheduler's idle and cputime accounting
+    // reads time in supervisor mode, so this must be done
+    // before main() runs scheduler() for the first time.
+    w_mcounteren(r_mcounteren() | 0x3);
+    w_scounteren(r_scounteren() | 0x3);
+
     // ask for clock interrupts.
     timerinit();
 
@@ -67,22 +74,25 @@ void start()
 // at timervec in kernelvec.S,
 // which turns them into software interrupts for
 // devintr() in trap.c.
+// the timer is one-shot: it starts disarmed, timervec
+// disarms it again when it fires, and supervisor mode
+// arms it with timerarm() in trap.c for whatever this
+// CPU next needs to be woken for.
 void timerinit()
 {
     // each CPU has a separate source of timer interrupts.
     int id = r_mhartid();
 
-    // ask the CLINT for a timer interrupt.
-    int interval                 = 1000000;   // cycles; about 1/10th second in qemu.
-    *(uint64*)CLINT_MTIMECMP(id) = *(uint64*)CLINT_MTIME + interval;
+    // no timer interrupt until the kernel asks for one.
+    *(uint64*)CLINT_MTIMECMP(id) = ~0ULL;
 
     // prepare information in scratch[] for timervec.
     // scratch[0..2] : space for timervec to save registers.
     // scratch[3] : address of CLINT MTIMECMP register.
-    // scratch[4] : desired interval (in cycles) between timer interrupts.
+    // scratch[5] : address of CLINT MSIP register.
     uint64* scratch = &timer_scratch[id][0];
     scratch[3]      = CLINT_MTIMECMP(id);
-    scratch[4]      = interval;
+    scratch[5]      = CLINT_MSIP(id);
     w_mscratch((uint64)scratch);
 
     // set the machine-mode trap handler.
@@ -91,6 +101,8 @@ void timerinit()
     // enable machine-mode interrupts.
     w_mstatus(r_mstatus() | MSTATUS_MIE);
 
-    // enable machine-mode timer interrupts.
-    w_mie(r_mie() | MIE_MTIE);
+    // enable machine-mode timer interrupts, and the software
+    // interrupts by which other CPUs ask this one to flush its
+    // TLB (see tlbshootdown() in vm.c).
+    w_mie(r_mie() | MIE_MTIE | MIE_MSIE);
 }
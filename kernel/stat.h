@@ -10,3 +10,11 @@ struct stat
     short  nlink;   // Number of links to file
     uint64 size;    // Size of file in bytes
 };
+
+// A directory entry and the status of its inode, as read by
+// getdents().
+struct dirstat
+{
+    char        name[16];   // 以 '\0' 结尾的名字（最长 DIRSIZ 字节）
+    struct stat st;         // 该目录项所指 inode 的状态
+};
@@ -0,0 +1,223 @@
+//
+// Lock contention statistics.
+//
+// Every spinlock and sleep-lock registers itself here when it is
+// initialized, and counts its acquisitions and how long they
+// waited: failed test-and-sets for a spinlock, sleeps for a
+// sleep-lock. Reading the statistics device (major STATS, made
+// by init as /statistics) reports the counts summed over all the
+// locks of each name, most contended first. Writing anything to
+// it zeroes the counters, so that a run can be measured by
+// itself.
+//
+
+#include "types.h"
+#include "param.h"
+#include "spinlock.h"
+#include "sleeplock.h"
+#include "riscv.h"
+#include "fs.h"
+#include "file.h"
+#include "defs.h"
+
+#define NTOP  10   // lock kinds reported for each type of lock
+#define NKIND 64   // lock names told apart; the rest are summed together
+
+// the counts of all the locks of one name.
+struct lockkind
+{
+    char*  name;
+    uint64 nacquire;
+    uint64 nwait;   // spins or sleeps
+};
+
+// the locks known to the statistics, and the report built
+// from them by the current reader. Each lock links itself in
+// when it is initialized, so that every one is counted however
+// many there are: each buffer and inode has a sleep-lock, and
+// each sleep-lock a spinlock.
+static struct
+{
+    struct spinlock   lock;   // protects locks and sleeplocks
+    struct spinlock*  locks;
+    struct sleeplock* sleeplocks;
+
+    struct sleeplock busy;   // held while building and reading buf
+    struct lockkind  kind[NKIND];
+    char             buf[4096];
+    int              sz;    // length of the report in buf
+    int              off;   // how much of it has been read
+} stats;
+
+// Remember lk. Locks initialized before statsinit() use
+// stats.lock while it is still all zeros, which works.
+// 登记一个自旋锁
+void statsaddlock(struct spinlock* lk)
+{
+    acquire(&stats.lock);
+    lk->statsnext = stats.locks;
+    lk->statsprev = &stats.locks;
+    if (stats.locks)
+        stats.locks->statsprev = &lk->statsnext;
+    stats.locks = lk;
+    release(&stats.lock);
+}
+
+// Forget lk, which is about to be freed.
+// 注销一个自旋锁
+void statsfreelock(struct spinlock* lk)
+{
+    acquire(&stats.lock);
+    *lk->statsprev = lk->statsnext;
+    if (lk->statsnext)
+        lk->statsnext->statsprev = lk->statsprev;
+    release(&stats.lock);
+}
+
+// Remember the sleep-lock lk.
+// 登记一个睡眠锁
+void statsaddsleeplock(struct sleeplock* lk)
+{
+    acquire(&stats.lock);
+    lk->statsnext    = stats.sleeplocks;
+    stats.sleeplocks = lk;
+    release(&stats.lock);
+}
+
+// Add one lock's counts to the kind with its name, the last
+// of the n kinds so far if it is a new one. Once there are
+// NKIND kinds, the locks of new names all go in the last, so
+// that they are still counted. Returns the new n.
+// 将一个锁的计数累加到同名的锁类别中
+static int addkind(int n, char* name, uint64 nacquire, uint64 nwait)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+        if (strncmp(stats.kind[i].name, name, 32) == 0)
+            break;
+    if (i == NKIND)
+        i = NKIND - 1;
+    if (i == n && n == NKIND - 1)
+        name = "(other kinds)";
+    if (i == n)
+    {
+        stats.kind[n].name     = name;
+        stats.kind[n].nacquire = 0;
+        stats.kind[n].nwait    = 0;
+        n++;
+    }
+    stats.kind[i].nacquire += nacquire;
+    stats.kind[i].nwait += nwait;
+    return n;
+}
+
+// Append to stats.buf the n kinds, the NTOP with the most
+// waits first, under a header naming what a wait was.
+// 按等待次数输出最受争用的锁类别
+static void report(int n, char* type, char* wait)
+{
+    uint64 total = 0;
+    int    i, j, top;
+
+    for (i = 0; i < n; i++)
+        total += stats.kind[i].nwait;
+    stats.sz += snprintf(stats.buf + stats.sz, sizeof(stats.buf) - stats.sz,
+                         "%s: %d kinds, %ld %s in all\n", type, n, total, wait);
+    for (j = 0; j < NTOP && j < n; j++)
+    {
+        top = j;
+        for (i = j + 1; i < n; i++)
+            if (stats.kind[i].nwait > stats.kind[top].nwait)
+                top = i;
+        if (top != j)
+        {
+            struct lockkind t = stats.kind[top];
+            stats.kind[top]   = stats.kind[j];
+            stats.kind[j]     = t;
+        }
+        stats.sz += snprintf(stats.buf + stats.sz, sizeof(stats.buf) - stats.sz,
+                             "  %s: %ld acquires, %ld %s\n", stats.kind[j].name,
+                             stats.kind[j].nacquire, stats.kind[j].nwait, wait);
+    }
+}
+
+// Build the report in stats.buf.
+// 生成锁争用统计报告
+static void statsbuild(void)
+{
+    struct spinlock*  lk;
+    struct sleeplock* slk;
+    int               n;
+
+    stats.sz = 0;
+
+    n = 0;
+    acquire(&stats.lock);
+    for (lk = stats.locks; lk; lk = lk->statsnext)
+        n = addkind(n, lk->name, lk->nacquire, lk->nspin);
+    release(&stats.lock);
+    report(n, "spinlocks", "spins");
+
+    n = 0;
+    acquire(&stats.lock);
+    for (slk = stats.sleeplocks; slk; slk = slk->statsnext)
+        n = addkind(n, slk->name, slk->nacquire, slk->nsleep);
+    release(&stats.lock);
+    report(n, "sleeplocks", "sleeps");
+}
+
+// Read the report, building it anew when a reader starts at
+// its beginning. Returns 0 once it has all been read.
+// 读取统计设备
+int statsread(int user_dst, uint64 dst, int n, int nonblock)
+{
+    int m;
+
+    acquiresleep(&stats.busy);
+    if (stats.off == 0)
+        statsbuild();
+    m = stats.sz - stats.off;
+    if (m > n)
+        m = n;
+    if (m > 0 && either_copyout(user_dst, dst, stats.buf + stats.off, m) == -1)
+        m = -1;
+    else if (m > 0)
+        stats.off += m;
+    else
+        stats.off = 0;
+    releasesleep(&stats.busy);
+    return m;
+}
+
+// Zero the counters of every lock.
+// 写统计设备：清零所有锁的计数
+int statswrite(int user_src, uint64 src, int n, int nonblock)
+{
+    struct spinlock*  lk;
+    struct sleeplock* slk;
+
+    acquire(&stats.lock);
+    for (lk = stats.locks; lk; lk = lk->statsnext)
+    {
+        lk->nacquire = 0;
+        lk->nspin    = 0;
+    }
+    for (slk = stats.sleeplocks; slk; slk = slk->statsnext)
+    {
+        slk->nacquire = 0;
+        slk->nsleep   = 0;
+    }
+    release(&stats.lock);
+    return n;
+}
+
+// 初始化统计设备
+void statsinit(void)
+{
+    initlock(&stats.lock, "stats");
+    initsleeplock(&stats.busy, "stats");
+
+    devsw[STATS].read  = statsread;
+    devsw[STATS].write = statswrite;
+}
@@ -1,22 +1,65 @@
 #include "types.h"
+#include "riscv.h"
 
+// The memory routines below move 8-byte words once the
+// pointers are word-aligned, 64 bytes per iteration while there
+// is room, and fall back to bytes for the unaligned head and
+// tail. When the two pointers of memcmp() or memmove() differ
+// in alignment they go byte by byte, since misaligned word
+// accesses trap or are slow on RISC-V.
+
+#define WORD(x) (((uint64)(x) & 7) == 0)
+
+// 按字填充内存
 void* memset(void* dst, int c, uint n)
 {
-    char* cdst = (char*)dst;
-    int   i;
-    for (i = 0; i < n; i++)
+    char*   cdst = (char*)dst;
+    uint64* wdst;
+    uint64  w;
+
+    while (n > 0 && !WORD(cdst))
     {
-        cdst[i] = c;
+        *cdst++ = c;
+        n--;
     }
+    w    = (uchar)c * 0x0101010101010101UL;
+    wdst = (uint64*)cdst;
+    for (; n >= 64; n -= 64, wdst += 8)
+    {
+        wdst[0] = w;
+        wdst[1] = w;
+        wdst[2] = w;
+        wdst[3] = w;
+        wdst[4] = w;
+        wdst[5] = w;
+        wdst[6] = w;
+        wdst[7] = w;
+    }
+    for (; n >= 8; n -= 8)
+        *wdst++ = w;
+    cdst = (char*)wdst;
+    while (n-- > 0)
+        *cdst++ = c;
     return dst;
 }
 
+// 按字比较内存
 int memcmp(const void* v1, const void* v2, uint n)
 {
     const uchar *s1, *s2;
 
     s1 = v1;
     s2 = v2;
+    if (WORD((uint64)s1 ^ (uint64)s2))
+    {
+        while (n > 0 && !WORD(s1) && *s1 == *s2)
+            n--, s1++, s2++;
+        // skip the equal words; a differing one is left for
+        // the byte loop to find the first differing byte in.
+        if (WORD(s1))
+            for (; n >= 8 && *(uint64*)s1 == *(uint64*)s2; n -= 8)
+                s1 += 8, s2 += 8;
+    }
     while (n-- > 0)
     {
         if (*s1 != *s2)
@@ -27,30 +70,118 @@ int memcmp(const void* v1, const void* v2, uint n)
     return 0;
 }
 
+// 按字复制内存，正确处理重叠区域
 void* memmove(void* dst, const void* src, uint n)
 {
     const char* s;
     char*       d;
+    int         words;
 
     if (n == 0)
         return dst;
 
-    s = src;
-    d = dst;
+    s     = src;
+    d     = dst;
+    words = WORD((uint64)s ^ (uint64)d);
     if (s < d && s + n > d)
     {
+        // copy backwards, from the end.
         s += n;
         d += n;
+        if (words)
+        {
+            while (n > 0 && !WORD(d))
+                *--d = *--s, n--;
+            for (; n >= 64; n -= 64)
+            {
+                d -= 64, s -= 64;
+                ((uint64*)d)[7] = ((uint64*)s)[7];
+                ((uint64*)d)[6] = ((uint64*)s)[6];
+                ((uint64*)d)[5] = ((uint64*)s)[5];
+                ((uint64*)d)[4] = ((uint64*)s)[4];
+                ((uint64*)d)[3] = ((uint64*)s)[3];
+                ((uint64*)d)[2] = ((uint64*)s)[2];
+                ((uint64*)d)[1] = ((uint64*)s)[1];
+                ((uint64*)d)[0] = ((uint64*)s)[0];
+            }
+            for (; n >= 8; n -= 8)
+            {
+                d -= 8, s -= 8;
+                *(uint64*)d = *(uint64*)s;
+            }
+        }
         while (n-- > 0)
             *--d = *--s;
     }
     else
+    {
+        if (words)
+        {
+            while (n > 0 && !WORD(d))
+                *d++ = *s++, n--;
+            for (; n >= 64; n -= 64, d += 64, s += 64)
+            {
+                ((uint64*)d)[0] = ((uint64*)s)[0];
+                ((uint64*)d)[1] = ((uint64*)s)[1];
+                ((uint64*)d)[2] = ((uint64*)s)[2];
+                ((uint64*)d)[3] = ((uint64*)s)[3];
+                ((uint64*)d)[4] = ((uint64*)s)[4];
+                ((uint64*)d)[5] = ((uint64*)s)[5];
+                ((uint64*)d)[6] = ((uint64*)s)[6];
+                ((uint64*)d)[7] = ((uint64*)s)[7];
+            }
+            for (; n >= 8; n -= 8, d += 8, s += 8)
+                *(uint64*)d = *(uint64*)s;
+        }
         while (n-- > 0)
             *d++ = *s++;
+    }
 
     return dst;
 }
 
+// Zero the page-aligned page at pa, with none of memset()'s
+// alignment checks.
+// 清零一整页
+void pgzero(void* pa)
+{
+    uint64* w = (uint64*)pa;
+    uint64* e = w + PGSIZE / 8;
+
+    for (; w < e; w += 8)
+    {
+        w[0] = 0;
+        w[1] = 0;
+        w[2] = 0;
+        w[3] = 0;
+        w[4] = 0;
+        w[5] = 0;
+        w[6] = 0;
+        w[7] = 0;
+    }
+}
+
+// Copy the page-aligned page at src to the one at dst.
+// 复制一整页
+void pgcopy(void* dst, const void* src)
+{
+    uint64*       d = (uint64*)dst;
+    const uint64* s = (const uint64*)src;
+    uint64*       e = d + PGSIZE / 8;
+
+    for (; d < e; d += 8, s += 8)
+    {
+        d[0] = s[0];
+        d[1] = s[1];
+        d[2] = s[2];
+        d[3] = s[3];
+        d[4] = s[4];
+        d[5] = s[5];
+        d[6] = s[6];
+        d[7] = s[7];
+    }
+}
+
 // memcpy exists to placate GCC.  Use memmove.
 void* memcpy(void* dst, const void* src, uint n)
 {
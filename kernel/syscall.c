@@ -5,6 +5,8 @@
 #include "spinlock.h"
 #include "proc.h"
 #include "syscall.h"
+#include "sysstat.h"
+#include "sysring.h"
 #include "defs.h"
 
 // Fetch the uint64 at addr from the current process.
@@ -102,6 +104,29 @@ extern uint64 sys_unlink(void);
 extern uint64 sys_link(void);
 extern uint64 sys_mkdir(void);
 extern uint64 sys_close(void);
+extern uint64 sys_fsync(void);
+extern uint64 sys_fcntl(void);
+extern uint64 sys_vmsplice(void);
+extern uint64 sys_mmap(void);
+extern uint64 sys_munmap(void);
+extern uint64 sys_trace(void);
+extern uint64 sys_sysstat(void);
+extern uint64 sys_readv(void);
+extern uint64 sys_writev(void);
+extern uint64 sys_pread(void);
+extern uint64 sys_pwrite(void);
+extern uint64 sys_getdents(void);
+extern uint64 sys_clone(void);
+extern uint64 sys_join(void);
+extern uint64 sys_futex(void);
+extern uint64 sys_setsched(void);
+extern uint64 sys_spawn(void);
+extern uint64 sys_prof(void);
+extern uint64 sys_sysinfo(void);
+extern uint64 sys_procinfo(void);
+extern uint64 sys_ringenter(void);
+extern uint64 sys_poll(void);
+extern uint64 sys_stat(void);
 
 // An array mapping syscall numbers from syscall.h
 // to the function that handles the system call.
@@ -112,9 +137,170 @@ static uint64 (*syscalls[])(void) = {
     [SYS_chdir] sys_chdir, [SYS_dup] sys_dup,       [SYS_getpid] sys_getpid, [SYS_sbrk] sys_sbrk,
     [SYS_sleep] sys_sleep, [SYS_uptime] sys_uptime, [SYS_open] sys_open,     [SYS_write] sys_write,
     [SYS_mknod] sys_mknod, [SYS_unlink] sys_unlink, [SYS_link] sys_link,     [SYS_mkdir] sys_mkdir,
-    [SYS_close] sys_close,
+    [SYS_close] sys_close, [SYS_fsync] sys_fsync,   [SYS_fcntl] sys_fcntl,
+    [SYS_vmsplice] sys_vmsplice, [SYS_mmap] sys_mmap, [SYS_munmap] sys_munmap,
+    [SYS_trace] sys_trace, [SYS_sysstat] sys_sysstat,
+    [SYS_readv] sys_readv, [SYS_writev] sys_writev, [SYS_pread] sys_pread, [SYS_pwrite] sys_pwrite,
+    [SYS_getdents] sys_getdents,
+    [SYS_clone] sys_clone, [SYS_join] sys_join, [SYS_futex] sys_futex,
+    [SYS_setsched] sys_setsched,
+    [SYS_spawn] sys_spawn,
+    [SYS_prof] sys_prof,
+    [SYS_sysinfo] sys_sysinfo,
+    [SYS_procinfo] sys_procinfo,
+    [SYS_ringenter] sys_ringenter,
+    [SYS_poll] sys_poll,
+    [SYS_stat] sys_stat,
 };
 
+// System call names, for tracing and sysstat().
+static char* syscallnames[] = {
+    [SYS_fork] "fork",   [SYS_exit] "exit",     [SYS_wait] "wait",     [SYS_pipe] "pipe",
+    [SYS_read] "read",   [SYS_kill] "kill",     [SYS_exec] "exec",     [SYS_fstat] "fstat",
+    [SYS_chdir] "chdir", [SYS_dup] "dup",       [SYS_getpid] "getpid", [SYS_sbrk] "sbrk",
+    [SYS_sleep] "sleep", [SYS_uptime] "uptime", [SYS_open] "open",     [SYS_write] "write",
+    [SYS_mknod] "mknod", [SYS_unlink] "unlink", [SYS_link] "link",     [SYS_mkdir] "mkdir",
+    [SYS_close] "close", [SYS_fsync] "fsync",   [SYS_fcntl] "fcntl",
+    [SYS_vmsplice] "vmsplice", [SYS_mmap] "mmap", [SYS_munmap] "munmap",
+    [SYS_trace] "trace", [SYS_sysstat] "sysstat",
+    [SYS_readv] "readv", [SYS_writev] "writev", [SYS_pread] "pread", [SYS_pwrite] "pwrite",
+    [SYS_getdents] "getdents",
+    [SYS_clone] "clone", [SYS_join] "join", [SYS_futex] "futex",
+    [SYS_setsched] "setsched",
+    [SYS_spawn] "spawn",
+    [SYS_prof] "prof",
+    [SYS_sysinfo] "sysinfo",
+    [SYS_procinfo] "procinfo",
+    [SYS_ringenter] "ringenter",
+    [SYS_poll] "poll",
+    [SYS_stat] "stat",
+};
+
+// Counts and latencies of every system call, kept by
+// syscall() without a lock, like the other statistics.
+static struct sysstat sysstats[NELEM(syscalls)];
+
+// Add a call of num that took dt time units to its statistics.
+// 记录一次系统调用的次数与延迟
+static void sysaccount(int num, uint64 dt)
+{
+    struct sysstat* st = &sysstats[num];
+    int             b  = 0;
+
+    while (b < NSYSHIST - 1 && (dt >> (b + 1)) != 0)
+        b++;
+    __sync_fetch_and_add(&st->count, 1);
+    __sync_fetch_and_add(&st->time, dt);
+    __sync_fetch_and_add(&st->hist[b], 1);
+}
+
+// Copy the statistics of up to n system calls, in order of
+// number, to the user array at addr.
+// Returns the number copied, or -1 on a bad address.
+// 将系统调用统计信息复制到用户空间
+int syscallstats(uint64 addr, int n)
+{
+    struct proc*   p = myproc();
+    struct sysstat st;
+    int            num, i = 0;
+
+    for (num = 1; num < NELEM(syscalls) && i < n; num++)
+    {
+        if (syscalls[num] == 0)
+            continue;
+        st = sysstats[num];
+        safestrcpy(st.name, syscallnames[num], sizeof(st.name));
+        if (copyout(p->pagetable, addr + i * sizeof(st), (char*)&st, sizeof(st)) < 0)
+            return -1;
+        i++;
+    }
+    return i;
+}
+
+// Run system call num, with its arguments in p->trapframe,
+// keeping its statistics. Returns its return value.
+// 执行系统调用 num 并记录统计信息
+static uint64 runsyscall(struct proc* p, int num)
+{
+    uint64 t0 = r_time(), r;
+
+    r = syscalls[num]();
+    sysaccount(num, r_time() - t0);
+    if (p->tracemask & (1L << num))
+        printf("%d: syscall %s -> %d\n", p->pid, syscallnames[num], (int)r);
+    return r;
+}
+
+// 判断系统调用能否放入系统调用环
+static int ringable(int num)
+{
+    return num == SYS_read || num == SYS_write || num == SYS_fstat || num == SYS_open || num == SYS_close;
+}
+
+// Run up to n of the system calls queued in the ring at
+// USYSRING (see sysring.h), in order, through syscalls[] with
+// each one's arguments put in the trapframe in turn, and post
+// their results. Stops early at an empty submission ring, a
+// full completion ring or a kill. Threads sharing the page
+// table share the ring, and must not enter it at once. Returns
+// the number of calls run, or -1.
+// 依次执行系统调用环中排队的至多 n 个系统调用并放入完成项
+int ringenter(int n)
+{
+    struct proc*      p = myproc();
+    struct trapframe* tf = p->trapframe;
+    struct sysring*   r;
+    struct sqe        e;
+    struct cqe*       c;
+    uint64            saved[6];
+    uint              head, tail;
+    int               i;
+
+    if ((r = (struct sysring*)walkaddr(p->pagetable, USYSRING)) == 0)
+        return -1;
+    saved[0] = tf->a0;
+    saved[1] = tf->a1;
+    saved[2] = tf->a2;
+    saved[3] = tf->a3;
+    saved[4] = tf->a4;
+    saved[5] = tf->a5;
+    // the page is the user's to scribble on, so each entry is
+    // copied before it is used, and the indices only ever pick
+    // an entry modulo NSQE.
+    tail = __atomic_load_n(&r->sqtail, __ATOMIC_ACQUIRE);
+    head = r->sqhead;
+    for (i = 0; i < n && head != tail && !killed(p); i++)
+    {
+        if (r->cqtail - __atomic_load_n(&r->cqhead, __ATOMIC_ACQUIRE) >= NSQE)
+            break;
+        e = r->sq[head % NSQE];
+        __atomic_store_n(&r->sqhead, ++head, __ATOMIC_RELEASE);
+
+        c      = &r->cq[r->cqtail % NSQE];
+        c->tag = e.tag;
+        if (ringable(e.num))
+        {
+            tf->a0 = e.args[0];
+            tf->a1 = e.args[1];
+            tf->a2 = e.args[2];
+            tf->a3 = e.args[3];
+            tf->a4 = e.args[4];
+            tf->a5 = e.args[5];
+            c->ret = runsyscall(p, e.num);
+        }
+        else
+            c->ret = -1;
+        __atomic_store_n(&r->cqtail, r->cqtail + 1, __ATOMIC_RELEASE);
+    }
+    tf->a0 = saved[0];
+    tf->a1 = saved[1];
+    tf->a2 = saved[2];
+    tf->a3 = saved[3];
+    tf->a4 = saved[4];
+    tf->a5 = saved[5];
+    return i;
+}
+
 // 系统调用入口函数 syscall()
 void syscall(void)
 {
@@ -126,7 +312,7 @@ void syscall(void)
     {
         // Use num to lookup the system call function for num, call it,
         // and store its return value in p->trapframe->a0
-        p->trapframe->a0 = syscalls[num]();
+        p->trapframe->a0 = runsyscall(p, num);
     }
     else
     {
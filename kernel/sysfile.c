@@ -15,6 +15,8 @@
 #include "sleeplock.h"
 #include "file.h"
 #include "fcntl.h"
+#include "uio.h"
+#include "poll.h"
 
 // 用于获取系统调用中文件描述符（fd）参数的辅助函数，将 fd 转换为对应的 struct file 指针
 static int argfd(int n, int* pfd, struct file** pf)
@@ -90,6 +92,78 @@ uint64 sys_write(void)
     return filewrite(f, p, n);
 }
 
+// Copy in the list of n buffers at user address addr for
+// readv() or writev(). Returns -1 if it is too long, or its
+// lengths add up to more than an int.
+static int argiov(uint64 addr, int n, struct iovec* iov)
+{
+    uint64 tot = 0;
+    int    i;
+
+    if (n < 0 || n > IOV_MAX || copyin(myproc()->pagetable, (char*)iov, addr, n * sizeof(*iov)) < 0)
+        return -1;
+    for (i = 0; i < n; i++)
+        if ((tot += iov[i].iov_len) > 0x7fffffff || iov[i].iov_len > 0x7fffffff)
+            return -1;
+    return 0;
+}
+
+uint64 sys_readv(void)
+{
+    struct file* f;
+    struct iovec iov[IOV_MAX];
+    int          n;
+    uint64       p;
+
+    argaddr(1, &p);
+    argint(2, &n);
+    if (argfd(0, 0, &f) < 0 || argiov(p, n, iov) < 0)
+        return -1;
+    return filereadv(f, iov, n);
+}
+
+uint64 sys_writev(void)
+{
+    struct file* f;
+    struct iovec iov[IOV_MAX];
+    int          n;
+    uint64       p;
+
+    argaddr(1, &p);
+    argint(2, &n);
+    if (argfd(0, 0, &f) < 0 || argiov(p, n, iov) < 0)
+        return -1;
+    return filewritev(f, iov, n);
+}
+
+uint64 sys_pread(void)
+{
+    struct file* f;
+    int          n, off;
+    uint64       p;
+
+    argaddr(1, &p);
+    argint(2, &n);
+    argint(3, &off);
+    if (argfd(0, 0, &f) < 0)
+        return -1;
+    return filepread(f, p, n, off);
+}
+
+uint64 sys_pwrite(void)
+{
+    struct file* f;
+    int          n, off;
+    uint64       p;
+
+    argaddr(1, &p);
+    argint(2, &n);
+    argint(3, &off);
+    if (argfd(0, 0, &f) < 0)
+        return -1;
+    return filepwrite(f, p, n, off);
+}
+
 uint64 sys_close(void)
 {
     int          fd;
@@ -102,6 +176,69 @@ uint64 sys_close(void)
     return 0;
 }
 
+// Wait until all completed file system calls, including
+// writes to fd, are on disk. With group commit an ordinary
+// write() may return before its transaction commits.
+uint64 sys_fsync(void)
+{
+    struct file* f;
+
+    if (argfd(0, 0, &f) < 0)
+        return -1;
+    log_sync();
+    return 0;
+}
+
+uint64 sys_fcntl(void)
+{
+    struct file* f;
+    int          cmd, arg;
+
+    argint(1, &cmd);
+    argint(2, &arg);
+    if (argfd(0, 0, &f) < 0)
+        return -1;
+    return filefcntl(f, cmd, arg);
+}
+
+uint64 sys_vmsplice(void)
+{
+    struct file* f;
+    int          n;
+    uint64       p;
+
+    argaddr(1, &p);
+    argint(2, &n);
+    if (argfd(0, 0, &f) < 0)
+        return -1;
+    return filesplice(f, p, n);
+}
+
+uint64 sys_mmap(void)
+{
+    struct file* f;
+    uint64       addr, len, off;
+    int          prot, flags;
+
+    argaddr(0, &addr);
+    argaddr(1, &len);
+    argint(2, &prot);
+    argint(3, &flags);
+    argaddr(5, &off);
+    if (argfd(4, 0, &f) < 0)
+        return -1;
+    return mmap(addr, len, prot, flags, f, off);
+}
+
+uint64 sys_munmap(void)
+{
+    uint64 addr, len;
+
+    argaddr(0, &addr);
+    argaddr(1, &len);
+    return munmap(addr, len);
+}
+
 uint64 sys_fstat(void)
 {
     struct file* f;
@@ -113,6 +250,94 @@ uint64 sys_fstat(void)
     return filestat(f, st);
 }
 
+// Fill the user struct stat at addr for path, without opening
+// it: the lookup goes through the directory cache, and the
+// in-memory inode answers without being locked once it has
+// been read in.
+// 按路径获取文件状态
+uint64 sys_stat(void)
+{
+    char          path[MAXPATH];
+    uint64        addr;   // user pointer to struct stat
+    struct inode* ip;
+    struct stat   st;
+
+    argaddr(1, &addr);
+    if (argstr(0, path, MAXPATH) < 0)
+        return -1;
+    // iput() may free an inode unlinked meanwhile.
+    begin_op();
+    if ((ip = namei(path)) == 0)
+    {
+        end_op();
+        return -1;
+    }
+    istat(ip, &st);
+    iput(ip);
+    end_op();
+    return copyout(myproc()->pagetable, addr, (char*)&st, sizeof(st));
+}
+
+// Read up to n entries of the directory open as fd, from the
+// file offset on, into the user array of struct dirstat at
+// addr, with the status of each entry's inode, so that a
+// listing needs no stat() per entry. The entries are read a
+// block at a time, and their inodes referenced before the
+// directory is unlocked, so none can be freed under us.
+// Returns the number read, 0 at the end of the directory.
+uint64 sys_getdents(void)
+{
+    struct file*   f;
+    struct inode*  ip[16];
+    struct dirent  de[16];
+    struct dirstat ds;
+    uint64         addr;
+    int            n, m, i, tot = 0;
+    uint           off;
+
+    argaddr(1, &addr);
+    argint(2, &n);
+    if (argfd(0, 0, &f) < 0 || n < 0 || f->type != FD_INODE || !f->readable)
+        return -1;
+
+    while (tot < n)
+    {
+        ilock(f->ip);
+        if (f->ip->type != T_DIR)
+        {
+            iunlock(f->ip);
+            return -1;
+        }
+        off = f->off;
+        m      = dirnext(f->ip, &off, de, ip, n - tot < NELEM(de) ? n - tot : NELEM(de));
+        f->off = off;
+        iunlock(f->ip);
+        if (m == 0)
+            break;
+
+        // ip[i] may be the last reference to an inode unlinked
+        // meanwhile, which iput() then frees.
+        begin_op();
+        for (i = 0; i < m; i++)
+        {
+            memset(&ds, 0, sizeof(ds));
+            memmove(ds.name, de[i].name, DIRSIZ);
+            istat(ip[i], &ds.st);
+            iput(ip[i]);
+            if (copyout(myproc()->pagetable, addr + (tot + i) * sizeof(ds), (char*)&ds, sizeof(ds)) < 0)
+            {
+                while (++i < m)
+                    iput(ip[i]);
+                end_op();
+                return -1;
+            }
+        }
+        end_op();
+        tot += m;
+    }
+    return tot;
+}
+
 // Create the path new as a link to the same inode as old.
 uint64 sys_link(void)
 {
@@ -168,23 +393,15 @@ bad:
 // Is the directory dp empty except for "." and ".." ?
 static int isdirempty(struct inode* dp)
 {
-    int           off;
+    uint          off = 2 * sizeof(struct dirent);
     struct dirent de;
 
-    for (off = 2 * sizeof(de); off < dp->size; off += sizeof(de))
-    {
-        if (readi(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
-            panic("isdirempty: readi");
-        if (de.inum != 0)
-            return 0;
-    }
-    return 1;
+    return dirnext(dp, &off, &de, 0, 1) == 0;
 }
 
 uint64 sys_unlink(void)
 {
     struct inode *ip, *dp;
-    struct dirent de;
     char          name[DIRSIZ], path[MAXPATH];
     uint          off;
 
@@ -216,9 +433,7 @@ uint64 sys_unlink(void)
         goto bad;
     }
 
-    memset(&de, 0, sizeof(de));
-    if (writei(dp, 0, (uint64)&de, off, sizeof(de)) != sizeof(de))
-        panic("unlink: writei");
+    dirunlink(dp, name, off);
     if (ip->type == T_DIR)
     {
         dp->nlink--;
@@ -370,6 +585,7 @@ uint64 sys_open(void)
     f->ip       = ip;
     f->readable = !(omode & O_WRONLY);
     f->writable = (omode & O_WRONLY) || (omode & O_RDWR);
+    f->nonblock = (omode & O_NONBLOCK) != 0;
 
     if ((omode & O_TRUNC) && ip->type == T_FILE)
     {
@@ -505,6 +721,73 @@ bad:
     return -1;
 }
 
+// spawn(path, argv, fds): start a child running path, as
+// fork() and exec() would, without copying the caller's
+// memory (see spawn()). fds is 0, or the user address of
+// three file descriptors for the child's 0, 1 and 2.
+// Returns the child's pid, or -1 if path does not exist.
+uint64 sys_spawn(void)
+{
+    char*         path;
+    char**        argv;
+    int           i, fds[3];
+    uint64        uargv, uarg, ufds;
+    struct inode* ip;
+    struct proc*  p = myproc();
+
+    argaddr(1, &uargv);
+    argaddr(2, &ufds);
+    if (ufds != 0)
+    {
+        if (copyin(p->pagetable, (char*)fds, ufds, sizeof(fds)) < 0)
+            return -1;
+        for (i = 0; i < 3; i++)
+            if (fds[i] >= NOFILE || (fds[i] >= 0 && p->ofile[fds[i]] == 0))
+                return -1;
+    }
+
+    if ((path = kmalloc(MAXPATH)) == 0)
+        return -1;
+    if ((argv = kmalloc(MAXARG * sizeof(char*))) == 0)
+    {
+        kmfree(path);
+        return -1;
+    }
+    memset(argv, 0, MAXARG * sizeof(char*));
+    if (argstr(0, path, MAXPATH) < 0)
+        goto bad;
+    for (i = 0;; i++)
+    {
+        if (i >= MAXARG)
+            goto bad;
+        if (fetchaddr(uargv + sizeof(uint64) * i, (uint64*)&uarg) < 0)
+            goto bad;
+        if (uarg == 0)
+            break;
+        if ((argv[i] = kalloc()) == 0 || fetchstr(uarg, argv[i], PGSIZE) < 0)
+            goto bad;
+    }
+
+    // fail here, where the caller can tell, if there is no
+    // such program.
+    begin_op();
+    if ((ip = namei(path)) == 0)
+    {
+        end_op();
+        goto bad;
+    }
+    iput(ip);
+    end_op();
+
+    if ((i = spawn(path, argv, ufds ? fds : 0)) < 0)
+        goto bad;
+    return i;
+
+bad:
+    spawnfree(path, argv);
+    return -1;
+}
+
 uint64 sys_pipe(void)
 {
     uint64       fdarray;   // user pointer to array of two integers
@@ -535,3 +818,49 @@ uint64 sys_pipe(void)
     }
     return 0;
 }
+
+// wait until one of the n files of the user's struct pollfd
+// array is ready for its events, or for timeout ticks, with a
+// negative timeout waiting for ever. returns the number of
+// entries with revents set, 0 on a timeout, or -1.
+uint64 sys_poll(void)
+{
+    struct pollfd fds[NOFILE];
+    struct proc*  p = myproc();
+    struct file*  f;
+    uint64        addr;
+    int           n, timeout, i, ready;
+    uint          seq, until;
+
+    argaddr(0, &addr);
+    argint(1, &n);
+    argint(2, &timeout);
+    if (n < 0 || n > NOFILE || copyin(p->pagetable, (char*)fds, addr, n * sizeof(fds[0])) < 0)
+        return -1;
+
+    until = readticks() + timeout;
+    seq   = pollstart();
+    for (;;)
+    {
+        ready = 0;
+        for (i = 0; i < n; i++)
+        {
+            fds[i].revents = 0;
+            if (fds[i].fd < 0)
+                continue;
+            if (fds[i].fd >= NOFILE || (f = p->ofile[fds[i].fd]) == 0)
+                fds[i].revents = POLLNVAL;
+            else
+                fds[i].revents = filepoll(f) & (fds[i].events | POLLERR | POLLHUP);
+            if (fds[i].revents)
+                ready++;
+        }
+        if (ready > 0 || timeout == 0 || pollwait(&seq, until, timeout < 0) < 0)
+            break;
+    }
+    pollstop();
+
+    if (copyout(p->pagetable, addr, (char*)fds, n * sizeof(fds[0])) < 0)
+        return -1;
+    return ready;
+}
@@ -0,0 +1,25 @@
+// System-wide usage, as returned by sysinfo().
+struct sysinfo
+{
+    uint64 freemem;    // 空闲物理内存（字节）
+    uint64 totalmem;   // 分配器管理的物理内存总量（字节）
+    uint64 nproc;      // 非 UNUSED 状态的进程数（含线程）
+    uint64 nfile;      // 打开的文件数
+    uint64 ncpu;       // 运行调度器的 CPU 数
+    uint64 merged;     // 合并相同内容的只读页省下的内存（字节）
+};
+
+// One process, as returned by procinfo().
+struct procinfo
+{
+    int    pid;
+    int    ppid;       // 父进程 pid，没有则为 0
+    int    state;      // proc.h 中的 enum procstate
+    int    sclass;     // 调度类，fcntl.h 中的 SCHED_*
+    int    nice;
+    int    thread;     // 非 0 表示 clone() 创建的线程
+    uint64 sz;         // 用户内存大小（字节）
+    uint64 rss;        // 已映射的用户页数，线程共享其进程的计数
+    uint64 cputime;    // 运行时间（r_time() 单位）
+    char   name[16];
+};
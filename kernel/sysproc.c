@@ -5,6 +5,7 @@
 #include "memlayout.h"
 #include "spinlock.h"
 #include "proc.h"
+#include "sysinfo.h"
 
 uint64 sys_exit(void)
 {
@@ -61,7 +62,7 @@ uint64 sys_sleep(void)
             release(&tickslock);
             return -1;
         }
-        sleep(&ticks, &tickslock);
+        tsleep(ticks0 + n);
     }
     release(&tickslock);
     return 0;
@@ -79,10 +80,123 @@ uint64 sys_kill(void)
 // since start.
 uint64 sys_uptime(void)
 {
-    uint xticks;
+    return readticks();
+}
 
-    acquire(&tickslock);
-    xticks = ticks;
-    release(&tickslock);
-    return xticks;
+// set the mask of system calls to log for this process
+// and the children it forks from now on.
+uint64 sys_trace(void)
+{
+    uint64 mask;
+
+    argaddr(0, &mask);
+    myproc()->tracemask = mask;
+    return 0;
+}
+
+// copy per-system-call statistics to user space.
+uint64 sys_sysstat(void)
+{
+    uint64 addr;
+    int    n;
+
+    argaddr(0, &addr);
+    argint(1, &n);
+    return syscallstats(addr, n);
+}
+
+// start or stop the sampling profiler, or read its samples.
+uint64 sys_prof(void)
+{
+    uint64 addr;
+    int    op, n;
+
+    argint(0, &op);
+    argaddr(1, &addr);
+    argint(2, &n);
+    return prof(op, addr, n);
+}
+
+// copy system-wide memory and table usage to user space.
+uint64 sys_sysinfo(void)
+{
+    struct sysinfo si;
+    uint64         addr, nfree, ntotal;
+
+    argaddr(0, &addr);
+    kmeminfo(&nfree, &ntotal);
+    si.freemem  = nfree * PGSIZE;
+    si.totalmem = ntotal * PGSIZE;
+    si.nproc    = nproc();
+    si.nfile    = filecount();
+    si.ncpu     = ncpu();
+    si.merged   = ksmsaved() * PGSIZE;
+    return copyout(myproc()->pagetable, addr, (char*)&si, sizeof(si));
+}
+
+// copy a struct procinfo for each process in use to user space.
+uint64 sys_procinfo(void)
+{
+    uint64 addr;
+    int    n;
+
+    argaddr(0, &addr);
+    argint(1, &n);
+    return procinfo(addr, n);
+}
+
+// run up to n of the system calls queued in the process's
+// system call ring.
+uint64 sys_ringenter(void)
+{
+    int n;
+
+    argint(0, &n);
+    return ringenter(n);
+}
+
+// start a thread running fn(arg) on the user stack whose top
+// is stack, sharing this process's memory.
+uint64 sys_clone(void)
+{
+    uint64 fn, arg, stack;
+
+    argaddr(0, &fn);
+    argaddr(1, &arg);
+    argaddr(2, &stack);
+    return clone(fn, arg, stack);
+}
+
+// wait for a thread of this process to exit.
+uint64 sys_join(void)
+{
+    int    tid;
+    uint64 addr;
+
+    argint(0, &tid);
+    argaddr(1, &addr);
+    return join(tid, addr);
+}
+
+// wait on or wake the waiters on a user int.
+uint64 sys_futex(void)
+{
+    uint64 addr;
+    int    op, val;
+
+    argaddr(0, &addr);
+    argint(1, &op);
+    argint(2, &val);
+    return futex(addr, op, val);
+}
+
+// set the scheduling class and nice value of a process.
+uint64 sys_setsched(void)
+{
+    int pid, sclass, nice;
+
+    argint(0, &pid);
+    argint(1, &sclass);
+    argint(2, &nice);
+    return setsched(pid, sclass, nice);
 }
@@ -0,0 +1,35 @@
+// The system call ring of a process, a page shared with user
+// code at USYSRING. User code queues system calls at sqtail
+// and calls ringenter(n), which runs up to n of them in order,
+// from sqhead, posting each result at cqtail for user code to
+// take from cqhead. The indices run freely; entry i of a ring
+// is at i % NSQE. Only SYS_read, SYS_write, SYS_fstat, SYS_open
+// and SYS_close may be queued; other calls complete with -1.
+#define NSQE 32   // 每个环的项数
+
+// A queued system call.
+struct sqe
+{
+    uint64 tag;       // 原样带到完成项，供调用者识别
+    uint64 args[6];   // 参数，即 a0-a5
+    int    num;       // 系统调用号 SYS_*
+    int    pad;
+};
+
+// A completed system call.
+struct cqe
+{
+    uint64 tag;   // 对应提交项的 tag
+    int    ret;   // 系统调用的返回值
+    int    pad;
+};
+
+struct sysring
+{
+    uint       sqhead;      // 内核取下一个提交项的位置，由内核写
+    uint       sqtail;      // 用户放下一个提交项的位置，由用户写
+    uint       cqhead;      // 用户取下一个完成项的位置，由用户写
+    uint       cqtail;      // 内核放下一个完成项的位置，由内核写
+    struct sqe sq[NSQE];
+    struct cqe cq[NSQE];
+};
@@ -0,0 +1,13 @@
+#define NSYSHIST 16   // 系统调用延迟直方图的桶数
+
+// Statistics of one system call, as returned by sysstat().
+// Times are in units of the time CSR (10 MHz under qemu).
+// hist[i] counts the calls that took from 2^i up to 2^(i+1)
+// units; the last bucket also counts all longer ones.
+struct sysstat
+{
+    char   name[16];          // Name of the system call
+    uint64 count;             // Number of calls made
+    uint64 time;              // Total time spent in them
+    uint64 hist[NSYSHIST];    // Latency histogram
+};
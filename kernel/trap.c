@@ -3,11 +3,29 @@
 #include "memlayout.h"
 #include "riscv.h"
 #include "spinlock.h"
+#include "seqlock.h"
 #include "proc.h"
 #include "defs.h"
 
 struct spinlock tickslock;
 uint            ticks;
+struct seqlock  tickseq;   // lets readticks() read ticks without tickslock
+struct ushared* ushared;   // mapped read-only at USHARED in every process
+
+// CPU 0 alone keeps ticks, with a timer deadline at every tick;
+// the other CPUs arm their timers only for the end of the
+// running process's time slice, and not at all when idle.
+// tickslock protects tickwait and tickwake.
+static uint64 nexttick;      // r_time() of CPU 0's next tick
+static int    tickwait;      // is anyone in tsleep()?
+static uint   tickwake;      // if so, the earliest ticks one of them waits for
+
+// poll() sleeps on &ticks too, so that its timeout comes with
+// the clock; pollwake() moves pollseq on and wakes it after a
+// change that may have made a pipe or the console ready.
+// tickslock protects pollseq.
+static uint pollseq;
+static int  npoll;   // processes between pollstart() and pollstop()
 
 extern char trampoline[], uservec[], userret[];
 
@@ -19,12 +37,18 @@ extern int devintr();
 void trapinit(void)
 {
     initlock(&tickslock, "time");
+    initseqlock(&tickseq, "time");
+    if ((ushared = (struct ushared*)kalloc()) == 0)
+        panic("trapinit");
+    memset(ushared, 0, PGSIZE);
 }
 
 // set up to take exceptions and traps while in the kernel.
 void trapinithart(void)
 {
     w_stvec((uint64)kernelvec);
+    if (cpuid() == 0)
+        nexttick = r_time() + TICKCYCLES;
 }
 
 //
@@ -68,6 +92,11 @@ void usertrap(void)
     {
         // ok
     }
+    else if ((r_scause() == 13 || r_scause() == 15) &&
+             vmfault(p->pagetable, r_stval(), r_scause() == 15) == 0)
+    {
+        // page fault on a copy-on-write or not yet allocated page.
+    }
     else
     {
         printf("usertrap(): unexpected scause %p pid=%d\n", r_scause(), p->pid);
@@ -78,9 +107,10 @@ void usertrap(void)
     if (killed(p))
         exit(-1);
 
-    // give up the CPU if this is a timer interrupt.
+    // the time slice is over: give up the CPU if another
+    // process should have it.
     if (which_dev == 2)
-        yield();
+        preempt();
 
     usertrapret();
 }
@@ -124,10 +154,11 @@ void usertrapret(void)
     uint64 satp = MAKE_SATP(p->pagetable);
 
     // jump to userret in trampoline.S at the top of memory, which
-    // switches to the user page table, restores user registers,
-    // and switches to user mode with sret.
+    // switches to the user page table, restores user registers
+    // from the trapframe at TFRAME(p->thread), and switches to
+    // user mode with sret.
     uint64 trampoline_userret = TRAMPOLINE + (userret - trampoline);
-    ((void (*)(uint64))trampoline_userret)(satp);
+    ((void (*)(uint64, uint64))trampoline_userret)(satp, TFRAME(p->thread));
 }
 
 // interrupts and exceptions from kernel code go here via kernelvec,
@@ -138,12 +169,36 @@ void kerneltrap()
     uint64 sepc      = r_sepc();
     uint64 sstatus   = r_sstatus();
     uint64 scause    = r_scause();
+    uint64 stval     = r_stval();
+    int    r;
 
     if ((sstatus & SSTATUS_SPP) == 0)
         panic("kerneltrap: not from supervisor mode");
     if (intr_get() != 0)
         panic("kerneltrap: interrupts enabled");
 
+    // ucopy() and ucopystr() run with SUM set, and swtch()
+    // does not save sstatus: whatever runs before the
+    // interrupted code resumes, on this CPU or after a yield,
+    // must not reach user memory by mistake. The
+    // w_sstatus(sstatus) on the way out sets SUM back.
+    w_sstatus(sstatus & ~SSTATUS_SUM);
+
+    // a page fault in ucopy() or ucopystr(), on user memory
+    // that copyin() or copyout() reach through the process's
+    // kernel page table: fault the page in, as usertrap()
+    // would, and retry, or make the copy fail. The interrupted
+    // code's interrupts go back on, since vmfault() may sleep.
+    if ((scause == 13 || scause == 15) && sepc >= (uint64)ucopystart && sepc < (uint64)ucopyend)
+    {
+        if (sstatus & SSTATUS_SPIE)
+            intr_on();
+        r = ukmapfault(stval, scause == 15);
+        intr_off();
+        w_sepc(r == 0 ? sepc : (uint64)ucopyfault);
+        w_sstatus(sstatus);
+        return;
+    }
 
     // 检查中断来自哪里
     // 1: UART/DISK
@@ -156,9 +211,10 @@ void kerneltrap()
         panic("kerneltrap");
     }
 
-    // give up the CPU if this is a timer interrupt.
+    // the time slice is over: give up the CPU if another
+    // process should have it.
     if (which_dev == 2 && myproc() != 0 && myproc()->state == RUNNING)
-        yield();
+        preempt();
 
     // the yield() may have caused some traps to occur,
     // so restore trap registers for use by kernelvec.S's sepc instruction.
@@ -166,14 +222,153 @@ void kerneltrap()
     w_sstatus(sstatus);
 }
 
+// Count the ticks due by now, and wake the sleepers in tsleep()
+// if the earliest of them is due. Called on CPU 0 only.
 void clockintr()
 {
+    uint64 now = r_time();
+
+    if (now < nexttick)
+        return;
+    acquire(&tickslock);
+    writeseqbegin(&tickseq);
+    while (nexttick <= now)
+    {
+        ticks++;
+        nexttick += TICKCYCLES;
+    }
+    ushared->ticks = ticks;
+    writeseqend(&tickseq);
+    if (tickwait && (int)(ticks - tickwake) >= 0)
+    {
+        tickwait = 0;
+        wakeup(&ticks);
+    }
+    release(&tickslock);
+}
+
+// Return ticks, for readers that do not also sleep on it and
+// so need not take tickslock.
+// 不加 tickslock 读取 ticks
+uint readticks(void)
+{
+    uint s, t;
+
+    do
+    {
+        s = readseqbegin(&tickseq);
+        t = ticks;
+    } while (readseqretry(&tickseq, s));
+    return t;
+}
+
+// Sleep on &ticks until ticks reaches until, or until
+// woken otherwise; callers check ticks again in a loop.
+// Caller must hold tickslock.
+// 在 &ticks 上睡眠，直到 ticks 到达 until
+void tsleep(uint until)
+{
+    if (!tickwait || (int)(until - tickwake) < 0)
+        tickwake = until;
+    tickwait = 1;
+    sleep(&ticks, &tickslock);
+}
+
+// Start a poll(), before the files are first looked at, so
+// that no pollwake() after that is missed. Returns the
+// sequence number for pollwait().
+// 开始一次 poll，返回当前的序号
+uint pollstart(void)
+{
+    uint seq;
+
+    __atomic_fetch_add(&npoll, 1, __ATOMIC_SEQ_CST);
     acquire(&tickslock);
-    ticks++;
+    seq = pollseq;
+    release(&tickslock);
+    return seq;
+}
+
+// 结束一次 poll
+void pollstop(void)
+{
+    __atomic_fetch_sub(&npoll, 1, __ATOMIC_SEQ_CST);
+}
+
+// Sleep until pollwake() is called after *seq was taken, or
+// until ticks reaches until unless forever is set, and take a
+// new *seq. Returns 0 to look at the files again, or -1 if the
+// time is up or the process was killed.
+// 睡眠直到有文件可能就绪、超时或被杀死
+int pollwait(uint* seq, uint until, int forever)
+{
+    int r = 0;
+
+    acquire(&tickslock);
+    while (*seq == pollseq)
+    {
+        if (killed(myproc()) || (!forever && (int)(ticks - until) >= 0))
+        {
+            r = -1;
+            break;
+        }
+        if (forever)
+            sleep(&ticks, &tickslock);
+        else
+            tsleep(until);
+    }
+    *seq = pollseq;
+    release(&tickslock);
+    return r;
+}
+
+// Wake the processes in poll(), after a pipe or the console
+// changed. Cheap when nobody polls; may be called from
+// interrupts, with the pipe or console lock held or not.
+// 唤醒 poll 中的进程
+void pollwake(void)
+{
+    if (__atomic_load_n(&npoll, __ATOMIC_SEQ_CST) == 0)
+        return;
+    acquire(&tickslock);
+    pollseq++;
     wakeup(&ticks);
     release(&tickslock);
 }
 
+// Arm this CPU's timer for the earliest thing it must wake
+// for: the end of the running process's time slice, on CPU 0
+// the next tick, and the next sample while profiling. With
+// none, leave it disarmed.
+// Interrupts must be off.
+// 按本 CPU 下一个截止时刻设置定时器
+void timerarm(void)
+{
+    struct cpu* c = mycpu();
+    uint64      when, prof;
+
+    // runq_kick() may have ended the slice of a process
+    // that had already left the CPU.
+    if (c->proc == 0)
+        c->sliceend = 0;
+    when = c->sliceend;
+
+    if (cpuid() == 0 && (when == 0 || nexttick < when))
+        when = nexttick;
+    if ((prof = profdeadline()) != 0 && (when == 0 || prof < when))
+        when = prof;
+    *(volatile uint64*)CLINT_MTIMECMP(cpuid()) = when ? when : ~0ULL;
+}
+
+// Make CPU id's timer fire at once, to wake it from wfi in
+// scheduler(). It re-arms the timer when it handles the
+// interrupt.
+// 让 CPU id 的定时器立即触发，将其从 wfi 中唤醒
+void timerkick(int id)
+{
+    *(volatile uint64*)CLINT_MTIMECMP(id) = 0;
+}
+
 // check if it's an external interrupt or software interrupt,
 // and handle it.
 // returns 2 if timer interrupt,
@@ -195,9 +390,9 @@ int devintr()
         {
             uartintr();
         }
-        else if (irq == VIRTIO0_IRQ)
+        else if (irq == VIRTIO0_IRQ || irq == VIRTIO1_IRQ)
         {
-            virtio_disk_intr();
+            virtio_disk_intr(irq);
         }
         else if (irq)
         {
@@ -217,19 +412,25 @@ int devintr()
     else if (scause == 0x8000000000000001L)
     {
         // software interrupt from a machine-mode timer interrupt,
-        // forwarded by timervec in kernelvec.S.
-        // 仅在 CPU 0 上调用 clockintr()，处理定时器中断
-        if (cpuid() == 0)
-        {
-            clockintr();
-        }
+        // forwarded by timervec in kernelvec.S, which has
+        // disarmed the timer.
+        struct cpu* c = mycpu();
 
         // acknowledge the software interrupt by clearing
         // the SSIP bit in sip.
         // 清除中断状态
         w_sip(r_sip() & ~2);
 
-        return 2;
+        // 仅在 CPU 0 上调用 clockintr()，维护全局 ticks
+        if (cpuid() == 0)
+            clockintr();
+        proftick();
+        timerarm();
+
+        // only the end of a time slice makes the process yield.
+        if (c->sliceend && r_time() >= c->sliceend)
+            return 2;
+        return 1;
     }
     else
     {
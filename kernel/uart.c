@@ -40,7 +40,8 @@
 
 // the transmit output buffer.
 struct spinlock uart_tx_lock;
-#define UART_TX_BUF_SIZE 32
+#define UART_TX_BUF_SIZE PGSIZE
+#define UART_FIFO_SIZE   16   // bytes the 16550 takes once THR reports empty
 char   uart_tx_buf[UART_TX_BUF_SIZE];
 uint64 uart_tx_w;   // write next to uart_tx_buf[uart_tx_w % UART_TX_BUF_SIZE]
 uint64 uart_tx_r;   // read next from uart_tx_buf[uart_tx_r % UART_TX_BUF_SIZE]
@@ -86,15 +87,20 @@ void uartinit(void)
     initlock(&uart_tx_lock, "uart");
 }
 
-// add a character to the output buffer and tell the
+// add n bytes from s to the output buffer and tell the
 // UART to start sending if it isn't already.
-// blocks if the output buffer is full.
+// blocks while the output buffer is full, unless nonblock
+// is set, in which case it queues only what fits.
+// returns the number of bytes queued, fewer than n only
+// if nonblock or if the process was killed.
 // because it may block, it can't be called
 // from interrupts; it's only suitable for use
 // by write().
-// 将字符添加到发送缓冲区，并在可能时触发发送。
-void uartputc(int c)
+// 将 n 个字节添加到发送缓冲区，并在可能时触发发送。
+int uartwrite(char* s, int n, int nonblock)
 {
+    int i = 0;
+
     acquire(&uart_tx_lock);
 
     if (panicked)
@@ -102,16 +108,26 @@ void uartputc(int c)
         for (;;)
             ;
     }
-    while (uart_tx_w == uart_tx_r + UART_TX_BUF_SIZE)
+    while (i < n)
     {
-        // buffer is full.
-        // wait for uartstart() to open up space in the buffer.
-        sleep(&uart_tx_r, &uart_tx_lock);
+        if (uart_tx_w == uart_tx_r + UART_TX_BUF_SIZE)
+        {
+            // buffer is full.
+            if (nonblock || killed(myproc()))
+                break;
+            // wait for uartstart() to open up space in the buffer.
+            sleep(&uart_tx_r, &uart_tx_lock);
+            continue;
+        }
+        while (i < n && uart_tx_w < uart_tx_r + UART_TX_BUF_SIZE)
+        {
+            uart_tx_buf[uart_tx_w % UART_TX_BUF_SIZE] = s[i++];
+            uart_tx_w += 1;
+        }
+        uartstart();
     }
-    uart_tx_buf[uart_tx_w % UART_TX_BUF_SIZE] = c;
-    uart_tx_w += 1;
-    uartstart();
     release(&uart_tx_lock);
+    return i;
 }
 
 
@@ -138,40 +154,42 @@ void uartputc_sync(int c)
     pop_off();
 }
 
-// if the UART is idle, and a character is waiting
-// in the transmit buffer, send it.
+// if the UART is idle, and characters are waiting in
+// the transmit buffer, send as many as its FIFO holds.
 // caller must hold uart_tx_lock.
 // called from both the top- and bottom-half.
-// 从发送缓冲区中取出字符并发送到 UART。可在中断或非中断上下文中调用，需持有 uart_tx_lock。
+// 从发送缓冲区中取出一批字符填入 UART 的 FIFO。可在中断或非中断上下文中调用，需持有 uart_tx_lock。
 void uartstart()
 {
-    while (1)
+    int i;
+
+    // 缓冲区空
+    if (uart_tx_w == uart_tx_r)
     {
-        // 缓冲区空
-        if (uart_tx_w == uart_tx_r)
-        {
-            // transmit buffer is empty.
-            return;
-        }
+        // transmit buffer is empty.
+        return;
+    }
 
-        // UART 忙
-        if ((ReadReg(LSR) & LSR_TX_IDLE) == 0)
-        {
-            // the UART transmit holding register is full,
-            // so we cannot give it another byte.
-            // it will interrupt when it's ready for a new byte.
-            return;
-        }
+    // UART 忙
+    if ((ReadReg(LSR) & LSR_TX_IDLE) == 0)
+    {
+        // the UART transmit FIFO still holds bytes,
+        // so we cannot tell how many more it has room for.
+        // it will interrupt when it has emptied.
+        return;
+    }
 
-        int c = uart_tx_buf[uart_tx_r % UART_TX_BUF_SIZE];
+    // with FIFOs enabled, LSR_TX_IDLE means the whole
+    // transmit FIFO is empty.
+    for (i = 0; i < UART_FIFO_SIZE && uart_tx_r != uart_tx_w; i++)
+    {
+        WriteReg(THR, uart_tx_buf[uart_tx_r % UART_TX_BUF_SIZE]);
         uart_tx_r += 1;
-
-        // maybe uartputc() is waiting for space in the buffer.
-        // 唤醒等待的 uartputc
-        wakeup(&uart_tx_r);
-
-        WriteReg(THR, c);
     }
+
+    // maybe uartwrite() is waiting for space in the buffer.
+    // 唤醒等待的 uartwrite
+    wakeup(&uart_tx_r);
 }
 
 // read one input character from the UART.
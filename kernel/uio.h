@@ -0,0 +1,8 @@
+#define IOV_MAX 16   // readv()/writev() 一次最多的缓冲区数
+
+// One buffer of a readv() or writev() list.
+struct iovec
+{
+    void*  iov_base;   // Start of the buffer
+    uint64 iov_len;    // Its length in bytes
+};
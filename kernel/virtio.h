@@ -52,8 +52,10 @@
 
 // this many virtio descriptors.
 // must be a power of two.
-// 定义了虚拟队列中描述符的数量为 8，且要求是 2 的幂
-#define NUM 8
+// with indirect descriptors each request takes one of them,
+// so this is also the number of requests in flight.
+// 定义了虚拟队列中描述符的数量为 32，且要求是 2 的幂
+#define NUM 32
 
 // a single descriptor, from the spec.
 // 描述符结构
@@ -64,8 +66,9 @@ struct virtq_desc
     uint16 flags;   // 标志（如 VIRTIO_DESC_F_NEXT, VIRTIO_DESC_F_WRITE）
     uint16 next;    // 下一个描述符索引（用于链式描述符）
 };
-#define VRING_DESC_F_NEXT  1   // 表示此描述符后还有下一个描述符
-#define VRING_DESC_F_WRITE 2   // 表示设备将数据写入此缓冲区（否则驱动程序提供数据给设备读取）。
+#define VRING_DESC_F_NEXT     1   // 表示此描述符后还有下一个描述符
+#define VRING_DESC_F_WRITE    2   // 表示设备将数据写入此缓冲区（否则驱动程序提供数据给设备读取）。
+#define VRING_DESC_F_INDIRECT 4   // 表示此描述符指向一张间接描述符表
 
 // the (entire) avail ring, from the spec.
 // 可用环结构
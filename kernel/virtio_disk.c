@@ -5,6 +5,19 @@
 // qemu ... -drive file=fs.img,if=none,format=raw,id=x0 -device
 // virtio-blk-device,drive=x0,bus=virtio-mmio-bus.0
 //
+// a second disk on virtio-mmio-bus.1 (make DISK1=img) becomes
+// block device DISK1DEV. each disk has its own queue, lock and
+// descriptors, and bio.c reaches it through bdevsw[].
+//
+// buffers to read or write join a queue sorted by block
+// number. the queue is handed to the device in elevator
+// order, with runs of consecutive blocks merged into one
+// multi-segment request, whenever there are descriptors for
+// it: right away, or when the interrupt handler frees some.
+// callers of virtio_disk_start() go on at once, and either
+// wait with virtio_disk_wait() when they need the result or
+// have the interrupt handler call b->iodone.
+//
 
 #include "types.h"
 #include "riscv.h"
@@ -19,11 +32,22 @@
 
 // the address of virtio mmio register r.
 // 寄存器访问宏
-#define R(r) ((volatile uint32*)(VIRTIO0 + (r)))
+#define R(r) ((volatile uint32*)(dk->base + (r)))
+
+// most consecutive blocks merged into one request.
+#define NSEG 8
 
-// 磁盘设备结构
+// most virtio disks: qemu -drive ... bus=virtio-mmio-bus.0 and .1.
+#define NDISK 2
+
+// 磁盘设备结构，每块磁盘一个，各有自己的队列和锁
 static struct disk
 {
+    uint64 base;   // mmio 寄存器地址
+    int    irq;    // PLIC 中断号
+    uint   dev;    // 块设备号
+    int    ok;     // 已找到设备并初始化
+
     // a set (not a ring) of DMA descriptors, with which the
     // driver tells the device where to read and write individual
     // disk operations. there are NUM descriptors.
@@ -51,29 +75,60 @@ static struct disk
     // indexed by first descriptor index of chain.
     struct
     {
-        struct buf* b;        // 关联的缓冲区
-        char        status;   // 请求状态
-    } info[NUM];              // 跟踪正在进行的操作
+        struct buf* b[NSEG];   // 关联的缓冲区，磁盘上连续
+        int         n;         // 缓冲区数量
+        char        status;    // 请求状态
+    } info[NUM];               // 跟踪正在进行的操作
 
     // disk command headers.
     // one-for-one with descriptors, for convenience.
     struct virtio_blk_req ops[NUM];   // 磁盘请求头部
 
+    // per-request indirect descriptor tables, indexed like info[].
+    // when the device offers VIRTIO_RING_F_INDIRECT_DESC a request
+    // occupies a single ring descriptor that points at its table,
+    // so NUM requests can be in flight instead of NUM/(NSEG+2).
+    struct virtq_desc itab[NUM][NSEG + 2] __attribute__((aligned(16)));   // 间接描述符表
+    int               indirect;                                           // 是否使用间接描述符
+
+    // buffers waiting to be handed to the device, sorted by
+    // block number through b->qnext. they are dispatched in
+    // elevator order, sweeping up from headpos, and runs of
+    // consecutive blocks going the same way become a single
+    // request.
+    struct buf* queue;      // 等待下发的缓冲区，按块号排序
+    uint        headpos;    // 电梯算法：上一次下发的最后一块之后的块号
+    int         inflight;   // 排队中或设备正在处理的缓冲区数
+
+    // statistics, printed by procdump().
+    uint64 nreq;      // 提交的请求数
+    uint64 nmerged;   // 合并进前一块所在请求的块数
+    uint64 nnotify;   // 通知设备的次数
+    uint64 nintr;     // 处理的中断次数
+
     struct spinlock vdisk_lock;   // 同步锁
 
-} disk;
+} disks[NDISK] = {
+    {VIRTIO0, VIRTIO0_IRQ, DISKDEV},
+    {VIRTIO1, VIRTIO1_IRQ, DISK1DEV},
+};
+
+static void virtio_disk_start(struct buf** bs, int n, int write);
+static void virtio_disk_wait(struct buf** bs, int n);
+static void virtio_disk_dump(uint dev);
 
 // 初始化 VirtIO 块设备，设置设备状态、协商功能、配置队列，并标记设备为就绪。
-void virtio_disk_init(void)
+// returns 0 if there is no disk at dk->base.
+static int virtio_disk_probe(struct disk* dk)
 {
     uint32 status = 0;
     // 初始化磁盘操作的自旋锁
-    initlock(&disk.vdisk_lock, "virtio_disk");
-    // 检查设备标识寄存器
+    initlock(&dk->vdisk_lock, "virtio_disk");
+    // 检查设备标识寄存器；空的 mmio 槽的设备类型为 0
     if (*R(VIRTIO_MMIO_MAGIC_VALUE) != 0x74726976 || *R(VIRTIO_MMIO_VERSION) != 2 ||
         *R(VIRTIO_MMIO_DEVICE_ID) != 2 || *R(VIRTIO_MMIO_VENDOR_ID) != 0x554d4551)
     {
-        panic("could not find virtio disk");
+        return 0;
     }
 
     // 写 0 重置设备e
@@ -97,7 +152,9 @@ void virtio_disk_init(void)
     features &= ~(1 << VIRTIO_BLK_F_MQ);
     features &= ~(1 << VIRTIO_F_ANY_LAYOUT);
     features &= ~(1 << VIRTIO_RING_F_EVENT_IDX);
-    features &= ~(1 << VIRTIO_RING_F_INDIRECT_DESC);
+
+    // 设备支持时使用间接描述符，每个请求只占用一个环描述符
+    dk->indirect = (features >> VIRTIO_RING_F_INDIRECT_DESC) & 1;
 
     // 回写协商后的特性
     *R(VIRTIO_MMIO_DRIVER_FEATURES) = features;
@@ -126,53 +183,89 @@ void virtio_disk_init(void)
         panic("virtio disk max queue too short");
 
     // 分配VirtIO队列内存
-    disk.desc  = (struct virtq_desc*)kalloc();
-    disk.avail = (struct virtq_avail*)kalloc();
-    disk.used  = (struct virtq_used*)kalloc();
-    if (!disk.desc || !disk.avail || !disk.used)
+    dk->desc  = (struct virtq_desc*)kalloc();
+    dk->avail = (struct virtq_avail*)kalloc();
+    dk->used  = (struct virtq_used*)kalloc();
+    if (!dk->desc || !dk->avail || !dk->used)
         panic("virtio disk kalloc");
-    memset(disk.desc, 0, PGSIZE);
-    memset(disk.avail, 0, PGSIZE);
-    memset(disk.used, 0, PGSIZE);
+    pgzero(dk->desc);
+    pgzero(dk->avail);
+    pgzero(dk->used);
 
     // 设置队列大小
     *R(VIRTIO_MMIO_QUEUE_NUM) = NUM;
 
     // 写入描述符表物理地址（64 位拆分为低/高 32 位）
-    *R(VIRTIO_MMIO_QUEUE_DESC_LOW)  = (uint64)disk.desc;
-    *R(VIRTIO_MMIO_QUEUE_DESC_HIGH) = (uint64)disk.desc >> 32;
+    *R(VIRTIO_MMIO_QUEUE_DESC_LOW)  = (uint64)dk->desc;
+    *R(VIRTIO_MMIO_QUEUE_DESC_HIGH) = (uint64)dk->desc >> 32;
 
     // 写入可用环地址（驱动->设备）
-    *R(VIRTIO_MMIO_DRIVER_DESC_LOW)  = (uint64)disk.avail;
-    *R(VIRTIO_MMIO_DRIVER_DESC_HIGH) = (uint64)disk.avail >> 32;
+    *R(VIRTIO_MMIO_DRIVER_DESC_LOW)  = (uint64)dk->avail;
+    *R(VIRTIO_MMIO_DRIVER_DESC_HIGH) = (uint64)dk->avail >> 32;
 
     // 写入已用环地址（设备->驱动）
-    *R(VIRTIO_MMIO_DEVICE_DESC_LOW)  = (uint64)disk.used;
-    *R(VIRTIO_MMIO_DEVICE_DESC_HIGH) = (uint64)disk.used >> 32;
+    *R(VIRTIO_MMIO_DEVICE_DESC_LOW)  = (uint64)dk->used;
+    *R(VIRTIO_MMIO_DEVICE_DESC_HIGH) = (uint64)dk->used >> 32;
 
     // 激活队列
     *R(VIRTIO_MMIO_QUEUE_READY) = 0x1;
 
     // 标记所有描述符为空闲可用
     for (int i = 0; i < NUM; i++)
-        disk.free[i] = 1;
+        dk->free[i] = 1;
 
     // 设置 DRIVER_OK 状态位，通知设备驱动完全就绪
     status |= VIRTIO_CONFIG_S_DRIVER_OK;
     *R(VIRTIO_MMIO_STATUS) = status;
 
-    // plic.c and trap.c arrange for interrupts from VIRTIO0_IRQ.
+    // plic.c and trap.c arrange for interrupts from VIRTIO0_IRQ
+    // and VIRTIO1_IRQ.
+    dk->ok = 1;
+    return 1;
+}
+
+// find the disks and make each the driver of its block device.
+// the first, with the root file system, must be there.
+// 查找各块 virtio 磁盘并注册为块设备
+void virtio_disk_init(void)
+{
+    struct disk* dk;
+
+    for (dk = disks; dk < &disks[NDISK]; dk++)
+    {
+        if (!virtio_disk_probe(dk))
+        {
+            if (dk == disks)
+                panic("could not find virtio disk");
+            continue;
+        }
+        bdevsw[dk->dev].name  = dk == disks ? "virtio0" : "virtio1";
+        bdevsw[dk->dev].start = virtio_disk_start;
+        bdevsw[dk->dev].wait  = virtio_disk_wait;
+        bdevsw[dk->dev].dump  = virtio_disk_dump;
+    }
+}
+
+// the disk that is block device dev.
+// 返回块设备号 dev 对应的磁盘
+static struct disk* diskof(uint dev)
+{
+    for (struct disk* dk = disks; dk < &disks[NDISK]; dk++)
+        if (dk->ok && dk->dev == dev)
+            return dk;
+    panic("virtio disk: bad dev");
+    return 0;
 }
 
 // find a free descriptor, mark it non-free, return its index.
-// 在 disk.free 数组中寻找一个空闲描述符，标记为非空闲并返回其索引
-static int alloc_desc()
+// 在 dk->free 数组中寻找一个空闲描述符，标记为非空闲并返回其索引
+static int alloc_desc(struct disk* dk)
 {
     for (int i = 0; i < NUM; i++)
     {
-        if (disk.free[i])
+        if (dk->free[i])
         {
-            disk.free[i] = 0;
+            dk->free[i] = 0;
             return i;
         }
     }
@@ -180,29 +273,28 @@ static int alloc_desc()
 }
 
 // mark a descriptor as free.
-// 释放指定索引 i 的描述符，标记为空闲并唤醒等待空闲描述符的进程
-static void free_desc(int i)
+// 释放指定索引 i 的描述符，标记为空闲
+static void free_desc(struct disk* dk, int i)
 {
     if (i >= NUM)
         panic("free_desc 1");
-    if (disk.free[i])
+    if (dk->free[i])
         panic("free_desc 2");
-    disk.desc[i].addr  = 0;
-    disk.desc[i].len   = 0;
-    disk.desc[i].flags = 0;
-    disk.desc[i].next  = 0;
-    disk.free[i]       = 1;
-    wakeup(&disk.free[0]);
+    dk->desc[i].addr  = 0;
+    dk->desc[i].len   = 0;
+    dk->desc[i].flags = 0;
+    dk->desc[i].next  = 0;
+    dk->free[i]       = 1;
 }
 
 // free a chain of descriptors.
-static void free_chain(int i)
+static void free_chain(struct disk* dk, int i)
 {
     while (1)
     {
-        int flag = disk.desc[i].flags;
-        int nxt  = disk.desc[i].next;
-        free_desc(i);
+        int flag = dk->desc[i].flags;
+        int nxt  = dk->desc[i].next;
+        free_desc(dk, i);
         if (flag & VRING_DESC_F_NEXT)
             i = nxt;
         else
@@ -210,120 +302,233 @@ static void free_chain(int i)
     }
 }
 
-// allocate three descriptors (they need not be contiguous).
-// disk transfers always use three descriptors.
-static int alloc3_desc(int* idx)
+// allocate n descriptors (they need not be contiguous).
+// a disk transfer of k blocks uses k+2 descriptors.
+static int allocn_desc(struct disk* dk, int* idx, int n)
 {
-    for (int i = 0; i < 3; i++)
+    for (int i = 0; i < n; i++)
     {
-        idx[i] = alloc_desc();
+        idx[i] = alloc_desc(dk);
         if (idx[i] < 0)
         {
             for (int j = 0; j < i; j++)
-                free_desc(idx[j]);
+                free_desc(dk, idx[j]);
             return -1;
         }
     }
     return 0;
 }
 
-void virtio_disk_rw(struct buf* b, int write)
+// fill in one descriptor.
+static void set_desc(struct virtq_desc* d, void* addr, uint32 len, uint16 flags, uint16 next)
 {
-    // 计算磁盘扇区地址
-    uint64 sector = b->blockno * (BSIZE / 512);
-    // 获取磁盘操作锁
-    acquire(&disk.vdisk_lock);
+    d->addr  = (uint64)addr;
+    d->len   = len;
+    d->flags = flags;
+    d->next  = next;
+}
 
+// format a request for the n buffers of bs, which are
+// consecutive on disk, and put it on the available ring,
+// without telling the device. returns -1 if there are not
+// enough free descriptors. caller holds dk->vdisk_lock.
+// 为磁盘上连续的 n 个缓冲区构造一个请求并放入可用环，但不通知设备
+static int virtio_disk_queue(struct disk* dk, struct buf** bs, int n, int write)
+{
     // the spec's Section 5.2 says that legacy block operations use
-    // three descriptors: one for type/reserved/sector, one for the
-    // data, one for a 1-byte status result.
-
-    // 分配描述符链
-    int idx[3];
-    while (1)
+    // a descriptor for type/reserved/sector, then the data, then
+    // one for a 1-byte status result. the data may be split over
+    // several descriptors, one per buffer here.
+    struct virtq_desc* d[NSEG + 2];     // 请求的描述符
+    int                id;              // 请求编号（环中的头描述符）
+    int                nxt[NSEG + 1];   // d[i] 的 next 下标
+
+    if (dk->indirect)
     {
-        if (alloc3_desc(idx) == 0)
-        {
-            break;
-        }
-        sleep(&disk.free[0], &disk.vdisk_lock);
+        // 一个环描述符指向该请求自己的间接表，表内下标为 0..n+1
+        if ((id = alloc_desc(dk)) < 0)
+            return -1;
+        set_desc(&dk->desc[id], dk->itab[id], (n + 2) * sizeof(struct virtq_desc),
+                 VRING_DESC_F_INDIRECT, 0);
+        for (int i = 0; i < n + 2; i++)
+            d[i] = &dk->itab[id][i];
+        for (int i = 0; i < n + 1; i++)
+            nxt[i] = i + 1;
+    }
+    else
+    {
+        int idx[NSEG + 2];
+        if (allocn_desc(dk, idx, n + 2) != 0)
+            return -1;
+        for (int i = 0; i < n + 2; i++)
+            d[i] = &dk->desc[idx[i]];
+        id = idx[0];
+        for (int i = 0; i < n + 1; i++)
+            nxt[i] = idx[i + 1];
     }
 
-    // format the three descriptors.
+    // format the descriptors.
     // qemu's virtio-blk.c reads them.
-
-    // 初始化请求头
-    // type：操作类型（读/写）
-    // sector：目标扇区地址
-    struct virtio_blk_req* buf0 = &disk.ops[idx[0]];
-    if (write)
-        buf0->type = VIRTIO_BLK_T_OUT;   // 写磁盘
-    else
-        buf0->type = VIRTIO_BLK_T_IN;   // 读磁盘
+    struct virtio_blk_req* buf0 = &dk->ops[id];
+    buf0->type     = write ? VIRTIO_BLK_T_OUT : VIRTIO_BLK_T_IN;   // 写磁盘 / 读磁盘
     buf0->reserved = 0;
-    buf0->sector   = sector;
-
-    // 请求头描述符 (索引 0)
-    // 指向预分配的 disk.ops[] 内存
-    // 设置 NEXT 标志和链式指针
-    disk.desc[idx[0]].addr  = (uint64)buf0;
-    disk.desc[idx[0]].len   = sizeof(struct virtio_blk_req);
-    disk.desc[idx[0]].flags = VRING_DESC_F_NEXT;
-    disk.desc[idx[0]].next  = idx[1];
-
-    // 数据缓冲区描述符 (索引 1)
-    // 写操作：设备从内存读取数据 → 磁盘
-    // 读操作：设备从磁盘读取数据 → 内存
-    // 零拷贝设计：直接使用用户缓冲区的物理地址
-    disk.desc[idx[1]].addr = (uint64)b->data;
-    disk.desc[idx[1]].len  = BSIZE;
-    if (write)
-        disk.desc[idx[1]].flags = 0;   // 设备读b->data
-    else
-        disk.desc[idx[1]].flags = VRING_DESC_F_WRITE;   // 设备写b->data
-    disk.desc[idx[1]].flags |= VRING_DESC_F_NEXT;
-    disk.desc[idx[1]].next = idx[2];
+    buf0->sector   = bs[0]->blockno * (BSIZE / 512);
 
-    // 状态描述符 (索引 2)
-    disk.info[idx[0]].status = 0xff;                                // 初始状态(非0)
-    disk.desc[idx[2]].addr   = (uint64)&disk.info[idx[0]].status;   // 状态字段地址
-    disk.desc[idx[2]].len    = 1;                                   // 单字节状态
-    disk.desc[idx[2]].flags  = VRING_DESC_F_WRITE;                  // 设备可写(返回状态)
-    disk.desc[idx[2]].next   = 0;                                   // 链结束
+    dk->info[id].status = 0xff;   // 初始状态(非0)
+    set_desc(d[0], buf0, sizeof(struct virtio_blk_req), VRING_DESC_F_NEXT, nxt[0]);
+    for (int i = 0; i < n; i++)
+        set_desc(d[i + 1], bs[i]->data, BSIZE, (write ? 0 : VRING_DESC_F_WRITE) | VRING_DESC_F_NEXT,
+                 nxt[i + 1]);
+    set_desc(d[n + 1], &dk->info[id].status, 1, VRING_DESC_F_WRITE, 0);
 
     // 关联请求元数据
-    b->disk             = 1;   // 标记缓冲区正在使用
-    disk.info[idx[0]].b = b;   // 将缓冲区与描述符关联
+    for (int i = 0; i < n; i++)
+        dk->info[id].b[i] = bs[i];
+    dk->info[id].n = n;
 
     // 告诉设备描述符链中的第一个索引。
-    // 添加至可用环
-    disk.avail->ring[disk.avail->idx % NUM] = idx[0];
+    dk->avail->ring[dk->avail->idx % NUM] = id;
 
     __sync_synchronize();   // 内存屏障(确保写入顺序)
 
-    // 更新可用索引
-    disk.avail->idx += 1;   // not % NUM ...
-
-    __sync_synchronize();   // 再次内存屏障
+    dk->avail->idx += 1;   // not % NUM ...
+    dk->nreq++;
+    dk->nmerged += n - 1;
+    return 0;
+}
 
+// tell the device about everything added to the available ring.
+static void virtio_disk_notify(struct disk* dk)
+{
+    __sync_synchronize();
     *R(VIRTIO_MMIO_QUEUE_NOTIFY) = 0;   // 通知设备(队列0)
+    dk->nnotify++;
+}
+
+// is a request for blockno already with the device? two
+// writes of one block, say a log install's snapshot and the
+// cached buffer itself, must not be in flight together: the
+// device may do them in either order. caller holds
+// dk->vdisk_lock.
+// 判断该块是否已有请求在设备处理中
+static int virtio_disk_busy(struct disk* dk, uint blockno)
+{
+    for (int id = 0; id < NUM; id++)
+        if (dk->info[id].n > 0 && blockno >= dk->info[id].b[0]->blockno &&
+            blockno < dk->info[id].b[0]->blockno + dk->info[id].n)
+            return 1;
+    return 0;
+}
+
+// hand queued buffers to the device while there are
+// descriptors for them, in elevator order: each request
+// starts at the lowest queued block at or after headpos,
+// wrapping around to the lowest one, and takes the blocks
+// right after it that go the same way. a block that already
+// has a request in flight stays queued until the interrupt
+// handler finishes that one. the device is notified once.
+// caller holds dk->vdisk_lock.
+// 按电梯顺序把队列中的缓冲区下发给设备，合并连续的块，跳过已在处理中的块
+static void virtio_disk_dispatch(struct disk* dk)
+{
+    struct buf*  bs[NSEG];
+    struct buf*  b;
+    struct buf** start;
+    int          n, queued = 0;
+
+    while (dk->queue)
+    {
+        for (start = &dk->queue;
+             *start && ((*start)->blockno < dk->headpos || virtio_disk_busy(dk, (*start)->blockno));
+             start = &(*start)->qnext)
+            ;
+        if (*start == 0)
+            for (start = &dk->queue; *start && virtio_disk_busy(dk, (*start)->blockno); start = &(*start)->qnext)
+                ;
+        if (*start == 0)
+            break;   // every queued block is in flight already
+        n       = 0;
+        bs[n++] = *start;
+        for (b = (*start)->qnext; b && n < NSEG && b->dev == bs[0]->dev && b->qwrite == bs[0]->qwrite &&
+                                  b->blockno == bs[n - 1]->blockno + 1 && !virtio_disk_busy(dk, b->blockno);
+             b = b->qnext)
+            bs[n++] = b;
+        // out of descriptors: the rest waits for the interrupt
+        // handler to free some.
+        if (virtio_disk_queue(dk, bs, n, bs[0]->qwrite) != 0)
+            break;
+        *start       = b;   // the run was a stretch of the queue
+        dk->headpos = bs[n - 1]->blockno + 1;
+        queued++;
+    }
+    if (queued)
+        virtio_disk_notify(dk);
+}
 
-    // 等待磁盘中断表示请求已完成。
-    while (b->disk == 1)
+// add n buffers to the queue and dispatch what the device
+// can take, without waiting. caller holds dk->vdisk_lock.
+// 将 n 个缓冲区按块号插入请求队列并尽量下发，不等待完成
+static void virtio_disk_submit(struct disk* dk, struct buf** bs, int n, int write)
+{
+    struct buf** pp;
+
+    for (int i = 0; i < n; i++)
     {
-        // 在缓冲区上休眠
-        sleep(b, &disk.vdisk_lock);
+        // after any queued for the same block, so those retain
+        // their order.
+        for (pp = &dk->queue; *pp && (*pp)->blockno <= bs[i]->blockno; pp = &(*pp)->qnext)
+            ;
+        bs[i]->disk   = 1;   // 标记缓冲区正在使用
+        bs[i]->qwrite = write;
+        bs[i]->qnext  = *pp;
+        *pp           = bs[i];
+        dk->inflight++;
     }
+    virtio_disk_dispatch(dk);
+}
+
+// start reading or writing n buffers of one disk, and return
+// at once: bdevsw's start. the interrupt handler hands those
+// with b->iodone set to it; the others are waited for with
+// virtio_disk_wait().
+// 启动 n 个读写请求后立即返回，设置了 b->iodone 的缓冲区完成时由中断处理程序回调
+static void virtio_disk_start(struct buf** bs, int n, int write)
+{
+    struct disk* dk = diskof(bs[0]->dev);
 
-    disk.info[idx[0]].b = 0;     // 清除关联
-    free_chain(idx[0]);          // 释放描述符链
-    release(&disk.vdisk_lock);   // 释放锁
+    acquire(&dk->vdisk_lock);
+    virtio_disk_submit(dk, bs, n, write);
+    release(&dk->vdisk_lock);
 }
 
-void virtio_disk_intr()
+// wait for the requests of n buffers started by
+// virtio_disk_start() without b->iodone to complete.
+// 等待 n 个已启动的请求完成
+static void virtio_disk_wait(struct buf** bs, int n)
 {
+    struct disk* dk = diskof(bs[0]->dev);
+
+    acquire(&dk->vdisk_lock);
+    // 等待磁盘中断表示请求已完成，描述符由中断处理程序释放
+    for (int i = 0; i < n; i++)
+        while (bs[i]->disk == 1)
+            sleep(bs[i], &dk->vdisk_lock);
+    release(&dk->vdisk_lock);
+}
+
+// handle an interrupt from the disk at PLIC irq.
+// 处理磁盘中断
+void virtio_disk_intr(int irq)
+{
+    struct disk* dk;
+
+    for (dk = disks; dk < &disks[NDISK] && dk->irq != irq; dk++)
+        ;
+    if (dk == &disks[NDISK] || !dk->ok)
+        return;
+
     // 获取磁盘操作锁
-    acquire(&disk.vdisk_lock);
+    acquire(&dk->vdisk_lock);
 
     // the device won't raise another interrupt until we tell it
     // we've seen this interrupt, which the following line does.
@@ -334,28 +539,59 @@ void virtio_disk_intr()
     // 读取中断状态寄存器 (VIRTIO_MMIO_INTERRUPT_STATUS)
     // 将状态值写入中断确认寄存器 (VIRTIO_MMIO_INTERRUPT_ACK)
     *R(VIRTIO_MMIO_INTERRUPT_ACK) = *R(VIRTIO_MMIO_INTERRUPT_STATUS) & 0x3;
+    dk->nintr++;
 
     __sync_synchronize();
 
-    // the device increments disk.used->idx when it
-    // adds an entry to the used ring.
+    // the device increments dk->used->idx when it
+    // adds an entry to the used ring. a batch usually completes
+    // in a single interrupt, so drain everything that is there.
 
-    while (disk.used_idx != disk.used->idx)
+    while (dk->used_idx != dk->used->idx)
     {
         __sync_synchronize();
         // 获取完成项ID
-        int id = disk.used->ring[disk.used_idx % NUM].id;
+        int id = dk->used->ring[dk->used_idx % NUM].id;
         // 检查状态字节
-        if (disk.info[id].status != 0)
+        if (dk->info[id].status != 0)
             panic("virtio_disk_intr status");
 
+        free_chain(dk, id);   // 释放描述符链
+        for (int i = 0; i < dk->info[id].n; i++)
+        {
+            struct buf* b      = dk->info[id].b[i];   // 获取关联缓冲区
+            dk->info[id].b[i] = 0;                    // 清除关联
+            b->disk            = 0;                    // 设置 b->disk = 0 标记操作完成
+            dk->inflight--;
+            if (b->iodone)
+            {
+                // nobody is waiting: hand it to the completion function.
+                void (*done)(struct buf*) = b->iodone;
+                b->iodone                 = 0;
+                done(b);
+            }
+            else
+                wakeup(b);   // wakeup(b) 唤醒在缓冲区上睡眠的进程
+        }
+        dk->info[id].n = 0;
 
-        struct buf* b = disk.info[id].b;   // 获取关联缓冲区
-        b->disk       = 0;                 // 设置 b->disk = 0 标记操作完成
-        wakeup(b);                         // wakeup(b) 唤醒在缓冲区上睡眠的进程
-
-        disk.used_idx += 1;   // 更新索引
+        dk->used_idx += 1;   // 更新索引
     }
 
-    release(&disk.vdisk_lock);
+    // descriptors were freed: start what has been waiting.
+    virtio_disk_dispatch(dk);
+
+    release(&dk->vdisk_lock);
+}
+
+// print the queue statistics of the disk that is block device
+// dev.
+// 打印磁盘队列统计信息
+static void virtio_disk_dump(uint dev)
+{
+    struct disk* dk = diskof(dev);
+
+    printf("%s: %s, %d requests, %d blocks merged, %d notifies, %d interrupts, %d queued\n",
+           bdevsw[dev].name, dk->indirect ? "indirect" : "direct", (int)dk->nreq, (int)dk->nmerged,
+           (int)dk->nnotify, (int)dk->nintr, dk->inflight);
 }
@@ -3,6 +3,8 @@
 #include "memlayout.h"
 #include "elf.h"
 #include "riscv.h"
+#include "spinlock.h"
+#include "proc.h"
 #include "defs.h"
 #include "fs.h"
 
@@ -15,6 +17,74 @@ extern char etext[];   // kernel.ld sets this to end of kernel code.
 
 extern char trampoline[];   // trampoline.S
 
+// Serializes changes to the user page tables that the threads
+// made by clone() share, where two threads may fault on the
+// same page at once, and the sizes those threads keep.
+struct spinlock vmlock;
+
+// Page fault counters, printed by vmdump().
+struct
+{
+    uint64 lazy;   // demand-zero pages allocated on first touch
+    uint64 cow;    // copy-on-write pages copied or made writable
+} vmstat;
+
+// Per page table state, by its root page. rss counts the
+// resident user pages: the leaf PTEs with PTE_U set, which
+// mapleaves() and uvmgift() add and uvmunmap() and uvmclear()
+// take away. Threads made by clone() share a page table, and so
+// a count. gen moves on whenever a user PTE is removed, loses
+// permissions or is pointed at another page, and when the root
+// page is reused for a new page table, so that a translation
+// cached with an older gen (see uvmxlate()) is not used.
+static struct
+{
+    int  rss;
+    uint gen;
+} ptinfo[(PHYSTOP - KERNBASE) / PGSIZE];
+#define PTINFO(pt) ptinfo[((uint64)(pt) - KERNBASE) / PGSIZE]
+#define RSS(pt)    PTINFO(pt).rss
+
+// 页表映射发生变化，使缓存的地址转换失效
+static void ptchanged(pagetable_t pagetable)
+{
+    __sync_fetch_and_add(&PTINFO(pagetable).gen, 1);
+}
+
+// Make the other CPUs running a thread on pagetable forget the
+// translations their TLBs hold, and wait until they have: each
+// gets a machine-mode software interrupt, whose handler does
+// the sfence.vma even while supervisor mode has interrupts off
+// (see timervec in kernelvec.S). Called after a mapping is
+// removed or loses a permission, before the page can be reused.
+// A CPU that starts running such a thread later flushes its TLB
+// as it switches page tables anyway.
+// 通知正在使用该页表的其他 CPU 刷新 TLB，并等待其完成
+static void tlbshootdown(pagetable_t pagetable)
+{
+    struct proc* p;
+    uint64       sent = 0;
+    int          i, me;
+
+    push_off();
+    me = cpuid();
+    // the PTE changes must be visible before the check.
+    __sync_synchronize();
+    for (i = 0; i < NCPU; i++)
+    {
+        if (i == me || (p = cpus[i].proc) == 0 || p->pagetable != pagetable)
+            continue;
+        *(volatile uint32*)CLINT_MSIP(i) = 1;
+        sent |= 1L << i;
+    }
+    for (i = 0; i < NCPU; i++)
+        if (sent & (1L << i))
+            while (*(volatile uint32*)CLINT_MSIP(i) != 0)
+                ;
+    pop_off();
+    sfence_vma();
+}
+
 // Make a direct-map page table for the kernel.
 // 创建内核页表，映射内核需要的内存区域
 pagetable_t kvmmake(void)
@@ -22,17 +92,22 @@ pagetable_t kvmmake(void)
     pagetable_t kpgtbl;
 
     kpgtbl = (pagetable_t)kalloc();
-    memset(kpgtbl, 0, PGSIZE);
+    pgzero(kpgtbl);
 
     // uart registers
     kvmmap(kpgtbl, UART0, UART0, PGSIZE, PTE_R | PTE_W);
 
-    // virtio mmio disk interface
+    // virtio mmio disk interfaces
     kvmmap(kpgtbl, VIRTIO0, VIRTIO0, PGSIZE, PTE_R | PTE_W);
+    kvmmap(kpgtbl, VIRTIO1, VIRTIO1, PGSIZE, PTE_R | PTE_W);
 
     // PLIC
     kvmmap(kpgtbl, PLIC, PLIC, 0x400000, PTE_R | PTE_W);
 
+    // CLINT, whose MTIMECMP registers timerarm() and
+    // timerkick() set.
+    kvmmap(kpgtbl, CLINT, CLINT, 0x10000, PTE_R | PTE_W);
+
     // map kernel text executable and read-only.
     kvmmap(kpgtbl, KERNBASE, KERNBASE, (uint64)etext - KERNBASE, PTE_R | PTE_X);
 
@@ -53,6 +128,7 @@ pagetable_t kvmmake(void)
 // 初始化全局内核页表 kernel_pagetable
 void kvminit(void)
 {
+    initlock(&vmlock, "vm");
     kernel_pagetable = kvmmake();
 }
 
@@ -70,43 +146,197 @@ void kvminithart()
     sfence_vma();
 }
 
-// Return the address of the PTE in page table pagetable
-// that corresponds to virtual address va.  If alloc!=0,
-// create any required page-table pages.
-//
-// The risc-v Sv39 scheme has three levels of page-table
-// pages. A page-table page contains 512 64-bit PTEs.
-// A 64-bit virtual address is split into five fields:
-//   39..63 -- must be zero.
-//   30..38 -- 9 bits of level-2 index.
-//   21..29 -- 9 bits of level-1 index.
-//   12..20 -- 9 bits of level-0 index.
-//    0..11 -- 12 bits of byte offset within the page.
-// 在三级页表中查找虚拟地址 va 对应的页表项（PTE）。
-pte_t* walk(pagetable_t pagetable, uint64 va, int alloc)
+// Make a kernel page table for a process. It shares
+// kernel_pagetable's page-table pages, and so its mappings,
+// except for the level-1 page of the lowest 1GB, which is a
+// copy of its own: there, below UKMAPTOP, kvmsync() points it
+// at the level-0 page-table pages of the process's user memory.
+// Returns 0 if out of memory.
+// 为进程创建内核页表，除最低 1GB 的一级页表外与全局内核页表共享
+pagetable_t kvmcreate(void)
+{
+    pagetable_t kpt, l1;
+
+    if ((kpt = (pagetable_t)kalloc()) == 0)
+        return 0;
+    if ((l1 = (pagetable_t)kalloc()) == 0)
+    {
+        kfree(kpt);
+        return 0;
+    }
+    memmove(kpt, kernel_pagetable, PGSIZE);
+    memmove(l1, (void*)PTE2PA(kernel_pagetable[0]), PGSIZE);
+    kpt[0] = PA2PTE(l1) | PTE_V;
+    return kpt;
+}
+
+// Free a page table made by kvmcreate(), which no CPU may be
+// using. The pages it shares are left alone.
+// 释放进程的内核页表
+void kvmfree(pagetable_t kpt)
+{
+    kfree((void*)PTE2PA(kpt[0]));
+    kfree((void*)kpt);
+}
+
+// Switch this CPU to the kernel page table kpt, or to
+// kernel_pagetable if kpt is 0.
+// 切换到进程的内核页表，kpt 为 0 时切换回全局内核页表
+void kvmuse(pagetable_t kpt)
+{
+    if (kpt == 0)
+        kpt = kernel_pagetable;
+    sfence_vma();
+    w_satp(MAKE_SATP(kpt));
+    sfence_vma();
+}
+
+// Forget the user mappings of kpt, for exec(), which is about
+// to free the page-table pages they point at. kpt must be this
+// CPU's page table.
+// 清除进程内核页表中的用户映射
+void kvmreset(pagetable_t kpt)
+{
+    memset((void*)PTE2PA(kpt[0]), 0, PX(1, UKMAPTOP) * sizeof(pte_t));
+    sfence_vma();
+}
+
+// Make p's kernel page table, which must be this CPU's, map the
+// user addresses [va, va+len), below UKMAPTOP, as p's page table
+// does, by copying the level-1 PTEs, so that both point at the
+// same level-0 page-table pages and whatever is done to those
+// shows in both. A level-0 page is only freed with its whole
+// page table, so a copied PTE holds until exec() calls
+// kvmreset(); this only fills in the ones that the user page
+// table has gained since.
+// 使进程的内核页表与用户页表共享 [va, va+len) 的零级页表
+static void kvmsync(struct proc* p, uint64 va, uint64 len)
+{
+    pagetable_t kl1 = (pagetable_t)PTE2PA(p->kpagetable[0]);
+    pagetable_t ul1;
+    int         i, changed = 0;
+
+    if ((p->pagetable[0] & PTE_V) == 0)
+        return;
+    ul1 = (pagetable_t)PTE2PA(p->pagetable[0]);
+    for (i = PX(1, va); i <= PX(1, va + len - 1); i++)
+    {
+        if (kl1[i] != ul1[i])
+        {
+            kl1[i]  = ul1[i];
+            changed = 1;
+        }
+    }
+    if (changed)
+        sfence_vma();
+}
+
+// Return whether the copy functions can reach the user
+// addresses [va, va+len) of pagetable directly, through the
+// current process's kernel page table, and if so make sure
+// that it maps them. The kernel page table is made for the
+// first copy of a page or more: shorter ones do as well a page
+// at a time with the translation cache, and kernel threads
+// and processes that never copy that much do without.
+// 判断能否经由进程的内核页表直接访问用户地址 [va, va+len)
+static int ukmapped(pagetable_t pagetable, uint64 va, uint64 len)
+{
+    struct proc* p = myproc();
+    pagetable_t  kpt;
+
+    if (!KUSERMAP || p == 0 || pagetable != p->pagetable)
+        return 0;
+    if (len == 0 || va >= UKMAPTOP || len > UKMAPTOP - va)
+        return 0;
+    if (p->kpagetable == 0)
+    {
+        if (len < PGSIZE || (kpt = kvmcreate()) == 0)
+            return 0;
+        // the scheduler switches to p->kpagetable whenever p
+        // runs from now on.
+        push_off();
+        p->kpagetable = kpt;
+        kvmuse(kpt);
+        pop_off();
+    }
+    kvmsync(p, va, len);
+    return 1;
+}
+
+// Handle a page fault at user address va, of a write if write
+// is set, taken in ucopy() or ucopystr() (see kerneltrap()).
+// Returns 0 if the copy can retry the access, -1 if it must
+// fail.
+// 处理直接访问用户内存时的缺页，返回 0 表示可以重试
+int ukmapfault(uint64 va, int write)
+{
+    struct proc* p = myproc();
+
+    if (p == 0 || p->kpagetable == 0 || va >= UKMAPTOP || vmfault(p->pagetable, va, write) != 0)
+        return -1;
+    // the fault may have added a level-0 page-table page, and
+    // the TLB may still hold the PTE as it was.
+    kvmsync(p, va, 1);
+    sfence_vma();
+    return 0;
+}
+
+// Like walk(), but stop at the PTE of level *level, which
+// maps LEVELSIZE(*level) bytes if it is a leaf. If a leaf
+// above that level already maps va, return it instead; either
+// way, set *level to the level of the returned PTE.
+// 查找 va 在第 *level 级（或更高一级叶子）的页表项
+static pte_t* walklevel(pagetable_t pagetable, uint64 va, int alloc, int* level)
 {
     if (va >= MAXVA)
         panic("walk");
 
-    for (int level = 2; level > 0; level--)
+    for (int l = 2; l > *level; l--)
     {
-        // addr = pagetable + PX(level, va) * sizeof(uint64) = pagetable + PX(level, va) * 8
-        pte_t* pte = &pagetable[PX(level, va)];
+        // addr = pagetable + PX(l, va) * sizeof(uint64) = pagetable + PX(l, va) * 8
+        pte_t* pte = &pagetable[PX(l, va)];
         if (*pte & PTE_V)
         {
+            if (PTE_LEAF(*pte))
+            {
+                *level = l;
+                return pte;
+            }
             // 将 PTE 转换为下一级页表的物理地址
             pagetable = (pagetable_t)PTE2PA(*pte);
         }
         else
         {
-            if (!alloc || (pagetable = (pde_t*)kalloc()) == 0)
+            if (!alloc || (pagetable = (pde_t*)kalloc_zeroed()) == 0)
                 return 0;
-            memset(pagetable, 0, PGSIZE);
             // 将新申请的物理页表new_pagetable 连接到 上一级页表的页表项（PTE）中
             *pte = PA2PTE(pagetable) | PTE_V;
         }
     }
-    return &pagetable[PX(0, va)];
+    return &pagetable[PX(*level, va)];
+}
+
+// Return the address of the PTE in page table pagetable
+// that corresponds to virtual address va.  If alloc!=0,
+// create any required page-table pages.
+//
+// The risc-v Sv39 scheme has three levels of page-table
+// pages. A page-table page contains 512 64-bit PTEs.
+// A 64-bit virtual address is split into five fields:
+//   39..63 -- must be zero.
+//   30..38 -- 9 bits of level-2 index.
+//   21..29 -- 9 bits of level-1 index.
+//   12..20 -- 9 bits of level-0 index.
+//    0..11 -- 12 bits of byte offset within the page.
+//
+// A PTE with any of R, W or X set is a leaf, also at level 1
+// or 2, where it maps a 2-megabyte or 1-gigabyte page. The
+// walk stops at such a leaf and returns it.
+// 在三级页表中查找虚拟地址 va 对应的页表项（PTE）。
+pte_t* walk(pagetable_t pagetable, uint64 va, int alloc)
+{
+    int level = 0;
+    return walklevel(pagetable, va, alloc, &level);
 }
 
 // Look up a virtual address, return the physical address,
@@ -117,11 +347,12 @@ uint64 walkaddr(pagetable_t pagetable, uint64 va)
 {
     pte_t* pte;
     uint64 pa;
+    int    level = 0;
 
     if (va >= MAXVA)
         return 0;
 
-    pte = walk(pagetable, va, 0);
+    pte = walklevel(pagetable, va, 0, &level);
     if (pte == 0)
         return 0;
     if ((*pte & PTE_V) == 0)
@@ -130,29 +361,20 @@ uint64 walkaddr(pagetable_t pagetable, uint64 va)
         return 0;
     // 返回虚拟地址对应的数据页表的地址
     // 实际地址是 pa+offset
-    pa = PTE2PA(*pte);
+    pa = PTE2PA(*pte) + (PGROUNDDOWN(va) & (LEVELSIZE(level) - 1));
     return pa;
 }
 
-// add a mapping to the kernel page table.
-// only used when booting.
-// does not flush TLB or enable paging.
-// 为内核页表添加虚拟地址 va 到物理地址 pa 的映射。
-void kvmmap(pagetable_t kpgtbl, uint64 va, uint64 pa, uint64 sz, int perm)
-{
-    if (mappages(kpgtbl, va, sz, pa, perm) != 0)
-        panic("kvmmap");
-}
-
-// Create PTEs for virtual addresses starting at va that refer to
-// physical addresses starting at pa. va and size might not
-// be page-aligned. Returns 0 on success, -1 if walk() couldn't
-// allocate a needed page-table page.
-// 将虚拟地址范围 [va, va+size) 映射到物理地址 [pa, pa+size)，支持非页面对齐。
-int mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
+// Like mappages(), but map with leaf PTEs of up to level
+// maxlevel: each part of the range where va and pa are aligned
+// to LEVELSIZE(level) and that covers a whole one is mapped
+// by a single PTE of that level.
+// 用不超过 maxlevel 级的叶子页表项建立映射（可使用大页）
+static int mapleaves(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm, int maxlevel)
 {
     uint64 a, last;
     pte_t* pte;
+    int    level;
 
     if (size == 0)
         panic("mappages: size");
@@ -161,45 +383,105 @@ int mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
     last = PGROUNDDOWN(va + size - 1);
     for (;;)
     {
-        if ((pte = walk(pagetable, a, 1)) == 0)
+        for (level = maxlevel; level > 0; level--)
+            if ((a | pa) % LEVELSIZE(level) == 0 && last - a >= LEVELSIZE(level) - PGSIZE)
+                break;
+        if ((pte = walklevel(pagetable, a, 1, &level)) == 0)
             return -1;
+        if (level > 0 && (*pte & PTE_V) && !PTE_LEAF(*pte))
+        {
+            // part of this range is already mapped by smaller pages.
+            level = 0;
+            if ((pte = walklevel(pagetable, a, 1, &level)) == 0)
+                return -1;
+        }
         if (*pte & PTE_V)
             panic("mappages: remap");
         *pte = PA2PTE(pa) | perm | PTE_V;
-        if (a == last)
+        if (perm & PTE_U)
+            __sync_fetch_and_add(&RSS(pagetable), LEVELSIZE(level) / PGSIZE);
+        if (last - a < LEVELSIZE(level))
             break;
-        a += PGSIZE;
-        pa += PGSIZE;
+        a += LEVELSIZE(level);
+        pa += LEVELSIZE(level);
     }
     return 0;
 }
 
+// add a mapping to the kernel page table.
+// only used when booting.
+// does not flush TLB or enable paging.
+// Where va and pa are both 2-megabyte aligned, the mapping
+// uses level-1 leaf PTEs (megapages), so the direct map of RAM
+// needs few page-table pages and TLB entries.
+// 为内核页表添加虚拟地址 va 到物理地址 pa 的映射。
+void kvmmap(pagetable_t kpgtbl, uint64 va, uint64 pa, uint64 sz, int perm)
+{
+    if (mapleaves(kpgtbl, va, sz, pa, perm, 1) != 0)
+        panic("kvmmap");
+}
+
+// Create PTEs for virtual addresses starting at va that refer to
+// physical addresses starting at pa. va and size might not
+// be page-aligned. Returns 0 on success, -1 if walk() couldn't
+// allocate a needed page-table page.
+// 将虚拟地址范围 [va, va+size) 映射到物理地址 [pa, pa+size)，支持非页面对齐。
+int mappages(pagetable_t pagetable, uint64 va, uint64 size, uint64 pa, int perm)
+{
+    return mapleaves(pagetable, va, size, pa, perm, 0);
+}
+
 // Remove npages of mappings starting from va. va must be
-// page-aligned. The mappings must exist.
+// page-aligned. Pages that were never touched (see vmfault())
+// have no mapping and are skipped. A megapage in the range
+// must lie wholly inside it.
 // Optionally free the physical memory.
-// 从页表中移除虚拟地址 va 开始的 npages 页映射，可选择释放物理内存。
+// 从页表中移除虚拟地址 va 开始的 npages 页映射，可选择释放物理内存；跳过未映射的页。
 void uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
 {
-    uint64 a;
+    uint64 a, pa;
     pte_t* pte;
+    int    level;
 
     if ((va % PGSIZE) != 0)
         panic("uvmunmap: not aligned");
+    ptchanged(pagetable);
 
     for (a = va; a < va + npages * PGSIZE; a += PGSIZE)
     {
-        if ((pte = walk(pagetable, a, 0)) == 0)
-            panic("uvmunmap: walk");
+        level = 0;
+        if ((pte = walklevel(pagetable, a, 0, &level)) == 0)
+        {
+            // no page-table page here: skip to the next one.
+            a = PGROUNDDOWN(a | (LEVELSIZE(1) - 1));
+            continue;
+        }
         if ((*pte & PTE_V) == 0)
-            panic("uvmunmap: not mapped");
+            continue;
         if (PTE_FLAGS(*pte) == PTE_V)
             panic("uvmunmap: not a leaf");
+        if (level > 0)
+        {
+            // a megapage goes all at once; kalloc() did not
+            // allocate it, so it cannot be freed.
+            if (a % LEVELSIZE(level) != 0 || a + LEVELSIZE(level) > va + npages * PGSIZE || do_free)
+                panic("uvmunmap: megapage");
+            if (*pte & PTE_U)
+                __sync_fetch_and_sub(&RSS(pagetable), LEVELSIZE(level) / PGSIZE);
+            *pte = 0;
+            a += LEVELSIZE(level) - PGSIZE;
+            continue;
+        }
+        if (*pte & PTE_U)
+            __sync_fetch_and_sub(&RSS(pagetable), 1);
+        pa   = PTE2PA(*pte);
+        *pte = 0;
         if (do_free)
         {
-            uint64 pa = PTE2PA(*pte);
+            // no thread may reach the page once it is free.
+            tlbshootdown(pagetable);
             kfree((void*)pa);
         }
-        *pte = 0;
     }
 }
 
@@ -209,13 +491,21 @@ void uvmunmap(pagetable_t pagetable, uint64 va, uint64 npages, int do_free)
 pagetable_t uvmcreate()
 {
     pagetable_t pagetable;
-    pagetable = (pagetable_t)kalloc();
+    pagetable = (pagetable_t)kalloc_zeroed();
     if (pagetable == 0)
         return 0;
-    memset(pagetable, 0, PGSIZE);
+    RSS(pagetable) = 0;
+    ptchanged(pagetable);
     return pagetable;
 }
 
+// Return the number of user pages mapped in pagetable.
+// 返回页表中已映射的用户页数
+uint64 uvmrss(pagetable_t pagetable)
+{
+    return __atomic_load_n(&RSS(pagetable), __ATOMIC_RELAXED);
+}
+
 // Load the user initcode into address 0 of pagetable,
 // for the very first process.
 // sz must be less than a page.
@@ -227,7 +517,7 @@ void uvmfirst(pagetable_t pagetable, uchar* src, uint sz)
     if (sz >= PGSIZE)
         panic("uvmfirst: more than a page");
     mem = (char*)kalloc();
-    memset(mem, 0, PGSIZE);
+    pgzero(mem);
     mappages(pagetable, 0, PGSIZE, (uint64)mem, PTE_W | PTE_R | PTE_X | PTE_U);
     memmove(mem, src, sz);
 }
@@ -246,14 +536,13 @@ uint64 uvmalloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz, int xperm)
     oldsz = PGROUNDUP(oldsz);
     for (a = oldsz; a < newsz; a += PGSIZE)
     {
-        mem = (char*)kalloc();
+        mem = (char*)kalloc_zeroed();
         if (mem == 0)
         {
             // 没分配成功则释放之前申请的物理内存
             uvmdealloc(pagetable, a, oldsz);
             return 0;
         }
-        memset(mem, 0, PGSIZE);
         if (mappages(pagetable, a, PGSIZE, (uint64)mem, PTE_R | PTE_U | xperm) != 0)
         {
             // 没有映射成功也释放之前申请的物理内存
@@ -285,7 +574,8 @@ uint64 uvmdealloc(pagetable_t pagetable, uint64 oldsz, uint64 newsz)
 }
 
 // Recursively free page-table pages.
-// All leaf mappings must already have been removed.
+// All leaf mappings, megapages included, must already have
+// been removed.
 // 递归释放页表及其子页表。
 void freewalk(pagetable_t pagetable)
 {
@@ -320,50 +610,345 @@ void uvmfree(pagetable_t pagetable, uint64 sz)
     freewalk(pagetable);
 }
 
-// Given a parent process's page table, copy
-// its memory into a child's page table.
-// Copies both the page table and the
-// physical memory.
+// Given a parent process's page table, share
+// its memory with a child's page table.
+// Writable pages are made read-only in both page tables
+// and marked PTE_COW; the first write to such a page makes
+// a private copy (see cowfault()). Pages the parent never
+// touched stay unmapped in the child as well.
 // returns 0 on success, -1 on failure.
 // frees any allocated pages on failure.
-// 复制父进程的页表和物理内存到子进程（用于 fork）。
+// 将父进程的页以写时复制的方式共享给子进程（用于 fork）。
 int uvmcopy(pagetable_t old, pagetable_t new, uint64 sz)
+{
+    return uvmcopyrange(old, new, 0, sz);
+}
+
+// Like uvmcopy(), but for the page-aligned range [start, end)
+// only, e.g. a region made by mmap().
+// 以写时复制的方式共享 [start, end) 范围内的页
+int uvmcopyrange(pagetable_t old, pagetable_t new, uint64 start, uint64 end)
 {
     pte_t* pte;
     uint64 pa, i;
     uint   flags;
-    char*  mem;
 
-    for (i = 0; i < sz; i += PGSIZE)
+    ptchanged(old);
+    for (i = start; i < end; i += PGSIZE)
     {
         if ((pte = walk(old, i, 0)) == 0)
-            panic("uvmcopy: pte should exist");
+        {
+            i = PGROUNDDOWN(i | (LEVELSIZE(1) - 1));
+            continue;
+        }
         if ((*pte & PTE_V) == 0)
-            panic("uvmcopy: page not present");
+            continue;
 
-        // 找到父进程虚拟地址为i的物理地址和数据页的权限
+        // 可写页改为只读并打上 COW 标记，父子进程共享同一物理页
+        if (*pte & PTE_W)
+            *pte = (*pte & ~PTE_W) | PTE_COW;
         pa    = PTE2PA(*pte);
         flags = PTE_FLAGS(*pte);
 
-        if ((mem = kalloc()) == 0)
-            goto err;
-        // 将old数据页复制到新申请的mem中
-        memmove(mem, (char*)pa, PGSIZE);
-        if (mappages(new, i, PGSIZE, (uint64)mem, flags) != 0)
-        {
-            kfree(mem);
+        if (mappages(new, i, PGSIZE, pa, flags) != 0)
             goto err;
-        }
+        kdup((void*)pa);
     }
+    // other threads of the parent must stop writing to the
+    // pages the child now shares.
+    tlbshootdown(old);
     return 0;
 
 err:
-    uvmunmap(new, 0, i / PGSIZE, 1);
+    tlbshootdown(old);
+    uvmunmap(new, start, (i - start) / PGSIZE, 1);
     return -1;
 }
 
+// Resolve a write to a copy-on-write page at va by giving
+// the page table its own writable copy. If this page table
+// holds the last reference, the page is just made writable.
+// Returns 0 on success, -1 if va is not a COW page or
+// there is no memory for the copy.
+// 处理写时复制缺页：为写入方复制出私有的可写页
+int cowfault(pagetable_t pagetable, uint64 va)
+{
+    pte_t* pte;
+    uint64 pa;
+    uint   flags;
+    char*  mem;
+
+    if (va >= MAXVA)
+        return -1;
+    pte = walk(pagetable, va, 0);
+    if (pte == 0 || (*pte & PTE_V) == 0 || (*pte & PTE_U) == 0 || (*pte & PTE_COW) == 0)
+        return -1;
+
+    pa    = PTE2PA(*pte);
+    flags = (PTE_FLAGS(*pte) & ~PTE_COW) | PTE_W;
+    ptchanged(pagetable);
+    if (krefcnt((void*)pa) == 1)
+    {
+        *pte = PA2PTE(pa) | flags;
+        __sync_fetch_and_add(&vmstat.cow, 1);
+        return 0;
+    }
+
+    if ((mem = kalloc()) == 0)
+        return -1;
+    pgcopy(mem, (char*)pa);
+    *pte = PA2PTE(mem) | flags;
+    // other threads must stop reading the old page, which
+    // others may yet write to.
+    tlbshootdown(pagetable);
+    kfree((void*)pa);
+    __sync_fetch_and_add(&vmstat.cow, 1);
+    return 0;
+}
+
+// Handle a fault on user address va in pagetable, which
+// the kernel also calls itself before touching user memory
+// that might not be mapped yet. Writes to copy-on-write
+// pages get a private copy; untouched pages below p->sz of
+// the current process are allocated and zeroed.
+// Returns 0 if the access can be retried, -1 if it is
+// illegal or memory ran out.
+// 处理用户地址缺页：写时复制或按需分配零页
+int vmfault(pagetable_t pagetable, uint64 va, int write)
+{
+    struct proc* p = myproc();
+    pte_t*       pte;
+    char*        mem;
+    int          r;
+
+    if (va >= MAXVA)
+        return -1;
+    va = PGROUNDDOWN(va);
+    acquire(&vmlock);
+    pte = walk(pagetable, va, 0);
+    if (pte && (*pte & PTE_V))
+    {
+        // another thread sharing the page table may have
+        // resolved the same fault first.
+        if ((*pte & PTE_U) && (*pte & (write ? PTE_W : PTE_R)))
+            r = 0;
+        else if (write && (*pte & PTE_COW))
+            r = cowfault(pagetable, va);
+        else
+            r = -1;
+        release(&vmlock);
+        return r;
+    }
+    release(&vmlock);
+
+    if (p == 0 || pagetable != p->pagetable)
+        return -1;
+    if (vmalookup(p, va))
+        return vmafault(p, va, write);
+
+    // sbrk() only moved p->sz; allocate the page on first touch.
+    if (va >= p->sz || (mem = kalloc_zeroed()) == 0)
+        return -1;
+    acquire(&vmlock);
+    if (va >= p->sz)
+        r = -1;
+    else
+        r = uvmmapshared(pagetable, va, (uint64)mem, PTE_R | PTE_W | PTE_U);
+    release(&vmlock);
+    if (r != 0)
+    {
+        kfree(mem);
+        return r < 0 ? -1 : 0;
+    }
+    __sync_fetch_and_add(&vmstat.lazy, 1);
+    return 0;
+}
+
+// Map the page pa at the user address va, for the fault
+// handlers. The caller holds vmlock, so that a thread sharing
+// the page table cannot be mapping va at the same time.
+// Returns 0 on success, 1 if va is already mapped, by a thread
+// that faulted on it too, and -1 if out of memory.
+// 在持有 vmlock 时为缺页映射一页，若已被其他线程映射则返回 1
+int uvmmapshared(pagetable_t pagetable, uint64 va, uint64 pa, int perm)
+{
+    pte_t* pte;
+
+    if (!holding(&vmlock))
+        panic("uvmmapshared");
+    if ((pte = walk(pagetable, va, 0)) != 0 && (*pte & PTE_V))
+        return 1;
+    return mappages(pagetable, va, PGSIZE, pa, perm) == 0 ? 0 : -1;
+}
+
+// Make sure every page of [va, va+len) is mapped for a user
+// access, calling vmfault() for those that are not. For use
+// by code that cannot take a fault where it copies, because
+// it holds a spinlock there.
+// Returns 0 on success, -1 if some page cannot be faulted in.
+// 预先为 [va, va+len) 中尚未映射的用户页处理缺页
+int uvmtouch(pagetable_t pagetable, uint64 va, uint64 len, int write)
+{
+    uint64 a;
+    pte_t* pte;
+
+    for (a = PGROUNDDOWN(va); a < va + len; a += PGSIZE)
+    {
+        if (a >= MAXVA)
+            return -1;
+        pte = walk(pagetable, a, 0);
+        if (pte && (*pte & PTE_V) && (*pte & PTE_U) && (!write || (*pte & PTE_W)))
+            continue;
+        if (vmfault(pagetable, a, write) != 0)
+            return -1;
+    }
+    return 0;
+}
+
+// Share the user page at va so that it can be handed to
+// someone else by reference. The page becomes copy-on-write
+// here, so that a later write by either side goes to a private
+// copy, and gains a reference for the receiver.
+// Returns its physical address, or 0 if va is not a readable
+// user page.
+// 将用户页 va 以写时复制方式共享出去，返回其物理地址
+uint64 uvmshare(pagetable_t pagetable, uint64 va)
+{
+    pte_t* pte;
+    uint64 pa;
+
+    if (va % PGSIZE != 0 || va >= MAXVA)
+        return 0;
+    pte = walk(pagetable, va, 0);
+    if ((pte == 0 || (*pte & PTE_V) == 0) && vmfault(pagetable, va, 0) == 0)
+        pte = walk(pagetable, va, 0);
+    if (pte == 0 || (*pte & PTE_V) == 0 || (*pte & PTE_U) == 0 || (*pte & PTE_R) == 0)
+        return 0;
+
+    pa = PTE2PA(*pte);
+    if (*pte & PTE_W)
+    {
+        *pte = (*pte & ~PTE_W) | PTE_COW;
+        ptchanged(pagetable);
+        tlbshootdown(pagetable);
+    }
+    kdup((void*)pa);
+    return pa;
+}
+
+// Map physical page pa at user address va in place of the page
+// that was there, taking over the caller's reference to pa. It
+// is mapped copy-on-write, since others may still share it.
+// va must be a writable user page, or an untouched page below
+// p->sz of the current process.
+// Returns 0 on success, -1 otherwise.
+// 用物理页 pa 替换用户地址 va 处的页（写时复制映射）
+int uvmgift(pagetable_t pagetable, uint64 va, uint64 pa)
+{
+    struct proc* p   = myproc();
+    uint64       old = 0;
+    pte_t*       pte;
+
+    if (va % PGSIZE != 0 || va >= MAXVA)
+        return -1;
+    pte = walk(pagetable, va, 0);
+    if (pte && (*pte & PTE_V))
+    {
+        if ((*pte & PTE_U) == 0 || (*pte & (PTE_W | PTE_COW)) == 0)
+            return -1;
+        old = PTE2PA(*pte);
+    }
+    else
+    {
+        if (p == 0 || pagetable != p->pagetable || va >= p->sz)
+            return -1;
+        if ((pte = walk(pagetable, va, 1)) == 0)
+            return -1;
+        __sync_fetch_and_add(&RSS(pagetable), 1);
+    }
+    *pte = PA2PTE(pa) | PTE_V | PTE_U | PTE_R | PTE_COW;
+    ptchanged(pagetable);
+    if (old)
+    {
+        tlbshootdown(pagetable);
+        kfree((void*)old);
+    }
+    return 0;
+}
+
+// Return the physical address of the user page at va if
+// pagetable can only read it, without a copy-on-write fault:
+// a page that ksm.c may share with others of the same
+// contents, if no one else holds a reference to it, or may be
+// sharing already. Returns 0 otherwise.
+// 若 va 处是只读用户页，返回其物理地址
+uint64 uvmrdonly(pagetable_t pagetable, uint64 va)
+{
+    pte_t* pte;
+    uint64 pa;
+    int    level = 0;
+
+    if (va >= MAXVA || (pte = walklevel(pagetable, va, 0, &level)) == 0 || level != 0)
+        return 0;
+    if ((*pte & (PTE_V | PTE_U | PTE_R | PTE_W)) != (PTE_V | PTE_U | PTE_R))
+        return 0;
+    pa = PTE2PA(*pte);
+    if (pa < KERNBASE || pa >= PHYSTOP)
+        return 0;
+    return pa;
+}
+
+// Point the user PTE at va at the physical page pa, which has
+// the same contents as the page there, taking over the
+// caller's reference to pa and dropping the page table's
+// reference to the old page. The permissions stay as they
+// were. No CPU may be using pagetable.
+// 将 va 的页表项改指向内容相同的物理页 pa，并释放原页
+void uvmremap(pagetable_t pagetable, uint64 va, uint64 pa)
+{
+    pte_t* pte;
+    uint64 old;
+
+    if ((pte = walk(pagetable, va, 0)) == 0 || (*pte & PTE_V) == 0)
+        panic("uvmremap");
+    old  = PTE2PA(*pte);
+    *pte = PA2PTE(pa) | PTE_FLAGS(*pte);
+    ptchanged(pagetable);
+    tlbshootdown(pagetable);
+    kfree((void*)old);
+}
+
+// Clear the dirty bit of the user page at va, so that a later
+// store to it, by the process or by copyout(), sets it again.
+// Returns the page's physical address if it was dirty, else 0.
+// 清除 va 处用户页的脏位，若原先为脏则返回其物理地址
+uint64 uvmclean(pagetable_t pagetable, uint64 va)
+{
+    pte_t* pte;
+
+    if ((pte = walk(pagetable, va, 0)) == 0 || (*pte & (PTE_V | PTE_D)) != (PTE_V | PTE_D))
+        return 0;
+    *pte &= ~PTE_D;
+    // a cached translation or TLB entry that has the page
+    // dirty already would let the next store skip setting it.
+    ptchanged(pagetable);
+    tlbshootdown(pagetable);
+    return PTE2PA(*pte);
+}
+
+// Print page fault counters. For debugging.
+// 打印缺页处理计数
+void vmdump(void)
+{
+    printf("vm: lazy %d cow %d\n", (int)vmstat.lazy, (int)vmstat.cow);
+}
+
 // mark a PTE invalid for user access.
 // used by exec for the user stack guard page.
+// The kernel, which may reach user memory through the
+// process's kernel page table (see ukmapped()), is kept out
+// too: the page is left executable only, which supervisor
+// loads and stores cannot use.
 // 清除指定虚拟地址的 PTE
 // 用户访问权限（PTE_U），用于设置用户栈保护页。​
 void uvmclear(pagetable_t pagetable, uint64 va)
@@ -373,23 +958,77 @@ void uvmclear(pagetable_t pagetable, uint64 va)
     pte = walk(pagetable, va, 0);
     if (pte == 0)
         panic("uvmclear");
-    *pte &= ~PTE_U;
+    if (*pte & PTE_U)
+        __sync_fetch_and_sub(&RSS(pagetable), 1);
+    *pte = (*pte & ~(PTE_U | PTE_R | PTE_W)) | PTE_X;
+    ptchanged(pagetable);
+}
+
+// Return the physical address of the user page va0 of
+// pagetable, for copying to it if write is set or from it
+// otherwise, faulting it in first if need be. The calling
+// process keeps the last translation, so that a run of small
+// copies to or from one page walks the page table just once;
+// the page table's gen tells whether it still holds.
+// Returns 0 if the page cannot be used so.
+// 为复制取得用户页 va0 的物理地址，使用并更新当前进程的转换缓存
+static uint64 uvmxlate(pagetable_t pagetable, uint64 va0, int write)
+{
+    struct proc*  p = myproc();
+    struct xlate* x = p ? &p->xlate : 0;
+    pte_t*        pte;
+    uint          gen;
+
+    if (va0 >= MAXVA)
+        return 0;
+    gen = __atomic_load_n(&PTINFO(pagetable).gen, __ATOMIC_ACQUIRE);
+    if (x && x->pagetable == pagetable && x->va == va0 && x->gen == gen && (x->write || !write))
+        return x->pa;
+
+    // 写入的目标页必须是用户可写的；写时复制页或未分配页先交给 vmfault 处理
+    pte = walk(pagetable, va0, 0);
+    if (pte == 0 || (*pte & PTE_V) == 0 || (write && (*pte & PTE_COW)))
+    {
+        if (vmfault(pagetable, va0, write) != 0)
+            return 0;
+        gen = __atomic_load_n(&PTINFO(pagetable).gen, __ATOMIC_ACQUIRE);
+        pte = walk(pagetable, va0, 0);
+    }
+    if (pte == 0 || (*pte & PTE_V) == 0 || (*pte & PTE_U) == 0 || (write && (*pte & PTE_W) == 0))
+        return 0;
+    // the copy goes through the kernel's direct map, which
+    // leaves the user PTE's dirty bit alone; vmawriteback()
+    // goes by it. a translation is kept for writing only once
+    // the page is dirty.
+    if (write)
+        *pte |= PTE_D;
+    if (x)
+    {
+        x->pagetable = pagetable;
+        x->va        = va0;
+        x->pa        = PTE2PA(*pte);
+        x->gen       = gen;
+        x->write     = (*pte & (PTE_W | PTE_D)) == (PTE_W | PTE_D);
+    }
+    return PTE2PA(*pte);
 }
 
 // Copy from kernel to user.
 // Copy len bytes from src to virtual address dstva in a given page table.
 // Return 0 on success, -1 on error.
+// Addresses that the process's kernel page table maps are
+// written directly, the others a page at a time.
 // 从内核空间复制数据到用户空间虚拟地址。
 int copyout(pagetable_t pagetable, uint64 dstva, char* src, uint64 len)
 {
     uint64 n, va0, pa0;
 
+    if (ukmapped(pagetable, dstva, len))
+        return ucopy((char*)dstva, src, len);
     while (len > 0)
     {
         va0 = PGROUNDDOWN(dstva);
-        // 找到va0对应的物理数据表地址
-        pa0 = walkaddr(pagetable, va0);
-        if (pa0 == 0)
+        if ((pa0 = uvmxlate(pagetable, va0, 1)) == 0)
             return -1;
 
         // 虚拟地址连续的页可能物理空间不连续，所以最多一次只能复制一页的数据
@@ -413,11 +1052,12 @@ int copyin(pagetable_t pagetable, char* dst, uint64 srcva, uint64 len)
 {
     uint64 n, va0, pa0;
 
+    if (ukmapped(pagetable, srcva, len))
+        return ucopy(dst, (char*)srcva, len);
     while (len > 0)
     {
         va0 = PGROUNDDOWN(srcva);
-        pa0 = walkaddr(pagetable, va0);
-        if (pa0 == 0)
+        if ((pa0 = uvmxlate(pagetable, va0, 0)) == 0)
             return -1;
         n = PGSIZE - (srcva - va0);
         if (n > len)
@@ -441,11 +1081,12 @@ int copyinstr(pagetable_t pagetable, char* dst, uint64 srcva, uint64 max)
     uint64 n, va0, pa0;
     int    got_null = 0;
 
+    if (ukmapped(pagetable, srcva, max))
+        return ucopystr(dst, (char*)srcva, max);
     while (got_null == 0 && max > 0)
     {
         va0 = PGROUNDDOWN(srcva);
-        pa0 = walkaddr(pagetable, va0);
-        if (pa0 == 0)
+        if ((pa0 = uvmxlate(pagetable, va0, 0)) == 0)
             return -1;
         n = PGSIZE - (srcva - va0);
         if (n > max)
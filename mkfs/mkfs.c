@@ -4,11 +4,14 @@
 #include <string.h>
 #include <fcntl.h>
 #include <assert.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 
-#define stat xv6_stat   // avoid clash with host struct stat
 #include "kernel/types.h"
 #include "kernel/fs.h"
+#define stat xv6_stat   // avoid clash with host struct stat
 #include "kernel/stat.h"
+#undef stat
 #include "kernel/param.h"
 
 #ifndef static_assert
@@ -21,20 +24,26 @@
     } while (0)
 #endif
 
-#define NINODES 200
-
 // Disk layout:
 // [ boot block | sb block | log | inode blocks | free bit map | data blocks ]
-
-int nbitmap      = FSSIZE / BPB + 1;
-int ninodeblocks = NINODES / IPB + 1;
-int nlog         = LOGSIZE;
+//
+// The image is built in memory: the output file is sized and
+// mapped, so that rsect() and wsect() are copies. Each file's
+// blocks are allocated in one run before it is copied in, its
+// data first and then its indirect blocks, so that the kernel
+// reads it sequentially.
+
+int fssize  = FSSIZE;   // Blocks in the image (-s)
+int ninodes = 200;      // Inodes (-i)
+int nbitmap;
+int ninodeblocks;
+int nlog = LOGSIZE;
 int nmeta;     // Number of meta blocks (boot, sb, nlog, inode, bitmap)
 int nblocks;   // Number of data blocks
 
 int               fsfd;
+char*             img;   // the mapped image
 struct superblock sb;
-char              zeroes[BSIZE];
 uint              freeinode = 1;
 uint              freeblock;
 
@@ -46,6 +55,10 @@ void rinode(uint inum, struct dinode* ip);
 void rsect(uint sec, void* buf);
 uint ialloc(ushort type);
 void iappend(uint inum, void* p, int n);
+void iprealloc(uint inum, uint n);
+uint indirect_entry(uint addr, uint i);
+uint dixcreate(uint inum);
+void dixinsert(uint root, char* name, uint e);
 void die(const char*);
 
 // convert to riscv byte order
@@ -72,17 +85,29 @@ uint xint(uint x)
 int main(int argc, char* argv[])
 {
     int           i, cc, fd;
-    uint          rootino, inum, off;
+    uint          rootino, rootdix, inum, off;
     struct dirent de;
-    char          buf[BSIZE];
+    static char   buf[64 * BSIZE];
     struct dinode din;
+    struct stat   st;
 
 
     static_assert(sizeof(int) == 4, "Integers must be 4 bytes!");
 
-    if (argc < 2)
+    while (argc > 2 && argv[1][0] == '-')
     {
-        fprintf(stderr, "Usage: mkfs fs.img files...\n");
+        if (strcmp(argv[1], "-s") == 0)
+            fssize = atoi(argv[2]);
+        else if (strcmp(argv[1], "-i") == 0)
+            ninodes = atoi(argv[2]);
+        else
+            break;
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc < 2 || argv[1][0] == '-' || fssize <= 0 || ninodes <= 0)
+    {
+        fprintf(stderr, "Usage: mkfs [-s blocks] [-i inodes] fs.img files...\n");
         exit(1);
     }
 
@@ -92,29 +117,37 @@ int main(int argc, char* argv[])
     fsfd = open(argv[1], O_RDWR | O_CREAT | O_TRUNC, 0666);
     if (fsfd < 0)
         die(argv[1]);
+    // a fresh file of this size reads as zeroes.
+    if (ftruncate(fsfd, (off_t)fssize * BSIZE) < 0)
+        die("ftruncate");
+    img = mmap(0, (size_t)fssize * BSIZE, PROT_READ | PROT_WRITE, MAP_SHARED, fsfd, 0);
+    if (img == MAP_FAILED)
+        die("mmap");
 
     // 1 fs block = 1 disk sector
-    nmeta   = 2 + nlog + ninodeblocks + nbitmap;
-    nblocks = FSSIZE - nmeta;
+    nbitmap      = fssize / BPB + 1;
+    ninodeblocks = ninodes / IPB + 1;
+    nmeta        = 2 + nlog + ninodeblocks + nbitmap;
+    nblocks      = fssize - nmeta;
+    if (nblocks <= 0)
+        die("image too small");
 
     sb.magic      = FSMAGIC;
-    sb.size       = xint(FSSIZE);
+    sb.size       = xint(fssize);
     sb.nblocks    = xint(nblocks);
-    sb.ninodes    = xint(NINODES);
+    sb.ninodes    = xint(ninodes);
     sb.nlog       = xint(nlog);
     sb.logstart   = xint(2);
     sb.inodestart = xint(2 + nlog);
     sb.bmapstart  = xint(2 + nlog + ninodeblocks);
+    sb.features   = xint(FSF_DINDIRECT | FSF_DIRHASH);
 
     printf("nmeta %d (boot, super, log blocks %u inode blocks %u, bitmap blocks %u) blocks %d "
            "total %d\n",
-           nmeta, nlog, ninodeblocks, nbitmap, nblocks, FSSIZE);
+           nmeta, nlog, ninodeblocks, nbitmap, nblocks, fssize);
 
     freeblock = nmeta;   // the first free block that we can allocate
 
-    for (i = 0; i < FSSIZE; i++)
-        wsect(i, zeroes);
-
     memset(buf, 0, sizeof(buf));
     memmove(buf, &sb, sizeof(sb));
     wsect(1, buf);
@@ -132,6 +165,8 @@ int main(int argc, char* argv[])
     strcpy(de.name, "..");
     iappend(rootino, &de, sizeof(de));
 
+    rootdix = dixcreate(rootino);
+
     for (i = 2; i < argc; i++)
     {
         // get rid of "user/"
@@ -156,10 +191,15 @@ int main(int argc, char* argv[])
         assert(strlen(shortname) <= DIRSIZ);
 
         inum = ialloc(T_FILE);
+        if (fstat(fd, &st) < 0)
+            die(argv[i]);
+        iprealloc(inum, (st.st_size + BSIZE - 1) / BSIZE);
 
         bzero(&de, sizeof(de));
         de.inum = xshort(inum);
         strncpy(de.name, shortname, DIRSIZ);
+        rinode(rootino, &din);
+        dixinsert(rootdix, de.name, xint(din.size) / sizeof(de));
         iappend(rootino, &de, sizeof(de));
 
         while ((cc = read(fd, buf, sizeof(buf))) > 0)
@@ -177,15 +217,19 @@ int main(int argc, char* argv[])
 
     balloc(freeblock);
 
+    if (munmap(img, (size_t)fssize * BSIZE) < 0 || close(fsfd) < 0)
+        die(argv[1]);
     exit(0);
 }
 
 void wsect(uint sec, void* buf)
 {
-    if (lseek(fsfd, sec * BSIZE, 0) != sec * BSIZE)
-        die("lseek");
-    if (write(fsfd, buf, BSIZE) != BSIZE)
-        die("write");
+    if (sec >= fssize)
+    {
+        fprintf(stderr, "mkfs: image of %d blocks is full\n", fssize);
+        exit(1);
+    }
+    memmove(img + (size_t)sec * BSIZE, buf, BSIZE);
 }
 
 void winode(uint inum, struct dinode* ip)
@@ -215,10 +259,12 @@ void rinode(uint inum, struct dinode* ip)
 
 void rsect(uint sec, void* buf)
 {
-    if (lseek(fsfd, sec * BSIZE, 0) != sec * BSIZE)
-        die("lseek");
-    if (read(fsfd, buf, BSIZE) != BSIZE)
-        die("read");
+    if (sec >= fssize)
+    {
+        fprintf(stderr, "mkfs: image of %d blocks is full\n", fssize);
+        exit(1);
+    }
+    memmove(buf, img + (size_t)sec * BSIZE, BSIZE);
 }
 
 uint ialloc(ushort type)
@@ -234,23 +280,74 @@ uint ialloc(ushort type)
     return inum;
 }
 
+// Mark the first used blocks allocated, in as many bitmap
+// blocks as that takes; they are all zero beforehand.
 void balloc(int used)
 {
-    uchar buf[BSIZE];
-    int   i;
+    uchar* bits = (uchar*)img + (size_t)xint(sb.bmapstart) * BSIZE;
+    int    i;
 
     printf("balloc: first %d blocks have been allocated\n", used);
-    assert(used < BPB);
-    bzero(buf, BSIZE);
-    for (i = 0; i < used; i++)
+    assert(used <= fssize);
+    memset(bits, 0xff, used / 8);
+    for (i = used / 8 * 8; i < used; i++)
+        bits[i / 8] |= 0x1 << (i % 8);
+    printf("balloc: write bitmap blocks at sector %d\n", xint(sb.bmapstart));
+}
+
+#define min(a, b) ((a) < (b) ? (a) : (b))
+
+// Return entry i of the indirect block at addr, allocating a
+// block for it if it is empty.
+uint indirect_entry(uint addr, uint i)
+{
+    uint indirect[NINDIRECT];
+
+    rsect(addr, (char*)indirect);
+    if (indirect[i] == 0)
     {
-        buf[i / 8] = buf[i / 8] | (0x1 << (i % 8));
+        indirect[i] = xint(freeblock++);
+        wsect(addr, (char*)indirect);
     }
-    printf("balloc: write bitmap block at sector %d\n", sb.bmapstart);
-    wsect(sb.bmapstart, buf);
+    return xint(indirect[i]);
 }
 
-#define min(a, b) ((a) < (b) ? (a) : (b))
+// Allocate the first n blocks of the empty file inum in one
+// run, then the indirect blocks that map them, each filled in,
+// so that iappend() finds every block it needs in place.
+void iprealloc(uint inum, uint n)
+{
+    struct dinode din;
+    uint          data = freeblock, fbn, x, ind[NINDIRECT];
+
+    assert(n <= MAXFILE);
+    freeblock += n;
+    rinode(inum, &din);
+    for (fbn = 0; fbn < n; fbn++)
+    {
+        if (fbn < NDIRECT)
+            din.addrs[fbn] = xint(data + fbn);
+        else if (fbn < NDIRECT + NINDIRECT)
+        {
+            if (xint(din.addrs[NDIRECT]) == 0)
+                din.addrs[NDIRECT] = xint(freeblock++);
+            rsect(xint(din.addrs[NDIRECT]), ind);
+            ind[fbn - NDIRECT] = xint(data + fbn);
+            wsect(xint(din.addrs[NDIRECT]), ind);
+        }
+        else
+        {
+            if (xint(din.addrs[NDIRECT + 1]) == 0)
+                din.addrs[NDIRECT + 1] = xint(freeblock++);
+            x = fbn - NDIRECT - NINDIRECT;
+            x = indirect_entry(xint(din.addrs[NDIRECT + 1]), x / NINDIRECT);
+            rsect(x, ind);
+            ind[(fbn - NDIRECT - NINDIRECT) % NINDIRECT] = xint(data + fbn);
+            wsect(x, ind);
+        }
+    }
+    winode(inum, &din);
+}
 
 void iappend(uint inum, void* xp, int n)
 {
@@ -258,7 +355,6 @@ void iappend(uint inum, void* xp, int n)
     uint          fbn, off, n1;
     struct dinode din;
     char          buf[BSIZE];
-    uint          indirect[NINDIRECT];
     uint          x;
 
     rinode(inum, &din);
@@ -276,19 +372,23 @@ void iappend(uint inum, void* xp, int n)
             }
             x = xint(din.addrs[fbn]);
         }
-        else
+        else if (fbn < NDIRECT + NINDIRECT)
         {
             if (xint(din.addrs[NDIRECT]) == 0)
             {
                 din.addrs[NDIRECT] = xint(freeblock++);
             }
-            rsect(xint(din.addrs[NDIRECT]), (char*)indirect);
-            if (indirect[fbn - NDIRECT] == 0)
+            x = indirect_entry(xint(din.addrs[NDIRECT]), fbn - NDIRECT);
+        }
+        else
+        {
+            if (xint(din.addrs[NDIRECT + 1]) == 0)
             {
-                indirect[fbn - NDIRECT] = xint(freeblock++);
-                wsect(xint(din.addrs[NDIRECT]), (char*)indirect);
+                din.addrs[NDIRECT + 1] = xint(freeblock++);
             }
-            x = xint(indirect[fbn - NDIRECT]);
+            x = fbn - NDIRECT - NINDIRECT;
+            x = indirect_entry(indirect_entry(xint(din.addrs[NDIRECT + 1]), x / NINDIRECT),
+                               x % NINDIRECT);
         }
         n1 = min(n, (fbn + 1) * BSIZE - off);
         rsect(x, buf);
@@ -302,6 +402,67 @@ void iappend(uint inum, void* xp, int n)
     winode(inum, &din);
 }
 
+// Hash a directory entry name, as dirhash() in kernel/fs.c.
+uint dirhash(char* name)
+{
+    uint h = 0;
+    int  i;
+
+    for (i = 0; i < DIRSIZ && name[i]; i++)
+        h = h * 31 + (uchar)name[i];
+    return h;
+}
+
+// Give directory inum, which holds only "." and "..", an empty
+// hash index, and return its root block.
+uint dixcreate(uint inum)
+{
+    struct dinode   din;
+    struct dirindex dx;
+    uint            root = freeblock++;
+
+    bzero(&dx, sizeof(dx));
+    dx.magic = xint(DIXMAGIC);
+    dx.free  = xint(2);
+    wsect(root, &dx);
+
+    rinode(inum, &din);
+    din.addrs[NDIRECT + 1] = xint(root);
+    winode(inum, &din);
+    return root;
+}
+
+// Add entry number e, holding name, to the hash index at root,
+// and move the index's free hint past it.
+void dixinsert(uint root, char* name, uint e)
+{
+    struct dirindex dx;
+    ushort          slot[DIXSLOTS];
+    uint            h = dirhash(name), leaf, i, k;
+
+    rsect(root, &dx);
+    if ((leaf = xint(dx.leaf[h % DIXLEAVES])) == 0)
+    {
+        leaf                   = freeblock++;   // already zeroed
+        dx.leaf[h % DIXLEAVES] = xint(leaf);
+    }
+    dx.free = xint(e + 1);
+    wsect(root, &dx);
+
+    rsect(leaf, slot);
+    for (i = 0; i < DIXSLOTS; i++)
+    {
+        k = (h / DIXLEAVES + i) % DIXSLOTS;
+        if (slot[k] == 0)
+        {
+            slot[k] = xshort(e);
+            wsect(leaf, slot);
+            return;
+        }
+    }
+    die("dixinsert: leaf full");
+}
+
 void die(const char* s)
 {
     perror(s);
@@ -0,0 +1,320 @@
+// Find the files under a directory, optionally by name.
+//
+// usage: find [-P nworkers] [-s] path [name]
+//
+// Prints every path under path, path included, whose last
+// element is name, or every path if no name is given. The
+// directories are read by a pool of nworkers forked workers.
+// Each has a pipe on which the parent sends it one directory at
+// a time and a pipe on which it sends back the entries, a line
+// each: 'd' or 'f' for a directory or anything else, then the
+// path, with an empty line at the end of the directory. A
+// worker reads a directory with getdents(), which returns the
+// names and inode status of a block of entries at a time. The
+// parent prints the entries and queues the subdirectories; it
+// waits on the busy workers in turn, and hands each another
+// directory as soon as it is done. With
+// -s, the number of entries and entries per second are printed
+// to the standard error at the end.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/param.h"
+#include "kernel/fs.h"
+#include "user/user.h"
+
+#define NWORKER ((NOFILE - 3) / 2)   // most workers, with two pipe ends each besides fds 0-2
+#define HZ      10                   // ticks a second, for TICKCYCLES in kernel/param.h under qemu
+
+// Buffered reading of lines from a pipe.
+struct rbuf
+{
+    int  fd;
+    int  pos, len;
+    char buf[512];
+};
+
+struct worker
+{
+    int         req;    // write end of the pipe of directories
+    struct rbuf res;    // read end of the pipe of entries
+    int         busy;   // has a directory to read
+};
+
+// a directory waiting for a worker.
+struct qent
+{
+    struct qent* next;
+    char         path[];
+};
+
+static struct worker workers[NWORKER];
+static int           nworkers = 4;
+static struct qent*  qhead;
+static struct qent*  qtail;
+static char*         name;       // name to look for, or 0 for any
+static int           nentries;   // entries seen
+
+// Read a line into line, which has room for MAXPATH bytes,
+// without its newline. Returns its length, or -1 at end of file.
+// Longer lines are cut short.
+// 从管道读取一行
+static int readline(struct rbuf* r, char* line)
+{
+    int n = 0, c;
+
+    for (;;)
+    {
+        if (r->pos == r->len)
+        {
+            if ((r->len = read(r->fd, r->buf, sizeof(r->buf))) <= 0)
+            {
+                r->len = r->pos = 0;
+                return n > 0 ? n : -1;
+            }
+            r->pos = 0;
+        }
+        if ((c = r->buf[r->pos++]) == '\n')
+            break;
+        if (n < MAXPATH - 1)
+            line[n++] = c;
+    }
+    line[n] = 0;
+    return n;
+}
+
+// A worker: read each directory sent on fd and send back its
+// entries on out.
+// 工作进程：读取收到的每个目录，将其中的目录项发回
+static void worker(int fd, int out)
+{
+    static struct dirstat ents[BSIZE / sizeof(struct dirent)];
+    static char           obuf[1024];
+    struct rbuf           r = {fd};
+    char                  path[MAXPATH];
+    int                   dfd, n, i, len, m, o = 0;
+
+    while ((len = readline(&r, path)) >= 0)
+    {
+        if ((dfd = open(path, 0)) < 0)
+        {
+            fprintf(2, "find: cannot open %s\n", path);
+        }
+        else
+        {
+            while ((n = getdents(dfd, ents, sizeof(ents) / sizeof(ents[0]))) > 0)
+            {
+                for (i = 0; i < n; i++)
+                {
+                    if (strcmp(ents[i].name, ".") == 0 || strcmp(ents[i].name, "..") == 0)
+                        continue;
+                    m = strlen(ents[i].name);
+                    if (len + 1 + m + 1 > MAXPATH - 1)
+                    {
+                        fprintf(2, "find: %s/%s: path too long\n", path, ents[i].name);
+                        continue;
+                    }
+                    if (o + 1 + len + 1 + m + 1 > sizeof(obuf))
+                    {
+                        write(out, obuf, o);
+                        o = 0;
+                    }
+                    obuf[o++] = ents[i].st.type == T_DIR ? 'd' : 'f';
+                    memmove(obuf + o, path, len);
+                    o += len;
+                    obuf[o++] = '/';
+                    memmove(obuf + o, ents[i].name, m);
+                    o += m;
+                    obuf[o++] = '\n';
+                }
+            }
+            if (n < 0)
+                fprintf(2, "find: cannot read %s\n", path);
+            close(dfd);
+        }
+        if (o + 1 > sizeof(obuf))
+        {
+            write(out, obuf, o);
+            o = 0;
+        }
+        obuf[o++] = '\n';
+        write(out, obuf, o);
+        o = 0;
+    }
+    exit(0);
+}
+
+// Print path if its last element is the name looked for.
+// 若路径的最后一段与要找的名字相同则打印
+static void match(char* path)
+{
+    char* p;
+
+    nentries++;
+    for (p = path + strlen(path); p > path && p[-1] != '/'; p--)
+        ;
+    if (name == 0 || strcmp(p, name) == 0)
+        printf("%s\n", path);
+}
+
+// 将目录加入等待队列
+static void enqueue(char* path)
+{
+    struct qent* q;
+
+    if ((q = malloc(sizeof(*q) + strlen(path) + 1)) == 0)
+    {
+        fprintf(2, "find: out of memory\n");
+        exit(1);
+    }
+    strcpy(q->path, path);
+    q->next = 0;
+    if (qtail)
+        qtail->next = q;
+    else
+        qhead = q;
+    qtail = q;
+}
+
+// Hand queued directories to idle workers.
+// 将队列中的目录分给空闲的工作进程
+static void dispatch(void)
+{
+    struct worker* w;
+    struct qent*   q;
+    int            n;
+
+    for (w = workers; w < &workers[nworkers] && qhead; w++)
+    {
+        if (w->busy)
+            continue;
+        q     = qhead;
+        qhead = q->next;
+        if (qhead == 0)
+            qtail = 0;
+        n          = strlen(q->path);
+        q->path[n] = '\n';
+        write(w->req, q->path, n + 1);
+        free(q);
+        w->busy = 1;
+    }
+}
+
+// Take the entries of the directory w was given.
+// 接收工作进程读到的目录项
+static void collect(struct worker* w)
+{
+    char line[MAXPATH];
+    int  n;
+
+    while ((n = readline(&w->res, line)) > 0)
+    {
+        match(line + 1);
+        if (line[0] == 'd')
+            enqueue(line + 1);
+    }
+    if (n < 0)
+    {
+        fprintf(2, "find: a worker died\n");
+        exit(1);
+    }
+    w->busy = 0;
+}
+
+// Start the workers, each with its pair of pipes.
+// 创建工作进程及其管道
+static void startworkers(void)
+{
+    int req[2], res[2], i, j;
+
+    for (i = 0; i < nworkers; i++)
+    {
+        if (pipe(req) < 0 || pipe(res) < 0)
+        {
+            fprintf(2, "find: pipe failed\n");
+            exit(1);
+        }
+        if (fork() == 0)
+        {
+            // only this worker's own pipe ends, so that each
+            // sees end of file when the parent closes its end.
+            for (j = 0; j < i; j++)
+            {
+                close(workers[j].req);
+                close(workers[j].res.fd);
+            }
+            close(req[1]);
+            close(res[0]);
+            worker(req[0], res[1]);
+        }
+        close(req[0]);
+        close(res[1]);
+        workers[i].req    = req[1];
+        workers[i].res.fd = res[0];
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    struct stat st;
+    int         i, busy, stats = 0, t0, t;
+
+    for (i = 1; i < argc && argv[i][0] == '-'; i++)
+    {
+        if (strcmp(argv[i], "-P") == 0 && i + 1 < argc)
+            nworkers = atoi(argv[++i]);
+        else if (strcmp(argv[i], "-s") == 0)
+            stats = 1;
+        else
+            break;
+    }
+    if (i >= argc || i + 2 < argc || nworkers < 1 || nworkers > NWORKER)
+    {
+        fprintf(2, "usage: find [-P nworkers] [-s] path [name]\n");
+        exit(1);
+    }
+    if (i + 1 < argc)
+        name = argv[i + 1];
+    if (strlen(argv[i]) >= MAXPATH || stat(argv[i], &st) < 0)
+    {
+        fprintf(2, "find: cannot stat %s\n", argv[i]);
+        exit(1);
+    }
+
+    t0 = uptime();
+    match(argv[i]);
+    if (st.type == T_DIR)
+    {
+        startworkers();
+        enqueue(argv[i]);
+        dispatch();
+        // wait on the busy workers in turn, refilling each as
+        // soon as it is done.
+        do
+        {
+            busy = 0;
+            for (i = 0; i < nworkers; i++)
+            {
+                if (!workers[i].busy)
+                    continue;
+                collect(&workers[i]);
+                dispatch();
+                busy = 1;
+            }
+        } while (busy);
+        for (i = 0; i < nworkers; i++)
+            close(workers[i].req);
+        for (i = 0; i < nworkers; i++)
+            wait(0);
+    }
+
+    if (stats)
+    {
+        t = uptime() - t0;
+        fprintf(2, "find: %d entries in %d ticks", nentries, t);
+        if (t > 0)
+            fprintf(2, ", %d a second", nentries * HZ / t);
+        fprintf(2, "\n");
+    }
+    exit(0);
+}
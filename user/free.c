@@ -0,0 +1,27 @@
+// Print how much physical memory is free and in use, how much
+// merging identical pages saves, and how many processes and
+// open files there are.
+//
+// usage: free
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/sysinfo.h"
+#include "user/user.h"
+
+int main(int argc, char* argv[])
+{
+    struct sysinfo si;
+
+    if (sysinfo(&si) < 0)
+    {
+        fprintf(2, "free: sysinfo failed\n");
+        exit(1);
+    }
+    printf("\ttotal(K)\tused(K)\t\tfree(K)\n");
+    printf("mem\t%d\t\t%d\t\t%d\n", (int)(si.totalmem / 1024), (int)((si.totalmem - si.freemem) / 1024),
+           (int)(si.freemem / 1024));
+    printf("merged identical pages save %dK\n", (int)(si.merged / 1024));
+    printf("processes %d of %d, open files %d\n", (int)si.nproc, NPROC, (int)si.nfile);
+    exit(0);
+}
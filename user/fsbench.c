@@ -0,0 +1,262 @@
+// File system benchmarks, to judge file system and process
+// changes against a baseline. Each is run by nprocs forked
+// processes at once, each on files of its own, and timed with
+// the time counter from the fork of the first to the exit of
+// the last:
+//
+//   write   sequential writes of a kb KiB file each, in MB/s
+//   read    sequential reads of the same files, in MB/s
+//   create  creates of small files, a second
+//   lookup  stat() of those files by name, us each
+//   unlink  unlinks of the files, a second
+//   exec    fork, exec and wait of a program that exits, us each
+//
+// usage: fsbench [-P nprocs] [-s kb]
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define TIMEHZ  10000000   // time counter rate under qemu, as TICKCYCLES in kernel/param.h
+#define MAXPROC 8          // most processes
+#define NSMALL  100        // small files each process creates
+#define NLOOKUP 10         // lookups of each small file
+#define NEXEC   20         // fork+exec each process runs
+#define CHUNK   8192       // bytes a read() or write()
+
+static char buf[CHUNK];
+static int  nprocs = 1;
+static int  kb     = 1024;
+
+// Read the time counter, which start.c lets user mode read.
+static inline uint64 rdtime(void)
+{
+    uint64 x;
+    asm volatile("rdtime %0" : "=r"(x));
+    return x;
+}
+
+// 打印失败的操作并退出
+static void fail(char* what)
+{
+    fprintf(2, "fsbench: %s failed\n", what);
+    exit(1);
+}
+
+// Set name to "fsb<p>" or, for small file i of process p,
+// "fsb<p>/<i>".
+// 生成第 p 个进程的目录名或其中第 i 个小文件的路径
+static void mkname(char* name, int p, int i)
+{
+    char* s = name;
+
+    *s++ = 'f';
+    *s++ = 's';
+    *s++ = 'b';
+    *s++ = '0' + p;
+    if (i >= 0)
+    {
+        *s++ = '/';
+        *s++ = '0' + i / 100 % 10;
+        *s++ = '0' + i / 10 % 10;
+        *s++ = '0' + i % 10;
+    }
+    *s = 0;
+}
+
+// The benchmarks, each run in process p of the nprocs.
+// 顺序写入本进程的大文件
+static void seqwrite(int p)
+{
+    char name[16];
+    int  fd, n;
+
+    mkname(name, p, -1);
+    strcpy(name + strlen(name), ".big");
+    if ((fd = open(name, O_CREATE | O_TRUNC | O_WRONLY)) < 0)
+        fail("open");
+    for (n = 0; n < kb * 1024; n += CHUNK)
+        if (write(fd, buf, CHUNK) != CHUNK)
+            fail("write");
+    close(fd);
+}
+
+// 顺序读取本进程的大文件
+static void seqread(int p)
+{
+    char name[16];
+    int  fd, n, tot = 0;
+
+    mkname(name, p, -1);
+    strcpy(name + strlen(name), ".big");
+    if ((fd = open(name, O_RDONLY)) < 0)
+        fail("open");
+    while ((n = read(fd, buf, CHUNK)) > 0)
+        tot += n;
+    if (tot != kb * 1024)
+        fail("read");
+    close(fd);
+}
+
+// 在本进程的目录下创建小文件
+static void create(int p)
+{
+    char name[16];
+    int  fd, i;
+
+    for (i = 0; i < NSMALL; i++)
+    {
+        mkname(name, p, i);
+        if ((fd = open(name, O_CREATE | O_WRONLY)) < 0)
+            fail("create");
+        if (write(fd, buf, 64) != 64)
+            fail("write");
+        close(fd);
+    }
+}
+
+// 按名字查找小文件
+static void lookup(int p)
+{
+    struct stat st;
+    char        name[16];
+    int         i, r;
+
+    for (r = 0; r < NLOOKUP; r++)
+    {
+        for (i = 0; i < NSMALL; i++)
+        {
+            mkname(name, p, i);
+            if (stat(name, &st) < 0)
+                fail("stat");
+        }
+    }
+}
+
+// 删除小文件
+static void unlinkall(int p)
+{
+    char name[16];
+    int  i;
+
+    for (i = 0; i < NSMALL; i++)
+    {
+        mkname(name, p, i);
+        if (unlink(name) < 0)
+            fail("unlink");
+    }
+}
+
+// 反复 fork 并 exec 一个立即退出的程序
+static void forkexec(int p)
+{
+    char* argv[] = {"fsbench", "-exit", 0};
+    int   i, pid;
+
+    for (i = 0; i < NEXEC; i++)
+    {
+        if ((pid = fork()) < 0)
+            fail("fork");
+        if (pid == 0)
+        {
+            exec("fsbench", argv);
+            fail("exec");
+        }
+        wait(0);
+    }
+}
+
+// Run f in nprocs processes at once, and return the time
+// counter ticks from the first fork to the last exit.
+// 在 nprocs 个进程中同时运行 f，返回总耗时
+static uint64 run(void (*f)(int))
+{
+    uint64 t0 = rdtime();
+    int    p, xstatus;
+
+    for (p = 0; p < nprocs; p++)
+    {
+        int pid = fork();
+        if (pid < 0)
+            fail("fork");
+        if (pid == 0)
+        {
+            f(p);
+            exit(0);
+        }
+    }
+    for (p = 0; p < nprocs; p++)
+    {
+        wait(&xstatus);
+        if (xstatus != 0)
+            exit(1);
+    }
+    return rdtime() - t0;
+}
+
+// Print the rate of n KiB in t time counter ticks, in MB/s.
+// 打印吞吐量（MB/s）
+static void mbps(char* what, int n, uint64 t)
+{
+    uint64 k = t ? (uint64)n * TIMEHZ / t : 0;   // KiB a second
+
+    printf("%s\t%d.%d MB/s\n", what, (int)(k / 1024), (int)(k % 1024 * 10 / 1024));
+}
+
+// Print the rate of n operations in t ticks, a second and
+// in us each.
+// 打印每秒操作数与每次操作的微秒数
+static void ops(char* what, int n, uint64 t)
+{
+    printf("%s\t%d/s\t%d us\n", what, t ? (int)((uint64)n * TIMEHZ / t) : 0,
+           (int)(t * 1000000 / TIMEHZ / n));
+}
+
+int main(int argc, char* argv[])
+{
+    char name[16];
+    int  i, p;
+
+    if (argc == 2 && strcmp(argv[1], "-exit") == 0)
+        exit(0);
+    for (i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-P") == 0)
+            nprocs = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-s") == 0)
+            kb = atoi(argv[i + 1]);
+        else
+            break;
+    }
+    if (i < argc || nprocs < 1 || nprocs > MAXPROC || kb < CHUNK / 1024)
+    {
+        fprintf(2, "usage: fsbench [-P nprocs] [-s kb]\n");
+        exit(1);
+    }
+    kb = kb / (CHUNK / 1024) * (CHUNK / 1024);
+    for (i = 0; i < CHUNK; i++)
+        buf[i] = 'a' + i % 26;
+    for (p = 0; p < nprocs; p++)
+    {
+        mkname(name, p, -1);
+        mkdir(name);   // may be left by an interrupted run
+    }
+
+    printf("fsbench: %d processes, %d KiB files\n", nprocs, kb);
+    mbps("write", nprocs * kb, run(seqwrite));
+    mbps("read", nprocs * kb, run(seqread));
+    ops("create", nprocs * NSMALL, run(create));
+    ops("lookup", nprocs * NSMALL * NLOOKUP, run(lookup));
+    ops("unlink", nprocs * NSMALL, run(unlinkall));
+    ops("exec", nprocs * NEXEC, run(forkexec));
+
+    for (p = 0; p < nprocs; p++)
+    {
+        mkname(name, p, -1);
+        unlink(name);
+        strcpy(name + strlen(name), ".big");
+        unlink(name);
+    }
+    exit(0);
+}
@@ -1,56 +1,230 @@
 // Simple grep.  Only supports ^ . * $ operators.
+//
+// The pattern is compiled once into a list of items, each a
+// character or '.', maybe starred, and matched against a line
+// as an NFA whose states are kept as bits of one word: bit i
+// set means that the first i items have matched, so each
+// character of a line costs a few word operations, however
+// many stars there are. If the pattern has a run of plain
+// characters, lines are first searched for that literal with
+// Boyer-Moore-Horspool, and only lines that contain it are
+// run through the NFA.
 
 #include "kernel/types.h"
 #include "kernel/stat.h"
 #include "user/user.h"
 
-char buf[1024];
-int  match(char*, char*);
+#define NRE   63      // most items in a pattern, with one bit left for the accept state
+#define BUFSZ 16384   // bytes read at a time; longer lines are split
 
-void grep(char* pattern, int fd)
+struct item
 {
-    int   n, m;
-    char *p, *q;
+    char c;      // character to match
+    char any;    // '.': matches any character
+    char star;   // repeated zero or more times
+};
 
-    m = 0;
-    while ((n = read(fd, buf + m, sizeof(buf) - m - 1)) > 0)
+char buf[BUFSZ];
+
+static struct item re[NRE];
+static int         nre;
+static int         bol;            // pattern starts with ^
+static int         eol;            // pattern ends with $
+static uint64      mask[256];      // items matching each character
+static uint64      starmask;       // starred items
+static uint64      start;          // states before the first character
+static char        lit[NRE];       // longest run of plain characters
+static int         nlit;           // its length, 0 if there is none
+static int         skip[256];      // Boyer-Moore-Horspool shifts for lit
+
+// Add to set the states reachable by skipping starred items.
+// 加入跳过带星号项后可达的状态
+static uint64 closure(uint64 set)
+{
+    uint64 n;
+
+    while ((n = set | (set & starmask) << 1) != set)
+        set = n;
+    return set;
+}
+
+// Compile pattern into re and the masks and literal used to
+// run it. Returns -1 if it is too long.
+// 编译模式串：生成 NFA 的位掩码与字面量预筛选表
+int compile(char* pattern)
+{
+    char* p = pattern;
+    int   i, n, c, first = 0;
+
+    if (*p == '^')
     {
-        m += n;
-        buf[m] = '\0';
-        p      = buf;
-        while ((q = strchr(p, '\n')) != 0)
+        bol = 1;
+        p++;
+    }
+    for (; *p; p++)
+    {
+        if (p[0] == '$' && p[1] == '\0')
         {
-            *q = 0;
-            if (match(pattern, p))
-            {
-                *q = '\n';
-                write(1, p, q + 1 - p);
-            }
-            p = q + 1;
+            eol = 1;
+            break;
+        }
+        if (nre == NRE)
+            return -1;
+        re[nre].c    = *p;
+        re[nre].any  = *p == '.';
+        re[nre].star = p[1] == '*';
+        if (re[nre].star)
+            p++;
+        nre++;
+    }
+
+    for (i = 0; i < nre; i++)
+    {
+        for (c = 0; c < 256; c++)
+            if (re[i].any || (uchar)re[i].c == c)
+                mask[c] |= 1ULL << i;
+        if (re[i].star)
+            starmask |= 1ULL << i;
+    }
+    start = closure(1);
+
+    // the longest run of plain characters, for search().
+    for (i = 0, n = 0; i <= nre; i++)
+    {
+        if (i < nre && !re[i].any && !re[i].star && re[i].c != '\n')
+        {
+            n++;
+            continue;
+        }
+        if (n > nlit)
+        {
+            nlit  = n;
+            first = i - n;
+        }
+        n = 0;
+    }
+    for (i = 0; i < nlit; i++)
+        lit[i] = re[first + i].c;
+    if (nlit)
+    {
+        for (c = 0; c < 256; c++)
+            skip[c] = nlit;
+        for (i = 0; i < nlit - 1; i++)
+            skip[(uchar)lit[i]] = nlit - 1 - i;
+    }
+    return 0;
+}
+
+// Find lit in [p, e). Returns where it starts, or 0.
+// 用 Boyer-Moore-Horspool 算法查找字面量
+static char* search(char* p, char* e)
+{
+    char* last = lit + nlit - 1;
+    char *s, *t, *u;
+
+    for (s = p + nlit - 1; s < e; s += skip[(uchar)*s])
+    {
+        for (t = s, u = last; *t == *u; t--, u--)
+            if (u == lit)
+                return t;
+    }
+    return 0;
+}
+
+// Return whether the line [p, e) matches the pattern.
+// 用位并行 NFA 判断一行是否匹配
+static int matchline(char* p, char* e)
+{
+    uint64 set = start, acc = 1ULL << nre, t;
+
+    for (;; p++)
+    {
+        if ((set & acc) && (!eol || p == e))
+            return 1;
+        if (p == e || set == 0)
+            return 0;
+        t   = set & mask[(uchar)*p];
+        set = (t & ~starmask) << 1 | (t & starmask);
+        if (!bol)
+            set |= 1;
+        set = closure(set);
+    }
+}
+
+// Print the lines of [p, e) that match, each ended by a
+// newline except maybe the last.
+// 输出 [p, e) 中匹配的行
+static void matchlines(char* p, char* e)
+{
+    char *q, *h;
+
+    while (p < e)
+    {
+        if (nlit)
+        {
+            // go straight to the next line holding the literal.
+            if ((h = search(p, e)) == 0)
+                return;
+            for (q = h; q > p && q[-1] != '\n'; q--)
+                ;
+            p = q;
         }
-        if (m > 0)
+        if ((q = memchr(p, '\n', e - p)) == 0)
+            q = e;
+        if (matchline(p, q))
         {
-            m -= p - buf;
-            memmove(buf, p, m);
+            if (q < e)
+                write(1, p, q + 1 - p);
+            else
+            {
+                write(1, p, q - p);
+                write(1, "\n", 1);
+            }
         }
+        p = q + 1;
     }
 }
 
+void grep(int fd)
+{
+    int   n, m;
+    char* q;
+
+    m = 0;
+    while ((n = read(fd, buf + m, sizeof(buf) - m)) > 0)
+    {
+        m += n;
+        for (q = buf + m; q > buf && q[-1] != '\n'; q--)
+            ;
+        if (q == buf && m == sizeof(buf))
+            q = buf + m;   // a line too long for buf
+        matchlines(buf, q);
+        m -= q - buf;
+        memmove(buf, q, m);
+    }
+    // a last line without a newline.
+    if (m > 0)
+        matchlines(buf, buf + m);
+}
+
 int main(int argc, char* argv[])
 {
-    int   fd, i;
-    char* pattern;
+    int fd, i;
 
     if (argc <= 1)
     {
         fprintf(2, "usage: grep pattern [file ...]\n");
         exit(1);
     }
-    pattern = argv[1];
+    if (compile(argv[1]) < 0)
+    {
+        fprintf(2, "grep: pattern too long\n");
+        exit(1);
+    }
 
     if (argc <= 2)
     {
-        grep(pattern, 0);
+        grep(0);
         exit(0);
     }
 
@@ -61,52 +235,8 @@ int main(int argc, char* argv[])
             printf("grep: cannot open %s\n", argv[i]);
             exit(1);
         }
-        grep(pattern, fd);
+        grep(fd);
         close(fd);
     }
     exit(0);
 }
-
-// Regexp matcher from Kernighan & Pike,
-// The Practice of Programming, Chapter 9, or
-// https://www.cs.princeton.edu/courses/archive/spr09/cos333/beautiful.html
-
-int matchhere(char*, char*);
-int matchstar(int, char*, char*);
-
-int match(char* re, char* text)
-{
-    if (re[0] == '^')
-        return matchhere(re + 1, text);
-    do
-    {   // must look at empty string
-        if (matchhere(re, text))
-            return 1;
-    } while (*text++ != '\0');
-    return 0;
-}
-
-// matchhere: search for re at beginning of text
-int matchhere(char* re, char* text)
-{
-    if (re[0] == '\0')
-        return 1;
-    if (re[1] == '*')
-        return matchstar(re[0], re + 2, text);
-    if (re[0] == '$' && re[1] == '\0')
-        return *text == '\0';
-    if (*text != '\0' && (re[0] == '.' || re[0] == *text))
-        return matchhere(re + 1, text + 1);
-    return 0;
-}
-
-// matchstar: search for c*re at beginning of text
-int matchstar(int c, char* re, char* text)
-{
-    do
-    {   // a * matches zero or more instances
-        if (matchhere(re, text))
-            return 1;
-    } while (*text != '\0' && (*text++ == c || c == '.'));
-    return 0;
-}
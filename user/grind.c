@@ -1,5 +1,9 @@
 //
-// run random system calls in parallel forever.
+// run random system calls in parallel forever or, with -t, in
+// one grinder a CPU for secs seconds, counting the calls each
+// completes by kind to report throughput (see grind-scale).
+//
+// usage: grind [-t secs [-P ngrinders]]
 //
 
 #include "kernel/param.h"
@@ -11,6 +15,29 @@
 #include "kernel/syscall.h"
 #include "kernel/memlayout.h"
 #include "kernel/riscv.h"
+#include "kernel/sysinfo.h"
+
+#define NOP      23         // kinds of operation go() picks from
+#define MAXGRIND NCPU       // most grinders with -t
+#define TIMEHZ   10000000   // time counter rate under qemu, as TICKCYCLES in kernel/param.h
+
+// The operations, in the order of go()'s cases.
+static char* opnames[NOP] = {
+    "nop",    "createa", "createb",  "unlinka", "unlinkb", "opena", "openb", "write",
+    "read",   "mkdira",  "mkdirb",   "linkb",   "linka",   "fork",  "forks", "grow",
+    "shrink", "kill",    "killself", "pipe",    "rmcwd",   "statc", "exec",
+};
+
+static uint64 deadline;    // rdtime() at which go() returns; 0 for never
+static uint64 nops[NOP];   // operations go() completed, by kind
+
+// Read the time counter, which start.c lets user mode read.
+static inline uint64 rdtime(void)
+{
+    uint64 x;
+    asm volatile("rdtime %0" : "=r"(x));
+    return x;
+}
 
 // from FreeBSD.
 int do_rand(unsigned long* ctx)
@@ -63,9 +90,9 @@ void go(int which_child)
     while (1)
     {
         iters++;
-        if ((iters % 500) == 0)
+        if ((iters % 500) == 0 && deadline == 0)
             write(1, which_child ? "B" : "A", 1);
-        int what = rand() % 23;
+        int what = rand() % NOP;
         if (what == 1)
         {
             close(open("grindir/../a", O_CREATE | O_RDWR));
@@ -370,6 +397,9 @@ void go(int which_child)
                 exit(1);
             }
         }
+        nops[what]++;
+        if (deadline && rdtime() >= deadline)
+            return;
     }
 }
 
@@ -417,8 +447,111 @@ void iter()
     exit(0);
 }
 
-int main()
+// Run n grinders at once until secs seconds from now, each
+// sending its counts back through a pipe of its own, then print
+// the operations completed of each kind, each grinder's rate,
+// and the total rate, a second and a second per CPU.
+// 同时运行 n 个 grinder secs 秒，打印各类操作的吞吐量
+void timed(int secs, int n)
+{
+    static uint64  counts[MAXGRIND][NOP];
+    struct sysinfo si;
+    uint64         t0, t, sum, total = 0;
+    int            fds[MAXGRIND], p[2], i, j, r, pid, cpus = 1;
+
+    if (sysinfo(&si) == 0 && si.ncpu > 0)
+        cpus = si.ncpu;
+    if (n == 0)
+        n = cpus < MAXGRIND ? cpus : MAXGRIND;
+    unlink("a");
+    unlink("b");
+    printf("grind: %d grinders on %d cpus for %d s\n", n, cpus, secs);
+
+    t0       = rdtime();
+    deadline = t0 + (uint64)secs * TIMEHZ;
+    for (i = 0; i < n; i++)
+    {
+        if (pipe(p) < 0)
+        {
+            printf("grind: pipe failed\n");
+            exit(1);
+        }
+        if ((pid = fork()) < 0)
+        {
+            printf("grind: fork failed\n");
+            exit(1);
+        }
+        if (pid == 0)
+        {
+            for (j = 0; j < i; j++)
+                close(fds[j]);
+            close(p[0]);
+            rand_next = 1 + i * 7177;
+            go(i & 1);
+            write(p[1], nops, sizeof(nops));
+            exit(0);
+        }
+        close(p[1]);
+        fds[i] = p[0];
+    }
+    for (i = 0; i < n; i++)
+    {
+        for (j = 0; j < sizeof(counts[i]); j += r)
+        {
+            if ((r = read(fds[i], (char*)counts[i] + j, sizeof(counts[i]) - j)) <= 0)
+            {
+                printf("grind: grinder %d failed\n", i);
+                exit(1);
+            }
+        }
+        close(fds[i]);
+    }
+    for (i = 0; i < n; i++)
+        wait(0);
+    t = rdtime() - t0;
+
+    printf("op\tops\t/s\n");
+    for (j = 0; j < NOP; j++)
+    {
+        for (sum = 0, i = 0; i < n; i++)
+            sum += counts[i][j];
+        total += sum;
+        printf("%s\t%d\t%d\n", opnames[j], (int)sum, (int)(sum * TIMEHZ / t));
+    }
+    for (i = 0; i < n; i++)
+    {
+        for (sum = 0, j = 0; j < NOP; j++)
+            sum += counts[i][j];
+        printf("grinder %d\t%d ops\t%d/s\n", i, (int)sum, (int)(sum * TIMEHZ / t));
+    }
+    printf("grind: total %d ops, %d/s, %d/s per cpu\n", (int)total, (int)(total * TIMEHZ / t),
+           (int)(total * TIMEHZ / t / cpus));
+}
+
+int main(int argc, char* argv[])
 {
+    int i, secs = 0, n = 0;
+
+    for (i = 1; i + 1 < argc; i += 2)
+    {
+        if (strcmp(argv[i], "-t") == 0)
+            secs = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-P") == 0)
+            n = atoi(argv[i + 1]);
+        else
+            break;
+    }
+    if (i < argc || (argc > 1 && secs <= 0) || n < 0 || n > MAXGRIND)
+    {
+        fprintf(2, "usage: grind [-t secs [-P ngrinders]]\n");
+        exit(1);
+    }
+    if (secs > 0)
+    {
+        timed(secs, n);
+        exit(0);
+    }
+
     while (1)
     {
         int pid = fork();
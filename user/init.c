@@ -13,7 +13,7 @@ char* argv[] = {"sh", 0};
 
 int main(void)
 {
-    int pid, wpid;
+    int pid, wpid, fd;
 
     if (open("console", O_RDWR) < 0)
     {
@@ -23,6 +23,12 @@ int main(void)
     dup(0);   // stdout
     dup(0);   // stderr
 
+    // the lock statistics device, opened by stats.
+    if ((fd = open("statistics", O_RDONLY)) < 0)
+        mknod("statistics", STATS, 0);
+    else
+        close(fd);
+
     for (;;)
     {
         printf("init: starting sh\n");
@@ -0,0 +1,218 @@
+// Microbenchmarks of the kernel's primitives, in the manner of
+// lmbench. Each is timed NSAMPLE times, one operation a sample,
+// with the cycle counter, and the minimum, median and 99th
+// percentile cycles are printed, a line each:
+//
+//   null    a system call that does nothing but trap (_getpid)
+//   pipe    a one-byte round trip through two pipes to another
+//           process and back: two context switches
+//   fork    fork() of a small process, its exit and wait()
+//   sbrk    sbrk() growing the heap by a page
+//   lazy    the first touch of a page sbrk() added
+//   cow     the first write to a page shared copy-on-write
+//           with the parent
+//
+// usage: lmbench [name ...]   (all of them by default)
+
+#include "kernel/types.h"
+#include "kernel/riscv.h"
+#include "user/user.h"
+
+#define NSAMPLE 1000
+#define NCOW    256   // pages written by the cow child
+
+static uint64 samples[NSAMPLE];
+static char   cowpages[NCOW * PGSIZE] __attribute__((aligned(PGSIZE)));
+
+static inline uint64 rdcycle(void)
+{
+    uint64 x;
+    asm volatile("rdcycle %0" : "=r"(x));
+    return x;
+}
+
+// Print n samples' minimum, median and 99th percentile.
+// 排序样本并打印最小值、中位数和 99 分位数
+static void report(char* name, uint64* s, int n)
+{
+    uint64 x;
+    int    i, j;
+
+    for (i = 1; i < n; i++)
+    {
+        x = s[i];
+        for (j = i; j > 0 && s[j - 1] > x; j--)
+            s[j] = s[j - 1];
+        s[j] = x;
+    }
+    printf("%s\tmin %d\tmedian %d\tp99 %d\n", name, (int)s[0], (int)s[n / 2], (int)s[n * 99 / 100]);
+}
+
+// 空系统调用
+static void null(void)
+{
+    uint64 t0;
+
+    for (int i = 0; i < NSAMPLE; i++)
+    {
+        t0 = rdcycle();
+        _getpid();
+        samples[i] = rdcycle() - t0;
+    }
+    report("null", samples, NSAMPLE);
+}
+
+// 通过两个管道与子进程往返一个字节
+static void pingpong(void)
+{
+    int    to[2], from[2], pid;
+    char   c = 0;
+    uint64 t0;
+
+    if (pipe(to) < 0 || pipe(from) < 0)
+    {
+        fprintf(2, "lmbench: pipe failed\n");
+        exit(1);
+    }
+    if ((pid = fork()) == 0)
+    {
+        close(to[1]);
+        close(from[0]);
+        while (read(to[0], &c, 1) == 1)
+            write(from[1], &c, 1);
+        exit(0);
+    }
+    close(to[0]);
+    close(from[1]);
+    for (int i = 0; i < NSAMPLE; i++)
+    {
+        t0 = rdcycle();
+        write(to[1], &c, 1);
+        read(from[0], &c, 1);
+        samples[i] = rdcycle() - t0;
+    }
+    close(to[1]);
+    close(from[0]);
+    wait(0);
+    report("pipe", samples, NSAMPLE);
+}
+
+// fork 一个立即退出的子进程并等待它
+static void forkwait(void)
+{
+    uint64 t0;
+    int    pid;
+
+    for (int i = 0; i < NSAMPLE; i++)
+    {
+        t0 = rdcycle();
+        if ((pid = fork()) == 0)
+            exit(0);
+        wait(0);
+        samples[i] = rdcycle() - t0;
+        if (pid < 0)
+        {
+            fprintf(2, "lmbench: fork failed\n");
+            exit(1);
+        }
+    }
+    report("fork", samples, NSAMPLE);
+}
+
+// Time sbrk() growing the heap by a page or, with touch, the
+// first touch of the new page; the heap shrinks back between
+// samples.
+// 测量 sbrk 增长一页，或首次访问新页的缺页
+static void grow(int touch)
+{
+    uint64 t0;
+    char*  p;
+
+    for (int i = 0; i < NSAMPLE; i++)
+    {
+        t0 = rdcycle();
+        p  = sbrk(PGSIZE);
+        if (!touch)
+            samples[i] = rdcycle() - t0;
+        if (p == (char*)-1)
+        {
+            fprintf(2, "lmbench: sbrk failed\n");
+            exit(1);
+        }
+        t0 = rdcycle();
+        *p = 1;
+        if (touch)
+            samples[i] = rdcycle() - t0;
+        sbrk(-PGSIZE);
+    }
+    report(touch ? "lazy" : "sbrk", samples, NSAMPLE);
+}
+
+// Time a child's first write to each of NCOW pages its parent
+// had written before the fork.
+// 测量子进程首次写入与父进程共享的写时复制页
+static void cow(void)
+{
+    uint64 t0;
+    int    i;
+
+    for (i = 0; i < NCOW; i++)
+        cowpages[i * PGSIZE] = 1;
+    if (fork() == 0)
+    {
+        for (i = 0; i < NCOW; i++)
+        {
+            t0                   = rdcycle();
+            cowpages[i * PGSIZE] = 2;
+            samples[i]           = rdcycle() - t0;
+        }
+        report("cow", samples, NCOW);
+        exit(0);
+    }
+    wait(0);
+}
+
+struct bench
+{
+    char* name;
+    void (*f)(void);
+};
+
+static void sbrkbench(void)
+{
+    grow(0);
+}
+
+static void lazybench(void)
+{
+    grow(1);
+}
+
+static struct bench benches[] = {
+    {"null", null},      {"pipe", pingpong},   {"fork", forkwait},
+    {"sbrk", sbrkbench}, {"lazy", lazybench}, {"cow", cow},
+};
+
+#define NBENCH (sizeof(benches) / sizeof(benches[0]))
+
+int main(int argc, char* argv[])
+{
+    int i, j;
+
+    printf("cycles per operation, %d samples:\n", NSAMPLE);
+    if (argc == 1)
+        for (j = 0; j < NBENCH; j++)
+            benches[j].f();
+    for (i = 1; i < argc; i++)
+    {
+        for (j = 0; j < NBENCH && strcmp(argv[i], benches[j].name) != 0; j++)
+            ;
+        if (j == NBENCH)
+        {
+            fprintf(2, "lmbench: no benchmark %s\n", argv[i]);
+            exit(1);
+        }
+        benches[j].f();
+    }
+    exit(0);
+}
@@ -0,0 +1,121 @@
+// Stress the kernel's global locks from several processes at
+// once and report how long it took and how contended each
+// lock was. Each process repeatedly opens, reads and closes
+// one shared file (ftable, itable, bcache), grows and shrinks
+// its memory (kmem) and creates and removes a file of its own
+// (log).
+//
+// usage: lockstress [nproc [iterations]]
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define FNAME "lockstress.f"
+
+char buf[4096];
+
+// Zero the lock statistics by writing to the device.
+// 清零锁统计计数
+static void zero(void)
+{
+    int fd;
+
+    if ((fd = open("statistics", O_WRONLY)) < 0)
+    {
+        fprintf(2, "lockstress: cannot open statistics\n");
+        exit(1);
+    }
+    write(fd, "0", 1);
+    close(fd);
+}
+
+// One process's share of the work.
+// 子进程的负载
+static void stress(int id, int n)
+{
+    char  name[] = "lockstress.0";
+    char* p;
+    int   fd, i;
+
+    name[sizeof(name) - 2] = '0' + id % 10;
+    for (i = 0; i < n; i++)
+    {
+        if ((fd = open(FNAME, O_RDONLY)) < 0)
+            exit(1);
+        read(fd, buf, 512);
+        close(fd);
+
+        if ((p = sbrk(4096)) == (char*)-1)
+            exit(1);
+        p[0] = i;
+        sbrk(-4096);
+
+        if (i % 8 == 0)
+        {
+            if ((fd = open(name, O_CREATE | O_WRONLY)) < 0)
+                exit(1);
+            write(fd, buf, 16);
+            close(fd);
+            unlink(name);
+        }
+    }
+    exit(0);
+}
+
+int main(int argc, char* argv[])
+{
+    int nproc = 4, n = 500;
+    int fd, i, xstatus, t0, t1, fail = 0;
+
+    if (argc > 1)
+        nproc = atoi(argv[1]);
+    if (argc > 2)
+        n = atoi(argv[2]);
+
+    if ((fd = open(FNAME, O_CREATE | O_WRONLY)) < 0)
+    {
+        fprintf(2, "lockstress: cannot create %s\n", FNAME);
+        exit(1);
+    }
+    write(fd, buf, 512);
+    close(fd);
+
+    zero();
+    t0 = uptime();
+    for (i = 0; i < nproc; i++)
+    {
+        int pid = fork();
+        if (pid < 0)
+        {
+            fprintf(2, "lockstress: fork failed\n");
+            exit(1);
+        }
+        if (pid == 0)
+            stress(i, n);
+    }
+    for (i = 0; i < nproc; i++)
+    {
+        wait(&xstatus);
+        if (xstatus != 0)
+            fail = 1;
+    }
+    t1 = uptime();
+    unlink(FNAME);
+    if (fail)
+    {
+        fprintf(2, "lockstress: a process failed\n");
+        exit(1);
+    }
+
+    printf("%d processes, %d iterations each: %d ticks\n", nproc, n, t1 - t0);
+    if ((fd = open("statistics", O_RDONLY)) < 0)
+    {
+        fprintf(2, "lockstress: cannot open statistics\n");
+        exit(1);
+    }
+    while ((n = read(fd, buf, sizeof(buf))) > 0)
+        write(1, buf, n);
+    close(fd);
+    exit(0);
+}
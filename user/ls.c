@@ -21,12 +21,14 @@ char* fmtname(char* path)
     return buf;
 }
 
+// entries read by one getdents(): a block's worth.
+struct dirstat ents[BSIZE / sizeof(struct dirent)];
+
 void ls(char* path)
 {
-    char          buf[512], *p;
-    int           fd;
-    struct dirent de;
-    struct stat   st;
+    char        buf[512], *p;
+    int         fd, n, i;
+    struct stat st;
 
     if ((fd = open(path, 0)) < 0)
     {
@@ -57,19 +59,17 @@ void ls(char* path)
         strcpy(buf, path);
         p    = buf + strlen(buf);
         *p++ = '/';
-        while (read(fd, &de, sizeof(de)) == sizeof(de))
+        while ((n = getdents(fd, ents, sizeof(ents) / sizeof(ents[0]))) > 0)
         {
-            if (de.inum == 0)
-                continue;
-            memmove(p, de.name, DIRSIZ);
-            p[DIRSIZ] = 0;
-            if (stat(buf, &st) < 0)
+            for (i = 0; i < n; i++)
             {
-                printf("ls: cannot stat %s\n", buf);
-                continue;
+                strcpy(p, ents[i].name);
+                printf("%s %d %d %d\n", fmtname(buf), ents[i].st.type, ents[i].st.ino,
+                       (int)ents[i].st.size);
             }
-            printf("%s %d %d %d\n", fmtname(buf), st.type, st.ino, st.size);
         }
+        if (n < 0)
+            printf("ls: cannot read %s\n", path);
         break;
     }
     close(fd);
@@ -0,0 +1,102 @@
+// Time malloc() and free(): small objects allocated and freed
+// in a tight loop, then a churn of random sizes with many
+// blocks live at once, and print the cycles each call takes.
+// Then free everything and show how much of the heap went
+// back to the kernel.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define NLIVE  512
+#define NOPS   20000
+#define MAXBIG 8192
+
+static void* live[NLIVE];
+
+static inline uint64 rdcycle(void)
+{
+    uint64 x;
+    asm volatile("rdcycle %0" : "=r"(x));
+    return x;
+}
+
+static uint64 seed = 1;
+
+// 线性同余伪随机数
+static uint rnd(void)
+{
+    seed = seed * 6364136223846793005ULL + 1442695040888963407ULL;
+    return seed >> 33;
+}
+
+// Allocate and at once free an n-byte object NOPS times.
+// Returns the mean cycles per malloc() and free() pair.
+// 测量小对象分配与释放的平均周期数
+static int pairs(uint n)
+{
+    uint64 t0;
+    int    i;
+    void*  p;
+
+    t0 = rdcycle();
+    for (i = 0; i < NOPS; i++)
+    {
+        if ((p = malloc(n)) == 0)
+        {
+            printf("mallocbench: out of memory\n");
+            exit(1);
+        }
+        free(p);
+    }
+    return (rdcycle() - t0) / NOPS;
+}
+
+// Replace a random one of NLIVE live blocks with a new block
+// of random size, mostly small, NOPS times. Returns the mean
+// cycles per replacement.
+// 测量随机大小分配与释放混合负载的平均周期数
+static int churn(void)
+{
+    uint64 t0;
+    uint   n;
+    int    i, j;
+
+    t0 = rdcycle();
+    for (i = 0; i < NOPS; i++)
+    {
+        j = rnd() % NLIVE;
+        free(live[j]);
+        n = rnd() % 8 == 0 ? rnd() % MAXBIG : rnd() % 128;
+        if ((live[j] = malloc(n)) == 0)
+        {
+            printf("mallocbench: out of memory\n");
+            exit(1);
+        }
+        memset(live[j], i, n);
+    }
+    return (rdcycle() - t0) / NOPS;
+}
+
+int main(int argc, char* argv[])
+{
+    char* brk0 = sbrk(0);
+    char* brk1;
+    int   i;
+
+    printf("cycles per malloc+free:\n");
+    printf("16 bytes\t%d\n", pairs(16));
+    printf("200 bytes\t%d\n", pairs(200));
+    printf("4000 bytes\t%d\n", pairs(4000));
+    printf("random churn\t%d\n", churn());
+
+    brk1 = sbrk(0);
+    for (i = 0; i < NLIVE; i++)
+    {
+        free(live[i]);
+        live[i] = 0;
+    }
+    printf("heap grew %d bytes, %d still held after freeing all\n", (int)(brk1 - brk0),
+           (int)(sbrk(0) - brk0));
+    exit(0);
+}
@@ -0,0 +1,101 @@
+// Time memset(), memmove() and memcmp() from ulib.c against
+// the byte-at-a-time loops they replaced, and print the cycles
+// each takes per page; kernel/string.c uses the same code.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "user/user.h"
+
+#define PG     4096
+#define NPAGE  16
+#define ROUNDS 8
+
+static char bufa[NPAGE * PG] __attribute__((aligned(PG)));
+static char bufb[NPAGE * PG] __attribute__((aligned(PG)));
+
+static inline uint64 rdcycle(void)
+{
+    uint64 x;
+    asm volatile("rdcycle %0" : "=r"(x));
+    return x;
+}
+
+static void* bytememset(void* dst, int c, uint n)
+{
+    char* cdst = (char*)dst;
+    int   i;
+    for (i = 0; i < n; i++)
+        cdst[i] = c;
+    return dst;
+}
+
+static void* bytememmove(void* vdst, const void* vsrc, int n)
+{
+    char*       dst = vdst;
+    const char* src = vsrc;
+    while (n-- > 0)
+        *dst++ = *src++;
+    return vdst;
+}
+
+static int bytememcmp(const void* s1, const void* s2, uint n)
+{
+    const char *p1 = s1, *p2 = s2;
+    while (n-- > 0)
+    {
+        if (*p1 != *p2)
+            return *p1 - *p2;
+        p1++;
+        p2++;
+    }
+    return 0;
+}
+
+// Run op over every page of the buffers ROUNDS times and
+// return the mean cycles per page.
+// 测量 op 处理每页平均所需的周期数
+static int measure(int op, int word)
+{
+    uint64 t0, t;
+    int    r, i;
+
+    t0 = rdcycle();
+    for (r = 0; r < ROUNDS; r++)
+    {
+        for (i = 0; i < NPAGE; i++)
+        {
+            char* a = bufa + i * PG;
+            char* b = bufb + i * PG;
+            if (op == 0)
+                word ? memset(a, r, PG) : bytememset(a, r, PG);
+            else if (op == 1)
+                word ? memmove(b, a, PG) : bytememmove(b, a, PG);
+            else if ((word ? memcmp(a, b, PG) : bytememcmp(a, b, PG)) != 0)
+            {
+                printf("membench: memcmp mismatch\n");
+                exit(1);
+            }
+        }
+    }
+    t = rdcycle() - t0;
+    return t / (ROUNDS * NPAGE);
+}
+
+int main(int argc, char* argv[])
+{
+    char* name[] = {"memset", "memmove", "memcmp"};
+    int   op, bytes, words;
+
+    // touch the pages first so that faults are not timed.
+    memset(bufa, 0, sizeof(bufa));
+    memset(bufb, 0, sizeof(bufb));
+
+    printf("cycles per %d-byte page:\n", PG);
+    for (op = 0; op < 3; op++)
+    {
+        bytes = measure(op, 0);
+        words = measure(op, 1);
+        printf("%s\tbyte %d\tword %d\tsaved %d\n", name[op], bytes, words, bytes - words);
+    }
+    exit(0);
+}
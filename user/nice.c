@@ -0,0 +1,56 @@
+// Run a command in a scheduling class and with a nice value:
+// the normal class and nice 10 unless -c and -n say otherwise.
+//
+// usage: nice [-c rt|normal|batch] [-n nice] command args...
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+static char* classes[] = {[SCHED_REALTIME] "rt", [SCHED_NORMAL] "normal", [SCHED_BATCH] "batch"};
+
+// 打印用法并退出
+static void usage(void)
+{
+    fprintf(2, "usage: nice [-c rt|normal|batch] [-n nice] command args...\n");
+    exit(1);
+}
+
+int main(int argc, char* argv[])
+{
+    int sclass = SCHED_NORMAL, nice = 10;
+    int i;
+
+    while (argc > 2 && argv[1][0] == '-')
+    {
+        if (strcmp(argv[1], "-c") == 0)
+        {
+            for (i = 0; i < NSCHED && strcmp(argv[2], classes[i]) != 0; i++)
+                ;
+            if (i == NSCHED)
+                usage();
+            sclass = i;
+        }
+        else if (strcmp(argv[1], "-n") == 0)
+        {
+            nice = argv[2][0] == '-' ? -atoi(argv[2] + 1) : atoi(argv[2]);
+        }
+        else
+        {
+            usage();
+        }
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc < 2)
+        usage();
+
+    if (setsched(0, sclass, nice) < 0)
+    {
+        fprintf(2, "nice: cannot set class %s, nice %d\n", classes[sclass], nice);
+        exit(1);
+    }
+    exec(argv[1], argv + 1);
+    fprintf(2, "nice: exec %s failed\n", argv[1]);
+    exit(1);
+}
@@ -1,14 +1,92 @@
+//
+// Formatted output, buffered per file descriptor so that a
+// line costs one write() rather than one per character. The
+// console is line-buffered, other files and pipes are written
+// a buffer at a time, and fd 2 at the end of each call, so
+// that errors come out at once. ulib.c flushes the buffers
+// before exit(), fork(), exec() and read(), and a descriptor's
+// buffer before write() or close() on it.
+//
+
 #include "kernel/types.h"
 #include "kernel/stat.h"
+#include "kernel/param.h"
 #include "user/user.h"
 
 #include <stdarg.h>
 
+#define OBUFSZ 512
+
+enum
+{
+    UNKNOWN,   // not yet written since it was opened
+    UNBUF,     // flushed at the end of every call
+    LINEBUF,   // flushed at every newline
+    FULLBUF    // flushed when full
+};
+
+static struct
+{
+    char buf[OBUFSZ];
+    int  n;
+    int  mode;
+} out[NOFILE];
+
 static char digits[] = "0123456789ABCDEF";
 
+// Write out what is buffered for fd.
+// 写出 fd 缓冲区中的数据
+static void flush(int fd)
+{
+    if (out[fd].n > 0)
+        _write(fd, out[fd].buf, out[fd].n);
+    out[fd].n = 0;
+}
+
+// Carry out op for the system call wrappers in ulib.c.
+// 供 ulib.c 的系统调用包装函数刷新缓冲区
+static void stdioop(int fd, int op)
+{
+    int i;
+
+    if (op == STDIO_FLUSHALL || op == STDIO_FLUSHLINE)
+    {
+        for (i = 0; i < NOFILE; i++)
+            if (op == STDIO_FLUSHALL || out[i].mode == LINEBUF)
+                flush(i);
+    }
+    else if (fd >= 0 && fd < NOFILE)
+    {
+        flush(fd);
+        if (op == STDIO_CLOSE)
+            out[fd].mode = UNKNOWN;
+    }
+}
+
+// Choose how to buffer fd from what it is open on.
+// 根据 fd 打开的文件类型选择缓冲方式
+static int outmode(int fd)
+{
+    struct stat st;
+
+    stdiohook = stdioop;
+    if (fd == 2 || fstat(fd, &st) < 0)
+        return UNBUF;
+    return st.type == T_DEVICE ? LINEBUF : FULLBUF;
+}
+
 static void putc(int fd, char c)
 {
-    write(fd, &c, 1);
+    if (fd < 0 || fd >= NOFILE)
+    {
+        _write(fd, &c, 1);
+        return;
+    }
+    if (out[fd].mode == UNKNOWN)
+        out[fd].mode = outmode(fd);
+    out[fd].buf[out[fd].n++] = c;
+    if (out[fd].n == OBUFSZ || (c == '\n' && out[fd].mode == LINEBUF))
+        flush(fd);
 }
 
 static void printint(int fd, int xx, int base, int sgn)
@@ -116,6 +194,8 @@ void vprintf(int fd, const char* fmt, va_list ap)
             state = 0;
         }
     }
+    if (fd >= 0 && fd < NOFILE && out[fd].mode == UNBUF)
+        flush(fd);
 }
 
 void fprintf(int fd, const char* fmt, ...)
@@ -0,0 +1,273 @@
+// Run a command with the sampling profiler on, then print where
+// the CPUs spent their time while it ran: how the samples split
+// between the command's own user code, other processes' user
+// code, the kernel and idle CPUs, and the functions that took
+// the most samples. Kernel samples, and user samples of the
+// command's process, are matched to the function they fell in
+// through /syms, which holds kernel/kernel.sym and the
+// user/<prog>.sym of each program (see the Makefile).
+//
+// usage: prof [-n nfunc] command [arg ...]
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "kernel/prof.h"
+#include "user/user.h"
+
+#define NREAD 256    // samples read at a time
+#define NSYM  4096   // most symbols in a table
+
+struct sym
+{
+    uint64 addr;
+    char*  name;
+    int    count;   // samples that fell in this function
+};
+
+struct symtab
+{
+    char*      prog;   // "kernel" or the command's name
+    struct sym sym[NSYM];
+    int        n;
+};
+
+static struct profsample samples[NREAD];
+static struct symtab     ktab, utab;
+static char              ibuf[1024];
+static int               ipos, ilen;
+
+// Read a line from fd into line, of size n, without its
+// newline. Returns 0 at end of file.
+// 从文件读取一行
+static int readline(int fd, char* line, int n)
+{
+    int i = 0, c;
+
+    for (;;)
+    {
+        if (ipos == ilen)
+        {
+            if ((ilen = read(fd, ibuf, sizeof(ibuf))) <= 0)
+            {
+                ilen = ipos = 0;
+                break;
+            }
+            ipos = 0;
+        }
+        if ((c = ibuf[ipos++]) == '\n')
+        {
+            line[i] = 0;
+            return 1;
+        }
+        if (i < n - 1)
+            line[i++] = c;
+    }
+    line[i] = 0;
+    return i > 0;
+}
+
+// Return whether name, from objdump -t, names a function or
+// object rather than a section, source file or mapping symbol.
+// 判断符号是否为函数或数据对象
+static int wanted(char* name)
+{
+    int n = strlen(name);
+
+    if (n == 0 || name[0] == '.' || name[0] == '$')
+        return 0;
+    if (n > 2 && name[n - 2] == '.' && strchr("cSo", name[n - 1]))
+        return 0;
+    return 1;
+}
+
+// Add the line "address name" of a symbol table to t.
+// 解析一行符号表并加入 t
+static void addsym(struct symtab* t, char* line)
+{
+    uint64 a = 0;
+    char*  p;
+    int    d;
+
+    for (p = line; *p && *p != ' '; p++)
+    {
+        d = *p >= 'a' ? *p - 'a' + 10 : *p - '0';
+        a = a << 4 | d;
+    }
+    if (*p++ != ' ' || !wanted(p) || t->n == NSYM)
+        return;
+    if ((t->sym[t->n].name = malloc(strlen(p) + 1)) == 0)
+    {
+        fprintf(2, "prof: out of memory\n");
+        exit(1);
+    }
+    strcpy(t->sym[t->n].name, p);
+    t->sym[t->n].addr = a;
+    t->n++;
+}
+
+// Load the kernel's and prog's symbol tables from /syms, whose
+// tables are each sorted by address.
+// 从 /syms 读取内核与被测程序的符号表
+static void loadsyms(char* prog)
+{
+    char           line[128];
+    struct symtab* t = 0;
+    int            fd;
+
+    ktab.prog = "kernel";
+    utab.prog = prog;
+    if ((fd = open("/syms", O_RDONLY)) < 0)
+    {
+        fprintf(2, "prof: cannot open /syms; functions are not named\n");
+        return;
+    }
+    while (readline(fd, line, sizeof(line)))
+    {
+        if (line[0] == '=' && line[1] == ' ')
+        {
+            t = 0;
+            if (strcmp(line + 2, "kernel") == 0)
+                t = &ktab;
+            else if (strcmp(line + 2, prog) == 0)
+                t = &utab;
+        }
+        else if (t)
+            addsym(t, line);
+    }
+    close(fd);
+}
+
+// Count a sample at pc against the function of t it fell in.
+// Returns 0 if pc is before t's first symbol.
+// 将样本计入其所在函数
+static int count(struct symtab* t, uint64 pc)
+{
+    int lo = 0, hi = t->n, mid;
+
+    // find the last symbol at or before pc.
+    while (lo < hi)
+    {
+        mid = (lo + hi) / 2;
+        if (t->sym[mid].addr <= pc)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    if (lo == 0)
+        return 0;
+    t->sym[lo - 1].count++;
+    return 1;
+}
+
+// Print the nfunc functions with the most samples, of total.
+// 打印样本最多的 nfunc 个函数
+static void top(int nfunc, int total)
+{
+    struct symtab* t;
+    struct sym    *s, *best;
+    char*          prog = 0;
+    int            i, j;
+
+    printf("samples\t%%\tfunction\n");
+    for (i = 0; i < nfunc; i++)
+    {
+        best = 0;
+        for (t = &ktab; t; t = t == &ktab ? &utab : 0)
+        {
+            for (j = 0; j < t->n; j++)
+            {
+                s = &t->sym[j];
+                if (s->count > 0 && (best == 0 || s->count > best->count))
+                {
+                    best = s;
+                    prog = t->prog;
+                }
+            }
+        }
+        if (best == 0)
+            break;
+        printf("%d\t%d\t%s:%s\n", best->count, best->count * 100 / total, prog, best->name);
+        best->count = 0;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    int   nfunc = 20, pid, n, i, total = 0, mine = 0, others = 0, kernel = 0, idle = 0, unknown = 0;
+    int   dropped;
+    char* prog;
+
+    if (argc > 2 && strcmp(argv[1], "-n") == 0)
+    {
+        nfunc = atoi(argv[2]);
+        argc -= 2;
+        argv += 2;
+    }
+    if (argc < 2)
+    {
+        fprintf(2, "usage: prof [-n nfunc] command [arg ...]\n");
+        exit(1);
+    }
+    for (prog = argv[1] + strlen(argv[1]); prog > argv[1] && prog[-1] != '/'; prog--)
+        ;
+    loadsyms(prog);
+
+    if (prof(PROF_START, 0, 0) < 0)
+    {
+        fprintf(2, "prof: cannot start sampling\n");
+        exit(1);
+    }
+    if ((pid = fork()) < 0)
+    {
+        fprintf(2, "prof: fork failed\n");
+        exit(1);
+    }
+    if (pid == 0)
+    {
+        exec(argv[1], argv + 1);
+        fprintf(2, "prof: exec %s failed\n", argv[1]);
+        exit(1);
+    }
+    wait(0);
+    dropped = prof(PROF_STOP, 0, 0);
+
+    while ((n = prof(PROF_READ, samples, NREAD)) > 0)
+    {
+        for (i = 0; i < n; i++)
+        {
+            struct profsample* s = &samples[i];
+
+            total++;
+            if (s->user && s->pid != pid)
+                others++;
+            else if (s->user)
+            {
+                mine++;
+                unknown += !count(&utab, s->pc);
+            }
+            else
+            {
+                if (s->pid == 0)
+                    idle++;
+                else
+                    kernel++;
+                unknown += !count(&ktab, s->pc);
+            }
+        }
+    }
+    if (total == 0)
+    {
+        printf("prof: no samples\n");
+        exit(0);
+    }
+
+    printf("%d samples", total);
+    if (dropped > 0)
+        printf(", %d dropped", dropped);
+    printf(": %s %d%%, other user %d%%, kernel %d%%, no process %d%%\n", prog, mine * 100 / total,
+           others * 100 / total, kernel * 100 / total, idle * 100 / total);
+    if (unknown > 0)
+        printf("%d samples outside the symbol tables\n", unknown);
+    top(nfunc, total);
+    exit(0);
+}
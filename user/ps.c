@@ -0,0 +1,42 @@
+// List the processes in use, with what procdump() prints and
+// their memory: sz, the size of the address space, and rss,
+// the pages of it that are mapped, which lazy allocation and
+// copy-on-write fork keep below sz. Threads made by clone()
+// share their process's pages.
+//
+// usage: ps
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/sysinfo.h"
+#include "user/user.h"
+
+static struct procinfo procs[NPROC];
+
+static char* states[] = {"unused", "used", "sleep", "runble", "run", "zombie"};
+static char* classes[] = {"rt", "normal", "batch"};
+
+int main(int argc, char* argv[])
+{
+    struct procinfo* p;
+    char*            state;
+    int              n;
+
+    if ((n = procinfo(procs, NPROC)) < 0)
+    {
+        fprintf(2, "ps: procinfo failed\n");
+        exit(1);
+    }
+    printf("pid\tppid\tstate\tclass\tnice\tticks\tsz(K)\trss(K)\tname\n");
+    for (p = procs; p < &procs[n]; p++)
+    {
+        state = p->state >= 0 && p->state < sizeof(states) / sizeof(states[0]) ? states[p->state] : "???";
+        printf("%d\t%d\t%s\t%s\t%d\t%d\t%d\t%d\t%s", p->pid, p->ppid, state,
+               p->sclass >= 0 && p->sclass < 3 ? classes[p->sclass] : "???", p->nice,
+               (int)(p->cputime / TICKCYCLES), (int)(p->sz / 1024), (int)(p->rss * 4), p->name);
+        if (p->thread)
+            printf(" (thread %d)", p->thread);
+        printf("\n");
+    }
+    exit(0);
+}
@@ -0,0 +1,136 @@
+// Time counting the lines and words of a multi-megabyte file
+// as wc did, a byte at a time through a 512-byte buffer, and
+// as it does now, with memcount() and wordcount() from ulib.c
+// over a 16 KiB buffer; then time finding every newline with
+// a byte loop and with memchr(). Prints cycles per KiB.
+
+#include "kernel/types.h"
+#include "kernel/stat.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+#define FILESZ (2 * 1024 * 1024)
+#define SMALL  512
+#define BIG    16384
+
+static char  buf[BIG];
+static char* file = "scanbench.tmp";
+
+static inline uint64 rdcycle(void)
+{
+    uint64 x;
+    asm volatile("rdcycle %0" : "=r"(x));
+    return x;
+}
+
+// Write FILESZ bytes of text with lines of varying length.
+// 生成测试文件
+static void mkfile(void)
+{
+    int fd, i, n;
+
+    if ((fd = open(file, O_CREATE | O_TRUNC | O_WRONLY)) < 0)
+    {
+        printf("scanbench: cannot create %s\n", file);
+        exit(1);
+    }
+    for (i = 0; i < BIG; i++)
+        buf[i] = i % 41 == 40 ? '\n' : i % 7 == 6 ? ' ' : 'a' + i % 26;
+    for (n = 0; n < FILESZ; n += BIG)
+    {
+        if (write(fd, buf, BIG) != BIG)
+        {
+            printf("scanbench: write failed\n");
+            exit(1);
+        }
+    }
+    close(fd);
+}
+
+// Count lines and words of the file, the old way if old is
+// set. Returns cycles per KiB, and sets *lines and *words.
+// 统计文件的行数与单词数，返回每 KiB 的周期数
+static int count(int old, int* lines, int* words)
+{
+    uint64 t0;
+    int    fd, n, i, l = 0, w = 0, inword = 0;
+
+    if ((fd = open(file, O_RDONLY)) < 0)
+    {
+        printf("scanbench: cannot open %s\n", file);
+        exit(1);
+    }
+    t0 = rdcycle();
+    while ((n = read(fd, buf, old ? SMALL : BIG)) > 0)
+    {
+        if (!old)
+        {
+            l += memcount(buf, '\n', n);
+            w += wordcount(buf, n, &inword);
+            continue;
+        }
+        for (i = 0; i < n; i++)
+        {
+            if (buf[i] == '\n')
+                l++;
+            if (strchr(" \r\t\n\v", buf[i]))
+                inword = 0;
+            else if (!inword)
+            {
+                w++;
+                inword = 1;
+            }
+        }
+    }
+    t0 = rdcycle() - t0;
+    close(fd);
+    *lines = l;
+    *words = w;
+    return t0 / (FILESZ / 1024);
+}
+
+// Find every newline in buf, ROUNDS times, with a byte loop or
+// memchr(). Returns cycles per KiB.
+// 查找缓冲区中的每个换行符，返回每 KiB 的周期数
+static int lines(int old)
+{
+    uint64 t0;
+    char  *p, *e = buf + BIG;
+    int    r, n = 0;
+
+    t0 = rdcycle();
+    for (r = 0; r < FILESZ / BIG; r++)
+    {
+        for (p = buf; p < e; p++)
+        {
+            if (old)
+                while (p < e && *p != '\n')
+                    p++;
+            else if ((p = memchr(p, '\n', e - p)) == 0)
+                break;
+            n++;
+        }
+    }
+    if (n == 0)
+        printf("scanbench: no lines\n");
+    return (rdcycle() - t0) / (FILESZ / 1024);
+}
+
+int main(int argc, char* argv[])
+{
+    int ol, ow, nl, nw, oc, nc;
+
+    mkfile();
+    oc = count(1, &ol, &ow);
+    nc = count(0, &nl, &nw);
+    if (ol != nl || ow != nw)
+    {
+        printf("scanbench: counts differ: %d/%d lines, %d/%d words\n", ol, nl, ow, nw);
+        exit(1);
+    }
+    printf("cycles per KiB of a %d KiB file, %d lines, %d words:\n", FILESZ / 1024, nl, nw);
+    printf("wc\tbyte %d\tword %d\n", oc, nc);
+    printf("newline\tbyte %d\tword %d\n", lines(1), lines(0));
+    unlink(file);
+    exit(0);
+}
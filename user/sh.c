@@ -1,8 +1,10 @@
 // Shell.
 
 #include "kernel/types.h"
+#include "kernel/stat.h"
 #include "user/user.h"
 #include "kernel/fcntl.h"
+#include "kernel/fs.h"
 
 // Parsed command representation
 #define EXEC  1
@@ -60,6 +62,8 @@ void        panic(char*);
 struct cmd* parsecmd(char*);
 void        runcmd(struct cmd*) __attribute__((noreturn));
 
+char* parseerr;   // the first syntax error parsecmd() found, or 0
+
 // Execute cmd.  Never returns.
 void runcmd(struct cmd* cmd)
 {
@@ -140,11 +144,182 @@ void runcmd(struct cmd* cmd)
     exit(0);
 }
 
+// Commands run from the shell itself with spawn(), by the
+// path that was found to work for each name, so that a name is
+// looked up just once until the next cd. A name without a '/'
+// is tried in the current directory, then in /.
+#define NCMDCACHE 16
+
+struct cmdcache
+{
+    char name[DIRSIZ + 1];
+    char path[DIRSIZ + 2];
+};
+
+struct cmdcache cmdcache[NCMDCACHE];
+int             ncmdcache;
+
+// Spawn argv[0] with fds, by the cached path if there is one.
+// Returns the pid, or -1.
+// 通过命令缓存找到的路径启动命令
+int spawnpath(char** argv, int* fds)
+{
+    struct cmdcache* c;
+    char             path[DIRSIZ + 2];
+    int              i, pid;
+
+    if (strchr(argv[0], '/') || strlen(argv[0]) > DIRSIZ)
+        return spawn(argv[0], argv, fds);
+    for (i = 0; i < ncmdcache; i++)
+    {
+        c = &cmdcache[i];
+        if (strcmp(c->name, argv[0]) == 0)
+        {
+            if ((pid = spawn(c->path, argv, fds)) >= 0)
+                return pid;
+            // gone since; look it up again.
+            *c = cmdcache[--ncmdcache];
+            break;
+        }
+    }
+
+    strcpy(path, argv[0]);
+    if ((pid = spawn(path, argv, fds)) < 0)
+    {
+        path[0] = '/';
+        strcpy(path + 1, argv[0]);
+        if ((pid = spawn(path, argv, fds)) < 0)
+            return -1;
+    }
+    if (ncmdcache < NCMDCACHE)
+    {
+        c = &cmdcache[ncmdcache++];
+        strcpy(c->name, argv[0]);
+        strcpy(c->path, path);
+    }
+    return pid;
+}
+
+// Return whether cmd is only commands, redirections and pipes,
+// which the shell starts with spawn() rather than fork().
+// 判断命令能否不经 fork() 直接由 spawn() 启动
+int spawnable(struct cmd* cmd)
+{
+    switch (cmd->type)
+    {
+    case EXEC:
+        return ((struct execcmd*)cmd)->argv[0] != 0;
+    case REDIR:
+        return spawnable(((struct redircmd*)cmd)->cmd);
+    case PIPE:
+        return spawnable(((struct pipecmd*)cmd)->left) && spawnable(((struct pipecmd*)cmd)->right);
+    }
+    return 0;
+}
+
+// Start the commands of cmd, which must be spawnable(), with
+// standard input, output and error fds. Returns the number of
+// processes started, for the caller to wait for.
+// 用 spawn() 启动 cmd 中的各个命令，返回启动的进程数
+int spawncmd(struct cmd* cmd, int* fds)
+{
+    int              p[2], sub[3], fd, n;
+    struct execcmd*  ecmd;
+    struct pipecmd*  pcmd;
+    struct redircmd* rcmd;
+
+    memmove(sub, fds, sizeof(sub));
+    switch (cmd->type)
+    {
+    case EXEC:
+        ecmd = (struct execcmd*)cmd;
+        if (spawnpath(ecmd->argv, fds) < 0)
+        {
+            fprintf(2, "exec %s failed\n", ecmd->argv[0]);
+            return 0;
+        }
+        return 1;
+
+    case REDIR:
+        rcmd = (struct redircmd*)cmd;
+        if ((fd = open(rcmd->file, rcmd->mode)) < 0)
+        {
+            fprintf(2, "open %s failed\n", rcmd->file);
+            return 0;
+        }
+        sub[rcmd->fd] = fd;
+        n             = spawncmd(rcmd->cmd, sub);
+        close(fd);
+        return n;
+
+    case PIPE:
+        pcmd = (struct pipecmd*)cmd;
+        if (pipe(p) < 0)
+        {
+            fprintf(2, "pipe\n");
+            return 0;
+        }
+        sub[1] = p[1];
+        n      = spawncmd(pcmd->left, sub);
+        sub[1] = fds[1];
+        sub[0] = p[0];
+        n += spawncmd(pcmd->right, sub);
+        close(p[0]);
+        close(p[1]);
+        return n;
+    }
+    return 0;
+}
+
+// Free the nodes of cmd; the strings are in the line.
+// 释放命令树的各个节点
+void freecmd(struct cmd* cmd)
+{
+    if (cmd == 0)
+        return;
+    switch (cmd->type)
+    {
+    case REDIR:
+        freecmd(((struct redircmd*)cmd)->cmd);
+        break;
+    case PIPE:
+    case LIST:
+        // listcmd has the same layout.
+        freecmd(((struct pipecmd*)cmd)->left);
+        freecmd(((struct pipecmd*)cmd)->right);
+        break;
+    case BACK:
+        freecmd(((struct backcmd*)cmd)->cmd);
+        break;
+    }
+    free(cmd);
+}
+
+// Read a command line into buf. A read() of the console
+// stops at the end of a line, so one read() gets it all;
+// reading ahead in a file or pipe would take input from the
+// commands that share it, so gets() reads those a byte at a
+// time.
 int getcmd(char* buf, int nbuf)
 {
+    static int  console = -1;
+    struct stat st;
+    char*       nl;
+    int         n;
+
+    if (console < 0)
+        console = fstat(0, &st) == 0 && st.type == T_DEVICE;
     write(2, "$ ", 2);
     memset(buf, 0, nbuf);
-    gets(buf, nbuf);
+    if (console)
+    {
+        if ((n = read(0, buf, nbuf - 1)) < 0)
+            n = 0;
+        if ((nl = memchr(buf, '\n', n)) != 0)
+            nl[1] = 0;
+    }
+    else
+        gets(buf, nbuf);
     if (buf[0] == 0)   // EOF
         return -1;
     return 0;
@@ -153,7 +328,9 @@ int getcmd(char* buf, int nbuf)
 int main(void)
 {
     static char buf[100];
-    int         fd;
+    int         fd, n;
+    int         stdfds[3] = {0, 1, 2};
+    struct cmd* cmd;
 
     // Ensure that three file descriptors are open.
     while ((fd = open("console", O_RDWR)) >= 0)
@@ -174,11 +351,28 @@ int main(void)
             buf[strlen(buf) - 1] = 0;   // chop \n
             if (chdir(buf + 3) < 0)
                 fprintf(2, "cannot cd %s\n", buf + 3);
+            ncmdcache = 0;
             continue;
         }
-        if (fork1() == 0)
-            runcmd(parsecmd(buf));
-        wait(0);
+        // the shell parses the line itself, so that commands,
+        // redirections and pipes can be started with spawn();
+        // anything else runs in a forked child as before.
+        parseerr = 0;
+        cmd      = parsecmd(buf);
+        if (parseerr)
+            fprintf(2, "%s\n", parseerr);
+        else if (spawnable(cmd))
+        {
+            for (n = spawncmd(cmd, stdfds); n > 0; n--)
+                wait(0);
+        }
+        else if (cmd->type != EXEC || ((struct execcmd*)cmd)->argv[0] != 0)
+        {
+            if (fork1() == 0)
+                runcmd(cmd);
+            wait(0);
+        }
+        freecmd(cmd);
     }
     exit(0);
 }
@@ -324,6 +518,16 @@ int peek(char** ps, char* es, char* toks)
     return *s && strchr(toks, *s);
 }
 
+// Note a syntax error for parsecmd()'s caller to report. The
+// parser goes on to the end of the line, but the command is
+// not run.
+// 记录语法错误
+void syntax(char* msg)
+{
+    if (parseerr == 0)
+        parseerr = msg;
+}
+
 struct cmd* parseline(char**, char*);
 struct cmd* parsepipe(char**, char*);
 struct cmd* parseexec(char**, char*);
@@ -337,10 +541,10 @@ struct cmd* parsecmd(char* s)
     es  = s + strlen(s);
     cmd = parseline(&s, es);
     peek(&s, es, "");
-    if (s != es)
+    if (s != es && !parseerr)
     {
         fprintf(2, "leftovers: %s\n", s);
-        panic("syntax");
+        syntax("syntax");
     }
     nulterminate(cmd);
     return cmd;
@@ -386,7 +590,10 @@ struct cmd* parseredirs(struct cmd* cmd, char** ps, char* es)
     {
         tok = gettoken(ps, es, 0, 0);
         if (gettoken(ps, es, &q, &eq) != 'a')
-            panic("missing file for redirection");
+        {
+            syntax("missing file for redirection");
+            break;
+        }
         switch (tok)
         {
         case '<':
@@ -412,7 +619,10 @@ struct cmd* parseblock(char** ps, char* es)
     gettoken(ps, es, 0, 0);
     cmd = parseline(ps, es);
     if (!peek(ps, es, ")"))
-        panic("syntax - missing )");
+    {
+        syntax("syntax - missing )");
+        return cmd;
+    }
     gettoken(ps, es, 0, 0);
     cmd = parseredirs(cmd, ps, es);
     return cmd;
@@ -438,12 +648,18 @@ struct cmd* parseexec(char** ps, char* es)
         if ((tok = gettoken(ps, es, &q, &eq)) == 0)
             break;
         if (tok != 'a')
-            panic("syntax");
+        {
+            syntax("syntax");
+            break;
+        }
+        if (argc + 1 >= MAXARGS)
+        {
+            syntax("too many args");
+            break;
+        }
         cmd->argv[argc]  = q;
         cmd->eargv[argc] = eq;
         argc++;
-        if (argc >= MAXARGS)
-            panic("too many args");
         ret = parseredirs(ret, ps, es);
     }
     cmd->argv[argc]  = 0;
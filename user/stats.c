@@ -0,0 +1,64 @@
+// Print the kernel's lock contention statistics from the
+// statistics device. With -z, zero the counters instead. With a
+// command, zero them, run it, and print the statistics of what
+// it did.
+//
+// usage: stats [-z | command args...]
+
+#include "kernel/types.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+
+char statbuf[4096];
+
+// Zero the counters by writing to the device.
+// 清零锁统计计数
+static void zero(void)
+{
+    int fd;
+
+    if ((fd = open("statistics", O_WRONLY)) < 0)
+    {
+        fprintf(2, "stats: cannot open statistics\n");
+        exit(1);
+    }
+    write(fd, "0", 1);
+    close(fd);
+}
+
+int main(int argc, char* argv[])
+{
+    int fd, n, pid;
+
+    if (argc > 1 && strcmp(argv[1], "-z") == 0)
+    {
+        zero();
+        exit(0);
+    }
+    if (argc > 1)
+    {
+        zero();
+        if ((pid = fork()) < 0)
+        {
+            fprintf(2, "stats: fork failed\n");
+            exit(1);
+        }
+        if (pid == 0)
+        {
+            exec(argv[1], argv + 1);
+            fprintf(2, "stats: exec %s failed\n", argv[1]);
+            exit(1);
+        }
+        wait(0);
+    }
+
+    if ((fd = open("statistics", O_RDONLY)) < 0)
+    {
+        fprintf(2, "stats: cannot open statistics\n");
+        exit(1);
+    }
+    while ((n = read(fd, statbuf, sizeof(statbuf))) > 0)
+        write(1, statbuf, n);
+    close(fd);
+    exit(0);
+}
@@ -0,0 +1,94 @@
+// Time getpid() and uptime(), which read the USYSCALL and
+// USHARED pages, against the system calls they stand in for,
+// and fstat() queued NSQE at a time in the system call ring
+// against fstat() called directly, and print the cycles each
+// takes per call.
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/stat.h"
+#include "kernel/syscall.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
+#include "kernel/sysring.h"
+#include "user/user.h"
+
+#define NCALL 10000
+
+static inline uint64 rdcycle(void)
+{
+    uint64 x;
+    asm volatile("rdcycle %0" : "=r"(x));
+    return x;
+}
+
+// Return the mean cycles per call of f over NCALL calls.
+// 测量 f 每次调用的平均周期数
+static int measure(int (*f)(void))
+{
+    uint64 t0;
+    int    i;
+
+    t0 = rdcycle();
+    for (i = 0; i < NCALL; i++)
+        f();
+    return (rdcycle() - t0) / NCALL;
+}
+
+// Return the mean cycles per fstat() of fd over NCALL calls,
+// each a system call of its own, or, if ring is set, queued in
+// the system call ring and run NSQE to a ringenter().
+// 测量 fstat 每次调用的平均周期数，直接调用或经由系统调用环
+static int measurefstat(int fd, int ring)
+{
+    static struct stat st;
+    struct sysring*    r = (struct sysring*)USYSRING;
+    struct sqe*        e;
+    uint64             t0;
+    int                i, j;
+
+    t0 = rdcycle();
+    for (i = 0; i < NCALL; i += NSQE)
+    {
+        for (j = 0; j < NSQE; j++)
+        {
+            if (!ring)
+            {
+                fstat(fd, &st);
+                continue;
+            }
+            e          = &r->sq[r->sqtail++ % NSQE];
+            e->num     = SYS_fstat;
+            e->args[0] = fd;
+            e->args[1] = (uint64)&st;
+        }
+        if (ring)
+        {
+            ringenter(NSQE);
+            r->cqhead = r->cqtail;
+        }
+    }
+    return (rdcycle() - t0) / i;
+}
+
+int main(int argc, char* argv[])
+{
+    int page, trap, ring, fd;
+
+    printf("cycles per call:\n");
+    page = measure(getpid);
+    trap = measure(_getpid);
+    printf("getpid\tpage %d\tsyscall %d\tsaved %d\n", page, trap, trap - page);
+    page = measure(uptime);
+    trap = measure(_uptime);
+    printf("uptime\tpage %d\tsyscall %d\tsaved %d\n", page, trap, trap - page);
+    if ((fd = open("/", 0)) < 0)
+    {
+        fprintf(2, "sysbench: cannot open /\n");
+        exit(1);
+    }
+    ring = measurefstat(fd, 1);
+    trap = measurefstat(fd, 0);
+    printf("fstat\tring %d\tsyscall %d\tsaved %d\n", ring, trap, trap - ring);
+    exit(0);
+}
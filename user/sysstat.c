@@ -0,0 +1,72 @@
+// Print the kernel's per-system-call counts and latency
+// histograms. With a command, run it first, logging the system
+// calls in mask as it makes them, and print the statistics of
+// the calls made while it ran.
+//
+// usage: sysstat [-t mask] [command args...]
+
+#include "kernel/types.h"
+#include "kernel/sysstat.h"
+#include "user/user.h"
+
+#define NSTAT 64
+
+struct sysstat before[NSTAT], after[NSTAT];
+
+int main(int argc, char* argv[])
+{
+    uint64 mask = 0;
+    int    n, i, b, last, pid;
+
+    if (argc > 2 && strcmp(argv[1], "-t") == 0)
+    {
+        mask = atoi(argv[2]);
+        argc -= 2;
+        argv += 2;
+    }
+
+    memset(before, 0, sizeof(before));
+    if (argc > 1)
+    {
+        if (sysstat(before, NSTAT) < 0)
+        {
+            fprintf(2, "sysstat: sysstat failed\n");
+            exit(1);
+        }
+        if ((pid = fork()) < 0)
+        {
+            fprintf(2, "sysstat: fork failed\n");
+            exit(1);
+        }
+        if (pid == 0)
+        {
+            trace(mask);
+            exec(argv[1], argv + 1);
+            fprintf(2, "sysstat: exec %s failed\n", argv[1]);
+            exit(1);
+        }
+        wait(0);
+    }
+
+    if ((n = sysstat(after, NSTAT)) < 0)
+    {
+        fprintf(2, "sysstat: sysstat failed\n");
+        exit(1);
+    }
+    printf("syscall\tcalls\tavg\thistogram (bucket i: 2^i..2^(i+1) time units)\n");
+    for (i = 0; i < n; i++)
+    {
+        struct sysstat* a     = &after[i];
+        struct sysstat* o     = &before[i];
+        uint64          count = a->count - o->count;
+        if (count == 0)
+            continue;
+        printf("%s\t%d\t%d\t", a->name, (int)count, (int)((a->time - o->time) / count));
+        for (last = NSYSHIST - 1; last > 0 && a->hist[last] == o->hist[last]; last--)
+            ;
+        for (b = 0; b <= last; b++)
+            printf(" %d", (int)(a->hist[b] - o->hist[b]));
+        printf("\n");
+    }
+    exit(0);
+}
@@ -1,8 +1,13 @@
 #include "kernel/types.h"
+#include "kernel/param.h"
 #include "kernel/stat.h"
 #include "kernel/fcntl.h"
+#include "kernel/riscv.h"
+#include "kernel/memlayout.h"
 #include "user/user.h"
 
+void (*stdiohook)(int, int);
+
 //
 // wrapper so that it's OK if main() does not call exit().
 //
@@ -13,6 +18,73 @@ void _main()
     exit(0);
 }
 
+//
+// system calls that must first flush what printf() has
+// buffered: output still buffered when the process exits or
+// is replaced would be lost, a child forked with it would
+// write it a second time, and a prompt must be out before
+// reading the answer.
+//
+int fork(void)
+{
+    if (stdiohook)
+        stdiohook(-1, STDIO_FLUSHALL);
+    return _fork();
+}
+
+int exit(int status)
+{
+    if (stdiohook)
+        stdiohook(-1, STDIO_FLUSHALL);
+    _exit(status);
+}
+
+int exec(const char* path, char** argv)
+{
+    if (stdiohook)
+        stdiohook(-1, STDIO_FLUSHALL);
+    return _exec(path, argv);
+}
+
+int read(int fd, void* p, int n)
+{
+    if (stdiohook)
+        stdiohook(-1, STDIO_FLUSHLINE);
+    return _read(fd, p, n);
+}
+
+int write(int fd, const void* p, int n)
+{
+    if (stdiohook)
+        stdiohook(fd, STDIO_FLUSH);
+    return _write(fd, p, n);
+}
+
+int close(int fd)
+{
+    if (stdiohook)
+        stdiohook(fd, STDIO_CLOSE);
+    return _close(fd);
+}
+
+//
+// system calls answered without a trap, from the read-only
+// pages the kernel maps into every process (see
+// kernel/memlayout.h). A pid of 0 means that threads share the
+// page, and each has to ask for its own.
+//
+int getpid(void)
+{
+    int pid = ((volatile struct usyscall*)USYSCALL)->pid;
+
+    return pid ? pid : _getpid();
+}
+
+int uptime(void)
+{
+    return ((volatile struct ushared*)USHARED)->ticks;
+}
+
 char* strcpy(char* s, const char* t)
 {
     char* os;
@@ -39,14 +111,40 @@ uint strlen(const char* s)
     return n;
 }
 
+// As in kernel/string.c, the memory routines move whole words
+// once the pointers are 8-byte aligned, 64 bytes at a time
+// while there is room.
+#define WORD(x) (((uint64)(x) & 7) == 0)
+
 void* memset(void* dst, int c, uint n)
 {
-    char* cdst = (char*)dst;
-    int   i;
-    for (i = 0; i < n; i++)
+    char*   cdst = (char*)dst;
+    uint64* wdst;
+    uint64  w;
+
+    while (n > 0 && !WORD(cdst))
     {
-        cdst[i] = c;
+        *cdst++ = c;
+        n--;
     }
+    w    = (uchar)c * 0x0101010101010101UL;
+    wdst = (uint64*)cdst;
+    for (; n >= 64; n -= 64, wdst += 8)
+    {
+        wdst[0] = w;
+        wdst[1] = w;
+        wdst[2] = w;
+        wdst[3] = w;
+        wdst[4] = w;
+        wdst[5] = w;
+        wdst[6] = w;
+        wdst[7] = w;
+    }
+    for (; n >= 8; n -= 8)
+        *wdst++ = w;
+    cdst = (char*)wdst;
+    while (n-- > 0)
+        *cdst++ = c;
     return dst;
 }
 
@@ -76,19 +174,6 @@ char* gets(char* buf, int max)
     return buf;
 }
 
-int stat(const char* n, struct stat* st)
-{
-    int fd;
-    int r;
-
-    fd = open(n, O_RDONLY);
-    if (fd < 0)
-        return -1;
-    r = fstat(fd, st);
-    close(fd);
-    return r;
-}
-
 int atoi(const char* s)
 {
     int n;
@@ -103,11 +188,31 @@ void* memmove(void* vdst, const void* vsrc, int n)
 {
     char*       dst;
     const char* src;
+    int         words;
 
-    dst = vdst;
-    src = vsrc;
+    dst   = vdst;
+    src   = vsrc;
+    words = WORD((uint64)src ^ (uint64)dst);
     if (src > dst)
     {
+        if (words)
+        {
+            while (n > 0 && !WORD(dst))
+                *dst++ = *src++, n--;
+            for (; n >= 64; n -= 64, dst += 64, src += 64)
+            {
+                ((uint64*)dst)[0] = ((uint64*)src)[0];
+                ((uint64*)dst)[1] = ((uint64*)src)[1];
+                ((uint64*)dst)[2] = ((uint64*)src)[2];
+                ((uint64*)dst)[3] = ((uint64*)src)[3];
+                ((uint64*)dst)[4] = ((uint64*)src)[4];
+                ((uint64*)dst)[5] = ((uint64*)src)[5];
+                ((uint64*)dst)[6] = ((uint64*)src)[6];
+                ((uint64*)dst)[7] = ((uint64*)src)[7];
+            }
+            for (; n >= 8; n -= 8, dst += 8, src += 8)
+                *(uint64*)dst = *(uint64*)src;
+        }
         while (n-- > 0)
             *dst++ = *src++;
     }
@@ -115,6 +220,28 @@ void* memmove(void* vdst, const void* vsrc, int n)
     {
         dst += n;
         src += n;
+        if (words)
+        {
+            while (n > 0 && !WORD(dst))
+                *--dst = *--src, n--;
+            for (; n >= 64; n -= 64)
+            {
+                dst -= 64, src -= 64;
+                ((uint64*)dst)[7] = ((uint64*)src)[7];
+                ((uint64*)dst)[6] = ((uint64*)src)[6];
+                ((uint64*)dst)[5] = ((uint64*)src)[5];
+                ((uint64*)dst)[4] = ((uint64*)src)[4];
+                ((uint64*)dst)[3] = ((uint64*)src)[3];
+                ((uint64*)dst)[2] = ((uint64*)src)[2];
+                ((uint64*)dst)[1] = ((uint64*)src)[1];
+                ((uint64*)dst)[0] = ((uint64*)src)[0];
+            }
+            for (; n >= 8; n -= 8)
+            {
+                dst -= 8, src -= 8;
+                *(uint64*)dst = *(uint64*)src;
+            }
+        }
         while (n-- > 0)
             *--dst = *--src;
     }
@@ -124,6 +251,19 @@ void* memmove(void* vdst, const void* vsrc, int n)
 int memcmp(const void* s1, const void* s2, uint n)
 {
     const char *p1 = s1, *p2 = s2;
+    if (WORD((uint64)p1 ^ (uint64)p2))
+    {
+        while (n > 0 && !WORD(p1) && *p1 == *p2)
+        {
+            n--;
+            p1++;
+            p2++;
+        }
+        // the byte loop below finds the byte that differs.
+        if (WORD(p1))
+            for (; n >= 8 && *(uint64*)p1 == *(uint64*)p2; n -= 8)
+                p1 += 8, p2 += 8;
+    }
     while (n-- > 0)
     {
         if (*p1 != *p2)
@@ -136,6 +276,113 @@ int memcmp(const void* s1, const void* s2, uint n)
     return 0;
 }
 
+// The scanning routines below also take 8 bytes at a time,
+// finding the bytes of a word equal to c with the usual bit
+// trick: each such byte gets its high bit set in BYTEEQ(),
+// and no other byte does.
+#define ONES  0x0101010101010101UL
+#define HIGHS 0x8080808080808080UL
+#define BYTEEQ(x, c) (~(((((x) ^ (c)) & ~HIGHS) + ~HIGHS) | ((x) ^ (c))) & HIGHS)
+
+// 统计字中高位被置位的字节数
+static int nhigh(uint64 m)
+{
+    return (m >> 7) * ONES >> 56;
+}
+
+void* memchr(const void* s, int c, uint n)
+{
+    const uchar* p = s;
+    uint64       w = (uchar)c * ONES, m;
+
+    while (n > 0 && !WORD(p))
+    {
+        if (*p == (uchar)c)
+            return (void*)p;
+        p++, n--;
+    }
+    for (; n >= 8; n -= 8, p += 8)
+    {
+        if ((m = BYTEEQ(*(uint64*)p, w)) != 0)
+        {
+            // little-endian: the lowest set bit is the first byte.
+            for (; !(m & 0x80); m >>= 8)
+                p++;
+            return (void*)p;
+        }
+    }
+    for (; n > 0; p++, n--)
+        if (*p == (uchar)c)
+            return (void*)p;
+    return 0;
+}
+
+// Return how many of the n bytes at s are c.
+// 统计 n 个字节中等于 c 的个数
+uint memcount(const void* s, int c, uint n)
+{
+    const uchar* p = s;
+    uint64       w = (uchar)c * ONES;
+    uint         k = 0;
+
+    while (n > 0 && !WORD(p))
+    {
+        k += *p++ == (uchar)c;
+        n--;
+    }
+    for (; n >= 8; n -= 8, p += 8)
+        k += nhigh(BYTEEQ(*(uint64*)p, w));
+    while (n-- > 0)
+        k += *p++ == (uchar)c;
+    return k;
+}
+
+// the bytes that wc counts as white space, high bits set.
+// 返回字中空白字节的掩码
+static uint64 spaces(uint64 x)
+{
+    return BYTEEQ(x, ' ' * ONES) | BYTEEQ(x, '\t' * ONES) | BYTEEQ(x, '\n' * ONES) |
+           BYTEEQ(x, '\v' * ONES) | BYTEEQ(x, '\r' * ONES) | BYTEEQ(x, 0);
+}
+
+// Return how many words, runs of bytes other than white
+// space and NUL, begin in the n bytes at s. *inword says
+// whether the byte before s was in a word, and is updated to
+// say so of the last byte, so that a text can be counted a
+// buffer at a time.
+// 统计 n 个字节中开始的单词数
+uint wordcount(const void* s, uint n, int* inword)
+{
+    const uchar* p  = s;
+    uint64       sp = *inword ? 0 : 1;   // was the last byte white space?
+    uint64       m;
+    uint         k = 0;
+
+    while (n > 0 && !WORD(p))
+    {
+        m = spaces(*p++ * ONES) != 0;
+        k += sp && !m;
+        sp = m;
+        n--;
+    }
+    for (; n >= 8; n -= 8, p += 8)
+    {
+        // a word begins at each byte that is not white space
+        // but follows one that is.
+        m = spaces(*(uint64*)p);
+        k += nhigh(~m & HIGHS & (m << 8 | sp << 7));
+        sp = m >> 63;
+    }
+    while (n-- > 0)
+    {
+        m = spaces(*p++ * ONES) != 0;
+        k += sp && !m;
+        sp = m;
+    }
+    *inword = !sp;
+    return k;
+}
+
 void* memcpy(void* dst, const void* src, uint n)
 {
     return memmove(dst, src, n);
@@ -3,95 +3,291 @@
 #include "user/user.h"
 #include "kernel/param.h"
 
-// Memory allocator by Kernighan and Ritchie,
-// The C programming Language, 2nd ed.  Section 8.7.
+// Memory allocator with size classes and boundary tags.
+//
+// The heap is cut into blocks, each starting with a struct
+// block header that holds its own size and that of the block
+// before it, so that a block's neighbours on both sides can be
+// found at once. The last header of each region taken from
+// sbrk() is a fencepost that reads as a block in use.
+//
+// Small blocks, of up to SMALLMAX bytes, are kept on a free
+// list per size when freed, still marked in use, so malloc()
+// and free() of them take constant time. Each list keeps at
+// most SMALLKEEP blocks, so that they cannot pin down much of
+// the heap. Other free blocks are merged with free neighbours
+// and kept on lists by powers of two of their size; malloc()
+// takes the first that fits, starting with the list of the
+// size asked for, and splits off what it does not need. When
+// the free block at the top of the heap grows past TRIMSIZE,
+// most of it goes back to the kernel with a negative sbrk().
+//
+// One lock covers the heap, so threads made by clone() may
+// share it.
 
-typedef long Align;
+#define HDR       16                // bytes of header before each block's data
+#define MINBLOCK  32                // smallest block, with room for the free list links
+#define SMALLMAX  256               // largest block kept on a per-size list
+#define NSMALL    (SMALLMAX / 16 - 1)
+#define SMALLKEEP 64                // most blocks kept on each per-size list
+#define NBIN      20                // lists of other free blocks: under 512, 512..1023, ...
+#define MINCORE   (64 * 1024)       // least memory to ask sbrk() for at once
+#define TRIMSIZE  (128 * 1024)      // free top of heap past which memory is given back
+#define INUSE     1
 
-union header
+struct block
 {
-    struct
-    {
-        union header* ptr;
-        uint          size;
-    } s;
-    Align x;
+    uint64        size;       // bytes in the block, header included, with INUSE
+    uint64        prevsize;   // bytes in the block just before, 0 for a region's first
+    struct block* next;       // free lists only, in place of the data
+    struct block* prev;       // bins only
 };
 
-typedef union header Header;
+static int           mlock;
+static struct block* small[NSMALL];    // free small blocks, by size
+static int           nsmall[NSMALL];   // blocks on each small list
+static struct block* bins[NBIN];       // other free blocks, by power of two
+static char*         heaptop;          // end of the last region taken from sbrk()
 
-static Header  base;
-static Header* freep;
+#define BSIZE(b) ((b)->size & ~(uint64)INUSE)
+#define NEXT(b)  ((struct block*)((char*)(b) + BSIZE(b)))
+#define PREV(b)  ((struct block*)((char*)(b) - (b)->prevsize))
 
-void free(void* ap)
+static void lock(void)
+{
+    while (__sync_lock_test_and_set(&mlock, 1))
+        ;
+}
+
+static void unlock(void)
 {
-    Header *bp, *p;
+    __sync_lock_release(&mlock);
+}
+
+// Set b's size and whether it is in use, and tell the block
+// after it.
+// 设置块大小，并更新其后一个块的边界标记
+static void setsize(struct block* b, uint64 size, int inuse)
+{
+    b->size           = size | inuse;
+    NEXT(b)->prevsize = size;
+}
+
+// 计算空闲块所属的链表
+static int binof(uint64 size)
+{
+    int i = 0;
+
+    for (size >>= 9; size && i < NBIN - 1; size >>= 1)
+        i++;
+    return i;
+}
+
+// 将空闲块加入链表
+static void binpush(struct block* b)
+{
+    struct block** l = &bins[binof(BSIZE(b))];
+
+    b->prev = 0;
+    b->next = *l;
+    if (*l)
+        (*l)->prev = b;
+    *l = b;
+}
 
-    bp = (Header*)ap - 1;
-    for (p = freep; !(bp > p && bp < p->s.ptr); p = p->s.ptr)
-        if (p >= p->s.ptr && (bp > p || bp < p->s.ptr))
-            break;
-    if (bp + bp->s.size == p->s.ptr)
+// 将空闲块移出链表
+static void binremove(struct block* b)
+{
+    if (b->prev)
+        b->prev->next = b->next;
+    else
+        bins[binof(BSIZE(b))] = b->next;
+    if (b->next)
+        b->next->prev = b->prev;
+}
+
+// Give most of the free block b, which ends at the top of the
+// heap, back to the kernel, unless something else has moved
+// the break since.
+// 将堆顶的空闲内存归还给内核
+static void trim(struct block* b)
+{
+    uint64        cut;
+    struct block* f;
+
+    if (BSIZE(b) < TRIMSIZE || sbrk(0) != heaptop)
+        return;
+    cut = (BSIZE(b) - MINCORE) & ~(uint64)(4096 - 1);
+    b->size -= cut;
+    f           = NEXT(b);
+    f->size     = INUSE;   // the new fencepost
+    f->prevsize = BSIZE(b);
+    sbrk(-(int)cut);
+    heaptop -= cut;
+}
+
+// Mark the block b free and merge it with its free
+// neighbours. Returns the merged block, which is on no list.
+// 将块标记为空闲，并与相邻的空闲块合并
+static struct block* merge(struct block* b)
+{
+    struct block* n    = NEXT(b);
+    uint64        size = BSIZE(b);
+
+    if (!(n->size & INUSE))
     {
-        bp->s.size += p->s.ptr->s.size;
-        bp->s.ptr = p->s.ptr->s.ptr;
+        binremove(n);
+        size += BSIZE(n);
     }
-    else
-        bp->s.ptr = p->s.ptr;
-    if (p + p->s.size == bp)
+    if (b->prevsize && !(PREV(b)->size & INUSE))
     {
-        p->s.size += bp->s.size;
-        p->s.ptr = bp->s.ptr;
+        b = PREV(b);
+        binremove(b);
+        size += BSIZE(b);
     }
-    else
-        p->s.ptr = bp;
-    freep = p;
+    setsize(b, size, 0);
+    return b;
 }
 
-static Header* morecore(uint nu)
+// Merge the blocks on the small lists back into the bins.
+// Returns the number of blocks moved.
+// 将小块链表中的块合并回空闲链表
+static int flushsmall(void)
 {
-    char*   p;
-    Header* hp;
+    struct block* b;
+    int           c, n = 0;
 
-    if (nu < 4096)
-        nu = 4096;
-    p = sbrk(nu * sizeof(Header));
-    if (p == (char*)-1)
-        return 0;
-    hp         = (Header*)p;
-    hp->s.size = nu;
-    free((void*)(hp + 1));
-    return freep;
+    for (c = 0; c < NSMALL; c++)
+    {
+        while ((b = small[c]) != 0)
+        {
+            small[c] = b->next;
+            binpush(merge(b));
+            n++;
+        }
+        nsmall[c] = 0;
+    }
+    return n;
 }
 
-void* malloc(uint nbytes)
+// Ask the kernel for at least nb more bytes of heap, going on
+// from the last region if the break has not moved since.
+// Returns 0 if there is no more memory.
+// 向内核申请更多堆内存
+static int morecore(uint64 nb)
 {
-    Header *p, *prevp;
-    uint    nunits;
+    char*         p;
+    uint64        pad;
+    struct block* b;
 
-    nunits = (nbytes + sizeof(Header) - 1) / sizeof(Header) + 1;
-    if ((prevp = freep) == 0)
+    nb += HDR;
+    if (nb < MINCORE)
+        nb = MINCORE;
+    nb  = (nb + 4096 - 1) & ~(uint64)(4096 - 1);
+    p   = sbrk(0);
+    pad = -(uint64)p & 15;
+    if (nb + pad > 0x7fffffff || (p = sbrk(nb + pad)) == (char*)-1)
+        return 0;
+    p += pad;
+
+    if (p == heaptop)
     {
-        base.s.ptr = freep = prevp = &base;
-        base.s.size                = 0;
+        // the old fencepost becomes the new block's header.
+        b       = (struct block*)(p - HDR);
+        b->size = nb;
     }
-    for (p = prevp->s.ptr;; prevp = p, p = p->s.ptr)
+    else
     {
-        if (p->s.size >= nunits)
+        b           = (struct block*)p;
+        b->prevsize = 0;
+        b->size     = nb - HDR;
+    }
+    heaptop = p + nb;
+    ((struct block*)(heaptop - HDR))->size = INUSE;
+    setsize(b, BSIZE(b), INUSE);
+    binpush(merge(b));
+    return 1;
+}
+
+// Take a free block of at least size bytes from the bins,
+// splitting off the rest if it is big enough to use.
+// 从空闲链表中取出一块，多余部分切分后放回
+static struct block* take(uint64 size)
+{
+    struct block *b, *rest;
+    int           i;
+
+    for (;;)
+    {
+        for (i = binof(size); i < NBIN; i++)
         {
-            if (p->s.size == nunits)
-                prevp->s.ptr = p->s.ptr;
-            else
-            {
-                p->s.size -= nunits;
-                p += p->s.size;
-                p->s.size = nunits;
-            }
-            freep = prevp;
-            return (void*)(p + 1);
+            for (b = bins[i]; b; b = b->next)
+                if (BSIZE(b) >= size)
+                    goto found;
         }
-        if (p == freep)
-            if ((p = morecore(nunits)) == 0)
-                return 0;
+        // before growing the heap, see whether the blocks
+        // kept for small sizes merge into one big enough.
+        if (!flushsmall() && !morecore(size))
+            return 0;
+    }
+
+found:
+    binremove(b);
+    if (BSIZE(b) - size >= MINBLOCK)
+    {
+        rest = (struct block*)((char*)b + size);
+        setsize(rest, BSIZE(b) - size, 0);
+        setsize(b, size, INUSE);
+        binpush(rest);
     }
+    else
+        setsize(b, BSIZE(b), INUSE);
+    return b;
+}
+
+void free(void* ap)
+{
+    struct block* b;
+    int           c;
+
+    if (ap == 0)
+        return;
+    b = (struct block*)((char*)ap - HDR);
+    lock();
+    if (BSIZE(b) <= SMALLMAX && nsmall[c = BSIZE(b) / 16 - 2] < SMALLKEEP)
+    {
+        b->next  = small[c];
+        small[c] = b;
+        nsmall[c]++;
+    }
+    else
+    {
+        b = merge(b);
+        if ((char*)NEXT(b) + HDR == heaptop)
+            trim(b);
+        binpush(b);
+    }
+    unlock();
+}
+
+void* malloc(uint nbytes)
+{
+    struct block* b;
+    uint64        size;
+    int           c;
+
+    size = ((uint64)nbytes + 15) / 16 * 16 + HDR;
+    if (size < MINBLOCK)
+        size = MINBLOCK;
+    lock();
+    if (size <= SMALLMAX && small[c = size / 16 - 2])
+    {
+        b        = small[c];
+        small[c] = b->next;
+        nsmall[c]--;
+    }
+    else
+        b = take(size);
+    unlock();
+    return b ? (char*)b + HDR : 0;
 }
@@ -1,6 +1,13 @@
 #include "kernel/types.h"
 
 struct stat;
+struct sysstat;
+struct profsample;
+struct sysinfo;
+struct procinfo;
+struct iovec;
+struct dirstat;
+struct pollfd;
 
 // system calls
 int   fork(void);
@@ -24,9 +31,41 @@ int   getpid(void);
 char* sbrk(int);
 int   sleep(int);
 int   uptime(void);
+int   fsync(int);
+int   fcntl(int, int, int);
+int   vmsplice(int, void*, int);
+void* mmap(void*, uint64, int, int, int, uint64);
+int   munmap(void*, uint64);
+int   trace(uint64);
+int   sysstat(struct sysstat*, int);
+int   readv(int, struct iovec*, int);
+int   writev(int, struct iovec*, int);
+int   pread(int, void*, int, uint);
+int   pwrite(int, const void*, int, uint);
+int   getdents(int, struct dirstat*, int);
+int   clone(void (*)(void*), void*, void*);
+int   join(int, int*);
+int   futex(int*, int, int);
+int   setsched(int, int, int);
+int   spawn(const char*, char**, int*);
+int   prof(int, struct profsample*, int);
+int   sysinfo(struct sysinfo*);
+int   procinfo(struct procinfo*, int);
+int   ringenter(int);
+int   poll(struct pollfd*, int, int);
+int   stat(const char*, struct stat*);
+
+// the system calls wrapped by ulib.c, called directly
+int   _fork(void);
+int   _exit(int) __attribute__((noreturn));
+int   _write(int, const void*, int);
+int   _read(int, void*, int);
+int   _close(int);
+int   _exec(const char*, char**);
+int   _getpid(void);
+int   _uptime(void);
 
 // ulib.c
-int   stat(const char*, struct stat*);
 char* strcpy(char*, const char*);
 void* memmove(void*, const void*, int);
 char* strchr(const char*, char c);
@@ -41,3 +80,17 @@ void  free(void*);
 int   atoi(const char*);
 int   memcmp(const void*, const void*, uint);
 void* memcpy(void*, const void*, uint);
+void* memchr(const void*, int, uint);
+uint  memcount(const void*, int, uint);
+uint  wordcount(const void*, uint, int*);
+
+// set by printf.c once it buffers output, for the wrappers
+// in ulib.c to flush it.
+enum
+{
+    STDIO_FLUSH,       // flush fd
+    STDIO_CLOSE,       // flush fd, which is being closed
+    STDIO_FLUSHLINE,   // flush every line-buffered fd
+    STDIO_FLUSHALL     // flush every fd
+};
+extern void (*stdiohook)(int fd, int op);
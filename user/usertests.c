@@ -7,6 +7,11 @@
 #include "kernel/syscall.h"
 #include "kernel/memlayout.h"
 #include "kernel/riscv.h"
+#include "kernel/sysstat.h"
+#include "kernel/sysinfo.h"
+#include "kernel/sysring.h"
+#include "kernel/poll.h"
+#include "kernel/uio.h"
 
 //
 // Tests xv6 system calls.  usertests without arguments runs them all
@@ -585,6 +590,127 @@ void opentest(char* s)
     }
 }
 
+// fsync() is a barrier for group commit: it must succeed on
+// an open file while other processes keep writing, and fail
+// on a descriptor that is not open.
+void fsynctest(char* s)
+{
+    enum
+    {
+        NCHILD = 4,
+        N      = 20
+    };
+    char name[3];
+    int  fd, i, pid, xstatus;
+
+    for (pid = 0; pid < NCHILD; pid++)
+    {
+        if (fork() == 0)
+        {
+            name[0] = 'f';
+            name[1] = '0' + pid;
+            name[2] = 0;
+            fd      = open(name, O_CREATE | O_RDWR);
+            if (fd < 0)
+            {
+                printf("%s: create %s failed\n", s, name);
+                exit(1);
+            }
+            for (i = 0; i < N; i++)
+            {
+                if (write(fd, "0123456789", 10) != 10 || (i % 5 == 0 && fsync(fd) != 0))
+                {
+                    printf("%s: write/fsync failed\n", s);
+                    exit(1);
+                }
+            }
+            close(fd);
+            unlink(name);
+            exit(0);
+        }
+    }
+    for (pid = 0; pid < NCHILD; pid++)
+    {
+        wait(&xstatus);
+        if (xstatus != 0)
+            exit(xstatus);
+    }
+    if (fsync(99) != -1)
+    {
+        printf("%s: fsync of a bad fd succeeded\n", s);
+        exit(1);
+    }
+}
+
+// read a file sequentially from two processes at once, in
+// reads that straddle block boundaries, so that read-ahead
+// buffers are shared and completed by the disk interrupt.
+void readahead(char* s)
+{
+    enum
+    {
+        NBLK = 60,
+        BS   = 1024,
+        RD   = 500
+    };
+    static char blk[BS];
+    int         fd, i, j, n, off, xstatus;
+
+    fd = open("ra", O_CREATE | O_RDWR);
+    if (fd < 0)
+    {
+        printf("%s: create ra failed\n", s);
+        exit(1);
+    }
+    for (i = 0; i < NBLK; i++)
+    {
+        memset(blk, 'a' + i % 26, BS);
+        if (write(fd, blk, BS) != BS)
+        {
+            printf("%s: write ra failed\n", s);
+            exit(1);
+        }
+    }
+    close(fd);
+
+    for (j = 0; j < 2; j++)
+    {
+        if (fork() == 0)
+        {
+            if ((fd = open("ra", O_RDONLY)) < 0)
+            {
+                printf("%s: open ra failed\n", s);
+                exit(1);
+            }
+            for (off = 0; (n = read(fd, blk, RD)) > 0; off += n)
+            {
+                for (i = 0; i < n; i++)
+                {
+                    if (blk[i] != 'a' + (off + i) / BS % 26)
+                    {
+                        printf("%s: wrong data at %d\n", s, off + i);
+                        exit(1);
+                    }
+                }
+            }
+            if (off != NBLK * BS)
+            {
+                printf("%s: read %d bytes, want %d\n", s, off, NBLK * BS);
+                exit(1);
+            }
+            close(fd);
+            exit(0);
+        }
+    }
+    for (j = 0; j < 2; j++)
+    {
+        wait(&xstatus);
+        if (xstatus != 0)
+            exit(xstatus);
+    }
+    unlink("ra");
+}
+
 void writetest(char* s)
 {
     int fd;
@@ -636,130 +762,1872 @@ void writetest(char* s)
     }
 }
 
-void writebig(char* s)
+// write a file that reaches well into the doubly-indirect
+// blocks, and read it back.
+void writebig(char* s)
+{
+    enum
+    {
+        N = NDIRECT + NINDIRECT + 4 * NINDIRECT
+    };
+    int i, fd, n;
+
+    fd = open("big", O_CREATE | O_RDWR);
+    if (fd < 0)
+    {
+        printf("%s: error: creat big failed!\n", s);
+        exit(1);
+    }
+
+    for (i = 0; i < N; i++)
+    {
+        ((int*)buf)[0] = i;
+        if (write(fd, buf, BSIZE) != BSIZE)
+        {
+            printf("%s: error: write big file failed\n", s, i);
+            exit(1);
+        }
+    }
+
+    close(fd);
+
+    fd = open("big", O_RDONLY);
+    if (fd < 0)
+    {
+        printf("%s: error: open big failed!\n", s);
+        exit(1);
+    }
+
+    n = 0;
+    for (;;)
+    {
+        i = read(fd, buf, BSIZE);
+        if (i == 0)
+        {
+            if (n != N)
+            {
+                printf("%s: read only %d blocks from big", s, n);
+                exit(1);
+            }
+            break;
+        }
+        else if (i != BSIZE)
+        {
+            printf("%s: read failed %d\n", s, i);
+            exit(1);
+        }
+        if (((int*)buf)[0] != n)
+        {
+            printf("%s: read content of block %d is %d\n", s, n, ((int*)buf)[0]);
+            exit(1);
+        }
+        n++;
+    }
+    close(fd);
+    if (unlink("big") < 0)
+    {
+        printf("%s: unlink big failed\n", s);
+        exit(1);
+    }
+}
+
+// many creates, followed by unlink test
+void createtest(char* s)
+{
+    int i, fd;
+    enum
+    {
+        N = 52
+    };
+
+    char name[3];
+    name[0] = 'a';
+    name[2] = '\0';
+    for (i = 0; i < N; i++)
+    {
+        name[1] = '0' + i;
+        fd      = open(name, O_CREATE | O_RDWR);
+        close(fd);
+    }
+    name[0] = 'a';
+    name[2] = '\0';
+    for (i = 0; i < N; i++)
+    {
+        name[1] = '0' + i;
+        unlink(name);
+    }
+}
+
+void dirtest(char* s)
+{
+    if (mkdir("dir0") < 0)
+    {
+        printf("%s: mkdir failed\n", s);
+        exit(1);
+    }
+
+    if (chdir("dir0") < 0)
+    {
+        printf("%s: chdir dir0 failed\n", s);
+        exit(1);
+    }
+
+    if (chdir("..") < 0)
+    {
+        printf("%s: chdir .. failed\n", s);
+        exit(1);
+    }
+
+    if (unlink("dir0") < 0)
+    {
+        printf("%s: unlink dir0 failed\n", s);
+        exit(1);
+    }
+}
+
+void exectest(char* s)
+{
+    int   fd, xstatus, pid;
+    char* echoargv[] = {"echo", "OK", 0};
+    char  buf[3];
+
+    unlink("echo-ok");
+    pid = fork();
+    if (pid < 0)
+    {
+        printf("%s: fork failed\n", s);
+        exit(1);
+    }
+    if (pid == 0)
+    {
+        close(1);
+        fd = open("echo-ok", O_CREATE | O_WRONLY);
+        if (fd < 0)
+        {
+            printf("%s: create failed\n", s);
+            exit(1);
+        }
+        if (fd != 1)
+        {
+            printf("%s: wrong fd\n", s);
+            exit(1);
+        }
+        if (exec("echo", echoargv) < 0)
+        {
+            printf("%s: exec echo failed\n", s);
+            exit(1);
+        }
+        // won't get to here
+    }
+    if (wait(&xstatus) != pid)
+    {
+        printf("%s: wait failed!\n", s);
+    }
+    if (xstatus != 0)
+        exit(xstatus);
+
+    fd = open("echo-ok", O_RDONLY);
+    if (fd < 0)
+    {
+        printf("%s: open failed\n", s);
+        exit(1);
+    }
+    if (read(fd, buf, 2) != 2)
+    {
+        printf("%s: read failed\n", s);
+        exit(1);
+    }
+    unlink("echo-ok");
+    if (buf[0] == 'O' && buf[1] == 'K')
+        exit(0);
+    else
+    {
+        printf("%s: wrong output\n", s);
+        exit(1);
+    }
+}
+
+// resize a pipe's buffer with fcntl(), fill it without a
+// reader, and check that the data survives another resize.
+void pipesize(char* s)
+{
+    enum
+    {
+        SZ = 20000
+    };
+    int fds[2], i, n, size;
+
+    if (pipe(fds) != 0)
+    {
+        printf("%s: pipe() failed\n", s);
+        exit(1);
+    }
+    if (fcntl(fds[0], F_GETPIPE_SZ, 0) != 4096)
+    {
+        printf("%s: default pipe size is %d\n", s, fcntl(fds[0], F_GETPIPE_SZ, 0));
+        exit(1);
+    }
+    size = fcntl(fds[1], F_SETPIPE_SZ, SZ);
+    if (size != 32768)
+    {
+        printf("%s: F_SETPIPE_SZ returned %d\n", s, size);
+        exit(1);
+    }
+    for (n = 0; n < SZ; n += i)
+    {
+        for (i = 0; i < sizeof(buf) && n + i < SZ; i++)
+            buf[i] = n + i;
+        if (write(fds[1], buf, i) != i)
+        {
+            printf("%s: pipe write failed\n", s);
+            exit(1);
+        }
+    }
+    if (fcntl(fds[1], F_SETPIPE_SZ, 4096) != -1)
+    {
+        printf("%s: shrank a pipe below its contents\n", s);
+        exit(1);
+    }
+    if (fcntl(fds[1], F_SETPIPE_SZ, SZ + 1) != 32768)
+    {
+        printf("%s: resize of a full pipe failed\n", s);
+        exit(1);
+    }
+    close(fds[1]);
+    for (n = 0; (i = read(fds[0], buf, sizeof(buf))) > 0; n += i)
+    {
+        for (int j = 0; j < i; j++)
+        {
+            if ((buf[j] & 0xff) != ((n + j) & 0xff))
+            {
+                printf("%s: pipe data wrong at %d\n", s, n + j);
+                exit(1);
+            }
+        }
+    }
+    if (n != SZ)
+    {
+        printf("%s: read %d bytes back, want %d\n", s, n, SZ);
+        exit(1);
+    }
+    close(fds[0]);
+    if (fcntl(0, F_SETPIPE_SZ, 4096) != -1)
+    {
+        printf("%s: F_SETPIPE_SZ on a non-pipe succeeded\n", s);
+        exit(1);
+    }
+}
+
+// move page-aligned buffers through a pipe by reference, and
+// check that neither side sees the other's later writes.
+void vmsplicetest(char* s)
+{
+    enum
+    {
+        NPG = 4,
+        PG  = 4096
+    };
+    char *a, *b, *top;
+    int   fds[2], i;
+
+    top = sbrk(0);
+    a   = sbrk(PG - (uint64)top % PG + 2 * NPG * PG);
+    if (a == (char*)-1)
+    {
+        printf("%s: sbrk failed\n", s);
+        exit(1);
+    }
+    a = top + (PG - (uint64)top % PG);
+    b = a + NPG * PG;
+    for (i = 0; i < NPG * PG; i++)
+        a[i] = i / PG + 'a';
+
+    if (pipe(fds) != 0 || fcntl(fds[1], F_SETPIPE_SZ, NPG * PG) != NPG * PG)
+    {
+        printf("%s: pipe setup failed\n", s);
+        exit(1);
+    }
+    if (vmsplice(fds[1], a, NPG * PG) != NPG * PG)
+    {
+        printf("%s: vmsplice write failed\n", s);
+        exit(1);
+    }
+    // the pipe holds the old contents, not these.
+    for (i = 0; i < NPG * PG; i++)
+        a[i] = 'x';
+    // an unaligned read takes the copying path.
+    if (vmsplice(fds[0], b + 1, 1) != 1 || b[1] != 'a')
+    {
+        printf("%s: unaligned vmsplice read failed\n", s);
+        exit(1);
+    }
+    if (read(fds[0], b + 1, PG - 1) != PG - 1)
+    {
+        printf("%s: read failed\n", s);
+        exit(1);
+    }
+    if (vmsplice(fds[0], b + PG, (NPG - 1) * PG) != (NPG - 1) * PG)
+    {
+        printf("%s: vmsplice read failed\n", s);
+        exit(1);
+    }
+    for (i = 1; i < NPG * PG; i++)
+    {
+        if (b[i] != i / PG + 'a')
+        {
+            printf("%s: wrong data at %d\n", s, i);
+            exit(1);
+        }
+    }
+    // the received pages are writable.
+    for (i = PG; i < NPG * PG; i++)
+        b[i] = 'y';
+    if (a[PG] != 'x' || b[PG] != 'y')
+    {
+        printf("%s: pages still shared\n", s);
+        exit(1);
+    }
+    close(fds[0]);
+    close(fds[1]);
+    sbrk(-(PG - (uint64)top % PG + 2 * NPG * PG));
+}
+
+// the word-at-a-time memset(), memmove() and memcmp() must
+// handle every alignment and overlapping moves.
+void memops(char* s)
+{
+    static char a[256], r[256];
+    int         d, o, n, i;
+
+    for (d = 0; d < 9; d++)
+    {
+        for (o = 0; o < 17; o++)
+        {
+            for (n = 0; n < 150; n += 7)
+            {
+                for (i = 0; i < sizeof(a); i++)
+                    a[i] = r[i] = i;
+                memmove(a + 64 + d, a + 64 + o, n);
+                for (i = n - 1; d > o && i >= 0; i--)
+                    r[64 + d + i] = r[64 + o + i];
+                for (i = 0; d <= o && i < n; i++)
+                    r[64 + d + i] = r[64 + o + i];
+                if (memcmp(a, r, sizeof(a)) != 0)
+                {
+                    printf("%s: memmove(+%d, +%d, %d) wrong\n", s, d, o, n);
+                    exit(1);
+                }
+                memset(a + d, 'x', n);
+                for (i = 0; i < n; i++)
+                    r[d + i] = 'x';
+                if (memcmp(a, r, sizeof(a)) != 0)
+                {
+                    printf("%s: memset(+%d, %d) wrong\n", s, d, n);
+                    exit(1);
+                }
+                if (n > 0)
+                {
+                    r[d + n - 1] = 'y';
+                    if (memcmp(a + d, r + d, n) >= 0 || memcmp(r + d, a + d, n) <= 0)
+                    {
+                        printf("%s: memcmp(+%d, %d) wrong\n", s, d, n);
+                        exit(1);
+                    }
+                }
+            }
+        }
+    }
+}
+
+// sysstat() counts every system call made.
+void sysstattest(char* s)
+{
+    static struct sysstat st[64];
+    uint64                before = 0, after = 0;
+    int                   n, i;
+
+    n = sysstat(st, 64);
+    for (i = 0; i < n; i++)
+        if (strcmp(st[i].name, "getpid") == 0)
+            before = st[i].count;
+    // getpid() itself reads the USYSCALL page.
+    for (i = 0; i < 10; i++)
+        _getpid();
+    if ((n = sysstat(st, 64)) <= 0)
+    {
+        printf("%s: sysstat failed\n", s);
+        exit(1);
+    }
+    for (i = 0; i < n; i++)
+        if (strcmp(st[i].name, "getpid") == 0)
+            after = st[i].count;
+    // other processes may call getpid() as well.
+    if (after < before + 10)
+    {
+        printf("%s: getpid counted %d times, expected 10\n", s, (int)(after - before));
+        exit(1);
+    }
+    if (sysstat((struct sysstat*)0xffffffffffffL, 64) != -1)
+    {
+        printf("%s: sysstat to a bad address succeeded\n", s);
+        exit(1);
+    }
+}
+
+// writev() and readv() move whole lists, across transaction
+// boundaries; pread() and pwrite() leave the file offset alone.
+void iovtest(char* s)
+{
+    static char  a[2000], b[3000], c[7];
+    struct iovec iov[3];
+    int          fd, i, fds[2];
+
+    for (i = 0; i < sizeof(a); i++)
+        a[i] = 'a' + i % 26;
+    for (i = 0; i < sizeof(b); i++)
+        b[i] = 'A' + i % 26;
+    unlink("iovf");
+    if ((fd = open("iovf", O_CREATE | O_RDWR)) < 0)
+    {
+        printf("%s: create iovf failed\n", s);
+        exit(1);
+    }
+    iov[0].iov_base = a;
+    iov[0].iov_len  = sizeof(a);
+    iov[1].iov_base = "";
+    iov[1].iov_len  = 0;
+    iov[2].iov_base = b;
+    iov[2].iov_len  = sizeof(b);
+    if (writev(fd, iov, 3) != sizeof(a) + sizeof(b))
+    {
+        printf("%s: writev failed\n", s);
+        exit(1);
+    }
+    if (pwrite(fd, "0123456", 7, 1995) != 7 || pread(fd, c, 7, 1996) != 7 || memcmp(c, "123456C", 7) != 0)
+    {
+        printf("%s: pwrite/pread failed\n", s);
+        exit(1);
+    }
+    // the offset is still at the end.
+    if (write(fd, "z", 1) != 1 || pread(fd, c, 7, sizeof(a) + sizeof(b)) != 1 || c[0] != 'z')
+    {
+        printf("%s: pwrite moved the offset\n", s);
+        exit(1);
+    }
+    close(fd);
+
+    if ((fd = open("iovf", O_RDONLY)) < 0)
+    {
+        printf("%s: open iovf failed\n", s);
+        exit(1);
+    }
+    memset(a, 0, sizeof(a));
+    memset(b, 0, sizeof(b));
+    iov[1].iov_base = c;
+    iov[1].iov_len  = sizeof(c);
+    iov[2].iov_len  = sizeof(b);   // only sizeof(b) - 7 + 1 are left
+    if (readv(fd, iov, 3) != sizeof(a) + sizeof(b) + 1 || a[0] != 'a' || memcmp(a + 1995, "01234", 5) != 0 ||
+        memcmp(c, "56CDEFG", 7) != 0 || b[0] != 'A' + 7 % 26 || b[sizeof(b) - 7] != 'z')
+    {
+        printf("%s: readv read the wrong data\n", s);
+        exit(1);
+    }
+    close(fd);
+    unlink("iovf");
+
+    if (pipe(fds) < 0)
+    {
+        printf("%s: pipe failed\n", s);
+        exit(1);
+    }
+    if (pwrite(fds[1], "x", 1, 0) != -1 || readv(fds[0], iov, IOV_MAX + 1) != -1)
+    {
+        printf("%s: pwrite to a pipe or too long a readv succeeded\n", s);
+        exit(1);
+    }
+    close(fds[0]);
+    close(fds[1]);
+}
+
+// a write of many blocks at once, split into transactions
+// with the data written around the log, reads back whole; so
+// does an unaligned overwrite, and a rewrite into the blocks
+// freed by truncating the file.
+void orderedwrite(char* s)
+{
+    enum
+    {
+        NB = 100
+    };
+    char* p;
+    int   fd, i, pass;
+
+    if ((p = malloc(NB * BSIZE)) == 0)
+    {
+        printf("%s: malloc failed\n", s);
+        exit(1);
+    }
+    unlink("orderedwrite");
+    for (pass = 0; pass < 2; pass++)
+    {
+        for (i = 0; i < NB * BSIZE; i++)
+            p[i] = (i / BSIZE + i + pass) % 251;
+        if ((fd = open("orderedwrite", O_CREATE | O_TRUNC | O_RDWR)) < 0)
+        {
+            printf("%s: create orderedwrite failed\n", s);
+            exit(1);
+        }
+        if (write(fd, p, NB * BSIZE) != NB * BSIZE)
+        {
+            printf("%s: write of %d blocks failed\n", s, NB);
+            exit(1);
+        }
+        memset(p + BSIZE / 2, 'x', 3 * BSIZE);
+        if (pwrite(fd, p + BSIZE / 2, 3 * BSIZE, BSIZE / 2) != 3 * BSIZE)
+        {
+            printf("%s: overwrite failed\n", s);
+            exit(1);
+        }
+        close(fd);
+
+        if ((fd = open("orderedwrite", O_RDONLY)) < 0)
+        {
+            printf("%s: open orderedwrite failed\n", s);
+            exit(1);
+        }
+        memset(p, 0, NB * BSIZE);
+        if (read(fd, p, NB * BSIZE) != NB * BSIZE || read(fd, p, 1) != 0)
+        {
+            printf("%s: orderedwrite is the wrong size\n", s);
+            exit(1);
+        }
+        close(fd);
+        for (i = 0; i < NB * BSIZE; i++)
+        {
+            char want = i >= BSIZE / 2 && i < BSIZE / 2 + 3 * BSIZE ? 'x' : (i / BSIZE + i + pass) % 251;
+            if (p[i] != want)
+            {
+                printf("%s: pass %d: wrong byte at %d\n", s, pass, i);
+                exit(1);
+            }
+        }
+    }
+    unlink("orderedwrite");
+    free(p);
+}
+
+// a directory with many entries, found through its hash
+// index: removed names are gone, the rest still there, and
+// new names reuse the freed entries.
+void dirindex(char* s)
+{
+    enum
+    {
+        N = 300
+    };
+    char        name[16];
+    struct stat st;
+    uint        size;
+    int         i, fd, pass;
+
+    if (mkdir("dix") < 0 || (fd = open("dixf", O_CREATE | O_RDWR)) < 0)
+    {
+        printf("%s: create dix failed\n", s);
+        exit(1);
+    }
+    close(fd);
+    strcpy(name, "dix/f000");
+    for (i = 0; i < N; i++)
+    {
+        name[5] = '0' + i / 100;
+        name[6] = '0' + i / 10 % 10;
+        name[7] = '0' + i % 10;
+        if (link("dixf", name) < 0)
+        {
+            printf("%s: link %s failed\n", s, name);
+            exit(1);
+        }
+    }
+    if (stat("dix", &st) < 0)
+    {
+        printf("%s: stat dix failed\n", s);
+        exit(1);
+    }
+    size = st.size;
+
+    // remove the even names, then the odd ones.
+    for (pass = 0; pass < 2; pass++)
+    {
+        for (i = pass; i < N; i += 2)
+        {
+            name[5] = '0' + i / 100;
+            name[6] = '0' + i / 10 % 10;
+            name[7] = '0' + i % 10;
+            if (unlink(name) < 0)
+            {
+                printf("%s: unlink %s failed\n", s, name);
+                exit(1);
+            }
+        }
+        for (i = 0; i < N; i++)
+        {
+            name[5] = '0' + i / 100;
+            name[6] = '0' + i / 10 % 10;
+            name[7] = '0' + i % 10;
+            if ((fd = open(name, O_RDONLY)) >= 0)
+                close(fd);
+            if ((fd >= 0) != (pass == 0 && i % 2 == 1))
+            {
+                printf("%s: %s %s\n", s, name, fd >= 0 ? "still there" : "missing");
+                exit(1);
+            }
+        }
+    }
+
+    // new names go in the entries just freed.
+    for (i = 0; i < N; i++)
+    {
+        name[5] = 'a' + i / 100;
+        name[6] = '0' + i / 10 % 10;
+        name[7] = '0' + i % 10;
+        if (link("dixf", name) < 0)
+        {
+            printf("%s: link %s failed\n", s, name);
+            exit(1);
+        }
+    }
+    if (stat("dix", &st) < 0 || st.size != size)
+    {
+        printf("%s: dix grew from %d to %d bytes\n", s, size, st.size);
+        exit(1);
+    }
+    for (i = 0; i < N; i++)
+    {
+        name[5] = 'a' + i / 100;
+        name[6] = '0' + i / 10 % 10;
+        name[7] = '0' + i % 10;
+        if (unlink(name) < 0)
+        {
+            printf("%s: unlink %s failed\n", s, name);
+            exit(1);
+        }
+    }
+
+    if ((fd = open("dix/..", O_RDONLY)) < 0)
+    {
+        printf("%s: open dix/.. failed\n", s);
+        exit(1);
+    }
+    close(fd);
+    if (unlink("dix") < 0 || unlink("dixf") < 0)
+    {
+        printf("%s: unlink dix failed\n", s);
+        exit(1);
+    }
+}
+
+// getdents() lists a directory with each entry's status, in
+// as many calls as it takes, and refuses a plain file.
+void getdentstest(char* s)
+{
+    static struct dirstat ents[5];
+    int                   fd, n, i, dots = 0, found = 0;
+
+    if (mkdir("gdd") < 0 || (fd = open("gdd/f", O_CREATE | O_RDWR)) < 0)
+    {
+        printf("%s: create gdd failed\n", s);
+        exit(1);
+    }
+    if (write(fd, "hello", 5) != 5 || getdents(fd, ents, 1) != -1)
+    {
+        printf("%s: getdents of a file did not fail\n", s);
+        exit(1);
+    }
+    close(fd);
+
+    if ((fd = open("gdd", O_RDONLY)) < 0)
+    {
+        printf("%s: open gdd failed\n", s);
+        exit(1);
+    }
+    // one entry at a time, to take several calls.
+    while ((n = getdents(fd, ents, 1)) > 0)
+    {
+        for (i = 0; i < n; i++)
+        {
+            if (strcmp(ents[i].name, ".") == 0 || strcmp(ents[i].name, "..") == 0)
+                dots += ents[i].st.type == T_DIR;
+            else if (strcmp(ents[i].name, "f") == 0 && ents[i].st.type == T_FILE && ents[i].st.size == 5)
+                found++;
+            else
+            {
+                printf("%s: unexpected entry %s\n", s, ents[i].name);
+                exit(1);
+            }
+        }
+    }
+    close(fd);
+    if (n < 0 || dots != 2 || found != 1)
+    {
+        printf("%s: getdents listed %d dirs and %d files\n", s, dots, found);
+        exit(1);
+    }
+    if (unlink("gdd/f") < 0 || unlink("gdd") < 0)
+    {
+        printf("%s: unlink gdd failed\n", s);
+        exit(1);
+    }
+}
+
+// a lock of the threads in threadtest, which sleeps in futex()
+// while it is held.
+static int tlock, tcount;
+
+static void tacquire(int* l)
+{
+    while (__sync_lock_test_and_set(l, 1))
+        futex(l, FUTEX_WAIT, 1);
+}
+
+static void trelease(int* l)
+{
+    __sync_lock_release(l);
+    futex(l, FUTEX_WAKE, 1);
+}
+
+static void tcounter(void* arg)
+{
+    for (int i = 0; i < 1000; i++)
+    {
+        tacquire(&tlock);
+        tcount++;
+        trelease(&tlock);
+    }
+    exit((int)(uint64)arg);
+}
+
+// grow the shared memory, and exit with where it grew.
+static void tgrower(void* arg)
+{
+    char* a = sbrk(PGSIZE);
+
+    a[0] = 'x';
+    exit((int)(uint64)a);
+}
+
+static void tspinner(void* arg)
+{
+    for (;;)
+        ;
+}
+
+// threads made by clone() share memory and take turns with a
+// futex lock, join() reaps them, and a process exiting takes
+// its threads down with it.
+void threadtest(char* s)
+{
+    enum
+    {
+        NT = 4
+    };
+    char* stk[NT + 1];
+    int   i, tid, pid, xstatus, sum = 0;
+
+    for (i = 0; i <= NT; i++)
+        stk[i] = malloc(PGSIZE);
+    for (i = 0; i < NT; i++)
+    {
+        if (clone(tcounter, (void*)(uint64)(i + 1), stk[i] + PGSIZE) < 0)
+        {
+            printf("%s: clone failed\n", s);
+            exit(1);
+        }
+    }
+    for (i = 0; i < NT; i++)
+    {
+        if (join(0, &xstatus) < 0)
+        {
+            printf("%s: join failed\n", s);
+            exit(1);
+        }
+        sum += xstatus;
+    }
+    if (tcount != NT * 1000 || sum != NT * (NT + 1) / 2 || join(0, 0) != -1)
+    {
+        printf("%s: threads counted %d, exited with %d\n", s, tcount, sum);
+        exit(1);
+    }
+    if (futex(&tlock, FUTEX_WAIT, 1) != -1)
+    {
+        printf("%s: futex waited on a changed value\n", s);
+        exit(1);
+    }
+
+    if ((tid = clone(tgrower, 0, stk[NT] + PGSIZE)) < 0 || join(tid, &xstatus) != tid ||
+        *(char*)(uint64)xstatus != 'x')
+    {
+        printf("%s: memory grown by a thread not shared\n", s);
+        exit(1);
+    }
+
+    if ((pid = fork()) < 0)
+    {
+        printf("%s: fork failed\n", s);
+        exit(1);
+    }
+    if (pid == 0)
+    {
+        if (clone(tspinner, 0, stk[0] + PGSIZE) < 0)
+            exit(1);
+        // fork and shrinking the memory work with a thread
+        // running on another CPU, whose TLB they flush.
+        tcount = 1;
+        if ((pid = fork()) < 0)
+            exit(2);
+        if (pid == 0)
+            exit(tcount == 1 ? 0 : 1);
+        tcount = 2;
+        wait(&xstatus);
+        if (xstatus != 0 || tcount != 2 || sbrk(PGSIZE) == (char*)-1 || sbrk(-PGSIZE) == (char*)-1)
+            exit(2);
+        exit(0);
+    }
+    wait(&xstatus);
+    if (xstatus == 2)
+    {
+        printf("%s: fork or shrink with a running thread failed\n", s);
+        exit(1);
+    }
+    if (xstatus != 0)
+    {
+        printf("%s: exit with a running thread failed\n", s);
+        exit(1);
+    }
+    for (i = 0; i <= NT; i++)
+        free(stk[i]);
+}
+
+static int tpid;
+
+static void tgetpid(void* arg)
+{
+    tpid = getpid();
+    exit(0);
+}
+
+// getpid() and uptime() read the USYSCALL and USHARED pages,
+// which agree with the system calls, read right in a thread,
+// and cannot be written.
+void usyscall(char* s)
+{
+    char* stk;
+    int   pid, tid, xstatus;
+
+    if (getpid() != _getpid() || uptime() - _uptime() > 1 || _uptime() - uptime() > 1)
+    {
+        printf("%s: getpid %d/%d, uptime %d/%d\n", s, getpid(), _getpid(), uptime(), _uptime());
+        exit(1);
+    }
+
+    if ((pid = fork()) < 0)
+    {
+        printf("%s: fork failed\n", s);
+        exit(1);
+    }
+    if (pid == 0)
+    {
+        if (getpid() != _getpid())
+            exit(1);
+        stk = malloc(PGSIZE);
+        if ((tid = clone(tgetpid, 0, stk + PGSIZE)) < 0 || join(tid, 0) != tid || tpid != tid ||
+            getpid() != _getpid())
+            exit(1);
+        // the page is read-only: this kills the child.
+        ((struct usyscall*)USYSCALL)->pid = 0;
+        exit(0);
+    }
+    wait(&xstatus);
+    if (xstatus != -1)
+    {
+        printf("%s: child exited with %d\n", s, xstatus);
+        exit(1);
+    }
+}
+
+// scheduling classes and nice values: setsched() checks its
+// arguments, and a batch process still runs.
+void setschedtest(char* s)
+{
+    int pid, xstatus, t0;
+
+    if (setsched(0, NSCHED, 0) != -1 || setsched(0, SCHED_NORMAL, 20) != -1 ||
+        setsched(0, SCHED_NORMAL, -21) != -1 || setsched(0, -1, 0) != -1)
+    {
+        printf("%s: setsched accepted bad arguments\n", s);
+        exit(1);
+    }
+    if (setsched(0, SCHED_NORMAL, 0) != 0)
+    {
+        printf("%s: setsched failed\n", s);
+        exit(1);
+    }
+
+    if ((pid = fork()) < 0)
+    {
+        printf("%s: fork failed\n", s);
+        exit(1);
+    }
+    if (pid == 0)
+    {
+        if (setsched(0, SCHED_BATCH, 19) != 0)
+            exit(1);
+        // spin through a few ticks, competing with the parent.
+        t0 = uptime();
+        while (uptime() - t0 < 3)
+            ;
+        exit(0);
+    }
+    if (setsched(pid, SCHED_BATCH, 0) != 0)
+    {
+        printf("%s: setsched of child failed\n", s);
+        exit(1);
+    }
+    t0 = uptime();
+    while (uptime() - t0 < 3)
+        ;
+    wait(&xstatus);
+    if (xstatus != 0)
+    {
+        printf("%s: child exited with %d\n", s, xstatus);
+        exit(1);
+    }
+    if (setsched(pid, SCHED_NORMAL, 0) != -1)
+    {
+        printf("%s: setsched of reaped child succeeded\n", s);
+        exit(1);
+    }
+}
+
+// several processes at once take the ticket locks on the
+// file, inode and log tables, and none is left waiting forever.
+void ticketlocks(char* s)
+{
+    enum
+    {
+        NCHILD = 4,
+        N      = 200
+    };
+    char name[] = "tkl0";
+    int  i, j, fd, pid, xstatus;
+
+    for (i = 0; i < NCHILD; i++)
+    {
+        if ((pid = fork()) < 0)
+        {
+            printf("%s: fork failed\n", s);
+            exit(1);
+        }
+        if (pid == 0)
+        {
+            name[3] = '0' + i;
+            for (j = 0; j < N; j++)
+            {
+                if ((fd = open(name, O_CREATE | O_RDWR)) < 0)
+                    exit(1);
+                close(fd);
+                if (j % 10 == 0)
+                    unlink(name);
+            }
+            unlink(name);
+            exit(0);
+        }
+    }
+    for (i = 0; i < NCHILD; i++)
+    {
+        wait(&xstatus);
+        if (xstatus != 0)
+        {
+            printf("%s: child failed\n", s);
+            exit(1);
+        }
+    }
+}
+
+// several processes pread() and fstat() one file with its
+// inode locked shared, while another rewrites it with the same
+// bytes holding the lock exclusively.
+void sharedread(char* s)
+{
+    enum
+    {
+        NCHILD = 4,
+        N      = 100,
+        SZ     = 4 * BSIZE
+    };
+    static char data[SZ];
+    char        got[64];
+    struct stat st;
+    int         i, j, fd, pid, off, xstatus;
+
+    for (i = 0; i < SZ; i++)
+        data[i] = 'a' + i % 23;
+    if ((fd = open("sharedread", O_CREATE | O_RDWR)) < 0 || write(fd, data, SZ) != SZ)
+    {
+        printf("%s: create failed\n", s);
+        exit(1);
+    }
+
+    for (i = 0; i <= NCHILD; i++)
+    {
+        if ((pid = fork()) < 0)
+        {
+            printf("%s: fork failed\n", s);
+            exit(1);
+        }
+        if (pid == 0 && i == NCHILD)
+        {
+            for (j = 0; j < N / 4; j++)
+                if (pwrite(fd, data, SZ, 0) != SZ)
+                    exit(1);
+            exit(0);
+        }
+        if (pid == 0)
+        {
+            for (j = 0; j < N; j++)
+            {
+                off = (j * 97 + i * 31) % (SZ - sizeof(got));
+                if (pread(fd, got, sizeof(got), off) != sizeof(got) ||
+                    memcmp(got, data + off, sizeof(got)) != 0)
+                    exit(1);
+                if (fstat(fd, &st) < 0 || st.size != SZ)
+                    exit(1);
+            }
+            exit(0);
+        }
+    }
+    close(fd);
+    for (i = 0; i <= NCHILD; i++)
+    {
+        wait(&xstatus);
+        if (xstatus != 0)
+        {
+            printf("%s: child failed\n", s);
+            exit(1);
+        }
+    }
+    unlink("sharedread");
+}
+
+// kill() finds each of many children by pid, wait() reaps
+// them all, and their pids are gone afterwards, while a child
+// whose parent exits first is passed on to init.
+void killwaitmany(char* s)
+{
+    enum
+    {
+        N = 20
+    };
+    int pids[N];
+    int i, j, pid, xstatus, fds[2];
+
+    for (i = 0; i < N; i++)
+    {
+        if ((pids[i] = fork()) < 0)
+        {
+            printf("%s: fork failed\n", s);
+            exit(1);
+        }
+        if (pids[i] == 0)
+        {
+            sleep(1000);
+            exit(0);
+        }
+    }
+    for (i = N - 1; i >= 0; i--)
+    {
+        if (kill(pids[i]) != 0)
+        {
+            printf("%s: kill %d failed\n", s, pids[i]);
+            exit(1);
+        }
+    }
+    for (i = 0; i < N; i++)
+    {
+        pid = wait(&xstatus);
+        for (j = 0; j < N && pids[j] != pid; j++)
+            ;
+        if (j == N || xstatus != -1)
+        {
+            printf("%s: wait returned %d, status %d\n", s, pid, xstatus);
+            exit(1);
+        }
+        pids[j] = 0;
+        if (kill(pid) != -1)
+        {
+            printf("%s: kill of reaped %d succeeded\n", s, pid);
+            exit(1);
+        }
+    }
+    if (wait(0) != -1)
+    {
+        printf("%s: wait found a child too many\n", s);
+        exit(1);
+    }
+
+    // an orphan outlives its parent and can still be killed.
+    if (pipe(fds) < 0)
+    {
+        printf("%s: pipe failed\n", s);
+        exit(1);
+    }
+    if ((pid = fork()) < 0)
+    {
+        printf("%s: fork failed\n", s);
+        exit(1);
+    }
+    if (pid == 0)
+    {
+        close(fds[0]);
+        if ((pid = fork()) < 0)
+            exit(1);
+        if (pid == 0)
+        {
+            sleep(1000);
+            exit(0);
+        }
+        write(fds[1], &pid, sizeof(pid));
+        exit(0);
+    }
+    close(fds[1]);
+    if (read(fds[0], &pid, sizeof(pid)) != sizeof(pid))
+    {
+        printf("%s: no grandchild pid\n", s);
+        exit(1);
+    }
+    close(fds[0]);
+    wait(&xstatus);
+    if (xstatus != 0 || kill(pid) != 0)
+    {
+        printf("%s: could not kill orphan %d\n", s, pid);
+        exit(1);
+    }
+}
+
+// free() hands a large freed heap back to the kernel, and
+// small blocks freed are used again.
+void malloctrim(char* s)
+{
+    enum
+    {
+        N  = 64,
+        SZ = 16 * 1024
+    };
+    char* p[N];
+    char *top, *a, *b;
+    int   i;
+
+    for (i = 0; i < N; i++)
+    {
+        if ((p[i] = malloc(SZ)) == 0)
+        {
+            printf("%s: malloc failed\n", s);
+            exit(1);
+        }
+        memset(p[i], i, SZ);
+    }
+    top = sbrk(0);
+    for (i = 0; i < N; i++)
+        free(p[i]);
+    if (sbrk(0) >= top)
+    {
+        printf("%s: heap not trimmed\n", s);
+        exit(1);
+    }
+
+    a = malloc(24);
+    free(a);
+    b = malloc(24);
+    if (a != b)
+    {
+        printf("%s: small block not reused\n", s);
+        exit(1);
+    }
+    free(b);
+}
+
+// spawn() runs a program in a new child with the given fds,
+// without the caller's memory, and fails at once for a program
+// that does not exist.
+void spawntest(char* s)
+{
+    char* echoargv[] = {"echo", "OK", 0};
+    int   p[2], fds[3], pid, xstatus;
+    char  buf[8];
+
+    if (pipe(p) < 0)
+    {
+        printf("%s: pipe failed\n", s);
+        exit(1);
+    }
+    fds[0] = 0;
+    fds[1] = p[1];
+    fds[2] = 2;
+    if ((pid = spawn("echo", echoargv, fds)) < 0)
+    {
+        printf("%s: spawn echo failed\n", s);
+        exit(1);
+    }
+    close(p[1]);
+    if (read(p[0], buf, sizeof(buf)) != 3 || buf[0] != 'O' || buf[1] != 'K')
+    {
+        printf("%s: wrong output\n", s);
+        exit(1);
+    }
+    close(p[0]);
+    if (wait(&xstatus) != pid || xstatus != 0)
+    {
+        printf("%s: wait failed\n", s);
+        exit(1);
+    }
+
+    if (spawn("nosuchprogram", echoargv, 0) >= 0)
+    {
+        printf("%s: spawn of a missing program succeeded\n", s);
+        exit(1);
+    }
+}
+
+// Return the resident pages of the calling process.
+uint64 myrss(char* s)
+{
+    static struct procinfo pi[NPROC];
+    int                    n, pid = getpid();
+
+    if ((n = procinfo(pi, NPROC)) <= 0)
+    {
+        printf("%s: procinfo failed\n", s);
+        exit(1);
+    }
+    while (--n >= 0)
+        if (pi[n].pid == pid)
+            return pi[n].rss;
+    printf("%s: own process missing\n", s);
+    exit(1);
+}
+
+// procinfo() counts a process's pages as they are touched, not
+// as sbrk() reserves them, and sysinfo() sees the free memory
+// they take.
+void memaccount(char* s)
+{
+    enum
+    {
+        N = 16
+    };
+    struct sysinfo si0, si1;
+    uint64         rss0, rss1;
+    char*          a;
+    int            i;
+
+    if ((a = sbrk(N * PGSIZE)) == (char*)-1)
+    {
+        printf("%s: sbrk failed\n", s);
+        exit(1);
+    }
+    rss0 = myrss(s);
+    if (sysinfo(&si0) < 0)
+    {
+        printf("%s: sysinfo failed\n", s);
+        exit(1);
+    }
+    for (i = 0; i < N; i++)
+        a[i * PGSIZE] = i;
+    rss1 = myrss(s);
+    if (sysinfo(&si1) < 0)
+    {
+        printf("%s: sysinfo failed\n", s);
+        exit(1);
+    }
+    if (rss1 < rss0 + N)
+    {
+        printf("%s: rss %d then %d\n", s, (int)rss0, (int)rss1);
+        exit(1);
+    }
+    if (si1.freemem > si0.freemem - N * PGSIZE || si0.nproc < 1 || si0.nfile < 1)
+    {
+        printf("%s: sysinfo wrong\n", s);
+        exit(1);
+    }
+    sbrk(-N * PGSIZE);
+}
+
+// queue a system call in the ring at USYSRING.
+static void ringqueue(int num, uint64 tag, uint64 a0, uint64 a1, uint64 a2)
+{
+    struct sysring* r = (struct sysring*)USYSRING;
+    struct sqe*     e = &r->sq[r->sqtail % NSQE];
+
+    e->num     = num;
+    e->tag     = tag;
+    e->args[0] = a0;
+    e->args[1] = a1;
+    e->args[2] = a2;
+    r->sqtail++;
+}
+
+// system calls queued in the ring run in order with one
+// ringenter(), and calls that may not be queued fail.
+void sysring(char* s)
+{
+    struct sysring* r      = (struct sysring*)USYSRING;
+    int             want[] = {3, 3, 0, -1, 0};   // results of tags 2 to 6
+    struct stat     st;
+    char            buf[8];
+    int             fd, i, n;
+
+    ringqueue(SYS_open, 1, (uint64)"ringfile", O_CREATE | O_RDWR, 0);
+    if ((n = ringenter(NSQE)) != 1 || r->cqtail - r->cqhead != 1 || r->cq[r->cqhead % NSQE].tag != 1)
+    {
+        printf("%s: ringenter open returned %d\n", s, n);
+        exit(1);
+    }
+    if ((fd = r->cq[r->cqhead++ % NSQE].ret) < 0)
+    {
+        printf("%s: open failed\n", s);
+        exit(1);
+    }
+
+    ringqueue(SYS_write, 2, fd, (uint64)"abc", 3);
+    ringqueue(SYS_write, 3, fd, (uint64)"def", 3);
+    ringqueue(SYS_fstat, 4, fd, (uint64)&st, 0);
+    ringqueue(SYS_fork, 5, 0, 0, 0);
+    ringqueue(SYS_close, 6, fd, 0, 0);
+    if ((n = ringenter(NSQE)) != 5)
+    {
+        printf("%s: ringenter returned %d\n", s, n);
+        exit(1);
+    }
+    for (i = 2; i <= 6; i++)
+    {
+        struct cqe* c = &r->cq[r->cqhead++ % NSQE];
+
+        if (c->tag != i || c->ret != want[i - 2])
+        {
+            printf("%s: completion %d: tag %d ret %d\n", s, i, (int)c->tag, c->ret);
+            exit(1);
+        }
+    }
+    if (st.size != 6 || r->sqhead != r->sqtail || ringenter(NSQE) != 0)
+    {
+        printf("%s: ring state wrong\n", s);
+        exit(1);
+    }
+
+    fd = open("ringfile", O_RDONLY);
+    if (fd < 0 || read(fd, buf, sizeof(buf)) != 6 || memcmp(buf, "abcdef", 6) != 0)
+    {
+        printf("%s: wrong file contents\n", s);
+        exit(1);
+    }
+    close(fd);
+    unlink("ringfile");
+}
+
+// O_NONBLOCK pipe reads and writes return at once, and poll()
+// waits for pipes to become readable or writable.
+void polltest(char* s)
+{
+    static char   buf[PGSIZE];
+    struct pollfd fds[3];
+    int           p[2], q[2], n, pid, xstatus;
+
+    if (pipe(p) < 0 || pipe(q) < 0)
+    {
+        printf("%s: pipe failed\n", s);
+        exit(1);
+    }
+    fcntl(p[0], F_SETFL, O_NONBLOCK);
+    fcntl(p[1], F_SETFL, O_NONBLOCK);
+    if (read(p[0], buf, 1) != -1)
+    {
+        printf("%s: non-blocking read of an empty pipe did not fail\n", s);
+        exit(1);
+    }
+    // a full pipe takes no more.
+    if ((n = write(p[1], buf, sizeof(buf))) != fcntl(p[1], F_GETPIPE_SZ, 0) || write(p[1], buf, 1) != 0)
+    {
+        printf("%s: non-blocking write of a full pipe wrote %d\n", s, n);
+        exit(1);
+    }
+
+    fds[0].fd     = p[0];
+    fds[0].events = POLLIN;
+    fds[1].fd     = p[1];
+    fds[1].events = POLLOUT;
+    fds[2].fd     = NOFILE - 1;
+    fds[2].events = POLLIN;
+    if (poll(fds, 3, 0) != 2 || fds[0].revents != POLLIN || fds[1].revents != 0 || fds[2].revents != POLLNVAL)
+    {
+        printf("%s: poll of a full pipe wrong\n", s);
+        exit(1);
+    }
+    while (read(p[0], buf, sizeof(buf)) > 0)
+        ;
+    if (poll(fds, 2, 0) != 1 || fds[0].revents != 0 || fds[1].revents != POLLOUT)
+    {
+        printf("%s: poll of an empty pipe wrong\n", s);
+        exit(1);
+    }
+
+    // poll() sleeps until a child writes, or the timeout.
+    fds[0].fd = q[0];
+    if (poll(fds, 1, 2) != 0)
+    {
+        printf("%s: poll did not time out\n", s);
+        exit(1);
+    }
+    if ((pid = fork()) < 0)
+    {
+        printf("%s: fork failed\n", s);
+        exit(1);
+    }
+    if (pid == 0)
+    {
+        sleep(2);
+        write(q[1], "x", 1);
+        exit(0);
+    }
+    if (poll(fds, 1, -1) != 1 || fds[0].revents != POLLIN)
+    {
+        printf("%s: poll did not see the write\n", s);
+        exit(1);
+    }
+    wait(&xstatus);
+    close(q[1]);
+    read(q[0], buf, 1);
+    if (poll(fds, 1, -1) != 1 || fds[0].revents != (POLLIN | POLLHUP))
+    {
+        printf("%s: poll did not see the close\n", s);
+        exit(1);
+    }
+    close(q[0]);
+    close(p[0]);
+    close(p[1]);
+}
+
+// stat() by path agrees with fstat(), follows writes, and
+// fails for missing and unlinked files.
+void statpath(char* s)
+{
+    struct stat st, fst;
+    int         fd;
+
+    unlink("statpath");
+    if (stat("statpath", &st) != -1)
+    {
+        printf("%s: stat of a missing file succeeded\n", s);
+        exit(1);
+    }
+    if ((fd = open("statpath", O_CREATE | O_RDWR)) < 0)
+    {
+        printf("%s: create failed\n", s);
+        exit(1);
+    }
+    if (write(fd, "hello", 5) != 5)
+    {
+        printf("%s: write failed\n", s);
+        exit(1);
+    }
+    if (stat("statpath", &st) < 0 || fstat(fd, &fst) < 0)
+    {
+        printf("%s: stat failed\n", s);
+        exit(1);
+    }
+    if (st.ino != fst.ino || st.dev != fst.dev || st.type != T_FILE || st.size != 5 || st.nlink != 1)
+    {
+        printf("%s: stat and fstat disagree\n", s);
+        exit(1);
+    }
+    close(fd);
+    // the inode is released now, and stat must still see the write.
+    if ((fd = open("statpath", O_WRONLY)) < 0 || pwrite(fd, "world", 5, 5) != 5)
+    {
+        printf("%s: append failed\n", s);
+        exit(1);
+    }
+    close(fd);
+    if (stat("statpath", &st) < 0 || st.size != 10)
+    {
+        printf("%s: stat size %d, not 10\n", s, (int)st.size);
+        exit(1);
+    }
+    if (stat(".", &st) < 0 || st.type != T_DIR)
+    {
+        printf("%s: stat of . failed\n", s);
+        exit(1);
+    }
+    unlink("statpath");
+    if (stat("statpath", &st) != -1)
+    {
+        printf("%s: stat of an unlinked file succeeded\n", s);
+        exit(1);
+    }
+}
+
+// the file table grows past NFILE open files.
+void manyfiles(char* s)
+{
+    enum
+    {
+        NCHILD = 10,
+        NFD    = 11
+    };
+    int  fds[2], i, j, fd, xstatus, ok = 1;
+    char c;
+
+    if (pipe(fds) < 0)
+    {
+        printf("%s: pipe failed\n", s);
+        exit(1);
+    }
+    for (i = 0; i < NCHILD; i++)
+    {
+        if (fork() == 0)
+        {
+            close(fds[1]);
+            for (j = 0; j < NFD; j++)
+            {
+                if (open("README", O_RDONLY) < 0)
+                {
+                    printf("%s: open %d failed\n", s, i * NFD + j);
+                    exit(1);
+                }
+            }
+            // hold them open until the parent is done.
+            read(fds[0], &c, 1);
+            exit(0);
+        }
+    }
+    close(fds[0]);
+    // the children's files plus NFD of our own pass NFILE.
+    for (j = 0; j < NFD; j++)
+        if ((fd = open("README", O_RDONLY)) < 0)
+            ok = 0;
+    close(fds[1]);
+    for (i = 0; i < NCHILD; i++)
+    {
+        wait(&xstatus);
+        if (xstatus != 0)
+            ok = 0;
+    }
+    if (!ok || NCHILD * NFD + NFD <= NFILE)
+    {
+        printf("%s: could not open more than NFILE files\n", s);
+        exit(1);
+    }
+}
+
+// O_NONBLOCK can be set at open() and changed with fcntl().
+void nonblocktest(char* s)
+{
+    int fd;
+
+    if ((fd = open("console", O_WRONLY | O_NONBLOCK)) < 0)
+    {
+        printf("%s: open console failed\n", s);
+        exit(1);
+    }
+    if (fcntl(fd, F_GETFL, 0) != O_NONBLOCK || write(fd, "", 0) != 0)
+    {
+        printf("%s: console not opened non-blocking\n", s);
+        exit(1);
+    }
+    if (fcntl(fd, F_SETFL, 0) != 0 || fcntl(fd, F_GETFL, 0) != 0)
+    {
+        printf("%s: F_SETFL failed\n", s);
+        exit(1);
+    }
+    close(fd);
+}
+
+// how many write() system calls have been made.
+static uint64 nwrites(void)
+{
+    static struct sysstat st[64];
+    int                   n, i;
+
+    n = sysstat(st, 64);
+    for (i = 0; i < n; i++)
+        if (strcmp(st[i].name, "write") == 0)
+            return st[i].count;
+    return 0;
+}
+
+// fprintf() to a file is written a buffer at a time, reaches
+// the file by close(), and is not written twice by a child that
+// was forked with it still buffered.
+void stdiotest(char* s)
+{
+    enum
+    {
+        NLINE = 100
+    };
+    uint64 before, writes;
+    int    fd, i, n, tot, pid;
+
+    unlink("stdiof");
+    if ((fd = open("stdiof", O_CREATE | O_RDWR)) < 0)
+    {
+        printf("%s: create stdiof failed\n", s);
+        exit(1);
+    }
+    before = nwrites();
+    for (i = 0; i < NLINE; i++)
+        fprintf(fd, "line %d\n", i);
+    close(fd);
+    writes = nwrites() - before;
+
+    if ((fd = open("stdiof", O_RDONLY)) < 0)
+    {
+        printf("%s: open stdiof failed\n", s);
+        exit(1);
+    }
+    tot = 0;
+    while ((n = read(fd, buf + tot, BUFSZ - 1 - tot)) > 0)
+        tot += n;
+    close(fd);
+    buf[tot] = 0;
+    // one write() per character before buffering.
+    printf("%d lines: %d writes, was %d: ", NLINE, (int)writes, tot);
+    if (writes > tot / 256 + 2)
+    {
+        printf("%s: too many writes\n", s);
+        exit(1);
+    }
+    if (tot < 10 || memcmp(buf, "line 0\nline 1\n", 14) != 0 || memcmp(buf + tot - 8, "line 99\n", 8) != 0)
+    {
+        printf("%s: wrong contents\n", s);
+        exit(1);
+    }
+
+    if ((fd = open("stdiof", O_CREATE | O_RDWR | O_TRUNC)) < 0)
+    {
+        printf("%s: create stdiof failed\n", s);
+        exit(1);
+    }
+    fprintf(fd, "x");
+    if ((pid = fork()) < 0)
+    {
+        printf("%s: fork failed\n", s);
+        exit(1);
+    }
+    if (pid == 0)
+        exit(0);
+    wait(0);
+    close(fd);
+    if ((fd = open("stdiof", O_RDONLY)) < 0 || read(fd, buf, BUFSZ) != 1)
+    {
+        printf("%s: buffered output not written exactly once\n", s);
+        exit(1);
+    }
+    close(fd);
+    unlink("stdiof");
+}
+
+// the name cache must follow creates and unlinks, including of
+// names it has cached as missing, and must forget a removed
+// directory whose inode number is used again.
+void dcachetest(char* s)
+{
+    int fd, round;
+
+    for (round = 0; round < 3; round++)
+    {
+        if (open("dcd/f", O_RDONLY) >= 0)
+        {
+            printf("%s: open of missing dcd/f succeeded\n", s);
+            exit(1);
+        }
+        if (mkdir("dcd") < 0)
+        {
+            printf("%s: mkdir dcd failed\n", s);
+            exit(1);
+        }
+        if (open("dcd/f", O_RDONLY) >= 0)
+        {
+            printf("%s: open of missing dcd/f succeeded\n", s);
+            exit(1);
+        }
+        if ((fd = open("dcd/f", O_CREATE | O_RDWR)) < 0)
+        {
+            printf("%s: create dcd/f failed\n", s);
+            exit(1);
+        }
+        close(fd);
+        if ((fd = open("dcd/./f", O_RDONLY)) < 0 || close(fd) < 0 || (fd = open("dcd/../dcd/f", O_RDONLY)) < 0)
+        {
+            printf("%s: open dcd/f failed\n", s);
+            exit(1);
+        }
+        close(fd);
+        if (unlink("dcd/f") < 0 || open("dcd/f", O_RDONLY) >= 0)
+        {
+            printf("%s: dcd/f still there after unlink\n", s);
+            exit(1);
+        }
+        if (unlink("dcd") < 0)
+        {
+            printf("%s: unlink dcd failed\n", s);
+            exit(1);
+        }
+    }
+}
+
+// the statistics device builds its report afresh for each
+// reader.
+void lockstatstest(char* s)
 {
-    int i, fd, n;
+    int fd, n, tot, round;
 
-    fd = open("big", O_CREATE | O_RDWR);
-    if (fd < 0)
-    {
-        printf("%s: error: creat big failed!\n", s);
-        exit(1);
-    }
-
-    for (i = 0; i < MAXFILE; i++)
+    for (round = 0; round < 2; round++)
     {
-        ((int*)buf)[0] = i;
-        if (write(fd, buf, BSIZE) != BSIZE)
+        if ((fd = open("statistics", O_RDONLY)) < 0)
         {
-            printf("%s: error: write big file failed\n", s, i);
+            printf("%s: cannot open statistics\n", s);
+            exit(1);
+        }
+        tot = 0;
+        while (tot < BUFSZ - 1 && (n = read(fd, buf + tot, BUFSZ - 1 - tot)) > 0)
+            tot += n;
+        close(fd);
+        buf[tot] = 0;
+        if (tot < 10 || memcmp(buf, "spinlocks:", 10) != 0)
+        {
+            printf("%s: bad report: %s\n", s, buf);
             exit(1);
         }
     }
+}
 
-    close(fd);
-
-    fd = open("big", O_RDONLY);
-    if (fd < 0)
+// private mappings share pages through the page cache, which
+// must forget them when the file is written or truncated.
+void pcachetest(char* s)
+{
+    enum
     {
-        printf("%s: error: open big failed!\n", s);
-        exit(1);
-    }
+        PG = 4096
+    };
+    char* p;
+    int   fd, i, round;
 
-    n = 0;
-    for (;;)
+    unlink("pcachef");
+    for (round = 0; round < 3; round++)
     {
-        i = read(fd, buf, BSIZE);
-        if (i == 0)
+        // round 2 truncates the file and rewrites it.
+        fd = open("pcachef", round == 2 ? O_CREATE | O_RDWR | O_TRUNC : O_CREATE | O_RDWR);
+        if (fd < 0)
         {
-            if (n == MAXFILE - 1)
-            {
-                printf("%s: read only %d blocks from big", s, n);
-                exit(1);
-            }
-            break;
+            printf("%s: open failed\n", s);
+            exit(1);
         }
-        else if (i != BSIZE)
+        memset(buf, 'a' + round, PG);
+        if (write(fd, buf, PG) != PG)
         {
-            printf("%s: read failed %d\n", s, i);
+            printf("%s: write failed\n", s);
             exit(1);
         }
-        if (((int*)buf)[0] != n)
+        p = mmap(0, PG, PROT_READ, MAP_PRIVATE, fd, 0);
+        close(fd);
+        if (p == (char*)-1)
         {
-            printf("%s: read content of block %d is %d\n", s, n, ((int*)buf)[0]);
+            printf("%s: mmap failed\n", s);
             exit(1);
         }
-        n++;
-    }
-    close(fd);
-    if (unlink("big") < 0)
-    {
-        printf("%s: unlink big failed\n", s);
-        exit(1);
+        for (i = 0; i < PG; i++)
+        {
+            if (p[i] != 'a' + round)
+            {
+                printf("%s: stale page in round %d\n", s, round);
+                exit(1);
+            }
+        }
+        munmap(p, PG);
     }
+    unlink("pcachef");
 }
 
-// many creates, followed by unlink test
-void createtest(char* s)
+// mmap() a file privately and shared; the shared changes reach
+// the file on munmap(), the private ones never do.
+void mmaptest(char* s)
 {
-    int i, fd;
     enum
     {
-        N = 52
+        PG = 4096,
+        SZ = 2 * PG + PG / 2
     };
+    char *p, *q;
+    int   fd, rfd, fds[2], i, pid, xstatus;
 
-    char name[3];
-    name[0] = 'a';
-    name[2] = '\0';
-    for (i = 0; i < N; i++)
+    unlink("mmapf");
+    fd = open("mmapf", O_CREATE | O_RDWR);
+    if (fd < 0)
     {
-        name[1] = '0' + i;
-        fd      = open(name, O_CREATE | O_RDWR);
-        close(fd);
+        printf("%s: create failed\n", s);
+        exit(1);
     }
-    name[0] = 'a';
-    name[2] = '\0';
-    for (i = 0; i < N; i++)
+    for (i = 0; i < SZ; i++)
     {
-        name[1] = '0' + i;
-        unlink(name);
+        char c = i % 26 + 'a';
+        if (write(fd, &c, 1) != 1)
+        {
+            printf("%s: write failed\n", s);
+            exit(1);
+        }
     }
-}
 
-void dirtest(char* s)
-{
-    if (mkdir("dir0") < 0)
+    p = mmap(0, SZ, PROT_READ, MAP_PRIVATE, fd, 0);
+    if (p == (char*)-1)
     {
-        printf("%s: mkdir failed\n", s);
+        printf("%s: mmap private failed\n", s);
         exit(1);
     }
-
-    if (chdir("dir0") < 0)
+    for (i = 0; i < 3 * PG; i++)
     {
-        printf("%s: chdir dir0 failed\n", s);
+        if (p[i] != (i < SZ ? i % 26 + 'a' : 0))
+        {
+            printf("%s: wrong data at %d\n", s, i);
+            exit(1);
+        }
+    }
+    // a shared writable mapping needs a writable file.
+    rfd = open("mmapf", O_RDONLY);
+    q   = mmap(0, PG, PROT_READ | PROT_WRITE, MAP_SHARED, rfd, 0);
+    close(rfd);
+    if (q != (char*)-1)
+    {
+        printf("%s: mmap of read-only file succeeded\n", s);
         exit(1);
     }
 
-    if (chdir("..") < 0)
+    q = mmap(0, SZ, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (q == (char*)-1 || q == p)
     {
-        printf("%s: chdir .. failed\n", s);
+        printf("%s: mmap shared failed\n", s);
         exit(1);
     }
-
-    if (unlink("dir0") < 0)
+    close(fd);
+    // a pipe copies from a page not yet read in.
+    if (pipe(fds) != 0 || write(fds[1], q + PG, 10) != 10 || read(fds[0], buf, 10) != 10 ||
+        memcmp(buf, p + PG, 10) != 0)
     {
-        printf("%s: unlink dir0 failed\n", s);
+        printf("%s: pipe from mapping failed\n", s);
         exit(1);
     }
-}
-
-void exectest(char* s)
-{
-    int   fd, xstatus, pid;
-    char* echoargv[] = {"echo", "OK", 0};
-    char  buf[3];
+    close(fds[0]);
+    close(fds[1]);
 
-    unlink("echo-ok");
+    for (i = 0; i < SZ; i++)
+        q[i] = 'Z';
     pid = fork();
     if (pid < 0)
     {
@@ -768,51 +2636,75 @@ void exectest(char* s)
     }
     if (pid == 0)
     {
-        close(1);
-        fd = open("echo-ok", O_CREATE | O_WRONLY);
-        if (fd < 0)
-        {
-            printf("%s: create failed\n", s);
-            exit(1);
-        }
-        if (fd != 1)
-        {
-            printf("%s: wrong fd\n", s);
+        if (q[0] != 'Z' || q[SZ - 1] != 'Z' || p[0] != 'a')
             exit(1);
-        }
-        if (exec("echo", echoargv) < 0)
+        exit(0);
+    }
+    wait(&xstatus);
+    if (xstatus != 0)
+    {
+        printf("%s: child saw wrong mapping\n", s);
+        exit(1);
+    }
+
+    // unmapping the middle page splits the region.
+    if (munmap(q + PG, PG) != 0 || munmap(q, PG) != 0 || munmap(q + 2 * PG, PG) != 0 ||
+        munmap(p, SZ) != 0)
+    {
+        printf("%s: munmap failed\n", s);
+        exit(1);
+    }
+    if (munmap(q, PG) == 0)
+    {
+        printf("%s: munmap of unmapped page succeeded\n", s);
+        exit(1);
+    }
+
+    fd = open("mmapf", O_RDONLY);
+    for (i = 0; i < SZ; i += PG / 2)
+    {
+        if (read(fd, buf, PG / 2) != PG / 2 || buf[0] != 'Z' || buf[PG / 2 - 1] != 'Z')
         {
-            printf("%s: exec echo failed\n", s);
+            printf("%s: shared writes not in file at %d\n", s, i);
             exit(1);
         }
-        // won't get to here
     }
-    if (wait(&xstatus) != pid)
+    if (read(fd, buf, 1) != 0)
     {
-        printf("%s: wait failed!\n", s);
+        printf("%s: file grew\n", s);
+        exit(1);
     }
-    if (xstatus != 0)
-        exit(xstatus);
+    close(fd);
 
-    fd = open("echo-ok", O_RDONLY);
-    if (fd < 0)
+    // read() from another file into a shared mapping, where
+    // the kernel does the stores, reaches the file too.
+    unlink("mmapg");
+    rfd = open("mmapg", O_CREATE | O_RDWR);
+    if (rfd < 0 || write(rfd, "0123456789", 10) != 10)
     {
-        printf("%s: open failed\n", s);
+        printf("%s: create mmapg failed\n", s);
         exit(1);
     }
-    if (read(fd, buf, 2) != 2)
+    close(rfd);
+    rfd = open("mmapg", O_RDONLY);
+    fd = open("mmapf", O_RDWR);
+    q  = mmap(0, PG, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (q == (char*)-1 || read(rfd, q, 10) != 10 || munmap(q, PG) != 0)
     {
-        printf("%s: read failed\n", s);
+        printf("%s: read into mapping failed\n", s);
         exit(1);
     }
-    unlink("echo-ok");
-    if (buf[0] == 'O' && buf[1] == 'K')
-        exit(0);
-    else
+    close(rfd);
+    fd = open("mmapf", O_RDONLY);
+    if (read(fd, buf, 11) != 11 || memcmp(buf, "0123456789Z", 11) != 0)
     {
-        printf("%s: wrong output\n", s);
+        printf("%s: read into mapping not in file\n", s);
         exit(1);
     }
+    close(fd);
+    unlink("mmapg");
+    unlink("mmapf");
 }
 
 // simple fork and pipe read/write
@@ -2322,6 +4214,100 @@ void forktest(char* s)
     }
 }
 
+// fork() shares memory copy-on-write, so a process using
+// more than half of physical memory can still fork, and
+// writes by the child must not show up in the parent.
+void cowfork(char* s)
+{
+    enum
+    {
+        SZ = 64 * 1024 * 1024
+    };
+    char *p, *q;
+    int   pid, xstatus;
+
+    p = sbrk(SZ);
+    if (p == (char*)0xffffffffffffffffL)
+    {
+        printf("%s: sbrk failed\n", s);
+        exit(1);
+    }
+    for (q = p; q < p + SZ; q += 4096)
+        *(int*)q = getpid();
+
+    pid = fork();
+    if (pid < 0)
+    {
+        printf("%s: fork failed\n", s);
+        exit(1);
+    }
+    if (pid == 0)
+    {
+        for (q = p; q < p + SZ; q += 64 * 4096)
+            *(int*)q = 0;
+        exit(0);
+    }
+    wait(&xstatus);
+    if (xstatus != 0)
+        exit(xstatus);
+
+    for (q = p; q < p + SZ; q += 4096)
+    {
+        if (*(int*)q != getpid())
+        {
+            printf("%s: parent saw child's write\n", s);
+            exit(1);
+        }
+    }
+}
+
+// sbrk() allocates lazily: a huge break costs nothing until
+// it is touched, and the kernel can copy into untouched pages.
+void lazysbrk(char* s)
+{
+    enum
+    {
+        BIG = 512 * 1024 * 1024
+    };
+    char* a;
+    int   fds[2];
+
+    a = sbrk(BIG);
+    if (a == (char*)0xffffffffffffffffL)
+    {
+        printf("%s: sbrk failed\n", s);
+        exit(1);
+    }
+    a[0]       = 1;
+    a[BIG / 2] = 2;
+    a[BIG - 1] = 3;
+    if (a[0] != 1 || a[BIG / 2] != 2 || a[BIG - 1] != 3 || a[BIG / 4] != 0)
+    {
+        printf("%s: lazy page has wrong contents\n", s);
+        exit(1);
+    }
+
+    if (pipe(fds) != 0)
+    {
+        printf("%s: pipe() failed\n", s);
+        exit(1);
+    }
+    write(fds[1], "x", 1);
+    if (read(fds[0], a + BIG / 4 + 4096, 1) != 1 || a[BIG / 4 + 4096] != 'x')
+    {
+        printf("%s: read into untouched page failed\n", s);
+        exit(1);
+    }
+    close(fds[0]);
+    close(fds[1]);
+
+    if (sbrk(-BIG) == (char*)0xffffffffffffffffL)
+    {
+        printf("%s: sbrk could not deallocate\n", s);
+        exit(1);
+    }
+}
+
 void sbrkbasic(char* s)
 {
     enum
@@ -2972,11 +4958,40 @@ struct test
     {iputtest, "iput"},
     {opentest, "opentest"},
     {writetest, "writetest"},
+    {fsynctest, "fsynctest"},
+    {readahead, "readahead"},
     {writebig, "writebig"},
     {createtest, "createtest"},
     {dirtest, "dirtest"},
     {exectest, "exectest"},
     {pipe1, "pipe1"},
+    {pipesize, "pipesize"},
+    {vmsplicetest, "vmsplice"},
+    {mmaptest, "mmap"},
+    {memops, "memops"},
+    {pcachetest, "pcache"},
+    {sysstattest, "sysstat"},
+    {lockstatstest, "lockstats"},
+    {dcachetest, "dcache"},
+    {stdiotest, "stdio"},
+    {nonblocktest, "nonblock"},
+    {manyfiles, "manyfiles"},
+    {iovtest, "iov"},
+    {orderedwrite, "orderedwrite"},
+    {dirindex, "dirindex"},
+    {getdentstest, "getdents"},
+    {threadtest, "threads"},
+    {usyscall, "usyscall"},
+    {setschedtest, "setsched"},
+    {ticketlocks, "ticketlocks"},
+    {sharedread, "sharedread"},
+    {killwaitmany, "killwaitmany"},
+    {malloctrim, "malloctrim"},
+    {spawntest, "spawntest"},
+    {memaccount, "memaccount"},
+    {sysring, "sysring"},
+    {polltest, "polltest"},
+    {statpath, "statpath"},
     {killstatus, "killstatus"},
     {preempt, "preempt"},
     {exitwait, "exitwait"},
@@ -3001,6 +5016,8 @@ struct test
     {dirfile, "dirfile"},
     {iref, "iref"},
     {forktest, "forktest"},
+    {cowfork, "cowfork"},
+    {lazysbrk, "lazysbrk"},
     {sbrkbasic, "sbrkbasic"},
     {sbrkmuch, "sbrkmuch"},
     {kernmem, "kernmem"},
@@ -3338,6 +5355,68 @@ void outofinodes(char* s)
     }
 }
 
+// two sleeping children's identical copy-on-write pages, which
+// the parent no longer shares, get merged into one frame, and
+// stay private to each child when it writes them.
+void ksmmerge(char* s)
+{
+    enum
+    {
+        N = 4
+    };
+    static char    buf[N * PGSIZE] __attribute__((aligned(PGSIZE)));
+    struct sysinfo si;
+    int            fds[2][2], pids[2], i, k, xstatus;
+    char           c;
+
+    for (i = 0; i < sizeof(buf); i++)
+        buf[i] = 'a' + i % 26;
+    for (k = 0; k < 2; k++)
+    {
+        if (pipe(fds[k]) < 0 || (pids[k] = fork()) < 0)
+        {
+            printf("%s: pipe or fork failed\n", s);
+            exit(1);
+        }
+        if (pids[k] == 0)
+        {
+            // sleep until the parent says to write.
+            if (read(fds[k][0], &c, 1) != 1)
+                exit(1);
+            for (i = 0; i < sizeof(buf); i++)
+                if (buf[i] != 'a' + i % 26)
+                    exit(2);
+            for (i = 0; i < sizeof(buf); i += PGSIZE)
+                buf[i] = 'A' + k;
+            for (i = 0; i < sizeof(buf); i += PGSIZE)
+                if (buf[i] != 'A' + k || buf[i + 1] != 'a' + (i + 1) % 26)
+                    exit(3);
+            exit(0);
+        }
+        // give the parent copies of its own, leaving the child
+        // the only reference to the pages it has.
+        for (i = 0; i < sizeof(buf); i += PGSIZE)
+            buf[i] = 'a' + i % 26;
+    }
+
+    sleep(2 * KSMTICKS + 10);
+    if (sysinfo(&si) < 0 || si.merged < N * PGSIZE)
+    {
+        printf("%s: merged %d bytes, not %d\n", s, (int)si.merged, N * PGSIZE);
+        exit(1);
+    }
+    for (k = 0; k < 2; k++)
+    {
+        write(fds[k][1], "x", 1);
+        wait(&xstatus);
+        if (xstatus != 0)
+        {
+            printf("%s: child %d saw wrong contents (%d)\n", s, k, xstatus);
+            exit(1);
+        }
+    }
+}
+
 struct test slowtests[] = {
     {bigdir, "bigdir"},
     {manywrites, "manywrites"},
@@ -3345,6 +5424,7 @@ struct test slowtests[] = {
     {execout, "execout"},
     {diskfull, "diskfull"},
     {outofinodes, "outofinodes"},
+    {ksmmerge, "ksmmerge"},
 
     {0, 0},
 };
@@ -6,24 +6,27 @@ print "# generated by usys.pl - do not edit\n";
 
 print "#include \"kernel/syscall.h\"\n";
 
+# entry("_x", "x") names the stub of x _x, for a wrapper
+# in ulib.c to call.
 sub entry {
     my $name = shift;
+    my $sys = shift || $name;
     print ".global $name\n";
     print "${name}:\n";
-    print " li a7, SYS_${name}\n";
+    print " li a7, SYS_${sys}\n";
     print " ecall\n";
     print " ret\n";
 }
 	
-entry("fork");
-entry("exit");
+entry("_fork", "fork");
+entry("_exit", "exit");
 entry("wait");
 entry("pipe");
-entry("read");
-entry("write");
-entry("close");
+entry("_read", "read");
+entry("_write", "write");
+entry("_close", "close");
 entry("kill");
-entry("exec");
+entry("_exec", "exec");
 entry("open");
 entry("mknod");
 entry("unlink");
@@ -32,7 +35,30 @@ entry("link");
 entry("mkdir");
 entry("chdir");
 entry("dup");
-entry("getpid");
+entry("_getpid", "getpid");
 entry("sbrk");
 entry("sleep");
-entry("uptime");
+entry("_uptime", "uptime");
+entry("fsync");
+entry("fcntl");
+entry("vmsplice");
+entry("mmap");
+entry("munmap");
+entry("trace");
+entry("sysstat");
+entry("readv");
+entry("writev");
+entry("pread");
+entry("pwrite");
+entry("getdents");
+entry("clone");
+entry("join");
+entry("futex");
+entry("setsched");
+entry("spawn");
+entry("prof");
+entry("sysinfo");
+entry("procinfo");
+entry("ringenter");
+entry("poll");
+entry("stat");
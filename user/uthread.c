@@ -0,0 +1,434 @@
+//
+// User-level threads.
+//
+// Each thread has a stack from malloc() and a struct ucontext
+// holding the registers that uthread_switch() saves and
+// restores, as swtch() does in the kernel. A thread gives up
+// its worker by switching to the worker's scheduler loop,
+// schedule(), which files it by why it stopped, and only then,
+// with the thread off its stack, lets another worker take it.
+//
+// A worker is a kernel thread: the process's own, or one made
+// by clone() in thread_init(). It keeps its struct worker in
+// the tp register, which uthread_switch() and the compiler
+// leave alone, so a thread that moves to another worker finds
+// that worker there. A worker takes threads from its own run
+// queue first, then steals from the others', and waits with
+// futex() when all are empty. The main thread stays on the
+// process's own kernel thread, so that its exit() is that of
+// the whole process rather than of one clone()d worker.
+//
+// Not safe for threads on different workers to call: printf(),
+// which keeps state of its own.
+//
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "kernel/fcntl.h"
+#include "user/user.h"
+#include "user/uthread.h"
+
+// Registers saved by uthread_switch(), laid out as struct
+// context in kernel/proc.h.
+struct ucontext
+{
+    uint64 ra;
+    uint64 sp;
+    uint64 s[12];   // callee-saved s0-s11
+};
+
+enum ustate
+{
+    FREE,
+    RUNNABLE,
+    RUNNING,
+    JOINING,   // switching away to wait for waitfor
+    BLOCKED,   // waiting for waitfor to exit
+    EXITING,   // switching away for the last time
+    ZOMBIE
+};
+
+struct uthread
+{
+    struct ucontext ctx;       // uthread_switch() here to run the thread
+    enum ustate     state;     // ulock protects, except for a thread's own changes while running
+    void (*fn)(void*);         // start routine and its argument
+    void*           arg;
+    char*           stack;     // from malloc(), 0 for the main thread
+    int             status;    // exit status, for thread_join()
+    struct uthread* waitfor;   // thread being joined
+    struct uthread* joiner;    // thread joining this one
+    struct uthread* next;      // next on the same run queue
+};
+
+struct worker
+{
+    struct ucontext sched;   // uthread_switch() here to enter schedule()
+    struct uthread* cur;     // thread running on this worker, or 0
+    int             lock;    // protects the run queue
+    struct uthread* head;
+    struct uthread* tail;
+    int             n;   // queue length, may be read without the lock as a hint
+};
+
+extern void uthread_switch(struct ucontext*, struct ucontext*);
+
+static struct uthread threads[NUTHREAD];   // threads[0] is the main thread
+static struct worker  workers[NTHREAD];
+static int            nworkers;   // 0 until thread_init()
+static int            ulock;      // protects thread states
+static int            workseq;    // bumped whenever a thread is queued, for idle workers
+static int            nidle;      // workers waiting on workseq
+
+static void schedule(void) __attribute__((noreturn));
+
+static void lock(int* l)
+{
+    while (__sync_lock_test_and_set(l, 1))
+        ;
+}
+
+static void unlock(int* l)
+{
+    __sync_lock_release(l);
+}
+
+// 获取当前内核线程的 worker，保存在 tp 寄存器中
+static struct worker* myworker(void)
+{
+    struct worker* w;
+
+    asm volatile("mv %0, tp" : "=r"(w));
+    return w;
+}
+
+// Append t to w's run queue, or the first worker's if t is the
+// main thread, and wake an idle worker to take it if there is
+// one. Only the first worker may take the main thread, so then
+// they are all woken.
+// 将线程加入 worker 的运行队列尾部
+static void push(struct worker* w, struct uthread* t)
+{
+    if (t == &threads[0])
+        w = &workers[0];
+    lock(&w->lock);
+    t->next = 0;
+    if (w->tail)
+        w->tail->next = t;
+    else
+        w->head = t;
+    w->tail = t;
+    w->n++;
+    unlock(&w->lock);
+
+    __sync_fetch_and_add(&workseq, 1);
+    if (__atomic_load_n(&nidle, __ATOMIC_SEQ_CST) > 0)
+        futex(&workseq, FUTEX_WAKE, t == &threads[0] ? NTHREAD : 1);
+}
+
+// Take the first thread on w's run queue, or return 0. A
+// thief passes over the main thread.
+// 从 worker 的运行队列头部取出一个线程
+static struct uthread* pop(struct worker* w, int thief)
+{
+    struct uthread *t, *prev = 0;
+
+    if (__atomic_load_n(&w->n, __ATOMIC_SEQ_CST) == 0)
+        return 0;
+    lock(&w->lock);
+    for (t = w->head; t && thief && t == &threads[0]; t = t->next)
+        prev = t;
+    if (t)
+    {
+        if (prev)
+            prev->next = t->next;
+        else
+            w->head = t->next;
+        if (w->tail == t)
+            w->tail = prev;
+        w->n--;
+    }
+    unlock(&w->lock);
+    return t;
+}
+
+// Take a thread from another worker's run queue, starting
+// with the next worker so that thieves spread out.
+// 从其他 worker 的运行队列窃取一个线程
+static struct uthread* steal(struct worker* w)
+{
+    struct uthread* t;
+    int             i, n = nworkers, id = w - workers;
+
+    for (i = 1; i < n; i++)
+        if ((t = pop(&workers[(id + i) % n], 1)) != 0)
+            return t;
+    return 0;
+}
+
+// Wait for some thread to be queued. With only one worker
+// there is no one else to queue it: every thread is blocked.
+// 所有运行队列为空时等待新的可运行线程
+static void idle(void)
+{
+    int seq = __atomic_load_n(&workseq, __ATOMIC_SEQ_CST);
+    int i, queued = 0;
+
+    if (nworkers == 1)
+    {
+        fprintf(2, "uthread: every thread is blocked\n");
+        exit(1);
+    }
+    __sync_fetch_and_add(&nidle, 1);
+    for (i = 0; i < nworkers; i++)
+        queued |= __atomic_load_n(&workers[i].n, __ATOMIC_SEQ_CST);
+    // push() bumps workseq after queueing, so the wait returns
+    // at once if anything was queued since seq was read.
+    if (!queued)
+        futex(&workseq, FUTEX_WAIT, seq);
+    __sync_fetch_and_sub(&nidle, 1);
+}
+
+// File t, which has just switched back to w's scheduler, by why
+// it stopped running.
+// 线程切换回调度器后，按其状态重新安置
+static void settle(struct worker* w, struct uthread* t)
+{
+    struct uthread* j = 0;
+
+    if (t->state == RUNNABLE)
+    {
+        push(w, t);
+        return;
+    }
+
+    lock(&ulock);
+    if (t->state == JOINING)
+    {
+        if (t->waitfor->state == ZOMBIE)
+        {
+            t->state = RUNNABLE;
+            j        = t;
+        }
+        else
+        {
+            t->state = BLOCKED;
+        }
+    }
+    else if (t->state == EXITING)
+    {
+        t->state = ZOMBIE;
+        if (t->joiner && t->joiner->state == BLOCKED)
+        {
+            t->joiner->state = RUNNABLE;
+            j                = t->joiner;
+        }
+    }
+    unlock(&ulock);
+    if (j)
+        push(w, j);
+}
+
+// A worker's scheduler loop: run the next thread until it
+// switches back, then file it.
+// worker 的调度循环
+static void schedule(void)
+{
+    struct worker*  w = myworker();
+    struct uthread* t;
+
+    for (;;)
+    {
+        if ((t = pop(w, 0)) == 0 && (t = steal(w)) == 0)
+        {
+            idle();
+            continue;
+        }
+        t->state = RUNNING;
+        w->cur   = t;
+        uthread_switch(&w->sched, &t->ctx);
+        w->cur = 0;
+        settle(w, t);
+    }
+}
+
+// A worker made by clone() starts here.
+// clone() 创建的 worker 从这里开始运行
+static void worker(void* arg)
+{
+    asm volatile("mv tp, %0" : : "r"(arg));
+    schedule();
+}
+
+// A thread's very first switch comes here.
+// 新线程首次被调度时从这里开始运行
+static void thread_start(void)
+{
+    struct uthread* t = myworker()->cur;
+
+    t->fn(t->arg);
+    thread_exit(0);
+}
+
+// Make the caller the main thread, thread 0, and start the
+// workers: the caller's kernel thread and n-1 more made
+// by clone(), as many as the kernel allows. Called by
+// thread_create() with one worker if it was not called first.
+// 初始化线程库：调用者成为 0 号线程，并创建 nworkers 个 worker
+void thread_init(int n)
+{
+    char* stack;
+    int   i;
+
+    if (nworkers)
+        return;
+    if (n < 1)
+        n = 1;
+    if (n > NTHREAD)
+        n = NTHREAD;
+    nworkers = n;
+
+    threads[0].state = RUNNING;
+    workers[0].cur   = &threads[0];
+    asm volatile("mv tp, %0" : : "r"(&workers[0]));
+
+    // the main thread keeps the original stack, so the first
+    // worker's scheduler needs one of its own.
+    for (i = 0; i < nworkers; i++)
+    {
+        if ((stack = malloc(USTACKSIZE)) == 0)
+        {
+            fprintf(2, "uthread: out of memory\n");
+            exit(1);
+        }
+        if (i == 0)
+        {
+            workers[0].sched.ra = (uint64)schedule;
+            workers[0].sched.sp = (uint64)(stack + USTACKSIZE);
+        }
+        else if (clone(worker, &workers[i], stack + USTACKSIZE) < 0)
+        {
+            free(stack);
+            nworkers = i;
+            break;
+        }
+    }
+}
+
+// Create a thread that runs fn(arg), on the caller's worker
+// to begin with. Returns its id, or -1.
+// 创建一个运行 fn(arg) 的线程，返回其编号
+int thread_create(void (*fn)(void*), void* arg)
+{
+    struct uthread* t;
+    char*           stack;
+    int             i;
+
+    thread_init(1);
+    lock(&ulock);
+    for (i = 1; i < NUTHREAD && threads[i].state != FREE; i++)
+        ;
+    if (i == NUTHREAD || (stack = malloc(USTACKSIZE)) == 0)
+    {
+        unlock(&ulock);
+        return -1;
+    }
+    t = &threads[i];
+    memset(&t->ctx, 0, sizeof(t->ctx));
+    t->ctx.ra  = (uint64)thread_start;
+    t->ctx.sp  = (uint64)(stack + USTACKSIZE);
+    t->fn      = fn;
+    t->arg     = arg;
+    t->stack   = stack;
+    t->status  = 0;
+    t->waitfor = 0;
+    t->joiner  = 0;
+    t->state   = RUNNABLE;
+    unlock(&ulock);
+
+    push(myworker(), t);
+    return i;
+}
+
+// Let the other runnable threads run.
+// 让出 worker，允许其他可运行线程运行
+void thread_yield(void)
+{
+    struct worker*  w;
+    struct uthread* t;
+
+    if (nworkers == 0)
+        return;
+    w        = myworker();
+    t        = w->cur;
+    t->state = RUNNABLE;
+    uthread_switch(&t->ctx, &w->sched);
+}
+
+// End the calling thread, keeping status for thread_join().
+// The main thread ends the whole process instead.
+// 结束当前线程，退出状态留给 thread_join()
+void thread_exit(int status)
+{
+    struct worker*  w;
+    struct uthread* t;
+
+    if (nworkers == 0 || (t = (w = myworker())->cur) == &threads[0])
+        exit(status);
+    t->status = status;
+    t->state  = EXITING;
+    uthread_switch(&t->ctx, &w->sched);
+    fprintf(2, "uthread: zombie ran\n");
+    exit(1);
+}
+
+// Wait for thread id to exit, copy its exit status to status
+// if that is not 0, and free it. Only one thread may join a
+// given one.
+// Returns id, or -1 if there is no such thread to join.
+// 等待线程 id 结束并回收它
+int thread_join(int id, int* status)
+{
+    struct uthread* me;
+    struct uthread* t;
+
+    if (nworkers == 0 || id <= 0 || id >= NUTHREAD)
+        return -1;
+    me = myworker()->cur;
+    t  = &threads[id];
+
+    lock(&ulock);
+    if (t == me || t->state == FREE || t->joiner)
+    {
+        unlock(&ulock);
+        return -1;
+    }
+    if (t->state != ZOMBIE)
+    {
+        // settle() decides, once we are off our stack, whether
+        // t has exited meanwhile or we must wait for it.
+        t->joiner   = me;
+        me->waitfor = t;
+        me->state   = JOINING;
+        unlock(&ulock);
+        uthread_switch(&me->ctx, &myworker()->sched);
+        lock(&ulock);
+    }
+    if (status)
+        *status = t->status;
+    free(t->stack);
+    t->stack  = 0;
+    t->joiner = 0;
+    t->state  = FREE;
+    unlock(&ulock);
+    return id;
+}
+
+// Return the calling thread's id.
+// 返回当前线程的编号
+int thread_self(void)
+{
+    if (nworkers == 0)
+        return 0;
+    return myworker()->cur - threads;
+}
@@ -0,0 +1,18 @@
+// User-level threads (user/uthread.c).
+//
+// Threads are scheduled cooperatively: one runs until it calls
+// thread_yield(), thread_join() or thread_exit(). They run on
+// the process's one kernel thread, or on nworkers kernel
+// threads made by clone() after thread_init(nworkers), which
+// take runnable threads from one another's run queues when
+// their own is empty.
+
+#define NUTHREAD    64     // 用户级线程的最大数量（含主线程）
+#define USTACKSIZE  8192   // 每个线程的栈大小
+
+void thread_init(int nworkers);
+int  thread_create(void (*fn)(void*), void* arg);
+void thread_yield(void);
+void thread_exit(int status) __attribute__((noreturn));
+int  thread_join(int id, int* status);
+int  thread_self(void);
@@ -0,0 +1,150 @@
+// Time a switch between user-level threads (uthread.c) against
+// one between processes through a pipe, then run a batch of
+// compute-bound threads on one worker and on several, which
+// take work from one another, and print how long each took.
+//
+// usage: uthreadbench [nworkers]
+
+#include "kernel/types.h"
+#include "user/user.h"
+#include "user/uthread.h"
+
+#define NSWITCH 10000    // switches timed
+#define NTASK   32       // threads in the batch
+#define WORK    200000   // steps of each thread, yielding every 1000
+
+static inline uint64 rdcycle(void)
+{
+    uint64 x;
+    asm volatile("rdcycle %0" : "=r"(x));
+    return x;
+}
+
+static void yielder(void* arg)
+{
+    for (int i = 0; i < NSWITCH / 2; i++)
+        thread_yield();
+}
+
+// Run an LCG from arg and exit with a digest of where it went.
+static void task(void* arg)
+{
+    uint64 x = (uint64)arg;
+
+    for (int i = 1; i <= WORK; i++)
+    {
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+        if (i % 1000 == 0)
+            thread_yield();
+    }
+    thread_exit((int)(x >> 40) & 0xffff);
+}
+
+// Cycles per switch between two threads yielding to each other.
+// 测量两个用户级线程互相让出时每次切换的周期数
+static int uswitch(void)
+{
+    uint64 t0;
+    int    a, b;
+
+    thread_init(1);
+    t0 = rdcycle();
+    a  = thread_create(yielder, 0);
+    b  = thread_create(yielder, 0);
+    if (a < 0 || b < 0 || thread_join(a, 0) != a || thread_join(b, 0) != b)
+    {
+        fprintf(2, "uthreadbench: threads failed\n");
+        exit(1);
+    }
+    return (rdcycle() - t0) / NSWITCH;
+}
+
+// Cycles per switch between two processes passing a byte back
+// and forth through a pair of pipes.
+// 测量两个进程通过管道来回传递一个字节时每次切换的周期数
+static int pswitch(void)
+{
+    int    ab[2], ba[2], i;
+    char   c = 0;
+    uint64 t0;
+
+    if (pipe(ab) < 0 || pipe(ba) < 0)
+    {
+        fprintf(2, "uthreadbench: pipe failed\n");
+        exit(1);
+    }
+    if (fork() == 0)
+    {
+        for (i = 0; i < NSWITCH / 2; i++)
+            if (read(ab[0], &c, 1) != 1 || write(ba[1], &c, 1) != 1)
+                exit(1);
+        exit(0);
+    }
+    t0 = rdcycle();
+    for (i = 0; i < NSWITCH / 2; i++)
+        if (write(ab[1], &c, 1) != 1 || read(ba[0], &c, 1) != 1)
+            break;
+    t0 = (rdcycle() - t0) / NSWITCH;
+    wait(0);
+    close(ab[0]);
+    close(ab[1]);
+    close(ba[0]);
+    close(ba[1]);
+    return t0;
+}
+
+// Run the batch on n workers, and print the ticks it took with
+// a sum of the threads' exit statuses, which must not depend on
+// n.
+// 在 n 个 worker 上运行一批计算线程并打印耗时
+static void batch(int n)
+{
+    int id[NTASK], i, st, sum = 0, t0;
+
+    thread_init(n);
+    t0 = uptime();
+    for (i = 0; i < NTASK; i++)
+        if ((id[i] = thread_create(task, (void*)(uint64)(i + 1))) < 0)
+        {
+            fprintf(2, "uthreadbench: thread_create failed\n");
+            exit(1);
+        }
+    for (i = 0; i < NTASK; i++)
+    {
+        if (thread_join(id[i], &st) != id[i])
+        {
+            fprintf(2, "uthreadbench: thread_join failed\n");
+            exit(1);
+        }
+        sum += st;
+    }
+    printf("%d worker(s): %d threads in %d ticks, checksum %d\n", n, NTASK, uptime() - t0, sum);
+}
+
+// Run f(n) in a child, each library instance being good for
+// one thread_init().
+static void inchild(void (*f)(int), int n)
+{
+    if (fork() == 0)
+    {
+        f(n);
+        exit(0);
+    }
+    wait(0);
+}
+
+static void switches(int n)
+{
+    printf("cycles per switch: uthread %d\n", uswitch());
+}
+
+int main(int argc, char* argv[])
+{
+    int n = argc > 1 ? atoi(argv[1]) : 4;
+
+    inchild(switches, 0);
+    printf("cycles per switch: process %d\n", pswitch());
+    inchild(batch, 1);
+    inchild(batch, n);
+    exit(0);
+}
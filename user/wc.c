@@ -2,30 +2,20 @@
 #include "kernel/stat.h"
 #include "user/user.h"
 
-char buf[512];
+char buf[16384];
 
 void wc(int fd, char* name)
 {
-    int i, n;
+    int n;
     int l, w, c, inword;
 
     l = w = c = 0;
     inword    = 0;
     while ((n = read(fd, buf, sizeof(buf))) > 0)
     {
-        for (i = 0; i < n; i++)
-        {
-            c++;
-            if (buf[i] == '\n')
-                l++;
-            if (strchr(" \r\t\n\v", buf[i]))
-                inword = 0;
-            else if (!inword)
-            {
-                w++;
-                inword = 1;
-            }
-        }
+        c += n;
+        l += memcount(buf, '\n', n);
+        w += wordcount(buf, n, &inword);
     }
     if (n < 0)
     {
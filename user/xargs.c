@@ -0,0 +1,178 @@
+// Run a command with arguments read from standard input.
+//
+// usage: xargs [-n maxargs] [-P maxprocs] command [arg ...]
+//
+// Each word of the input, words being separated by blanks and
+// newlines and shorter than MAXPATH, becomes an argument after
+// the given ones. They are
+// batched as many to a command as exec() allows, or maxargs if
+// that is given. With -P, up to maxprocs commands run at once,
+// and a new one starts as soon as wait() reaps one that has
+// finished, so the commands spread across the harts. Commands
+// are started with spawn(), which copies the arguments before
+// it returns, so one buffer serves every batch.
+//
+// Exits 1 if any command failed or could not be run.
+
+#include "kernel/types.h"
+#include "kernel/param.h"
+#include "user/user.h"
+
+#define ARGSPACE 4096   // bytes of words in one batch
+
+static char  ibuf[512];
+static char* ip;   // next unread byte of ibuf
+static char* ie;   // end of what was read into ibuf
+
+static char  words[ARGSPACE];
+static char* args[MAXARG];
+static int   nfixed;    // arguments from the command line, with the command
+static int   maxargs;   // most words from the input per command
+static int   maxprocs = 1;
+static int   running;   // commands started and not yet reaped
+static int   failed;
+
+// Return the next byte of standard input, or -1 at its end.
+// 读取标准输入的下一个字节
+static int getbyte(void)
+{
+    int n;
+
+    if (ip == ie)
+    {
+        if ((n = read(0, ibuf, sizeof(ibuf))) <= 0)
+            return -1;
+        ip = ibuf;
+        ie = ibuf + n;
+    }
+    return (uchar)*ip++;
+}
+
+// 判断是否为分隔单词的空白符
+static int blank(int c)
+{
+    return c == ' ' || c == '\t' || c == '\n' || c == '\r' || c == '\v';
+}
+
+// Reap one command, noting whether it failed.
+// 回收一个已结束的命令
+static void reap(void)
+{
+    int xstatus;
+
+    if (wait(&xstatus) < 0)
+    {
+        running = 0;
+        return;
+    }
+    running--;
+    if (xstatus != 0)
+        failed = 1;
+}
+
+// Run args[0..n) once fewer than maxprocs commands are running.
+// 在运行中的命令少于 maxprocs 时启动一个命令
+static void run(int n)
+{
+    char path[MAXPATH];
+
+    while (running >= maxprocs)
+        reap();
+    args[n] = 0;
+    if (spawn(args[0], args, 0) < 0)
+    {
+        // a bare name may be a program in /.
+        path[0] = '/';
+        strcpy(path + 1, args[0]);
+        if (args[0][0] == '/' || strlen(args[0]) + 2 > MAXPATH || spawn(path, args, 0) < 0)
+        {
+            fprintf(2, "xargs: cannot run %s\n", args[0]);
+            failed = 1;
+            return;
+        }
+    }
+    running++;
+}
+
+// Read the input a word at a time and run the command on
+// batches of words.
+// 逐词读取输入，按批次运行命令
+static void xargs(void)
+{
+    char *w, *e = words + sizeof(words);
+    int   c, n = nfixed, started = 0;
+
+    w = words;
+    c = getbyte();
+    for (;;)
+    {
+        while (c >= 0 && blank(c))
+            c = getbyte();
+        if (c < 0)
+            break;
+
+        args[n] = w;
+        while (c >= 0 && !blank(c))
+        {
+            if (w - args[n] == MAXPATH - 1)
+            {
+                fprintf(2, "xargs: argument too long\n");
+                exit(1);
+            }
+            *w++ = c;
+            c    = getbyte();
+        }
+        *w++ = 0;
+        n++;
+
+        // a batch ends when it is full, or when the next word,
+        // of less than MAXPATH bytes, might not fit.
+        if (n - nfixed == maxargs || e - w < MAXPATH)
+        {
+            run(n);
+            started = 1;
+            n       = nfixed;
+            w       = words;
+        }
+    }
+    if (n > nfixed || !started)
+        run(n);
+    while (running > 0)
+        reap();
+}
+
+int main(int argc, char* argv[])
+{
+    int i;
+
+    i = 1;
+    while (i + 1 < argc && argv[i][0] == '-')
+    {
+        if (strcmp(argv[i], "-n") == 0)
+            maxargs = atoi(argv[i + 1]);
+        else if (strcmp(argv[i], "-P") == 0)
+            maxprocs = atoi(argv[i + 1]);
+        else
+            break;
+        i += 2;
+    }
+    if (i >= argc || maxprocs < 1 || maxargs < 0)
+    {
+        fprintf(2, "usage: xargs [-n maxargs] [-P maxprocs] command [arg ...]\n");
+        exit(1);
+    }
+    nfixed = argc - i;
+    // exec() takes fewer than MAXARG arguments.
+    if (nfixed >= MAXARG - 1)
+    {
+        fprintf(2, "xargs: too many arguments\n");
+        exit(1);
+    }
+    for (; i < argc; i++)
+        args[i - (argc - nfixed)] = argv[i];
+    if (maxargs == 0 || maxargs > MAXARG - 1 - nfixed)
+        maxargs = MAXARG - 1 - nfixed;
+
+    xargs();
+    exit(failed);
+}
@@ -0,0 +1,81 @@
+// Time xargs running a batch of compute-bound jobs one at a
+// time and with xargs -P, several at once, and print the ticks
+// each took. Each job is this program run as "xargsbench -spin
+// n", one to a command.
+//
+// usage: xargsbench [maxprocs]
+
+#include "kernel/types.h"
+#include "user/user.h"
+
+#define NJOB 32          // jobs in the batch
+#define WORK "2000000"   // steps of each job
+
+// Run an LCG for n steps. The exit status depends on where it
+// went, so that the loop is not optimized away; it is 0 unless
+// it ends on 0.
+// 计算任务：运行 n 步线性同余生成器
+static void spin(int n)
+{
+    uint64 x = n;
+
+    for (int i = 0; i < n; i++)
+        x = x * 6364136223846793005ULL + 1442695040888963407ULL;
+    exit(x == 0);
+}
+
+// Run the batch through "xargs -n 1 -P p", feeding it the jobs
+// through a pipe. Returns the ticks it took.
+// 通过 xargs -P p 运行一批计算任务，返回耗时
+static int batch(char* p)
+{
+    char* argv[] = {"xargs", "-n", "1", "-P", p, "xargsbench", "-spin", 0};
+    int   fd[2], i, t0, xstatus;
+
+    if (pipe(fd) < 0)
+    {
+        fprintf(2, "xargsbench: pipe failed\n");
+        exit(1);
+    }
+    t0 = uptime();
+    if (fork() == 0)
+    {
+        close(0);
+        dup(fd[0]);
+        close(fd[0]);
+        close(fd[1]);
+        exec("xargs", argv);
+        fprintf(2, "xargsbench: exec xargs failed\n");
+        exit(1);
+    }
+    close(fd[0]);
+    for (i = 0; i < NJOB; i++)
+        write(fd[1], WORK "\n", sizeof(WORK));
+    close(fd[1]);
+    wait(&xstatus);
+    if (xstatus != 0)
+    {
+        fprintf(2, "xargsbench: xargs failed\n");
+        exit(1);
+    }
+    return uptime() - t0;
+}
+
+int main(int argc, char* argv[])
+{
+    char* p = argc > 1 ? argv[1] : "8";
+    int   t1, tp;
+
+    if (argc > 2 && strcmp(argv[1], "-spin") == 0)
+        spin(atoi(argv[2]));
+    if (atoi(p) < 1)
+    {
+        fprintf(2, "usage: xargsbench [maxprocs]\n");
+        exit(1);
+    }
+
+    t1 = batch("1");
+    tp = batch(p);
+    printf("%d jobs: -P 1 %d ticks, -P %s %d ticks\n", NJOB, t1, p, tp);
+    exit(0);
+}